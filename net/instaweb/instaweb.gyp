@@ -1458,6 +1458,7 @@
         'rewriter/css_inline_import_to_link_filter.cc',
         'rewriter/css_minify.cc',
         'rewriter/css_resource_slot.cc',
+        'rewriter/css_rule_index.cc',
         'rewriter/css_summarizer_base.cc',
         'rewriter/css_url_counter.cc',
         'rewriter/css_url_encoder.cc',
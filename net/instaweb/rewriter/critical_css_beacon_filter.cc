@@ -23,6 +23,7 @@
 
 #include "net/instaweb/rewriter/public/critical_finder_support_util.h"
 #include "net/instaweb/rewriter/public/critical_selector_finder.h"
+#include "net/instaweb/rewriter/public/css_rule_index.h"
 #include "net/instaweb/rewriter/public/css_tag_scanner.h"
 #include "net/instaweb/rewriter/public/css_util.h"
 #include "net/instaweb/rewriter/public/request_properties.h"
@@ -38,14 +39,9 @@
 #include "pagespeed/kernel/html/html_element.h"
 #include "pagespeed/kernel/html/html_name.h"
 #include "pagespeed/kernel/http/google_url.h"
-#include "webutil/css/media.h"
 #include "webutil/css/parser.h"
-#include "webutil/css/selector.h"
 
-using Css::Selectors;
 using Css::Stylesheet;
-using Css::Ruleset;
-using Css::Rulesets;
 
 namespace net_instaweb {
 
@@ -94,12 +90,24 @@ bool CriticalCssBeaconFilter::MustSummarize(HtmlElement* element) const {
       css_util::CanMediaAffectScreen(element->AttributeValue(HtmlName::kMedia));
 }
 
+// The summary is the sorted, comma-separated list of distinct JS-detectable
+// selectors of the rules that can affect the screen.  An empty trimmed
+// selector (eg :hover, which gets stripped away as it's not JS detectable) is
+// *automatically* critical, so it is left out.
 void CriticalCssBeaconFilter::Summarize(Stylesheet* stylesheet,
                                         GoogleString* out) const {
-  StringSet selectors;
-  FindSelectorsFromStylesheet(*stylesheet, &selectors);
-  // Serialize set into out.
-  AppendJoinCollection(out, selectors, ",");
+  CssRuleIndex index(stylesheet);
+  index.AppendSelectorKeys(out);
+}
+
+bool CriticalCssBeaconFilter::SummarizeContents(StringPiece contents,
+                                                GoogleString* out) const {
+  CssRuleIndexPtr index(GetRuleIndex(contents));
+  if (index.get() == NULL) {
+    return false;
+  }
+  index->AppendSelectorKeys(out);
+  return true;
 }
 
 // Append the selector list initialization JavaScript to |script|.
@@ -221,40 +229,4 @@ void CriticalCssBeaconFilter::DetermineEnabled(GoogleString* disabled_reason) {
   set_is_enabled(driver()->request_properties()->SupportsCriticalCssBeacon());
 }
 
-void CriticalCssBeaconFilter::FindSelectorsFromRuleset(
-    const Ruleset& ruleset, StringSet* selectors) {
-  const Selectors& rule_selectors = ruleset.selectors();
-  for (int i = 0, n = rule_selectors.size(); i < n; ++i) {
-    GoogleString trimmed(css_util::JsDetectableSelector(*rule_selectors[i]));
-    if (!trimmed.empty()) {
-      // Non-empty trimmed selector.  An empty trimmed selector (eg :hover,
-      // which gets stripped away as it's not JS detectable) is *automatically*
-      // critical, and we could also ignore the selector * (:hover is implicitly
-      // *:hover).
-      selectors->insert(trimmed);
-    }
-  }
-}
-
-// Returns false on parse failure, else records css selectors (in normalized
-// string form) in selectors.  The selectors will be sorted and unique.  Logging
-// of failures etc. should be done in the caller.
-void CriticalCssBeaconFilter::FindSelectorsFromStylesheet(
-    const Stylesheet& css, StringSet* selectors) {
-  const Rulesets& rulesets = css.rulesets();
-  for (int i = 0, n = rulesets.size(); i < n; ++i) {
-    Ruleset* ruleset = rulesets[i];
-    if (ruleset->type() == Ruleset::UNPARSED_REGION) {
-      // Couldn't parse this as a rule.
-      continue;
-    }
-    // Skip rules that can't apply to the screen.
-    if (!css_util::CanMediaAffectScreen(ruleset->media_queries().ToString())) {
-      continue;
-    }
-    // Record the selectors associated with this ruleset.
-    FindSelectorsFromRuleset(*ruleset, selectors);
-  }
-}
-
 }  // namespace net_instaweb
@@ -27,7 +27,7 @@
 #include "base/logging.h"
 #include "net/instaweb/http/public/log_record.h"
 #include "net/instaweb/rewriter/public/critical_selector_finder.h"
-#include "net/instaweb/rewriter/public/css_minify.h"
+#include "net/instaweb/rewriter/public/css_rule_index.h"
 #include "net/instaweb/rewriter/public/css_tag_scanner.h"
 #include "net/instaweb/rewriter/public/css_util.h"
 #include "net/instaweb/rewriter/public/request_properties.h"
@@ -37,7 +37,6 @@
 #include "net/instaweb/rewriter/public/static_asset_manager.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/hasher.h"
-#include "pagespeed/kernel/base/null_message_handler.h"
 #include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
@@ -49,9 +48,7 @@
 #include "pagespeed/kernel/html/html_parse.h"
 #include "pagespeed/kernel/http/google_url.h"
 #include "pagespeed/opt/logging/enums.pb.h"
-#include "webutil/css/media.h"
 #include "webutil/css/parser.h"
-#include "webutil/css/selector.h"
 
 namespace net_instaweb {
 
@@ -143,69 +140,18 @@ CriticalSelectorFilter::~CriticalSelectorFilter() {
 
 void CriticalSelectorFilter::Summarize(Css::Stylesheet* stylesheet,
                                        GoogleString* out) const {
-  for (int ruleset_index = 0, num_rulesets = stylesheet->rulesets().size();
-       ruleset_index < num_rulesets; ++ruleset_index) {
-    Css::Ruleset* r = stylesheet->mutable_rulesets().at(ruleset_index);
-    if (r->type() == Css::Ruleset::UNPARSED_REGION) {
-      // Couldn't parse this as a rule, leave unaltered. Hopefully it's not
-      // too big..
-      continue;
-    }
-
-    // TODO(morlovich): This does a lot of repeated work as the same media
-    // entries are repeated for tons of rulesets.
-    // TODO(morlovich): It's silly to serialize this, we should work directly
-    // off AST once we have decision procedure on that.
-
-    bool any_media_apply = r->media_queries().empty();
-    for (int mediaquery_index = 0, num_mediaquery = r->media_queries().size();
-         mediaquery_index < num_mediaquery; ++mediaquery_index) {
-      Css::MediaQuery* mq = r->mutable_media_queries().at(mediaquery_index);
-      if (css_util::CanMediaAffectScreen(mq->ToString())) {
-        any_media_apply = true;
-      } else {
-        delete mq;
-        r->mutable_media_queries()[mediaquery_index] = NULL;
-      }
-    }
-
-    bool any_selectors_apply = false;
-    if (any_media_apply) {
-      // See which of the selectors for given declaration apply.
-      // Note that in some partial parse errors we will get 0 selectors here,
-      // in which case we retain things to be conservative.
-      any_selectors_apply = r->selectors().empty();
-      for (int selector_index = 0, num_selectors = r->selectors().size();
-          selector_index < num_selectors; ++selector_index) {
-        Css::Selector* s = r->mutable_selectors().at(selector_index);
-        GoogleString portion_to_compare = css_util::JsDetectableSelector(*s);
-        if (portion_to_compare.empty() ||
-            critical_selectors_.find(portion_to_compare)
-                != critical_selectors_.end()) {
-          any_selectors_apply = true;
-        } else {
-          delete s;
-          r->mutable_selectors()[selector_index] = NULL;
-        }
-      }
-    }
+  CssRuleIndex index(stylesheet);
+  index.AppendCriticalSubset(critical_selectors_, out);
+}
 
-    if (any_selectors_apply && any_media_apply) {
-      // Just remove the irrelevant selectors & media
-      Compact(&r->mutable_selectors());
-      Compact(&r->mutable_media_queries());
-    } else {
-      // Remove the entire production
-      delete r;
-      stylesheet->mutable_rulesets()[ruleset_index] = NULL;
-    }
+bool CriticalSelectorFilter::SummarizeContents(StringPiece contents,
+                                               GoogleString* out) const {
+  CssRuleIndexPtr index(GetRuleIndex(contents));
+  if (index.get() == NULL) {
+    return false;
   }
-  Compact(&stylesheet->mutable_rulesets());
-
-  // Serialize out the remaining subset.
-  StringWriter writer(out);
-  NullMessageHandler handler;
-  CssMinify::Stylesheet(*stylesheet, &writer, &handler);
+  index->AppendCriticalSubset(critical_selectors_, out);
+  return true;
 }
 
 void CriticalSelectorFilter::RenderSummary(
@@ -197,6 +197,34 @@ TEST_F(CriticalSelectorFilterTest, BasicOperation) {
   ValidateRewriterLogging(RewriterHtmlApplication::ACTIVE);
 }
 
+TEST_F(CriticalSelectorFilterTest, RuleIndexSharedAcrossSelectorSets) {
+  GoogleString html = StrCat(
+      "<head>",
+      "<style>*,p {display: none; } span {display: inline; }</style>",
+      CssLinkHref("a.css"),
+      CssLinkHref("b.css"),
+      "</head>"
+      "<body><div>Stuff</div></body>");
+  Parse("first_selectors", html);
+  EXPECT_EQ(0, statistics()->GetVariable(
+      CssSummarizerBase::kCssRuleIndexCacheHits)->Get());
+  EXPECT_EQ(3, statistics()->GetVariable(
+      CssSummarizerBase::kCssRuleIndexCacheMisses)->Get());
+
+  // A different set of critical selectors makes for different summaries, but
+  // the stylesheets do not need to be parsed again.
+  StringSet selectors;
+  selectors.insert("span");
+  WriteCriticalSelectorsToPropertyCache(selectors);
+  Parse("second_selectors", html);
+  EXPECT_EQ(3, statistics()->GetVariable(
+      CssSummarizerBase::kCssRuleIndexCacheHits)->Get());
+  EXPECT_EQ(3, statistics()->GetVariable(
+      CssSummarizerBase::kCssRuleIndexCacheMisses)->Get());
+  EXPECT_NE(GoogleString::npos,
+            output_buffer_.find("<style>span{display:inline}</style>"));
+}
+
 TEST_F(CriticalSelectorFilterTest, UnauthorizedCss) {
   GoogleString css = StrCat(
       "<style>*,p {display: none; } span {display: inline; }</style>",
@@ -63,6 +63,7 @@
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/string_writer.h"
+#include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/html/html_element.h"
 #include "pagespeed/kernel/html/html_name.h"
 #include "pagespeed/kernel/html/html_node.h"
@@ -150,6 +151,11 @@ const char CssFilter::kBlocksRewritten[] = "css_filter_blocks_rewritten";
 const char CssFilter::kParseFailures[] = "css_filter_parse_failures";
 const char CssFilter::kFallbackRewrites[] = "css_filter_fallback_rewrites";
 const char CssFilter::kFallbackFailures[] = "css_filter_fallback_failures";
+const char CssFilter::kMinifySkipped[] = "css_filter_minify_skipped";
+const char CssFilter::kMinifyBytes[] = "css_filter_minify_bytes";
+const char CssFilter::kMinifyUs[] = "css_filter_minify_us";
+const char CssFilter::kMinifySkippedSavedUs[] =
+    "css_filter_minify_skipped_saved_us";
 const char CssFilter::kRewritesDropped[] = "css_filter_rewrites_dropped";
 const char CssFilter::kTotalBytesSaved[] = "css_filter_total_bytes_saved";
 const char CssFilter::kTotalOriginalBytes[] = "css_filter_total_original_bytes";
@@ -178,6 +184,7 @@ CssFilter::Context::Context(CssFilter* filter, RewriteDriver* driver,
       css_rewritten_(false),
       has_utf8_bom_(false),
       fallback_mode_(false),
+      minify_skipped_(false),
       rewrite_element_(NULL),
       rewrite_inline_element_(NULL),
       rewrite_inline_char_node_(NULL),
@@ -367,10 +374,27 @@ void CssFilter::Context::RewriteSingle(
   GetCssBaseUrlToUse(input_resource, &css_base_gurl_to_use);
   GoogleUrl css_trim_gurl_to_use;
   GetCssTrimUrlToUse(input_resource, output_resource_, &css_trim_gurl_to_use);
-  bool parsed = RewriteCssText(
-      css_base_gurl_to_use, css_trim_gurl_to_use, input_contents, in_text_size_,
-      IsInlineAttribute() /* text_is_declarations */,
-      Driver()->message_handler());
+  bool parsed;
+  if (ShouldSkipMinify(input_contents)) {
+    minify_skipped_ = true;
+    filter_->num_minify_skipped_->Add(1);
+    // We did not measure what parsing would have cost, so go by how long
+    // it took for the CSS that was parsed.
+    int64 minify_bytes = filter_->minify_bytes_->Get();
+    if (minify_bytes > 0) {
+      double us_per_byte =
+          static_cast<double>(filter_->minify_us_->Get()) / minify_bytes;
+      filter_->minify_skipped_saved_us_->Add(
+          static_cast<int64>(us_per_byte * in_text_size_));
+    }
+    parsed = RewriteUrlsOnly(css_base_gurl_to_use, css_trim_gurl_to_use,
+                             input_contents);
+  } else {
+    parsed = RewriteCssText(
+        css_base_gurl_to_use, css_trim_gurl_to_use, input_contents,
+        in_text_size_, IsInlineAttribute() /* text_is_declarations */,
+        Driver()->message_handler());
+  }
 
   if (parsed) {
     if (num_nested() > 0) {
@@ -395,6 +419,9 @@ bool CssFilter::Context::RewriteCssText(const GoogleUrl& css_base_gurl,
                                         int64 in_text_size,
                                         bool text_is_declarations,
                                         MessageHandler* handler) {
+  Timer* timer = FindServerContext()->timer();
+  int64 start_us = timer->NowUs();
+
   // Load stylesheet w/o expanding background attributes and preserving as
   // much content as possible from the original document.
   Css::Parser parser(in_text);
@@ -416,6 +443,8 @@ bool CssFilter::Context::RewriteCssText(const GoogleUrl& css_base_gurl,
   } else {
     stylesheet.reset(parser.ParseRawStylesheet());
   }
+  filter_->minify_us_->Add(timer->NowUs() - start_us);
+  filter_->minify_bytes_->Add(in_text_size);
 
   bool parsed = true;
   if (stylesheet.get() == NULL ||
@@ -452,7 +481,7 @@ bool CssFilter::Context::RewriteCssText(const GoogleUrl& css_base_gurl,
 
   if (!parsed &&
       Driver()->options()->Enabled(RewriteOptions::kFallbackRewriteCssUrls)) {
-    parsed = FallbackRewriteUrls(css_base_gurl, css_trim_gurl, in_text);
+    parsed = RewriteUrlsOnly(css_base_gurl, css_trim_gurl, in_text);
   }
 
   return parsed;
@@ -483,10 +512,21 @@ void CssFilter::Context::RewriteCssFromNested(RewriteContext* parent,
                                   Driver()->message_handler());
 }
 
-// Fallback to rewriting URLs using CssTagScanner because of failure to parse.
+bool CssFilter::Context::ShouldSkipMinify(StringPiece in_text) const {
+  // Flattening and spriting work on the parsed stylesheet, so if either is
+  // enabled we have to parse anyway.
+  int min_savings_percent = Options()->css_minify_min_savings_percent();
+  return (min_savings_percent > 0 &&
+          !Driver()->FlattenCssImportsEnabled() &&
+          !Options()->Enabled(RewriteOptions::kSpriteImages) &&
+          CssMinify::EstimateSavingsPercent(in_text) < min_savings_percent);
+}
+
+// Rewrite URLs using CssTagScanner, either because the CSS looks minified
+// already or because of failure to parse.
 // Note: We do not flatten CSS during fallback processing.
 // TODO(sligocki): Allow recursive rewriting of @imported CSS files.
-bool CssFilter::Context::FallbackRewriteUrls(
+bool CssFilter::Context::RewriteUrlsOnly(
     const GoogleUrl& css_base_gurl, const GoogleUrl& css_trim_gurl,
     const StringPiece& in_text) {
   fallback_mode_ = true;
@@ -567,15 +607,29 @@ void CssFilter::Context::Harvest() {
   CssImageRewriter::InheritChildImageInfo(this);
 
   if (fallback_mode_) {
-    // If CSS was not successfully parsed.
+    // If CSS was not parsed.
+    StringPiece in_text = input_resource_->ExtractUncompressedContents();
     if (fallback_transformer_.get() != NULL) {
       StringWriter out(&out_text);
       ok = CssTagScanner::TransformUrls(
-          input_resource_->ExtractUncompressedContents(), &out,
-          fallback_transformer_.get(), Driver()->message_handler());
+          in_text, &out, fallback_transformer_.get(),
+          Driver()->message_handler());
     }
-    if (ok) {
+    if (ok && minify_skipped_) {
+      // Unlike the fallback, this path was not forced on us, so only keep
+      // the result if it changed something.  Either way the block has been
+      // counted in num_minify_skipped_, and only there.
+      if (out_text == in_text && !Options()->always_rewrite_css()) {
+        ok = false;
+      }
+    } else if (ok) {
       filter_->num_fallback_rewrites_->Add(1);
+    } else if (minify_skipped_) {
+      GoogleUrl css_base_gurl;
+      GetCssBaseUrlToUse(input_resource_, &css_base_gurl);
+      mutable_output_partition(0)->add_debug_message(StrCat(
+          "CSS rewrite failed: URL transformer error in ",
+          css_base_gurl.Spec()));
     } else {
       filter_->num_fallback_failures_->Add(1);
       GoogleUrl css_base_gurl;
@@ -643,11 +697,14 @@ void CssFilter::Context::Harvest() {
           Driver()->message_handler());
     }
 
+    Timer* timer = FindServerContext()->timer();
+    int64 start_us = timer->NowUs();
     ok = SerializeCss(
         in_text_size_, hierarchy_.mutable_stylesheet(), css_base_gurl_to_use,
         css_trim_gurl_to_use, previously_optimized || absolutified_urls,
         IsInlineAttribute() /* stylesheet_is_declarations */, has_utf8_bom_,
         &out_text, Driver()->message_handler());
+    filter_->minify_us_->Add(timer->NowUs() - start_us);
   }
 
   if (ok) {
@@ -840,6 +897,11 @@ CssFilter::CssFilter(RewriteDriver* driver,
   num_parse_failures_ = stats->GetVariable(CssFilter::kParseFailures);
   num_fallback_rewrites_ = stats->GetVariable(CssFilter::kFallbackRewrites);
   num_fallback_failures_ = stats->GetVariable(CssFilter::kFallbackFailures);
+  num_minify_skipped_ = stats->GetVariable(CssFilter::kMinifySkipped);
+  minify_bytes_ = stats->GetVariable(CssFilter::kMinifyBytes);
+  minify_us_ = stats->GetVariable(CssFilter::kMinifyUs);
+  minify_skipped_saved_us_ =
+      stats->GetVariable(CssFilter::kMinifySkippedSavedUs);
   num_rewrites_dropped_ = stats->GetVariable(CssFilter::kRewritesDropped);
   total_bytes_saved_ = stats->GetUpDownCounter(CssFilter::kTotalBytesSaved);
   total_original_bytes_ = stats->GetVariable(CssFilter::kTotalOriginalBytes);
@@ -859,6 +921,10 @@ void CssFilter::InitStats(Statistics* statistics) {
   statistics->AddVariable(CssFilter::kParseFailures);
   statistics->AddVariable(CssFilter::kFallbackRewrites);
   statistics->AddVariable(CssFilter::kFallbackFailures);
+  statistics->AddVariable(CssFilter::kMinifySkipped);
+  statistics->AddVariable(CssFilter::kMinifyBytes);
+  statistics->AddVariable(CssFilter::kMinifyUs);
+  statistics->AddVariable(CssFilter::kMinifySkippedSavedUs);
   statistics->AddVariable(CssFilter::kRewritesDropped);
   statistics->AddUpDownCounter(CssFilter::kTotalBytesSaved);
   statistics->AddVariable(CssFilter::kTotalOriginalBytes);
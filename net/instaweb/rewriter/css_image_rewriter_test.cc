@@ -19,6 +19,7 @@
 #include "base/logging.h"
 #include "net/instaweb/http/public/http_cache.h"
 #include "net/instaweb/http/public/http_value.h"
+#include "net/instaweb/rewriter/public/css_filter.h"
 #include "net/instaweb/rewriter/public/css_rewrite_test_base.h"
 #include "net/instaweb/rewriter/public/domain_lawyer.h"
 #include "net/instaweb/rewriter/public/image_rewrite_filter.h"
@@ -859,6 +860,55 @@ TEST_F(CssImageRewriterTest, FallbackImportsAndUnknownContentType) {
                              kExpectFallback | kNoClearFetcher);
 }
 
+// CSS that is minified already only has its URLs rewritten, while CSS with
+// enough whitespace to be worth it is still minified.
+TEST_F(CssImageRewriterTest, CacheExtendsImagesMinifySkipped) {
+  options()->ClearSignatureForTesting();
+  options()->set_css_minify_min_savings_percent(5);
+  server_context()->ComputeSignature(options());
+
+  SetResponseWithDefaultHeaders("foo.png", kContentTypePng, kDummyContent, 100);
+  static const char pretty_template[] =
+      "body {\n"
+      "  background-image: url(%s);\n"
+      "}\n";
+  static const char minified_template[] = "body{background-image:url(%s)}";
+  GoogleString pretty_css = StringPrintf(pretty_template, "foo.png");
+  SetResponseWithDefaultHeaders("pretty.css", kContentTypeCss, pretty_css, 100);
+  SetResponseWithDefaultHeaders("minified.css", kContentTypeCss,
+                                StringPrintf(minified_template, "foo.png"),
+                                100);
+  GoogleString rewritten_png = Encode("", "ce", "0", "foo.png", "png");
+
+  GoogleString content;
+  FetchResource(kTestDomain, "cf", "pretty.css", "css", &content);
+  EXPECT_STREQ(StringPrintf(minified_template, rewritten_png.c_str()),
+               content);
+  EXPECT_EQ(0, statistics()->GetVariable(CssFilter::kMinifySkipped)->Get());
+  EXPECT_EQ(static_cast<int64>(pretty_css.size()),
+            statistics()->GetVariable(CssFilter::kMinifyBytes)->Get());
+
+  content.clear();
+  FetchResource(kTestDomain, "cf", "minified.css", "css", &content);
+  EXPECT_STREQ(StringPrintf(minified_template, rewritten_png.c_str()),
+               content);
+  EXPECT_EQ(1, statistics()->GetVariable(CssFilter::kMinifySkipped)->Get());
+  EXPECT_EQ(0, num_rewrites_dropped_->Get());
+  EXPECT_EQ(static_cast<int64>(pretty_css.size()),
+            statistics()->GetVariable(CssFilter::kMinifyBytes)->Get());
+  EXPECT_EQ(0, num_parse_failures_->Get());
+
+  // Without URLs nothing changes, so the rewrite is not used, but it is still
+  // only counted as skipped.
+  SetResponseWithDefaultHeaders("no_urls.css", kContentTypeCss,
+                                "body{color:red}", 100);
+  content.clear();
+  FetchResource(kTestDomain, "cf", "no_urls.css", "css", &content);
+  EXPECT_STREQ("body{color:red}", content);
+  EXPECT_EQ(2, statistics()->GetVariable(CssFilter::kMinifySkipped)->Get());
+  EXPECT_EQ(0, num_rewrites_dropped_->Get());
+}
+
 // Test that the fallback fetcher fails smoothly.
 TEST_F(CssImageRewriterTest, FallbackFails) {
   // Note: //// is not a valid URL leading to fallback rewrite failure.
@@ -19,6 +19,7 @@
 #include "net/instaweb/rewriter/public/css_minify.h"
 
 #include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include "base/logging.h"
@@ -52,6 +53,9 @@ bool CssMinify::ParseStylesheet(StringPiece stylesheet_text) {
   Css::Parser parser(stylesheet_text);
   parser.set_preservation_mode(true);  // Leave in unparseable regions.
   parser.set_quirks_mode(false);  // Don't fix badly formatted colors.
+  // The stylesheet is only used to produce the minified text, before
+  // stylesheet_text goes away.
+  parser.set_use_arena(true);
   scoped_ptr<Css::Stylesheet> stylesheet(parser.ParseRawStylesheet());
 
   // Report error summary.
@@ -88,6 +92,82 @@ bool CssMinify::Declarations(const Css::Declarations& declarations,
   return minifier.ok_;
 }
 
+bool CssMinify::Selector(const Css::Selector& selector,
+                         Writer* writer,
+                         MessageHandler* handler) {
+  CssMinify minifier(writer, handler);
+  minifier.Minify(selector);
+  return minifier.ok_;
+}
+
+bool CssMinify::MediaQueries(const Css::MediaQueries& media_queries,
+                             Writer* writer,
+                             MessageHandler* handler) {
+  CssMinify minifier(writer, handler);
+  minifier.JoinMinify(media_queries, ",");
+  return minifier.ok_;
+}
+
+bool CssMinify::RulesetIgnoringMedia(const Css::Ruleset& ruleset,
+                                     Writer* writer,
+                                     MessageHandler* handler) {
+  CssMinify minifier(writer, handler);
+  minifier.MinifyRulesetIgnoringMedia(ruleset);
+  return minifier.ok_;
+}
+
+namespace {
+
+// Returns the number of bytes in data that are <= ' ', i.e. whitespace (or
+// control characters, which are rare enough not to matter for an estimate).
+// We look at a machine word at a time: for a byte b < 0x80, 0x7f + 0x21 - b
+// has its high bit set iff b <= 0x20, and the subtraction cannot borrow from
+// the next byte.  Bytes >= 0x80 are masked out by ~word.
+size_t CountWhitespaceBytes(const char* data, size_t size) {
+  static const uint64 kOnes = 0x0101010101010101ULL;
+  static const uint64 kLowBits = kOnes * 0x7f;
+  static const uint64 kHighBits = kOnes * 0x80;
+  static const uint64 kThresholds = kOnes * (0x7f + 0x21);
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + sizeof(uint64) <= size; i += sizeof(uint64)) {
+    uint64 word;
+    memcpy(&word, data + i, sizeof(word));
+    uint64 hits = (kThresholds - (word & kLowBits)) & ~word & kHighBits;
+    // Each byte of hits >> 7 is 0 or 1; multiplying by kOnes sums them all
+    // into the top byte.
+    count += ((hits >> 7) * kOnes) >> 56;
+  }
+  for (; i < size; ++i) {
+    if (static_cast<uint8>(data[i]) <= ' ') {
+      ++count;
+    }
+  }
+  return count;
+}
+
+}  // namespace
+
+int CssMinify::EstimateSavingsPercent(StringPiece stylesheet_text) {
+  if (stylesheet_text.empty()) {
+    return 0;
+  }
+  size_t size = stylesheet_text.size();
+  size_t removable = CountWhitespaceBytes(stylesheet_text.data(), size);
+  // Comments are few and far between, so jump from one to the next.  Any
+  // whitespace inside them is counted twice, and "/*" in a string is taken
+  // for a comment; neither matters for an estimate.
+  for (StringPiece::size_type start = stylesheet_text.find("/*");
+       start != StringPiece::npos;
+       start = stylesheet_text.find("/*", start)) {
+    StringPiece::size_type end = stylesheet_text.find("*/", start + 2);
+    end = (end == StringPiece::npos) ? size : end + 2;
+    removable += end - start;
+    start = end;
+  }
+  return static_cast<int>(std::min(removable, size) * 100 / size);
+}
+
 CssMinify::CssMinify(Writer* writer, MessageHandler* handler)
     : writer_(writer), error_writer_(NULL), handler_(handler), ok_(true),
       url_collector_(NULL) {
@@ -46,6 +46,8 @@
 // interleaved runs with the old & new algorithm.
 
 #include "net/instaweb/rewriter/public/css_minify.h"
+#include "net/instaweb/rewriter/public/css_tag_scanner.h"
+#include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/benchmark.h"
 #include "pagespeed/kernel/base/null_message_handler.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
@@ -60,7 +62,8 @@ extern const char* CSS_console_css;
 
 namespace {
 
-static void BM_MinifyCss(int iters, int size) {
+void MinifyCss(int iters, int size, bool use_arena) {
+  StopBenchmarkTiming();
   GoogleString in_text;
   for (int i = 0; i < size; i += strlen(CSS_console_css)) {
     in_text += CSS_console_css;
@@ -68,10 +71,12 @@ static void BM_MinifyCss(int iters, int size) {
   in_text.resize(size);
 
   NullMessageHandler handler;
+  StartBenchmarkTiming();
   for (int i = 0; i < iters; ++i) {
     Css::Parser parser(in_text);
     parser.set_preservation_mode(true);
     parser.set_quirks_mode(false);
+    parser.set_use_arena(use_arena);
     scoped_ptr<Css::Stylesheet> stylesheet(parser.ParseRawStylesheet());
 
     GoogleString result;
@@ -79,8 +84,68 @@ static void BM_MinifyCss(int iters, int size) {
     CssMinify::Stylesheet(*stylesheet, &writer, &handler);
   }
 }
+
+static void BM_MinifyCss(int iters, int size) {
+  MinifyCss(iters, size, false);
+}
 BENCHMARK_RANGE(BM_MinifyCss, 1<<6, 1<<18);
 
+// As above, but with the whole AST in one Css::Arena.
+static void BM_MinifyCssArena(int iters, int size) {
+  MinifyCss(iters, size, true);
+}
+BENCHMARK_RANGE(BM_MinifyCssArena, 1<<6, 1<<18);
+
+// Rewrites every URL, the way CssFilter does when it only needs to touch the
+// URLs.  Compare with BM_MinifyCss.
+class PrefixTransformer : public CssTagScanner::Transformer {
+ public:
+  PrefixTransformer() {}
+  virtual TransformStatus Transform(GoogleString* str) {
+    str->insert(0, "http://cdn.example.com/");
+    return kSuccess;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PrefixTransformer);
+};
+
+static void BM_TransformCssUrls(int iters, int size) {
+  StopBenchmarkTiming();
+  GoogleString in_text;
+  for (int i = 0; i < size; i += strlen(CSS_console_css)) {
+    in_text += CSS_console_css;
+  }
+  in_text.resize(size);
+
+  NullMessageHandler handler;
+  PrefixTransformer transformer;
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    GoogleString result;
+    StringWriter writer(&result);
+    CssTagScanner::TransformUrls(in_text, &writer, &transformer, &handler);
+  }
+}
+BENCHMARK_RANGE(BM_TransformCssUrls, 1<<6, 1<<18);
+
+// The pre-scan CssFilter runs to decide whether minifying is worth it.
+// Compare with BM_MinifyCss, which is what it saves.
+static void BM_EstimateSavingsPercent(int iters, int size) {
+  StopBenchmarkTiming();
+  GoogleString in_text;
+  for (int i = 0; i < size; i += strlen(CSS_console_css)) {
+    in_text += CSS_console_css;
+  }
+  in_text.resize(size);
+
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    CssMinify::EstimateSavingsPercent(in_text);
+  }
+}
+BENCHMARK_RANGE(BM_EstimateSavingsPercent, 1<<6, 1<<18);
+
 // Common-case, all chars are normal alpha-num that don't need to be escaped.
 static void BM_EscapeStringNormal(int iters, int size) {
   GoogleString ident(size, 'A');
@@ -255,5 +255,20 @@ TEST_F(CssMinifyTest, StraySingleQuote3) {
   EXPECT_STREQ(".view_all a{display:block;margin:1px}", minified);
 }
 
+TEST_F(CssMinifyTest, EstimateSavingsPercent) {
+  EXPECT_EQ(0, CssMinify::EstimateSavingsPercent(""));
+  EXPECT_EQ(0, CssMinify::EstimateSavingsPercent("a{b:c}"));
+  EXPECT_EQ(40, CssMinify::EstimateSavingsPercent("a { b: c }"));
+  // Long enough to be counted a word at a time, with a tail.
+  EXPECT_EQ(72, CssMinify::EstimateSavingsPercent(
+      "\t\t\t\t\n\n\n\n        a{b:c}"));
+  // Bytes with the high bit set are not whitespace.
+  EXPECT_EQ(11, CssMinify::EstimateSavingsPercent(
+      "\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9 "));
+  // Comments, including an unterminated one, count in full.
+  EXPECT_EQ(69, CssMinify::EstimateSavingsPercent("/* x */a{b:c}"));
+  EXPECT_EQ(71, CssMinify::EstimateSavingsPercent("a{}/* x"));
+}
+
 }  // namespace
 }  // namespace net_instaweb
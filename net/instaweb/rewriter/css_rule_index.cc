@@ -0,0 +1,259 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/instaweb/rewriter/public/css_rule_index.h"
+
+#include <algorithm>
+
+#include "net/instaweb/rewriter/public/css_minify.h"
+#include "net/instaweb/rewriter/public/css_util.h"
+#include "pagespeed/kernel/base/abstract_mutex.h"
+#include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/stl_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
+#include "webutil/css/media.h"
+#include "webutil/css/parser.h"
+#include "webutil/css/selector.h"
+
+namespace net_instaweb {
+
+// One ruleset (or unparsed region) of the stylesheet.  The output for a
+// ruleset whose selectors are filtered is the kept entries of
+// selector_texts joined by commas, followed by text.  Otherwise it is just
+// text.
+struct CssRuleIndex::Rule {
+  Rule() : always_kept(false) {}
+
+  // Minified media queries the rule is wrapped in, empty for none.
+  GoogleString media;
+
+  // True if the rule is emitted whatever the critical selectors are, with
+  // no filtering of its selectors.
+  bool always_kept;
+
+  // css_util::JsDetectableSelector() of each selector, and its minified
+  // text.  Empty if always_kept.
+  StringVector selector_keys;
+  StringVector selector_texts;
+
+  // The whole minified rule if always_kept, otherwise its declaration block
+  // including the braces.
+  GoogleString text;
+};
+
+CssRuleIndex::CssRuleIndex(Css::Stylesheet* stylesheet) : size_bytes_(0) {
+  NullMessageHandler handler;
+  Css::Rulesets& rulesets = stylesheet->mutable_rulesets();
+  for (int i = 0, n = rulesets.size(); i < n; ++i) {
+    Css::Ruleset* r = rulesets[i];
+    Css::MediaQueries& media_queries = r->mutable_media_queries();
+    if (r->type() == Css::Ruleset::RULESET) {
+      // Only keep the media that can apply to the screen, and drop the rule
+      // entirely if there are none.
+      bool any_media_apply = media_queries.empty();
+      for (int j = 0, num_media = media_queries.size(); j < num_media; ++j) {
+        if (css_util::CanMediaAffectScreen(media_queries[j]->ToString())) {
+          any_media_apply = true;
+        } else {
+          delete media_queries[j];
+          media_queries[j] = NULL;
+        }
+      }
+      media_queries.erase(
+          std::remove(media_queries.begin(), media_queries.end(),
+                      static_cast<Css::MediaQuery*>(NULL)),
+          media_queries.end());
+      if (!any_media_apply) {
+        continue;
+      }
+    }
+
+    int rule_index = rules_.size();
+    Rule* rule = new Rule;
+    rules_.push_back(rule);
+    StringWriter media_writer(&rule->media);
+    CssMinify::MediaQueries(media_queries, &media_writer, &handler);
+    StringWriter text_writer(&rule->text);
+    // Note that in some partial parse errors we will get 0 selectors, in
+    // which case we retain the rule to be conservative.
+    if (r->type() != Css::Ruleset::RULESET || r->selectors().empty()) {
+      rule->always_kept = true;
+      always_kept_.push_back(SelectorPosition(rule_index, -1));
+      CssMinify::RulesetIgnoringMedia(*r, &text_writer, &handler);
+    } else {
+      const Css::Selectors& selectors = r->selectors();
+      for (int j = 0, num_selectors = selectors.size(); j < num_selectors;
+           ++j) {
+        const Css::Selector& selector = *selectors[j];
+        rule->selector_keys.push_back(css_util::JsDetectableSelector(selector));
+        StringWriter selector_writer(StringVectorAdd(&rule->selector_texts));
+        CssMinify::Selector(selector, &selector_writer, &handler);
+        const GoogleString& key = rule->selector_keys.back();
+        SelectorPosition position(rule_index, j);
+        if (key.empty()) {
+          always_kept_.push_back(position);
+        } else {
+          SelectorPositions& positions = selector_index_[key];
+          if (positions.empty()) {
+            size_bytes_ += sizeof(SelectorIndex::value_type) + key.size();
+          }
+          positions.push_back(position);
+        }
+        size_bytes_ += 2 * key.size() + rule->selector_texts.back().size() +
+            sizeof(position);
+      }
+      text_writer.Write("{", &handler);
+      CssMinify::Declarations(r->declarations(), &text_writer, &handler);
+      text_writer.Write("}", &handler);
+    }
+    size_bytes_ += sizeof(*rule) + rule->media.size() + rule->text.size();
+  }
+
+  // What is left is minified as it would be at the head of the output.
+  STLDeleteElements(&rulesets);
+  StringWriter preamble_writer(&preamble_);
+  CssMinify::Stylesheet(*stylesheet, &preamble_writer, &handler);
+  size_bytes_ += sizeof(*this) + preamble_.size();
+}
+
+CssRuleIndex::~CssRuleIndex() {
+  STLDeleteElements(&rules_);
+}
+
+void CssRuleIndex::AppendCriticalSubset(const StringSet& critical_selectors,
+                                        GoogleString* out) const {
+  out->append(preamble_);
+  if (critical_selectors.size() < selector_index_.size()) {
+    AppendCriticalSubsetByLookup(critical_selectors, out);
+  } else {
+    AppendCriticalSubsetByScan(critical_selectors, out);
+  }
+}
+
+void CssRuleIndex::AppendSelectorKeys(GoogleString* out) const {
+  for (SelectorIndex::const_iterator i = selector_index_.begin(),
+           end = selector_index_.end(); i != end; ++i) {
+    if (i != selector_index_.begin()) {
+      out->push_back(',');
+    }
+    out->append(i->first);
+  }
+}
+
+void CssRuleIndex::AppendRule(const Rule& rule, StringPiece selectors,
+                              const GoogleString** open_media,
+                              GoogleString* out) {
+  // Like CssMinify, wrap runs of adjacent rules with the same media in a
+  // single @media block.
+  if (*open_media == NULL || **open_media != rule.media) {
+    if (*open_media != NULL && !(*open_media)->empty()) {
+      out->push_back('}');
+    }
+    if (!rule.media.empty()) {
+      StrAppend(out, "@media ", rule.media, "{");
+    }
+    *open_media = &rule.media;
+  }
+  StrAppend(out, selectors, rule.text);
+}
+
+void CssRuleIndex::AppendCriticalSubsetByScan(
+    const StringSet& critical_selectors, GoogleString* out) const {
+  const GoogleString* open_media = NULL;
+  GoogleString selectors;
+  for (int i = 0, n = rules_.size(); i < n; ++i) {
+    const Rule& rule = *rules_[i];
+    selectors.clear();
+    if (!rule.always_kept) {
+      for (int j = 0, num_selectors = rule.selector_keys.size();
+           j < num_selectors; ++j) {
+        const GoogleString& key = rule.selector_keys[j];
+        if (key.empty() ||
+            critical_selectors.find(key) != critical_selectors.end()) {
+          if (!selectors.empty()) {
+            selectors.push_back(',');
+          }
+          selectors.append(rule.selector_texts[j]);
+        }
+      }
+      if (selectors.empty()) {
+        continue;
+      }
+    }
+    AppendRule(rule, selectors, &open_media, out);
+  }
+  if (open_media != NULL && !open_media->empty()) {
+    out->push_back('}');
+  }
+}
+
+void CssRuleIndex::AppendCriticalSubsetByLookup(
+    const StringSet& critical_selectors, GoogleString* out) const {
+  // Gather the positions of everything that is kept, and put them back in
+  // stylesheet order.
+  SelectorPositions kept(always_kept_);
+  for (StringSet::const_iterator i = critical_selectors.begin(),
+           end = critical_selectors.end(); i != end; ++i) {
+    SelectorIndex::const_iterator found = selector_index_.find(*i);
+    if (found != selector_index_.end()) {
+      kept.insert(kept.end(), found->second.begin(), found->second.end());
+    }
+  }
+  std::sort(kept.begin(), kept.end());
+
+  const GoogleString* open_media = NULL;
+  GoogleString selectors;
+  for (int k = 0, num_kept = kept.size(); k < num_kept; ) {
+    int rule_index = kept[k].first;
+    const Rule& rule = *rules_[rule_index];
+    selectors.clear();
+    for (; k < num_kept && kept[k].first == rule_index; ++k) {
+      int selector_index = kept[k].second;
+      if (selector_index >= 0) {
+        if (!selectors.empty()) {
+          selectors.push_back(',');
+        }
+        selectors.append(rule.selector_texts[selector_index]);
+      }
+    }
+    AppendRule(rule, selectors, &open_media, out);
+  }
+  if (open_media != NULL && !open_media->empty()) {
+    out->push_back('}');
+  }
+}
+
+CssRuleIndexCache::CssRuleIndexCache(size_t max_bytes, AbstractMutex* mutex)
+    : mutex_(mutex),
+      lru_(max_bytes, &value_helper_) {
+}
+
+CssRuleIndexCache::~CssRuleIndexCache() {
+}
+
+CssRuleIndexPtr CssRuleIndexCache::Find(const GoogleString& key) {
+  ScopedMutex lock(mutex_.get());
+  CssRuleIndexPtr* index = lru_.GetFreshen(key);
+  return (index == NULL) ? CssRuleIndexPtr() : *index;
+}
+
+void CssRuleIndexCache::Insert(const GoogleString& key,
+                               const CssRuleIndexPtr& index) {
+  ScopedMutex lock(mutex_.get());
+  lru_.Put(key, index);
+}
+
+}  // namespace net_instaweb
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures critical CSS computation on a stylesheet shaped like a CSS
+// framework: about 2000 rules and 4000 selectors, mostly class selectors
+// with some descendant, id, tag and :hover ones, and responsive @media
+// blocks.  The argument of the range benchmarks is the number of critical
+// selectors for the page.
+//
+// BM_PruneParsedStylesheet is the way CriticalSelectorFilter used to compute
+// critical CSS, by removing the non-critical selectors from the AST and
+// minifying what is left, not counting the parse.  BM_CriticalSubset does the
+// same from a CssRuleIndex, which is what is kept in the CssRuleIndexCache.
+// BM_ParseAndIndex is the cost of a cache miss.
+//
+// Disclaimer: comparing runs over time and across different machines
+// can be misleading.  When contemplating an algorithm change, always do
+// interleaved runs with the old & new algorithm.
+
+#include "net/instaweb/rewriter/public/css_rule_index.h"
+
+#include <algorithm>
+
+#include "net/instaweb/rewriter/public/css_minify.h"
+#include "net/instaweb/rewriter/public/css_util.h"
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/benchmark.h"
+#include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
+#include "webutil/css/media.h"
+#include "webutil/css/parser.h"
+#include "webutil/css/selector.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const int kNumRules = 2000;
+
+const char* kComponents[] = {
+  "btn", "nav", "navbar", "dropdown", "form-control", "table", "col-md",
+  "col-sm", "alert", "badge", "card", "modal", "list-group", "pagination",
+};
+
+const char* kTags[] = { "a", "li", "span", "p", "input", "td" };
+
+GoogleString FrameworkCss() {
+  GoogleString css;
+  for (int i = 0; i < kNumRules; ++i) {
+    GoogleString component = StrCat(
+        ".", kComponents[i % arraysize(kComponents)], "-",
+        IntegerToString(i / arraysize(kComponents)));
+    const char* tag = kTags[i % arraysize(kTags)];
+    if (i % 100 == 0) {
+      if (i != 0) {
+        css += "}";
+      }
+      css += (i % 200 == 0) ? "@media (min-width: 768px) {" : "@media print {";
+    }
+    switch (i % 4) {
+      case 0:
+        StrAppend(&css, component, ", ", component, ":hover");
+        break;
+      case 1:
+        StrAppend(&css, component, " > ", tag, ", ", component, " ", tag);
+        break;
+      case 2:
+        StrAppend(&css, "#main ", component, ", ", tag, component);
+        break;
+      case 3:
+        StrAppend(&css, component, ".active, ", component, "-lg");
+        break;
+    }
+    StrAppend(&css, " { margin: ", IntegerToString(i % 17),
+              "px; color: #333; background: url(img/", IntegerToString(i),
+              ".png) no-repeat }\n");
+  }
+  css += "}";
+  return css;
+}
+
+Css::Stylesheet* ParseCss(StringPiece css) {
+  Css::Parser parser(css);
+  parser.set_preservation_mode(true);
+  parser.set_quirks_mode(false);
+  parser.set_use_arena(true);
+  return parser.ParseRawStylesheet();
+}
+
+// Picks num_critical of the stylesheet's selector keys, spread out over it.
+StringSet CriticalSelectors(const GoogleString& css, int num_critical) {
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseCss(css));
+  CssRuleIndex index(stylesheet.get());
+  GoogleString joined;
+  index.AppendSelectorKeys(&joined);
+  StringPieceVector keys;
+  SplitStringPieceToVector(joined, ",", &keys, true);
+  StringSet critical;
+  int step = std::max(1, static_cast<int>(keys.size()) / num_critical);
+  for (int i = 0, n = keys.size();
+       i < n && static_cast<int>(critical.size()) < num_critical; i += step) {
+    critical.insert(keys[i].as_string());
+  }
+  return critical;
+}
+
+template<typename VectorType> void Compact(VectorType* v) {
+  v->erase(std::remove(v->begin(), v->end(),
+                       static_cast<typename VectorType::value_type>(NULL)),
+           v->end());
+}
+
+void PruneAndMinify(Css::Stylesheet* stylesheet, const StringSet& critical,
+                    GoogleString* out) {
+  Css::Rulesets& rulesets = stylesheet->mutable_rulesets();
+  for (int i = 0, n = rulesets.size(); i < n; ++i) {
+    Css::Ruleset* r = rulesets[i];
+    bool any_media_apply = r->media_queries().empty();
+    Css::MediaQueries& media = r->mutable_media_queries();
+    for (int j = 0, num_media = media.size(); j < num_media; ++j) {
+      if (css_util::CanMediaAffectScreen(media[j]->ToString())) {
+        any_media_apply = true;
+      } else {
+        delete media[j];
+        media[j] = NULL;
+      }
+    }
+    bool any_selectors_apply = false;
+    Css::Selectors& selectors = r->mutable_selectors();
+    for (int j = 0, num_selectors = selectors.size(); j < num_selectors;
+         ++j) {
+      GoogleString key = css_util::JsDetectableSelector(*selectors[j]);
+      if (key.empty() || critical.find(key) != critical.end()) {
+        any_selectors_apply = true;
+      } else {
+        delete selectors[j];
+        selectors[j] = NULL;
+      }
+    }
+    Compact(&media);
+    Compact(&selectors);
+    if (!any_media_apply || !any_selectors_apply) {
+      delete r;
+      rulesets[i] = NULL;
+    }
+  }
+  Compact(&rulesets);
+
+  StringWriter writer(out);
+  NullMessageHandler handler;
+  CssMinify::Stylesheet(*stylesheet, &writer, &handler);
+}
+
+static void BM_PruneParsedStylesheet(int iters, int num_critical) {
+  StopBenchmarkTiming();
+  GoogleString css = FrameworkCss();
+  StringSet critical = CriticalSelectors(css, num_critical);
+  for (int i = 0; i < iters; ++i) {
+    scoped_ptr<Css::Stylesheet> stylesheet(ParseCss(css));
+    GoogleString out;
+    StartBenchmarkTiming();
+    PruneAndMinify(stylesheet.get(), critical, &out);
+    StopBenchmarkTiming();
+  }
+}
+BENCHMARK_RANGE(BM_PruneParsedStylesheet, 1<<3, 1<<12);
+
+static void BM_CriticalSubset(int iters, int num_critical) {
+  StopBenchmarkTiming();
+  GoogleString css = FrameworkCss();
+  StringSet critical = CriticalSelectors(css, num_critical);
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseCss(css));
+  CssRuleIndex index(stylesheet.get());
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    GoogleString out;
+    index.AppendCriticalSubset(critical, &out);
+  }
+}
+BENCHMARK_RANGE(BM_CriticalSubset, 1<<3, 1<<12);
+
+static void BM_ParseAndIndex(int iters) {
+  StopBenchmarkTiming();
+  GoogleString css = FrameworkCss();
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    scoped_ptr<Css::Stylesheet> stylesheet(ParseCss(css));
+    CssRuleIndex index(stylesheet.get());
+  }
+}
+BENCHMARK(BM_ParseAndIndex);
+
+// The summary CriticalCssBeaconFilter computes for each stylesheet.
+static void BM_SelectorKeys(int iters) {
+  StopBenchmarkTiming();
+  GoogleString css = FrameworkCss();
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseCss(css));
+  CssRuleIndex index(stylesheet.get());
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    GoogleString out;
+    index.AppendSelectorKeys(&out);
+  }
+}
+BENCHMARK(BM_SelectorKeys);
+
+}  // namespace
+
+}  // namespace net_instaweb
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/instaweb/rewriter/public/css_rule_index.h"
+
+#include <algorithm>
+
+#include "net/instaweb/rewriter/public/css_minify.h"
+#include "net/instaweb/rewriter/public/css_util.h"
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/null_mutex.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
+#include "webutil/css/media.h"
+#include "webutil/css/parser.h"
+#include "webutil/css/selector.h"
+
+namespace net_instaweb {
+
+namespace {
+
+Css::Stylesheet* ParseCss(StringPiece css) {
+  Css::Parser parser(css);
+  parser.set_preservation_mode(true);
+  parser.set_quirks_mode(false);
+  Css::Stylesheet* stylesheet = parser.ParseRawStylesheet();
+  EXPECT_EQ(Css::Parser::kNoError, parser.errors_seen_mask());
+  return stylesheet;
+}
+
+template<typename VectorType> void Compact(VectorType* v) {
+  v->erase(std::remove(v->begin(), v->end(),
+                       static_cast<typename VectorType::value_type>(NULL)),
+           v->end());
+}
+
+// Computes the critical subset by pruning the parsed stylesheet and
+// minifying what is left, which is what the index has to reproduce.
+GoogleString PruneAndMinify(StringPiece css, const StringSet& critical) {
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseCss(css));
+  Css::Rulesets& rulesets = stylesheet->mutable_rulesets();
+  for (int i = 0, n = rulesets.size(); i < n; ++i) {
+    Css::Ruleset* r = rulesets[i];
+    if (r->type() == Css::Ruleset::UNPARSED_REGION) {
+      continue;
+    }
+    bool any_media_apply = r->media_queries().empty();
+    Css::MediaQueries& media = r->mutable_media_queries();
+    for (int j = 0, num_media = media.size(); j < num_media; ++j) {
+      if (css_util::CanMediaAffectScreen(media[j]->ToString())) {
+        any_media_apply = true;
+      } else {
+        delete media[j];
+        media[j] = NULL;
+      }
+    }
+    bool any_selectors_apply = r->selectors().empty();
+    Css::Selectors& selectors = r->mutable_selectors();
+    for (int j = 0, num_selectors = selectors.size(); j < num_selectors;
+         ++j) {
+      GoogleString key = css_util::JsDetectableSelector(*selectors[j]);
+      if (key.empty() || critical.find(key) != critical.end()) {
+        any_selectors_apply = true;
+      } else {
+        delete selectors[j];
+        selectors[j] = NULL;
+      }
+    }
+    Compact(&media);
+    Compact(&selectors);
+    if (!any_media_apply || !any_selectors_apply) {
+      delete r;
+      rulesets[i] = NULL;
+    }
+  }
+  Compact(&rulesets);
+
+  GoogleString out;
+  StringWriter writer(&out);
+  NullMessageHandler handler;
+  CssMinify::Stylesheet(*stylesheet, &writer, &handler);
+  return out;
+}
+
+GoogleString CriticalSubset(StringPiece css, const StringSet& critical) {
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseCss(css));
+  CssRuleIndexPtr index(new CssRuleIndex(stylesheet.get()));
+  GoogleString out;
+  index->AppendCriticalSubset(critical, &out);
+  return out;
+}
+
+StringSet MakeSet(StringPiece comma_separated) {
+  StringPieceVector pieces;
+  SplitStringPieceToVector(comma_separated, ",", &pieces, true);
+  StringSet result;
+  for (int i = 0, n = pieces.size(); i < n; ++i) {
+    result.insert(pieces[i].as_string());
+  }
+  return result;
+}
+
+TEST(CssRuleIndexTest, FiltersSelectorsAndMedia) {
+  const char kCss[] =
+      "div,span,*::first-letter { display: block; }"
+      "p { display: inline; }"
+      "@media print { div { color: red } }"
+      "@media screen, print { div { margin: 0 } span { margin: 1px } }";
+  EXPECT_EQ("div,*::first-letter{display:block}"
+            "@media screen{div{margin:0}}",
+            CriticalSubset(kCss, MakeSet("div,*")));
+  EXPECT_EQ("span{display:block}@media screen{span{margin:1px}}",
+            CriticalSubset(kCss, MakeSet("span")));
+  EXPECT_EQ("", CriticalSubset(kCss, MakeSet("table")));
+}
+
+TEST(CssRuleIndexTest, MatchesPruningTheStylesheet) {
+  const char* kStylesheets[] = {
+    "@charset \"utf-8\";"
+    "@import url(foo.css) screen;"
+    "@font-face { font-family: x; src: url(x.ttf) }"
+    "a, b:hover { color: red } i { color: blue }",
+
+    "@media screen { a { x: y } } b { x: y } @media screen { i { x: y } }"
+    "@media screen { b { x: z } } @media print { a { x: z } }"
+    "@media screen { i { x: z } }",
+
+    "a > b + i, a { x: y } #id.class, .class { x: y } [attr] { x: y }"
+    "@media screen and (max-width: 100px), print { .class, i { x: y } }",
+  };
+  const char* kCriticalSets[] = {
+    "", "a", "b", "i", "a,b,i", "a,i", "#id.class,[attr]", ".class,i",
+  };
+  for (int i = 0, n = arraysize(kStylesheets); i < n; ++i) {
+    for (int j = 0, m = arraysize(kCriticalSets); j < m; ++j) {
+      StringSet critical = MakeSet(kCriticalSets[j]);
+      EXPECT_EQ(PruneAndMinify(kStylesheets[i], critical),
+                CriticalSubset(kStylesheets[i], critical))
+          << "stylesheet " << i << ", critical selectors " << kCriticalSets[j];
+    }
+  }
+}
+
+TEST(CssRuleIndexTest, LookupMatchesScan) {
+  // Many distinct keys, so that small critical sets are looked up in the
+  // index and large ones are matched by scanning every selector.
+  GoogleString css = "@media print { .p0 { x: y } }";
+  StringSet all_keys;
+  all_keys.insert("a");
+  for (int i = 0; i < 50; ++i) {
+    StrAppend(&css, ".c", IntegerToString(i), ", #i", IntegerToString(i % 7),
+              " span, a:hover { x: y }");
+    if (i % 10 == 0) {
+      StrAppend(&css, "@media screen { .c", IntegerToString(i), " { x: z } }");
+    }
+    all_keys.insert(StrCat(".c", IntegerToString(i)));
+    all_keys.insert(StrCat("#i", IntegerToString(i % 7), " span"));
+  }
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseCss(css));
+  CssRuleIndexPtr index(new CssRuleIndex(stylesheet.get()));
+  EXPECT_EQ(static_cast<int>(all_keys.size()), index->num_selector_keys());
+
+  StringSet critical;
+  for (StringSet::const_iterator i = all_keys.begin(); i != all_keys.end();
+       ++i) {
+    critical.insert(*i);
+    GoogleString out;
+    index->AppendCriticalSubset(critical, &out);
+    EXPECT_EQ(PruneAndMinify(css, critical), out) << critical.size();
+  }
+}
+
+TEST(CssRuleIndexTest, SelectorKeys) {
+  const char kCss[] =
+      "div, span:hover, :hover { x: y } @media print { p { x: y } }"
+      "@media screen { a, div { x: y } } i { x: y }";
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseCss(kCss));
+  CssRuleIndex index(stylesheet.get());
+  GoogleString keys;
+  index.AppendSelectorKeys(&keys);
+  EXPECT_EQ("a,div,i,span", keys);
+}
+
+TEST(CssRuleIndexTest, Cache) {
+  CssRuleIndexCache cache(1024 * 1024, new NullMutex);
+  EXPECT_TRUE(cache.Find("key").get() == NULL);
+
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseCss("div { color: red }"));
+  CssRuleIndexPtr index(new CssRuleIndex(stylesheet.get()));
+  cache.Insert("key", index);
+  EXPECT_EQ(index.get(), cache.Find("key").get());
+  EXPECT_TRUE(cache.Find("other").get() == NULL);
+}
+
+TEST(CssRuleIndexTest, CacheEvictionKeepsIndexAlive) {
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseCss("div { color: red }"));
+  CssRuleIndexPtr index(new CssRuleIndex(stylesheet.get()));
+  CssRuleIndexCache cache(index->size_bytes() + 10, new NullMutex);
+  cache.Insert("key1", index);
+  CssRuleIndexPtr found = cache.Find("key1");
+  ASSERT_TRUE(found.get() != NULL);
+
+  // Too big for both to fit, so key1 is evicted.
+  scoped_ptr<Css::Stylesheet> stylesheet2(ParseCss("span { color: blue }"));
+  cache.Insert("key2", CssRuleIndexPtr(new CssRuleIndex(stylesheet2.get())));
+  EXPECT_TRUE(cache.Find("key1").get() == NULL);
+
+  GoogleString out;
+  found->AppendCriticalSubset(MakeSet("div"), &out);
+  EXPECT_EQ("div{color:red}", out);
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
@@ -24,6 +24,7 @@
 #include "net/instaweb/rewriter/cached_result.pb.h"
 #include "net/instaweb/rewriter/public/common_filter.h"
 #include "net/instaweb/rewriter/public/css_inline_filter.h"
+#include "net/instaweb/rewriter/public/css_rule_index.h"
 #include "net/instaweb/rewriter/public/css_tag_scanner.h"
 #include "net/instaweb/rewriter/public/data_url_input_resource.h"
 #include "net/instaweb/rewriter/public/inline_resource_slot.h"
@@ -37,6 +38,7 @@
 #include "pagespeed/kernel/base/abstract_mutex.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/charset_util.h"
+#include "pagespeed/kernel/base/hasher.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
@@ -195,22 +197,11 @@ void CssSummarizerBase::Context::RewriteSingle(
   // TODO(morlovich): Should we keep track of this so it can be restored?
   StripUtf8Bom(&input_contents);
 
-  // Load stylesheet w/o expanding background attributes and preserving as
-  // much content as possible from the original document.
-  Css::Parser parser(input_contents);
-  parser.set_preservation_mode(true);
-
-  // We avoid quirks-mode so that we do not "fix" something we shouldn't have.
-  parser.set_quirks_mode(false);
-
-  scoped_ptr<Css::Stylesheet> stylesheet(parser.ParseRawStylesheet());
   CachedResult* result = mutable_output_partition(0);
-  if (stylesheet.get() == NULL ||
-      parser.errors_seen_mask() != Css::Parser::kNoError) {
+  if (!filter_->SummarizeContents(input_contents,
+                                  result->mutable_inlined_data())) {
     // TODO(morlovich): do we want a stat here?
     result->clear_inlined_data();
-  } else {
-    filter_->Summarize(stylesheet.get(), result->mutable_inlined_data());
   }
   if (CssInlineFilter::HasClosingStyleTag(result->inlined_data())) {
     result->clear_inlined_data();
@@ -248,6 +239,10 @@ const char CssSummarizerBase::kNumCssUsedForCriticalCssComputation[] =
     "num_css_used_for_critical_css_computation";
 const char CssSummarizerBase::kNumCssNotUsedForCriticalCssComputation[] =
     "num_css_not_used_for_critical_css_computation";
+const char CssSummarizerBase::kCssRuleIndexCacheHits[] =
+    "css_rule_index_cache_hits";
+const char CssSummarizerBase::kCssRuleIndexCacheMisses[] =
+    "css_rule_index_cache_misses";
 
 CssSummarizerBase::CssSummarizerBase(RewriteDriver* driver)
     : RewriteFilter(driver),
@@ -257,6 +252,8 @@ CssSummarizerBase::CssSummarizerBase(RewriteDriver* driver)
       stats->GetVariable(kNumCssUsedForCriticalCssComputation);
   num_css_not_used_for_critical_css_computation_ =
       stats->GetVariable(kNumCssNotUsedForCriticalCssComputation);
+  css_rule_index_cache_hits_ = stats->GetVariable(kCssRuleIndexCacheHits);
+  css_rule_index_cache_misses_ = stats->GetVariable(kCssRuleIndexCacheMisses);
   Clear();
 }
 
@@ -267,6 +264,63 @@ CssSummarizerBase::~CssSummarizerBase() {
 void CssSummarizerBase::InitStats(Statistics* statistics) {
   statistics->AddVariable(kNumCssUsedForCriticalCssComputation);
   statistics->AddVariable(kNumCssNotUsedForCriticalCssComputation);
+  statistics->AddVariable(kCssRuleIndexCacheHits);
+  statistics->AddVariable(kCssRuleIndexCacheMisses);
+}
+
+bool CssSummarizerBase::SummarizeContents(StringPiece contents,
+                                          GoogleString* out) const {
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseForSummary(contents));
+  if (stylesheet.get() == NULL) {
+    return false;
+  }
+  Summarize(stylesheet.get(), out);
+  return true;
+}
+
+Css::Stylesheet* CssSummarizerBase::ParseForSummary(StringPiece contents) {
+  // Load stylesheet w/o expanding background attributes and preserving as
+  // much content as possible from the original document.
+  Css::Parser parser(contents);
+  parser.set_preservation_mode(true);
+
+  // We avoid quirks-mode so that we do not "fix" something we shouldn't have.
+  parser.set_quirks_mode(false);
+
+  // Summaries only hold on to the stylesheet while computing the summary.
+  parser.set_use_arena(true);
+
+  scoped_ptr<Css::Stylesheet> stylesheet(parser.ParseRawStylesheet());
+  if (parser.errors_seen_mask() != Css::Parser::kNoError) {
+    stylesheet.reset(NULL);
+  }
+  return stylesheet.release();
+}
+
+CssRuleIndexPtr CssSummarizerBase::GetRuleIndex(StringPiece contents) const {
+  // The index does not depend on the page, only on the CSS, so a hash of the
+  // contents is all the key needs.  Stylesheets that fail to parse are not
+  // cached; their summaries are still cached per URL by the metadata cache.
+  CssRuleIndexCache* cache = server_context()->css_rule_index_cache();
+  GoogleString key;
+  CssRuleIndexPtr index;
+  if (cache != NULL) {
+    key = server_context()->contents_hasher()->Hash(contents);
+    index = cache->Find(key);
+    if (index.get() != NULL) {
+      css_rule_index_cache_hits_->Add(1);
+      return index;
+    }
+    css_rule_index_cache_misses_->Add(1);
+  }
+  scoped_ptr<Css::Stylesheet> stylesheet(ParseForSummary(contents));
+  if (stylesheet.get() != NULL) {
+    index.reset(new CssRuleIndex(stylesheet.get()));
+    if (cache != NULL) {
+      cache->Insert(key, index);
+    }
+  }
+  return index;
 }
 
 GoogleString CssSummarizerBase::CacheKeySuffix() const {
@@ -143,6 +143,18 @@ inline bool PopFirst(StringPiece* in, char* c) {
   }
 }
 
+// Skips *in ahead to the next '@' or 'u', the only characters that can start
+// an @import or a url(, so that the bytes in between are passed through as
+// one range instead of being lexed one at a time.
+inline void SkipToUrlUseCandidate(StringPiece* in) {
+  const char* p = in->data();
+  const char* end = p + in->size();
+  while (p < end && *p != '@' && *p != 'u') {
+    ++p;
+  }
+  in->remove_prefix(p - in->data());
+}
+
 // Since we handle incomplete input, in some cases we may not have enough of it
 // available to accept or reject a construct --- in which case the routines
 // will return kLexInterrupted.
@@ -380,6 +392,8 @@ bool CssTagScanner::TransformUrlsStreaming(
   // when an entire chunk has been understood. This means when we are streaming
   // incrementally, unparsed can be retained until the next chunk.
   StringPiece remaining = contents;
+  SkipToUrlUseCandidate(&remaining);
+  out_end = remaining.data();
   StringPiece reparse_candidate = remaining;
   while (PopFirst(&remaining, &c)) {
     UrlKind have_url = kNone;
@@ -502,6 +516,7 @@ bool CssTagScanner::TransformUrlsStreaming(
 
     // remaining.data() points to the next byte to read, which is exactly
     // right after the last byte we want to output.
+    SkipToUrlUseCandidate(&remaining);
     out_end = remaining.data();
     reparse_candidate = remaining;
   }
@@ -25,12 +25,8 @@
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/string_writer.h"
-#include "pagespeed/kernel/html/collapse_whitespace_filter.h"
-#include "pagespeed/kernel/html/elide_attributes_filter.h"
-#include "pagespeed/kernel/html/html_attribute_quote_removal.h"
 #include "pagespeed/kernel/html/html_parse.h"
-#include "pagespeed/kernel/html/html_writer_filter.h"
-#include "pagespeed/kernel/html/remove_comments_filter.h"
+#include "pagespeed/kernel/html/minifying_html_writer_filter.h"
 
 namespace {
 
@@ -70,11 +66,9 @@ class HtmlMinifier {
  private:
   net_instaweb::FileMessageHandler message_handler_;
   net_instaweb::HtmlParse html_parse_;
-  net_instaweb::RemoveCommentsFilter remove_comments_filter_;
-  net_instaweb::ElideAttributesFilter elide_attributes_filter_;
-  net_instaweb::HtmlAttributeQuoteRemoval quote_removal_filter_;
-  net_instaweb::CollapseWhitespaceFilter collapse_whitespace_filter_;
-  net_instaweb::HtmlWriterFilter html_writer_filter_;
+  // Removes comments, elides attributes, removes attribute quotes and
+  // collapses whitespace while writing the output.
+  net_instaweb::MinifyingHtmlWriterFilter html_writer_filter_;
 
   DISALLOW_COPY_AND_ASSIGN(HtmlMinifier);
 };
@@ -82,15 +76,7 @@ class HtmlMinifier {
 HtmlMinifier::HtmlMinifier()
     : message_handler_(stderr),
       html_parse_(&message_handler_),
-      remove_comments_filter_(&html_parse_),
-      elide_attributes_filter_(&html_parse_),
-      quote_removal_filter_(&html_parse_),
-      collapse_whitespace_filter_(&html_parse_),
       html_writer_filter_(&html_parse_) {
-  html_parse_.AddFilter(&remove_comments_filter_);
-  html_parse_.AddFilter(&elide_attributes_filter_);
-  html_parse_.AddFilter(&quote_removal_filter_);
-  html_parse_.AddFilter(&collapse_whitespace_filter_);
   html_parse_.AddFilter(&html_writer_filter_);
 }
 
@@ -22,11 +22,16 @@
 #include <cstddef>
 
 #include "net/instaweb/rewriter/public/javascript_library_identification.h"
+#include "pagespeed/kernel/base/cache_interface.h"
 #include "pagespeed/kernel/base/message_handler.h"
+#include "pagespeed/kernel/base/rolling_hash.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/shared_string.h"
 #include "pagespeed/kernel/base/source_map.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
 #include "pagespeed/kernel/js/js_minify.h"
 #include "pagespeed/kernel/js/js_tokenizer.h"
 
@@ -46,7 +51,10 @@ const char JavascriptRewriteConfig::kTotalOriginalBytes[] =
 const char JavascriptRewriteConfig::kMinifyUses[] = "javascript_minify_uses";
 const char JavascriptRewriteConfig::kNumReducingMinifications[] =
     "javascript_reducing_minifications";
-
+const char JavascriptRewriteConfig::kMinifyMemoHits[] =
+    "javascript_minify_memo_hits";
+const char JavascriptRewriteConfig::kMinifyMemoMisses[] =
+    "javascript_minify_memo_misses";
 
 const char JavascriptRewriteConfig::kJSMinificationDisabled[] =
     "javascript_minification_disabled";
@@ -58,6 +66,19 @@ const char JavascriptRewriteConfig::kJSFailedToWrite[] =
 const char JavascriptCodeBlock::kIntrospectionComment[] =
     "This script contains introspective JavaScript and is unsafe to replace.";
 
+namespace {
+
+// Values in the minified code cache are laid out as
+//   <status><original size>:<original code><minified code>
+// where status is kMemoMinified, or kMemoFailed if minification failed (in
+// which case there is no minified code).  The original code is kept so that
+// hits can be verified; the rolling hash used in the key is fast but not
+// collision-resistant.
+const char kMemoMinified = 'm';
+const char kMemoFailed = 'f';
+
+}  // namespace
+
 JavascriptRewriteConfig::JavascriptRewriteConfig(
     Statistics* stats, bool minify, bool use_experimental_minifier,
     const JavascriptLibraryIdentification* identification,
@@ -66,6 +87,7 @@ JavascriptRewriteConfig::JavascriptRewriteConfig(
       use_experimental_minifier_(use_experimental_minifier),
       library_identification_(identification),
       js_tokenizer_patterns_(js_tokenizer_patterns),
+      minified_code_cache_(NULL),
       blocks_minified_(stats->GetVariable(kBlocksMinified)),
       libraries_identified_(stats->GetVariable(kLibrariesIdentified)),
       minification_failures_(stats->GetVariable(kMinificationFailures)),
@@ -74,6 +96,8 @@ JavascriptRewriteConfig::JavascriptRewriteConfig(
       num_uses_(stats->GetVariable(kMinifyUses)),
       num_reducing_minifications_(
           stats->GetVariable(kNumReducingMinifications)),
+      minify_memo_hits_(stats->GetVariable(kMinifyMemoHits)),
+      minify_memo_misses_(stats->GetVariable(kMinifyMemoMisses)),
       minification_disabled_(stats->GetVariable(kJSMinificationDisabled)),
       did_not_shrink_(stats->GetVariable(kJSDidNotShrink)),
       failed_to_write_(stats->GetVariable(kJSFailedToWrite)) {
@@ -87,6 +111,8 @@ void JavascriptRewriteConfig::InitStats(Statistics* statistics) {
   statistics->AddVariable(kTotalOriginalBytes);
   statistics->AddVariable(kMinifyUses);
   statistics->AddVariable(kNumReducingMinifications);
+  statistics->AddVariable(kMinifyMemoHits);
+  statistics->AddVariable(kMinifyMemoMisses);
 
   statistics->AddVariable(kJSMinificationDisabled);
   statistics->AddVariable(kJSDidNotShrink);
@@ -98,9 +124,11 @@ JavascriptCodeBlock::JavascriptCodeBlock(
     const StringPiece& message_id, MessageHandler* handler)
     : config_(config),
       message_id_(message_id.data(), message_id.size()),
-      original_code_(original_code.data(), original_code.size()),
+      original_code_(original_code),
       rewritten_(false),
       successfully_rewritten_(false),
+      need_source_mappings_(false),
+      memoize_minification_(false),
       handler_(handler) {
 }
 
@@ -187,7 +215,7 @@ bool JavascriptCodeBlock::Rewrite() {
     return successfully_rewritten_;
   }
 
-  if (MinifyJs(original_code_, &rewritten_code_, &source_mappings_)) {
+  if (MinifyJsWithMemo()) {
     // Minification succeeded. The fact that it succeeded doesn't imply that
     // it actually saved anything; we increment num_reducing_uses when there
     // were actual savings.
@@ -227,14 +255,79 @@ void JavascriptCodeBlock::SwapRewrittenString(GoogleString* other) {
 }
 
 bool JavascriptCodeBlock::MinifyJs(
-    StringPiece input, GoogleString* output,
-    source_map::MappingVector* source_mappings) {
+    StringPiece input, GoogleString* output, GoogleString* source_mappings) {
   if (config_->use_experimental_minifier()) {
-    return pagespeed::js::MinifyUtf8JsWithSourceMap(
-        config_->js_tokenizer_patterns(), input, output, source_mappings);
+    // Source mappings are encoded as they are produced; for big scripts a
+    // MappingVector would take several times the size of the script itself.
+    StringWriter writer(output);
+    scoped_ptr<source_map::MappingsEncoder> encoder;
+    if (source_mappings != NULL) {
+      encoder.reset(new source_map::MappingsEncoder(source_mappings));
+    }
+    return pagespeed::js::MinifyUtf8JsToWriter(
+        config_->js_tokenizer_patterns(), input, &writer, handler_,
+        encoder.get());
   } else {
     return pagespeed::js::MinifyJs(input, output);
   }
 }
 
+GoogleString JavascriptCodeBlock::MinifyMemoKey() const {
+  // The two minifiers produce different output, so they get separate keys.
+  // Nothing else in the config affects the result of MinifyJs.
+  uint64 hash = RollingHash(original_code_.data(), 0, original_code_.size());
+  return StrCat(config_->use_experimental_minifier() ? "jsmin/new/"
+                                                     : "jsmin/old/",
+                Integer64ToString(static_cast<int64>(hash)), "_",
+                IntegerToString(original_code_.size()));
+}
+
+bool JavascriptCodeBlock::MinifyJsWithMemo() {
+  CacheInterface* cache = config_->minified_code_cache();
+  if ((cache == NULL) || !memoize_minification_ ||
+      (need_source_mappings_ && config_->use_experimental_minifier())) {
+    return MinifyJs(original_code_, &rewritten_code_,
+                    need_source_mappings_ ? &source_mappings_ : NULL);
+  }
+
+  GoogleString key = MinifyMemoKey();
+  CacheInterface::SynchronousCallback callback;
+  cache->Get(key, &callback);
+  DCHECK(callback.called()) << "minified code cache must be blocking";
+  if (callback.called() && (callback.state() == CacheInterface::kAvailable)) {
+    StringPiece value = callback.value().Value();
+    stringpiece_ssize_type colon = value.find(':');
+    int original_size;
+    if ((colon != StringPiece::npos) && (colon > 1) &&
+        StringToInt(value.substr(1, colon - 1).as_string(), &original_size) &&
+        (original_size == static_cast<int>(original_code_.size())) &&
+        (value.substr(colon + 1, original_size) == original_code_)) {
+      StringPiece minified = value.substr(colon + 1 + original_size);
+      if (value[0] == kMemoMinified) {
+        config_->minify_memo_hits()->Add(1);
+        minified.CopyToString(&rewritten_code_);
+        return true;
+      } else if (value[0] == kMemoFailed) {
+        config_->minify_memo_hits()->Add(1);
+        return false;
+      }
+    }
+  }
+
+  config_->minify_memo_misses()->Add(1);
+  // Either nobody wants source mappings or the minifier in use cannot
+  // produce them, so hits and misses leave the block in the same state.
+  bool minified = MinifyJs(original_code_, &rewritten_code_, NULL);
+  GoogleString value;
+  value.reserve(original_code_.size() + rewritten_code_.size() + 16);
+  value.push_back(minified ? kMemoMinified : kMemoFailed);
+  StrAppend(&value, IntegerToString(original_code_.size()), ":",
+            original_code_);
+  if (minified) {
+    value.append(rewritten_code_);
+  }
+  cache->PutSwappingString(key, &value);
+  return minified;
+}
+
 }  // namespace net_instaweb
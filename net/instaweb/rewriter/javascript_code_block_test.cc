@@ -25,6 +25,7 @@
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/cache/lru_cache.h"
 #include "pagespeed/kernel/js/js_tokenizer.h"
 #include "pagespeed/kernel/util/platform.h"
 #include "pagespeed/kernel/util/simple_stats.h"
@@ -424,6 +425,71 @@ TEST_P(JsCodeBlockTest, BogusLibraryRegistration) {
                                           "data:text/plain,Hello-world"));
 }
 
+TEST_P(JsCodeBlockTest, MemoizeMinification) {
+  LRUCache cache(100000);
+  config_->set_minified_code_cache(&cache);
+  scoped_ptr<JavascriptCodeBlock> block(TestBlock(kBeforeCompilation));
+  block->set_memoize_minification(true);
+  EXPECT_TRUE(block->Rewrite());
+  EXPECT_EQ(after_compilation_, block->rewritten_code());
+  EXPECT_EQ(0, config_->minify_memo_hits()->Get());
+  EXPECT_EQ(1, config_->minify_memo_misses()->Get());
+
+  // The same code from another block, e.g. under another URL, is served out
+  // of the cache and counted exactly as before.
+  block.reset(TestBlock(kBeforeCompilation));
+  block->set_memoize_minification(true);
+  EXPECT_TRUE(block->Rewrite());
+  EXPECT_EQ(after_compilation_, block->rewritten_code());
+  EXPECT_EQ(1, config_->minify_memo_hits()->Get());
+  EXPECT_EQ(1, config_->minify_memo_misses()->Get());
+  EXPECT_EQ(2, config_->blocks_minified()->Get());
+
+  // Failures are remembered too.
+  block.reset(TestBlock(kTruncatedComment));
+  block->set_memoize_minification(true);
+  EXPECT_FALSE(block->Rewrite());
+  block.reset(TestBlock(kTruncatedComment));
+  block->set_memoize_minification(true);
+  EXPECT_FALSE(block->Rewrite());
+  EXPECT_EQ(2, config_->minify_memo_hits()->Get());
+  EXPECT_EQ(2, config_->minify_memo_misses()->Get());
+  EXPECT_EQ(2, config_->minification_failures()->Get());
+}
+
+TEST_P(JsCodeBlockTest, MemoSkippedUnlessRequested) {
+  // Blocks that don't ask for memoization, such as inline scripts, neither
+  // read nor fill the cache.
+  LRUCache cache(100000);
+  config_->set_minified_code_cache(&cache);
+  for (int i = 0; i < 2; ++i) {
+    scoped_ptr<JavascriptCodeBlock> block(TestBlock(kBeforeCompilation));
+    EXPECT_TRUE(block->Rewrite());
+    EXPECT_EQ(after_compilation_, block->rewritten_code());
+  }
+  EXPECT_EQ(0, config_->minify_memo_hits()->Get());
+  EXPECT_EQ(0, config_->minify_memo_misses()->Get());
+  EXPECT_EQ(static_cast<size_t>(0), cache.num_elements());
+  EXPECT_EQ(2, config_->blocks_minified()->Get());
+}
+
+TEST_P(JsCodeBlockTest, MemoSkippedForSourceMappings) {
+  LRUCache cache(100000);
+  config_->set_minified_code_cache(&cache);
+  for (int i = 0; i < 2; ++i) {
+    scoped_ptr<JavascriptCodeBlock> block(TestBlock(kBeforeCompilation));
+    block->set_memoize_minification(true);
+    block->set_need_source_mappings(true);
+    EXPECT_TRUE(block->Rewrite());
+    EXPECT_EQ(after_compilation_, block->rewritten_code());
+    // Only the new minifier produces source mappings.
+    EXPECT_EQ(use_experimental_minifier_,
+              !block->EncodedSourceMappings().empty());
+  }
+  EXPECT_EQ(use_experimental_minifier_ ? 0 : 1,
+            config_->minify_memo_hits()->Get());
+}
+
 // We test with use_experimental_minifier == GetParam() as both true and false.
 INSTANTIATE_TEST_CASE_P(JsCodeBlockTestInstance, JsCodeBlockTest,
                         ::testing::Bool());
@@ -140,6 +140,10 @@ class JavascriptFilter::Context : public SingleRewriteContext {
     MessageHandler* message_handler = server_context->message_handler();
     JavascriptCodeBlock code_block(input->ExtractUncompressedContents(),
                                    config_, input->url(), message_handler);
+    code_block.set_need_source_mappings(
+        output_source_map_ ||
+        Options()->Enabled(RewriteOptions::kIncludeJsSourceMaps));
+    code_block.set_memoize_minification(true);
     code_block.Rewrite();
     // Check whether this code should, for various reasons, not be rewritten.
     if (PossiblyRewriteToLibrary(code_block, server_context, rewritten)) {
@@ -164,7 +168,7 @@ class JavascriptFilter::Context : public SingleRewriteContext {
 
     // Write out source map before rewritten JS so that we can embed the
     // source map URL into the rewritten JS.
-    if (code_block.SourceMappings().empty()) {
+    if (code_block.EncodedSourceMappings().empty()) {
       if (output_source_map_) {
         // Source map will be empty if we can't construct it correctly.
         // If this fetch is explicitly for a source map, we must fail.
@@ -194,8 +198,9 @@ class JavascriptFilter::Context : public SingleRewriteContext {
       // rewritten URL depends on rewritten content, which depends on
       // source map URL, which depends on source map contents.
       // (So source map contents can't depend on rewritten URL!)
-      source_map::Encode("" /* Omit rewritten URL */, source_gurl->Spec(),
-                         code_block.SourceMappings(), &source_map_text);
+      source_map::EncodeWithEncodedMappings(
+          "" /* Omit rewritten URL */, source_gurl->Spec(),
+          code_block.EncodedSourceMappings(), &source_map_text);
 
       // TODO(sligocki): Perhaps we should not insert source maps into the
       // cache on every JS rewrite request because they will generally not
@@ -424,12 +429,15 @@ JavascriptRewriteConfig* JavascriptFilter::InitializeConfig(
   const RewriteOptions* options = driver->options();
   bool minify = options->Enabled(RewriteOptions::kRewriteJavascriptExternal) ||
       options->Enabled(RewriteOptions::kRewriteJavascriptInline);
-  return new JavascriptRewriteConfig(
-                 driver->server_context()->statistics(),
-                 minify,
-                 options->use_experimental_js_minifier(),
-                 options->javascript_library_identification(),
-                 driver->server_context()->js_tokenizer_patterns());
+  JavascriptRewriteConfig* config = new JavascriptRewriteConfig(
+      driver->server_context()->statistics(),
+      minify,
+      options->use_experimental_js_minifier(),
+      options->javascript_library_identification(),
+      driver->server_context()->js_tokenizer_patterns());
+  config->set_minified_code_cache(
+      driver->server_context()->minified_javascript_cache());
+  return config;
 }
 
 void JavascriptFilter::InitializeConfigIfNecessary() {
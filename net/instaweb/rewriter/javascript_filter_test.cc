@@ -1326,7 +1326,7 @@ TEST_P(JavascriptFilterTest, SourceMapOnDemandNotEnabled) {
   }
 
   // Note: !options()->use_experimental_js_minifier() also checks the
-  // code_block.SourceMappings().empty() case.
+  // code_block.EncodedSourceMappings().empty() case.
 }
 
 // If JS isn't optimizable, do not fallback to serving js for source_map!
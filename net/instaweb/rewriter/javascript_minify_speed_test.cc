@@ -41,6 +41,7 @@
 #include "pagespeed/kernel/base/null_message_handler.h"
 #include "pagespeed/kernel/base/null_statistics.h"
 #include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/js/js_keywords.h"
 #include "pagespeed/kernel/js/js_tokenizer.h"
 
 namespace net_instaweb {
@@ -49,12 +50,17 @@ extern const char* JS_console_js;
 
 namespace {
 
-void TestMinifyJavascript(bool use_experimental_minifier, int iters, int size) {
+GoogleString MakeInput(int size) {
   GoogleString in_text;
   for (int i = 0; i < size; i += strlen(JS_console_js)) {
     in_text += JS_console_js;
   }
   in_text.resize(size);
+  return in_text;
+}
+
+void TestMinifyJavascript(bool use_experimental_minifier, int iters, int size) {
+  GoogleString in_text = MakeInput(size);
 
   NullStatistics stats;
   JavascriptRewriteConfig::InitStats(&stats);
@@ -81,6 +87,24 @@ static void BM_MinifyJavascriptOld(int iters, int size) {
 }
 BENCHMARK_RANGE(BM_MinifyJavascriptOld, 1<<6, 1<<18);
 
+// Just the tokenizer that the new minifier is built on.
+static void BM_TokenizeJavascript(int iters, int size) {
+  StopBenchmarkTiming();
+  GoogleString in_text = MakeInput(size);
+  pagespeed::js::JsTokenizerPatterns js_tokenizer_patterns;
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    pagespeed::js::JsTokenizer tokenizer(&js_tokenizer_patterns, in_text);
+    StringPiece token;
+    pagespeed::JsKeywords::Type type;
+    do {
+      type = tokenizer.NextToken(&token);
+    } while (type != pagespeed::JsKeywords::kEndOfInput &&
+             type != pagespeed::JsKeywords::kError);
+  }
+}
+BENCHMARK_RANGE(BM_TokenizeJavascript, 1<<6, 1<<18);
+
 }  // namespace
 
 }  // namespace net_instaweb
@@ -46,6 +46,7 @@
 #include "net/instaweb/rewriter/public/server_context.h"
 #include "net/instaweb/rewriter/public/url_partnership.h"
 #include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/escaping.h"
 #include "pagespeed/kernel/base/function.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/statistics.h"
@@ -466,19 +467,17 @@ bool JsCombineFilter::JsCombiner::WritePiece(
     }
   }
 
-  // We write out code of each script into a variable.
-  writer->Write(StrCat("var ",
-                       JsCombineFilter::VarName(
-                           rewrite_driver_, input->url()),
-                       " = "),
-                handler);
-
-  GoogleString escaped;
-  JavascriptCodeBlock::ToJsStringLiteral(not_escaped, &escaped);
-
-  writer->Write(escaped, handler);
-  writer->Write(";\n", handler);
-  return true;
+  // We write out code of each script into a variable.  The script is
+  // escaped a piece at a time as it is written out, rather than into a
+  // second full-size copy.
+  bool ret = writer->Write("var ", handler);
+  ret &= writer->Write(
+      JsCombineFilter::VarName(rewrite_driver_, input->url()), handler);
+  ret &= writer->Write(" = ", handler);
+  ret &= EscapeToJsStringLiteral(not_escaped, true /* add quotes */, writer,
+                                 handler);
+  ret &= writer->Write(";\n", handler);
+  return ret;
 }
 
 JavascriptCodeBlock* JsCombineFilter::JsCombiner::BlockForResource(
@@ -32,7 +32,6 @@
 
 namespace Css {
 
-class Ruleset;
 class Stylesheet;
 
 }  // namespace Css
@@ -84,17 +83,14 @@ class CriticalCssBeaconFilter : public CssSummarizerBase {
   virtual bool MustSummarize(HtmlElement* element) const;
   virtual void Summarize(Css::Stylesheet* stylesheet,
                          GoogleString* out) const;
+  // Takes the selectors from the shared CssRuleIndex, see GetRuleIndex.
+  virtual bool SummarizeContents(StringPiece contents,
+                                 GoogleString* out) const;
   virtual void SummariesDone();
 
   virtual void DetermineEnabled(GoogleString* disabled_reason);
 
  private:
-  static void FindSelectorsFromRuleset(const Css::Ruleset& ruleset,
-                                       StringSet* selectors);
-  // The following adds the selectors to the given StringSet.
-  static void FindSelectorsFromStylesheet(const Css::Stylesheet& css,
-                                          StringSet* selectors);
-
   // Append the selectors initialization JavaScript.
   void AppendSelectorsInitJs(GoogleString* script, const StringSet& selectors);
 
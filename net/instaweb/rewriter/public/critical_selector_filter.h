@@ -83,6 +83,10 @@ class CriticalSelectorFilter : public CssSummarizerBase {
   // that will not contain on-screen critical CSS.
   void Summarize(Css::Stylesheet* stylesheet,
                  GoogleString* out) const override;
+  // Uses GetRuleIndex, so that the stylesheet is parsed only once for all
+  // the pages that use it.
+  bool SummarizeContents(StringPiece contents,
+                         GoogleString* out) const override;
   void RenderSummary(int pos,
                      HtmlElement* element,
                      HtmlCharactersNode* char_node,
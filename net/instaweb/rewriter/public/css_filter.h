@@ -108,6 +108,10 @@ class CssFilter : public RewriteFilter {
   static const char kParseFailures[];
   static const char kFallbackRewrites[];
   static const char kFallbackFailures[];
+  static const char kMinifySkipped[];
+  static const char kMinifyBytes[];
+  static const char kMinifyUs[];
+  static const char kMinifySkippedSavedUs[];
   static const char kRewritesDropped[];
   static const char kTotalBytesSaved[];
   static const char kTotalOriginalBytes[];
@@ -205,6 +209,19 @@ class CssFilter : public RewriteFilter {
   Variable* num_fallback_rewrites_;
   // # of CSS blocks that failed to be rewritten in the fallback path.
   Variable* num_fallback_failures_;
+  // # of CSS blocks whose URLs were rewritten without parsing them, because
+  // they looked minified already (see css_minify_min_savings_percent),
+  // whether or not the result was used.  These are not counted in
+  // num_rewrites_dropped_.  Compare with num_blocks_rewritten_, the blocks
+  // that were minified.
+  Variable* num_minify_skipped_;
+  // Bytes of CSS parsed for minification, and the microseconds spent parsing
+  // and re-serializing them.
+  Variable* minify_bytes_;
+  Variable* minify_us_;
+  // Estimate of the microseconds saved by num_minify_skipped_, going by the
+  // average cost per byte of the CSS that was minified.
+  Variable* minify_skipped_saved_us_;
   // # of CSS rewrites which were not applied because they made the CSS larger
   // and did not rewrite any images in it/flatten any other CSS files into it.
   Variable* num_rewrites_dropped_;
@@ -322,14 +339,19 @@ class CssFilter::Context : public SingleRewriteContext {
                           const StringPiece& in_text, int64 in_text_size,
                           bool has_unparseables, Css::Stylesheet* stylesheet);
 
-  // Fall back to using CssTagScanner to find the URLs and rewrite them
-  // that way. Like RewriteCssFromRoot, output is written into output
-  // resource in Harvest(). Called if CSS Parser fails to parse doc.
-  // Returns whether or not fallback rewriting succeeds. Fallback can fail
-  // if URLs in CSS are not parseable.
-  bool FallbackRewriteUrls(const GoogleUrl& css_base_gurl,
-                           const GoogleUrl& css_trim_gurl,
-                           const StringPiece& in_text);
+  // Whether in_text looks minified enough already that parsing and
+  // re-serializing it is not worth it, so that only its URLs are rewritten.
+  bool ShouldSkipMinify(StringPiece in_text) const;
+
+  // Uses CssTagScanner to find the URLs and rewrite them in a single pass
+  // over the text, without parsing it. Like RewriteCssFromRoot, output is
+  // written into output resource in Harvest(). Called if ShouldSkipMinify or
+  // as a fallback if CSS Parser fails to parse doc.
+  // Returns whether or not rewriting succeeds. It can fail if URLs in CSS are
+  // not parseable.
+  bool RewriteUrlsOnly(const GoogleUrl& css_base_gurl,
+                       const GoogleUrl& css_trim_gurl,
+                       const StringPiece& in_text);
 
   // Tries to write out a (potentially edited) stylesheet out to out_text,
   // and returns whether we should consider the result as an improvement.
@@ -365,10 +387,13 @@ class CssFilter::Context : public SingleRewriteContext {
   bool css_rewritten_;
   bool has_utf8_bom_;
 
-  // Are we performing a fallback rewrite?
+  // Are we rewriting URLs with CssTagScanner instead of parsing? This is the
+  // case on parse failure (a fallback rewrite) and when minify_skipped_.
   bool fallback_mode_;
-  // Transformer used by CssTagScanner to rewrite URLs if we failed to
-  // parse CSS. This will only be defined if CSS parsing failed.
+  // Did we skip parsing because ShouldSkipMinify()?
+  bool minify_skipped_;
+  // Transformer used by CssTagScanner to rewrite URLs if we did not parse
+  // the CSS. This will only be defined in fallback_mode_.
   scoped_ptr<AssociationTransformer> fallback_transformer_;
   // Backup transformer for AssociationTransformer. Absolutifies URLs and
   // rewrites their domains as necessary if they can't be cache extended.
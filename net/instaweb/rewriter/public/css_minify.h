@@ -70,6 +70,29 @@ class CssMinify {
                            Writer* writer,
                            MessageHandler* handler);
 
+  // Writes a single minified selector, as it would appear in a ruleset.
+  static bool Selector(const Css::Selector& selector,
+                       Writer* writer,
+                       MessageHandler* handler);
+
+  // Writes minified media queries separated by commas, as they would appear
+  // after "@media ".
+  static bool MediaQueries(const Css::MediaQueries& media_queries,
+                           Writer* writer,
+                           MessageHandler* handler);
+
+  // Writes a minified ruleset (or unparsed region) without its @media
+  // wrapper.
+  static bool RulesetIgnoringMedia(const Css::Ruleset& ruleset,
+                                   Writer* writer,
+                                   MessageHandler* handler);
+
+  // Cheaply estimates what percentage of stylesheet_text minification would
+  // remove, without parsing it, by counting the bytes of whitespace and
+  // comments.  Already-minified CSS scores low, though usually not 0, since
+  // some whitespace separates tokens ("margin:0 auto").
+  static int EstimateSavingsPercent(StringPiece stylesheet_text);
+
   // Establishes a string-vector to collect all parsed URLs.
   void set_url_collector(StringVector* urls) { url_collector_ = urls; }
 
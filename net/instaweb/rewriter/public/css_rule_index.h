@@ -0,0 +1,158 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// A parsed stylesheet reduced to what critical CSS computation needs: the
+// minified text of every rule, split up by selector, together with the key
+// each selector is matched against on the client.  Selectors are also
+// bucketed by key, so a page's critical selectors can be looked up directly
+// rather than by checking every selector of every rule.  Building an index
+// is the expensive part (a full CSS parse); intersecting it with a page's
+// critical selectors is just lookups and string concatenation.  Since the
+// same stylesheets show up on many pages of a site, indices are kept in a
+// process-wide CssRuleIndexCache keyed by stylesheet contents.
+
+#ifndef NET_INSTAWEB_REWRITER_PUBLIC_CSS_RULE_INDEX_H_
+#define NET_INSTAWEB_REWRITER_PUBLIC_CSS_RULE_INDEX_H_
+
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/ref_counted_ptr.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/cache/lru_cache_base.h"
+
+namespace Css {
+class Stylesheet;
+}  // namespace Css
+
+namespace net_instaweb {
+
+class AbstractMutex;
+
+class CssRuleIndex : public RefCounted<CssRuleIndex> {
+ public:
+  // Indexes stylesheet.  Media that cannot affect the screen are dropped
+  // here, as they never are critical.  stylesheet is modified in the
+  // process, and should be discarded afterwards.
+  explicit CssRuleIndex(Css::Stylesheet* stylesheet);
+  ~CssRuleIndex();
+
+  // Appends to *out the minified stylesheet restricted to the rules with at
+  // least one selector in critical_selectors, and within those rules to the
+  // matching selectors.  Selectors are compared using
+  // css_util::JsDetectableSelector; ones that have no such form, unparsed
+  // regions, and rules with no parsed selectors are always kept.  @charset,
+  // @import and @font-face rules are always kept as well.
+  //
+  // This costs time proportional to the number of critical selectors and the
+  // size of the output, or to the number of selectors in the stylesheet if
+  // that is smaller.
+  void AppendCriticalSubset(const StringSet& critical_selectors,
+                            GoogleString* out) const;
+
+  // Appends to *out all the distinct non-empty selector keys, sorted and
+  // separated by commas.  These are the selectors worth beaconing for.
+  void AppendSelectorKeys(GoogleString* out) const;
+
+  // Number of distinct non-empty selector keys.
+  int num_selector_keys() const { return selector_index_.size(); }
+
+  // Approximate memory used by the index.
+  size_t size_bytes() const { return size_bytes_; }
+
+ private:
+  struct Rule;
+
+  // Identifies a selector by the index of its rule in rules_ and its own
+  // index within the rule.  Rules that are always kept are referred to as a
+  // whole with a selector index of -1.
+  typedef std::pair<int, int> SelectorPosition;
+  typedef std::vector<SelectorPosition> SelectorPositions;
+  typedef std::map<GoogleString, SelectorPositions> SelectorIndex;
+
+  // Appends rule to *out with the given selector text, opening and closing
+  // @media blocks as needed.  *open_media tracks the current block.
+  static void AppendRule(const Rule& rule, StringPiece selectors,
+                         const GoogleString** open_media, GoogleString* out);
+
+  // The two strategies for AppendCriticalSubset; they produce the same output.
+  void AppendCriticalSubsetByScan(const StringSet& critical_selectors,
+                                  GoogleString* out) const;
+  void AppendCriticalSubsetByLookup(const StringSet& critical_selectors,
+                                    GoogleString* out) const;
+
+  // Minified text of everything that precedes the rulesets.
+  GoogleString preamble_;
+  std::vector<Rule*> rules_;
+
+  // Positions of the selectors with each non-empty key.
+  SelectorIndex selector_index_;
+  // Positions of the selectors (and rules) kept whatever the critical
+  // selectors are, in order.
+  SelectorPositions always_kept_;
+
+  size_t size_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(CssRuleIndex);
+};
+
+typedef RefCountedPtr<CssRuleIndex> CssRuleIndexPtr;
+
+// A thread-safe, size-bounded LRU cache of CssRuleIndex objects.  Entries
+// are shared, so an index found here stays valid while the caller holds on
+// to it even if it is evicted meanwhile.
+class CssRuleIndexCache {
+ public:
+  // Takes ownership of mutex.
+  CssRuleIndexCache(size_t max_bytes, AbstractMutex* mutex);
+  ~CssRuleIndexCache();
+
+  // Returns the index stored under key, or a NULL pointer.
+  CssRuleIndexPtr Find(const GoogleString& key);
+
+  void Insert(const GoogleString& key, const CssRuleIndexPtr& index);
+
+ private:
+  class ValueHelper {
+   public:
+    size_t size(const CssRuleIndexPtr& index) const {
+      return index->size_bytes();
+    }
+    bool Equal(const CssRuleIndexPtr& a, const CssRuleIndexPtr& b) const {
+      return a.get() == b.get();
+    }
+    void EvictNotify(const CssRuleIndexPtr& index) {}
+    bool ShouldReplace(const CssRuleIndexPtr& old_index,
+                       const CssRuleIndexPtr& new_index) const {
+      return true;
+    }
+  };
+
+  scoped_ptr<AbstractMutex> mutex_;
+  ValueHelper value_helper_;
+  LRUCacheBase<CssRuleIndexPtr, ValueHelper> lru_;  // guarded by mutex_
+
+  DISALLOW_COPY_AND_ASSIGN(CssRuleIndexCache);
+};
+
+}  // namespace net_instaweb
+
+#endif  // NET_INSTAWEB_REWRITER_PUBLIC_CSS_RULE_INDEX_H_
@@ -21,6 +21,7 @@
 
 #include <vector>
 
+#include "net/instaweb/rewriter/public/css_rule_index.h"
 #include "net/instaweb/rewriter/public/resource_slot.h"
 #include "net/instaweb/rewriter/public/rewrite_filter.h"
 #include "pagespeed/kernel/base/basictypes.h"
@@ -53,6 +54,8 @@ class CssSummarizerBase : public RewriteFilter {
  public:
   static const char kNumCssUsedForCriticalCssComputation[];
   static const char kNumCssNotUsedForCriticalCssComputation[];
+  static const char kCssRuleIndexCacheHits[];
+  static const char kCssRuleIndexCacheMisses[];
 
   explicit CssSummarizerBase(RewriteDriver* driver);
   virtual ~CssSummarizerBase();
@@ -136,6 +139,24 @@ class CssSummarizerBase : public RewriteFilter {
   virtual void Summarize(Css::Stylesheet* stylesheet,
                          GoogleString* out) const = 0;
 
+  // Computes the summary of the CSS text contents into *out, returning false
+  // if the CSS could not be parsed. The default implementation parses it with
+  // ParseForSummary and calls Summarize; subclasses that can reuse work
+  // across documents may override it. The same threading and statelessness
+  // requirements as for Summarize apply.
+  virtual bool SummarizeContents(StringPiece contents,
+                                 GoogleString* out) const;
+
+  // Parses contents the way CSS is parsed for summarization, returning NULL
+  // on an unrecoverable parse error.
+  static Css::Stylesheet* ParseForSummary(StringPiece contents);
+
+  // Returns the CssRuleIndex for the CSS text contents, from the server's
+  // CssRuleIndexCache if possible, so that stylesheets shared between pages
+  // are parsed only once.  Returns a NULL pointer if contents could not be
+  // parsed.  Like Summarize, this can be called from a rewrite thread.
+  CssRuleIndexPtr GetRuleIndex(StringPiece contents) const;
+
   // This can be optionally overridden to modify a CSS element based on a
   // successfully computed summary. It might not be invoked if cached
   // information is not readily available, and will not be invoked if CSS
@@ -258,6 +279,8 @@ class CssSummarizerBase : public RewriteFilter {
 
   Variable* num_css_used_for_critical_css_computation_;
   Variable* num_css_not_used_for_critical_css_computation_;
+  Variable* css_rule_index_cache_hits_;
+  Variable* css_rule_index_cache_misses_;
 
   DISALLOW_COPY_AND_ASSIGN(CssSummarizerBase);
 };
@@ -25,7 +25,6 @@
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/escaping.h"
 #include "pagespeed/kernel/base/hasher.h"
-#include "pagespeed/kernel/base/source_map.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/http/google_url.h"
@@ -34,6 +33,7 @@ namespace pagespeed { namespace js { struct JsTokenizerPatterns; } }
 
 namespace net_instaweb {
 
+class CacheInterface;
 class JavascriptLibraryIdentification;
 class MessageHandler;
 class Statistics;
@@ -52,6 +52,8 @@ class JavascriptRewriteConfig {
   static const char kTotalOriginalBytes[];
   static const char kMinifyUses[];
   static const char kNumReducingMinifications[];
+  static const char kMinifyMemoHits[];
+  static const char kMinifyMemoMisses[];
 
   // Those are JS rewrite failure type statistics.
   static const char kJSMinificationDisabled[];
@@ -78,6 +80,15 @@ class JavascriptRewriteConfig {
     return js_tokenizer_patterns_;
   }
 
+  // In-memory blocking cache, shared by every server context in the process,
+  // mapping JS contents to their minified form so that the same script
+  // served under several URLs or vhosts is only minified once.  NULL (the
+  // default) disables the memoization.  Not owned.
+  CacheInterface* minified_code_cache() const { return minified_code_cache_; }
+  void set_minified_code_cache(CacheInterface* cache) {
+    minified_code_cache_ = cache;
+  }
+
   Variable* blocks_minified() { return blocks_minified_; }
   Variable* libraries_identified() { return libraries_identified_; }
   Variable* minification_failures() { return minification_failures_; }
@@ -85,6 +96,8 @@ class JavascriptRewriteConfig {
   Variable* total_original_bytes() { return total_original_bytes_; }
   Variable* num_uses() { return num_uses_; }
   Variable* num_reducing_uses() { return num_reducing_minifications_; }
+  Variable* minify_memo_hits() { return minify_memo_hits_; }
+  Variable* minify_memo_misses() { return minify_memo_misses_; }
 
   Variable* minification_disabled() { return minification_disabled_; }
   Variable* did_not_shrink() { return did_not_shrink_; }
@@ -96,6 +109,7 @@ class JavascriptRewriteConfig {
   // Library identifier.  NULL if library identification should be skipped.
   const JavascriptLibraryIdentification* library_identification_;
   const pagespeed::js::JsTokenizerPatterns* js_tokenizer_patterns_;
+  CacheInterface* minified_code_cache_;
 
   // Statistics
   // # of JS blocks (JS files and <script> blocks) successfully minified:
@@ -117,6 +131,10 @@ class JavascriptRewriteConfig {
   Variable* num_uses_;
   // Number of times we have successfully reduced the size of JS block.
   Variable* num_reducing_minifications_;
+  // # of JS blocks whose minification was found in / missing from
+  // minified_code_cache_.
+  Variable* minify_memo_hits_;
+  Variable* minify_memo_misses_;
 
   // Failure metrics.
   // Number of scripts we didn't rewrite JS because minification was disabled.
@@ -143,6 +161,7 @@ class JavascriptCodeBlock {
   // Javascript context for debugging.
   static const char kIntrospectionComment[];
 
+  // original_code is not copied, and must outlive the JavascriptCodeBlock.
   JavascriptCodeBlock(const StringPiece& original_code,
                       JavascriptRewriteConfig* config,
                       const StringPiece& message_id,
@@ -169,10 +188,13 @@ class JavascriptCodeBlock {
     return rewritten_code_;
   }
 
-  // Returns the contents of a source map from original to rewritten.
+  // Returns the mappings from original to rewritten, in the encoded form
+  // used for the "mappings" field of a source map (see
+  // source_map::EncodeWithEncodedMappings).  Empty if there are none, or if
+  // set_need_source_mappings(true) was not called.
   // PRECONDITION: Rewrite() must have been called first and
   // successfully_rewritten() must be true.
-  const source_map::MappingVector& SourceMappings() const {
+  const GoogleString& EncodedSourceMappings() const {
     DCHECK(rewritten_);
     DCHECK(successfully_rewritten_);
     return source_mappings_;
@@ -186,6 +208,18 @@ class JavascriptCodeBlock {
   // this probably shouldn't happen in practice.
   void AppendSourceMapUrl(StringPiece url);
 
+  // Call before Rewrite() if EncodedSourceMappings() will be consulted.
+  // Source mappings are not kept in the config's minified_code_cache(), so
+  // blocks that need them are always minified afresh.  Defaults to false.
+  void set_need_source_mappings(bool x) { need_source_mappings_ = x; }
+
+  // Call before Rewrite() to consult and fill in the config's
+  // minified_code_cache().  Meant for external resources, which are often
+  // the same library under many URLs.  Inline scripts are usually unique to
+  // a page, may hold per-user data, and would only evict the shared entries,
+  // so they should leave this off.  Defaults to false.
+  void set_memoize_minification(bool x) { memoize_minification_ = x; }
+
   // Is the current block a JS library that can be redirected to a canonical
   // URL?  If so, return that canonical URL (storage owned by the underlying
   // config object passed in at construction), otherwise return an empty
@@ -234,19 +268,30 @@ class JavascriptCodeBlock {
   static bool IsSanitarySourceMapUrl(StringPiece url);
 
   // Temporary wrapper around calling new or old version of JS minifier.
+  // source_mappings may be NULL if they are not wanted.
   bool MinifyJs(StringPiece input, GoogleString* output,
-                source_map::MappingVector* source_mappings);
+                GoogleString* source_mappings);
+
+  // Like MinifyJs(original_code_, &rewritten_code_, ...), but consults and
+  // fills in the config's minified_code_cache() when one is available, the
+  // block asked for memoization and source mappings are not needed.
+  bool MinifyJsWithMemo();
+
+  // Key under which the minification of original_code_ is memoized.
+  GoogleString MinifyMemoKey() const;
 
   JavascriptRewriteConfig* config_;
   const GoogleString message_id_;  // ID to stick at begining of message.
-  const GoogleString original_code_;
+  const StringPiece original_code_;
   GoogleString rewritten_code_;
-  source_map::MappingVector source_mappings_;
+  GoogleString source_mappings_;  // Encoded; see EncodedSourceMappings().
 
   // Used to make sure we don't rewrite twice and that results aren't looked at
   // before produced.
   bool rewritten_;
   bool successfully_rewritten_;
+  bool need_source_mappings_;
+  bool memoize_minification_;
 
   MessageHandler* handler_;
 
@@ -116,7 +116,9 @@ class ResourceCombiner {
   // a combination. Returns whether successful. The default implementation
   // writes input->contents() to the writer without any alteration.
   // 'index' is the position of this piece in the combination, while
-  // num_pieces is the total number of pieces.
+  // num_pieces is the total number of pieces.  writer goes straight to the
+  // combination's contents, so large pieces are best written in parts
+  // rather than built up in a string first.
   virtual bool WritePiece(int index, int num_pieces, const Resource* input,
                           OutputResource* combination, Writer* writer,
                           MessageHandler* handler);
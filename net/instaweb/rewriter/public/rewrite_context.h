@@ -19,6 +19,7 @@
 #ifndef NET_INSTAWEB_REWRITER_PUBLIC_REWRITE_CONTEXT_H_
 #define NET_INSTAWEB_REWRITER_PUBLIC_REWRITE_CONTEXT_H_
 
+#include <deque>
 #include <set>
 #include <vector>
 
@@ -33,6 +34,7 @@
 #include "pagespeed/controller/schedule_rewrite_callback.h"
 #include "pagespeed/kernel/base/atomic_bool.h"
 #include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/cache_interface.h"
 #include "pagespeed/kernel/base/function.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/string.h"
@@ -635,6 +637,7 @@ class RewriteContext {
 
  private:
   class OutputCacheCallback;
+  class NestedLookupBatch;
   class WriteIfChanged;
   class LookupMetadataForOutputResourceCallback;
   class HTTPCacheCallback;
@@ -661,6 +664,10 @@ class RewriteContext {
 
   // Callback helper functions.
   void Start();
+  // Like Start(), but if a metadata cache lookup is needed it is appended to
+  // *lookups rather than issued, so that the caller can issue the lookups of
+  // several contexts with one MultiGet.  lookups may be NULL.
+  void StartWithBatchedLookup(CacheInterface::MultiGetRequest* lookups);
   void SetPartitionKey();
   void StartFetch();
   void StartFetchImpl();
@@ -828,6 +835,16 @@ class RewriteContext {
   // high-priority rewrite thread.
   void StartNestedTasksImpl();
 
+  // Called by a nested context before it fetches its inputs.  Returns true
+  // if it may go ahead; otherwise max_concurrent_nested_fetches() nested
+  // contexts are already fetching, and 'nested' is queued to have its
+  // FetchInputs re-run when one of them finishes.
+  bool TryStartNestedFetch(RewriteContext* nested);
+
+  // Called by a nested context once all its inputs have been fetched,
+  // handing its place on to the next queued nested context, if any.
+  void NestedFetchDone();
+
   // Establishes that a slot has been rewritten.  So when Propagate()
   // is called, the resource update that has been written to this slot can
   // be propagated to the DOM.
@@ -936,6 +953,15 @@ class RewriteContext {
   int num_pending_nested_;
   std::vector<RewriteContext*> nested_;
 
+  // The number of nested contexts currently fetching their inputs, and those
+  // waiting for their turn, if the options limit how many may do so at once.
+  int num_nested_fetches_;
+  std::deque<RewriteContext*> deferred_nested_fetches_;
+
+  // True while this nested context counts towards its parent's
+  // num_nested_fetches_.
+  bool nested_fetch_started_;
+
   // If this context is nested, the parent is the context that 'owns' it.
   RewriteContext* parent_;
 
@@ -90,7 +90,9 @@ class RequestProperties;
 class RequestTrace;
 class RewriteDriverPool;
 class RewriteFilter;
+class SplitWriter;
 class Statistics;
+class StringWriter;
 class UrlLeftTrimFilter;
 class UrlNamer;
 
@@ -482,7 +484,7 @@ class RewriteDriver : public HtmlParse {
   }
 
   // Takes ownership of 'options'. pool denotes the pool of rewrite drivers that
-  // use these options. May be NULL if using custom options.
+  // use these options. May be NULL if the driver is not to be recycled.
   void set_options_for_pool(RewriteDriverPool* pool, RewriteOptions* options) {
     controlling_pool_ = pool;
     options_.reset(options);
@@ -511,6 +513,10 @@ class RewriteDriver : public HtmlParse {
   // As above, but asynchronous. Note that the RewriteDriver may already be
   // deleted at the point the callback is invoked. The scheduler lock will
   // not be held when the callback is run.
+  //
+  // With RewriteOptions::cache_rewritten_html, a document that was parsed in
+  // a single flush window may be finished by writing its cached rewritten
+  // output, without lexing or filtering it.
   void FinishParseAsync(Function* callback);
 
   // Report error message with description of context's location
@@ -928,13 +934,28 @@ class RewriteDriver : public HtmlParse {
   // the callback is called. Scheduler mutex is not held while done is called.
   void FlushAsync(Function* done);
 
+  // Parses text that arrived while a flush is waiting for its rewrites into
+  // the look-ahead queue started by FlushAsync (see
+  // RewriteOptions::lex_ahead_during_flush).  Completed rewrites can render
+  // into the DOM from the rewrite thread meanwhile, so this excludes
+  // RewriteComplete for the duration.  Must be called from html_worker()
+  // while lexing_ahead().
+  void LexAheadText(const StringPiece& text) LOCKS_EXCLUDED(rewrite_mutex());
+
   // Queues up a task to run on the (high-priority) rewrite thread.
   void AddRewriteTask(Function* task);
 
+  // Like AddRewriteTask, for a batch of tasks queued in order with a single
+  // Sequence::AddAll.  Clears the vector.
+  void AddRewriteTasks(std::vector<Function*>* tasks);
+
   // Queues up a task to run on the low-priority rewrite thread.
   // Such tasks are expected to be safely cancelable.
   void AddLowPriorityRewriteTask(Function* task);
 
+  // Like AddLowPriorityRewriteTask, for a batch of tasks.  Clears the vector.
+  void AddLowPriorityRewriteTasks(std::vector<Function*>* tasks);
+
   QueuedWorkerPool::Sequence* html_worker() { return html_worker_; }
   Sequence* rewrite_worker();
   Scheduler::Sequence* scheduler_sequence() {
@@ -1163,6 +1184,19 @@ class RewriteDriver : public HtmlParse {
              StringPiece charset,
              OutputResource* output);
 
+  // Two-step form of Write() for callers that produce the contents in
+  // pieces, so they can be written straight into the output resource rather
+  // than first being gathered into one string.  BeginWrite sets up the
+  // output's headers and returns the writer to send the contents to (owned
+  // by output), or NULL on failure.  EndWrite must then be called, passing
+  // whether every write succeeded; it finishes the output and returns true
+  // iff it was written successfully.
+  Writer* BeginWrite(const ResourceVector& inputs,
+                     const ContentType* type,
+                     StringPiece charset,
+                     OutputResource* output);
+  bool EndWrite(OutputResource* output, bool contents_written);
+
   void set_defer_instrumentation_script(bool x) {
     defer_instrumentation_script_ = x;
   }
@@ -1288,6 +1322,35 @@ class RewriteDriver : public HtmlParse {
   void QueueFinishParseAfterFlush(Function* user_callback);
   void FinishParseAfterFlush(Function* user_callback);
 
+  // Finishes the parse the normal way: flushes the remaining events
+  // through the filters and then calls FinishParseAfterFlush.
+  void FinishParseRewriting(Function* user_callback);
+
+  // Looks up the rewritten output of the document in the metadata cache,
+  // and calls back into the driver on the html worker.
+  class RewrittenHtmlCacheCallback;
+
+  // Returns the metadata cache key for the rewritten output of the document
+  // whose input is buffered in rewritten_html_cache_input_.
+  GoogleString RewrittenHtmlCacheKey() const;
+
+  // Finishes the parse with html, the cached rewritten output of the
+  // document, bypassing the lexer and the filters.
+  void FinishParseFromRewrittenHtmlCache(StringPiece html,
+                                         Function* user_callback);
+
+  // Rewrites the buffered document, capturing the output so that
+  // FinishParseAfterFlush can store it in the cache.
+  void FinishParseCachingRewrittenHtml(Function* user_callback);
+
+  // Stores the output captured by FinishParseCachingRewrittenHtml if all of
+  // the document's rewrites finished in time.
+  void StoreRewrittenHtml();
+
+  // Gives up on caching the rewritten output of this document, e.g. because
+  // it is flushed in several windows, and lexes any text buffered so far.
+  void StopCachingRewrittenHtml();
+
   bool RewritesComplete() const EXCLUSIVE_LOCKS_REQUIRED(rewrite_mutex());
 
   // Sets the base GURL in response to a base-tag being parsed.  This
@@ -1310,6 +1373,9 @@ class RewriteDriver : public HtmlParse {
   // Parses an arbitrary block of an html file
   virtual void ParseTextInternal(const char* content, int size);
 
+  // Passes a block of html to the lexer.
+  void LexText(const char* content, int size);
+
   // Indicates whether we should skip parsing for the given request.
   bool ShouldSkipParsing();
 
@@ -1631,7 +1697,7 @@ class RewriteDriver : public HtmlParse {
 
   scoped_ptr<RewriteOptions> options_;
 
-  RewriteDriverPool* controlling_pool_;  // or NULL if this has custom options.
+  RewriteDriverPool* controlling_pool_;  // or NULL if not recycled.
 
   // Object which manages CacheUrlAsyncFetcher async operations.
   scoped_ptr<CacheUrlAsyncFetcher::AsyncOpHooks>
@@ -1658,6 +1724,11 @@ class RewriteDriver : public HtmlParse {
   QueuedWorkerPool::Sequence* low_priority_rewrite_worker_;
   scoped_ptr<Scheduler::Sequence> scheduler_sequence_;
 
+  // Held while rendering completed rewrites in RewriteComplete and while
+  // lexing ahead in LexAheadText, which run on different threads but both
+  // mutate the DOM and its arenas.  Acquired after rewrite_mutex().
+  scoped_ptr<AbstractMutex> dom_mutex_;
+
   Writer* writer_;
 
   // Stores any cached properties associated with the current URL and fallback
@@ -1689,6 +1760,20 @@ class RewriteDriver : public HtmlParse {
   // The total number of bytes for which ParseText is called.
   int num_bytes_in_;
 
+  // State for RewriteOptions::cache_rewritten_html.  While
+  // caching_rewritten_html_ is set, ParseText buffers the document in
+  // rewritten_html_cache_input_ instead of lexing it.  On a cache miss the
+  // output is captured in rewritten_html_cache_output_ via
+  // rewritten_html_split_writer_, and stored unless a rewrite missed its
+  // deadline, which clears rewritten_html_cacheable_.
+  bool caching_rewritten_html_;
+  bool rewritten_html_cacheable_;
+  GoogleString rewritten_html_cache_input_;
+  GoogleString rewritten_html_cache_key_;
+  GoogleString rewritten_html_cache_output_;
+  scoped_ptr<StringWriter> rewritten_html_output_writer_;
+  scoped_ptr<SplitWriter> rewritten_html_split_writer_;
+
   DebugFilter* debug_filter_;
 
   scoped_ptr<FlushEarlyInfo> flush_early_info_;
@@ -39,11 +39,14 @@ namespace pagespeed { namespace js { struct JsTokenizerPatterns; } }
 
 namespace net_instaweb {
 
+class CacheInterface;
 class CriticalImagesFinder;
 class CriticalSelectorFinder;
+class CssRuleIndexCache;
 class FileSystem;
 class ExperimentMatcher;
 class Hasher;
+class LRUCache;
 class MessageHandler;
 class NamedLockManager;
 class NonceGenerator;
@@ -167,6 +170,16 @@ class RewriteDriverFactory {
   const pagespeed::js::JsTokenizerPatterns* js_tokenizer_patterns() const {
     return js_tokenizer_patterns_;
   }
+  // Process-wide in-memory cache memoizing JavaScript minification by
+  // content, shared by all server contexts.  See JavascriptRewriteConfig.
+  CacheInterface* minified_javascript_cache() {
+    return minified_javascript_cache_.get();
+  }
+  // Process-wide cache of stylesheets indexed for critical CSS computation,
+  // keyed by content and shared by all server contexts.
+  CssRuleIndexCache* css_rule_index_cache() {
+    return css_rule_index_cache_.get();
+  }
   const std::vector<const UserAgentNormalizer*>& user_agent_normalizers();
 
   // Computes URL fetchers using the base fetcher, and optionally,
@@ -457,6 +470,12 @@ class RewriteDriverFactory {
   ServerContextSet server_contexts_;
   scoped_ptr<AbstractMutex> server_context_mutex_;
 
+  // Backing store for minified_javascript_cache_, which wraps it in a mutex.
+  scoped_ptr<LRUCache> minified_javascript_lru_cache_;
+  scoped_ptr<CacheInterface> minified_javascript_cache_;
+
+  scoped_ptr<CssRuleIndexCache> css_rule_index_cache_;
+
   // Stores options with hard-coded defaults and adjustments from
   // the core system, subclasses, and command-line.
   scoped_ptr<RewriteOptions> default_options_;
@@ -31,8 +31,17 @@ class RewriteOptions;
 // A class for managing recycling of RewriteDrivers with standard options.
 // Note that this class by itself is not threadsafe, as ServerContext
 // takes care of that.
+//
+// The pool tracks how many of its drivers are handed out at once, and only
+// keeps enough idle drivers around to cover the peak of the current or the
+// previous adaptation window, so a burst of traffic doesn't pin memory for
+// ever, while steady concurrency never has to construct drivers.
 class RewriteDriverPool  {
  public:
+  // Number of hand-outs after which we forget the older of the two peaks we
+  // size the pool by.
+  static const int kAdaptationWindow = 1000;
+
   RewriteDriverPool();
 
   // Deletes all drivers in the pool.
@@ -43,9 +52,31 @@ class RewriteDriverPool  {
   // Return a driver from freelist, or NULL.
   RewriteDriver* PopDriver();
 
-  // Stores the driver on freelist, and Clear()s it for reuse.
+  // Records that a driver for this pool, either from PopDriver or freshly
+  // constructed, has been handed out. Every call must eventually be matched
+  // by a RecycleDriver.
+  void NoteDriverHandedOut();
+
+  // Stores the driver on freelist, and Clear()s it for reuse, or deletes it
+  // if the pool already holds enough drivers for the concurrency we've seen,
+  // or has been retired.
   void RecycleDriver(RewriteDriver* driver);
 
+  // Deletes all idle drivers, and makes any future RecycleDriver delete its
+  // argument. Used when the owner wants to get rid of the pool but some of
+  // its drivers are still out.
+  void Retire();
+  bool retired() const { return retired_; }
+
+  // Number of drivers handed out and not yet recycled.
+  int num_outstanding() const { return num_outstanding_; }
+
+  // Number of drivers currently on the freelist.
+  int num_idle() const { return drivers_.size(); }
+
+  // The number of drivers, idle plus outstanding, we will retain.
+  int Capacity() const;
+
  private:
   std::vector<RewriteDriver*> drivers_;
 
@@ -54,6 +85,12 @@ class RewriteDriverPool  {
   // a lot of them lying around winds up wasting a lot of memory instead.
   static const int kMaxDriversInPool = 50;
 
+  int num_outstanding_;
+  int hand_outs_in_window_;
+  int window_peak_;
+  int previous_window_peak_;
+  bool retired_;
+
   DISALLOW_COPY_AND_ASSIGN(RewriteDriverPool);
 };
 
@@ -258,6 +258,7 @@ class RewriteOptions {
   static const char kBeaconReinstrumentTimeSec[];
   static const char kBeaconUrl[];
   static const char kCacheFragment[];
+  static const char kCacheRewrittenHtml[];
   static const char kCacheSmallImagesUnrewritten[];
   static const char kClientDomainRewrite[];
   static const char kCombineAcrossPaths[];
@@ -267,6 +268,7 @@ class RewriteOptions {
   static const char kCssFlattenMaxBytes[];
   static const char kCssImageInlineMaxBytes[];
   static const char kCssInlineMaxBytes[];
+  static const char kCssMinifyMinSavingsPercent[];
   static const char kCssOutlineMinBytes[];
   static const char kCssPreserveURLs[];
   static const char kDefaultCacheHtml[];
@@ -335,6 +337,7 @@ class RewriteOptions {
   static const char kJsPreserveURLs[];
   static const char kLazyloadImagesAfterOnload[];
   static const char kLazyloadImagesBlankUrl[];
+  static const char kLexAheadDuringFlush[];
   static const char kLoadFromFileCacheTtlMs[];
   static const char kLogBackgroundRewrite[];
   static const char kLogMobilizationSamples[];
@@ -344,6 +347,7 @@ class RewriteOptions {
   static const char kMaxCacheableResponseContentLength[];
   static const char kMaxCombinedCssBytes[];
   static const char kMaxCombinedJsBytes[];
+  static const char kMaxConcurrentNestedFetches[];
   static const char kMaxHtmlCacheTimeMs[];
   static const char kMaxHtmlParseBytes[];
   static const char kMaxImageSizeLowResolutionBytes[];
@@ -1423,6 +1427,11 @@ class RewriteOptions {
   // element to work.
   bool RequiresAddHead() const;
 
+  // Returns true if cache_rewritten_html() is on and no enabled filter
+  // makes the rewritten html depend on anything beyond the input html, the
+  // request URL, its User-Agent and Accept headers, and these options.
+  bool CanCacheRewrittenHtml() const;
+
   // Returns true if any filter benefits from per-origin property cache
   // information.
   bool UsePerOriginPropertyCachePage() const;
@@ -1626,6 +1635,12 @@ class RewriteOptions {
   void set_css_inline_max_bytes(int64 x) {
     set_option(x, &css_inline_max_bytes_);
   }
+  int css_minify_min_savings_percent() const {
+    return css_minify_min_savings_percent_.value();
+  }
+  void set_css_minify_min_savings_percent(int x) {
+    set_option(x, &css_minify_min_savings_percent_);
+  }
   int64 google_font_css_inline_max_bytes() const {
     return google_font_css_inline_max_bytes_.value();
   }
@@ -2373,6 +2388,20 @@ class RewriteOptions {
   void set_follow_flushes(bool x) { set_option(x, &follow_flushes_); }
   bool follow_flushes() const { return follow_flushes_.value(); }
 
+  void set_lex_ahead_during_flush(bool x) {
+    set_option(x, &lex_ahead_during_flush_);
+  }
+  bool lex_ahead_during_flush() const {
+    return lex_ahead_during_flush_.value();
+  }
+
+  void set_cache_rewritten_html(bool x) {
+    set_option(x, &cache_rewritten_html_);
+  }
+  bool cache_rewritten_html() const {
+    return cache_rewritten_html_.value();
+  }
+
   void set_enable_defer_js_experimental(bool x) {
     set_option(x, &enable_defer_js_experimental_);
   }
@@ -2576,6 +2605,13 @@ class RewriteOptions {
     return max_combined_js_bytes_.value();
   }
 
+  void set_max_concurrent_nested_fetches(int x) {
+    set_option(x, &max_concurrent_nested_fetches_);
+  }
+  int max_concurrent_nested_fetches() const {
+    return max_concurrent_nested_fetches_.value();
+  }
+
   void set_pre_connect_url(StringPiece p) {
     set_option(GoogleString(p.data(), p.size()), &pre_connect_url_);
   }
@@ -3674,6 +3710,9 @@ class RewriteOptions {
   Option<int64> image_resolution_limit_bytes_;
   Option<int64> css_image_inline_max_bytes_;
   Option<int64> css_inline_max_bytes_;
+  // If CssMinify::EstimateSavingsPercent of a stylesheet is below this, it
+  // is taken to be minified already, and only its URLs are rewritten.
+  Option<int> css_minify_min_savings_percent_;
   Option<int64> css_outline_min_bytes_;
   Option<int64> google_font_css_inline_max_bytes_;
 
@@ -3788,6 +3827,12 @@ class RewriteOptions {
   // If set to true, ProxyFetch will request a flush on its RewriteDriver when
   // Flush() is called on it.
   Option<bool> follow_flushes_;
+  // Experimental: if set, ProxyFetch lexes HTML that arrives while a flush
+  // window is being rewritten, rather than waiting for the flush to finish.
+  Option<bool> lex_ahead_during_flush_;
+  // Experimental: if set, RewriteDriver caches the rewritten output of
+  // documents parsed in a single flush window, keyed by their input.
+  Option<bool> cache_rewritten_html_;
   // Should we serve stale responses if the fetch results in a server side
   // error.
   Option<bool> serve_stale_if_fetch_error_;
@@ -4040,6 +4085,11 @@ class RewriteOptions {
   // Negative value will bypass the size check.
   Option<int64> max_combined_js_bytes_;
 
+  // Maximum number of nested rewrites of one resource, e.g. of the images in
+  // a stylesheet, that may be fetching their inputs at the same time.
+  // Zero or a negative value means there is no limit.
+  Option<int> max_concurrent_nested_fetches_;
+
   // Url to which pre connect requests will be sent.
   Option<GoogleString> pre_connect_url_;
   // The number of requests for which the status code should remain same so that
@@ -98,6 +98,13 @@ class RewriteStats {
 
   Variable* num_conditional_refreshes() { return num_conditional_refreshes_; }
 
+  // Lookups of whole rewritten html documents, see
+  // RewriteOptions::cache_rewritten_html.
+  Variable* rewritten_html_cache_hits() { return rewritten_html_cache_hits_; }
+  Variable* rewritten_html_cache_misses() {
+    return rewritten_html_cache_misses_;
+  }
+
   Variable* ipro_served() { return ipro_served_; }
   Variable* ipro_not_in_cache() { return ipro_not_in_cache_; }
   Variable* ipro_not_rewritable() { return ipro_not_rewritable_; }
@@ -117,6 +124,9 @@ class RewriteStats {
   // HTML rewrite latency in ms.
   Histogram* rewrite_latency_histogram() { return rewrite_latency_histogram_; }
   Histogram* backend_latency_histogram() { return backend_latency_histogram_; }
+  Histogram* html_parse_allocations_histogram() {
+    return html_parse_allocations_histogram_;
+  }
 
   // Number of .pagespeed. resources fetched.
   TimedVariable* total_fetch_count() { return total_fetch_count_; }
@@ -152,6 +162,8 @@ class RewriteStats {
   Variable* num_proactively_freshen_user_facing_request_;
   Variable* fallback_responses_served_while_revalidate_;
   Variable* num_conditional_refreshes_;
+  Variable* rewritten_html_cache_hits_;
+  Variable* rewritten_html_cache_misses_;
   Variable* ipro_served_;
   Variable* ipro_not_in_cache_;
   Variable* ipro_not_rewritable_;
@@ -162,6 +174,7 @@ class RewriteStats {
   Histogram* fetch_latency_histogram_;
   Histogram* rewrite_latency_histogram_;
   Histogram* backend_latency_histogram_;
+  Histogram* html_parse_allocations_histogram_;
 
   TimedVariable* total_fetch_count_;
   TimedVariable* total_rewrite_count_;
@@ -21,6 +21,8 @@
 #define NET_INSTAWEB_REWRITER_PUBLIC_SERVER_CONTEXT_H_
 
 #include <cstddef>                     // for size_t
+#include <list>
+#include <map>
 #include <set>
 #include <utility>
 #include <vector>
@@ -60,6 +62,7 @@ class AsyncFetch;
 class CachePropertyStore;
 class CriticalImagesFinder;
 class CriticalSelectorFinder;
+class CssRuleIndexCache;
 class RequestProperties;
 class ExperimentMatcher;
 class FileSystem;
@@ -420,6 +423,9 @@ class ServerContext {
       RewriteDriverPool* pool, RewriteOptions* options,
       const RequestContextPtr& request_ctx);
 
+  // Maximum number of custom-options pools kept by NewCustomRewriteDriver.
+  static const int kMaxCustomDriverPools = 16;
+
   // Like NewUnmanagedRewriteDriver, but uses standard semi-automatic
   // memory management for RewriteDrivers.
   //
@@ -429,7 +435,13 @@ class ServerContext {
   // Filters allocated using this mechanism have their filter-chain
   // already frozen (see AddFilters()).
   //
-  // Takes ownership of 'custom_options'.
+  // Drivers are recycled in a pool per distinct set of custom options, so
+  // repeated requests with, say, the same per-directory configuration don't
+  // rebuild the filter chain every time. Up to kMaxCustomDriverPools such
+  // pools are kept, least recently used first out.
+  //
+  // Takes ownership of 'custom_options', which may be deleted before this
+  // returns if an equivalent pooled driver is used instead.
   RewriteDriver* NewCustomRewriteDriver(
       RewriteOptions* custom_options, const RequestContextPtr& request_ctx);
 
@@ -543,6 +555,10 @@ class ServerContext {
     response_headers_finalized_ = x;
   }
 
+  // Returns the number of pools of custom-options drivers we are currently
+  // recycling into; exposed for tests.
+  int num_custom_rewrite_driver_pools();
+
   // Returns the RewriteDriverPool that's used by NewRewriteDriver (so calling
   // NewRewriteDriverFromPool(standard_rewrite_driver_pool()) is equivalent to
   // calling NewRewriteDriver.
@@ -628,6 +644,17 @@ class ServerContext {
     return js_tokenizer_patterns_;
   }
 
+  // Process-wide memo of minified JavaScript, keyed by content.
+  CacheInterface* minified_javascript_cache() const {
+    return minified_javascript_cache_;
+  }
+
+  // Process-wide cache of stylesheets indexed for critical CSS, keyed by
+  // content.
+  CssRuleIndexCache* css_rule_index_cache() const {
+    return css_rule_index_cache_;
+  }
+
   enum Format {
     kFormatAsHtml,
     kFormatAsJson
@@ -661,10 +688,32 @@ class ServerContext {
  private:
   friend class ServerContextTest;
   typedef std::set<RewriteDriver*> RewriteDriverSet;
+  typedef std::list<RewriteDriverPool*> RewriteDriverPoolList;
+  typedef std::map<GoogleString, RewriteDriverPoolList::iterator>
+      RewriteDriverPoolMap;
 
   // Must be called with rewrite_drivers_mutex_ held.
   void ReleaseRewriteDriverImpl(RewriteDriver* rewrite_driver);
 
+  // Returns the pool NewCustomRewriteDriver should use for 'options', making
+  // a new one if needed, or NULL if the options can't be pooled. The returned
+  // pool has already had NoteDriverHandedOut called, and the popped driver,
+  // if any, is stored in *driver and added to active_rewrite_drivers_.
+  // Must be called with rewrite_drivers_mutex_ held.
+  RewriteDriverPool* ReserveCustomDriverPool(const RewriteOptions* options,
+                                             RewriteDriver** driver);
+
+  // Pops a driver matching pool's options, if any, and records the hand-out
+  // with pool and active_rewrite_drivers_.
+  // Must be called with rewrite_drivers_mutex_ held.
+  RewriteDriver* ReserveDriverFromPool(RewriteDriverPool* pool);
+
+  // Second half of NewRewriteDriverFromPool: sets up 'rewrite_driver' for
+  // the request, or constructs one if it is NULL.
+  RewriteDriver* PrepareDriverFromPool(RewriteDriverPool* pool,
+                                       RewriteDriver* rewrite_driver,
+                                       const RequestContextPtr& request_ctx);
+
   // Applies the remote configuration options, by feeding each line in the
   // config to ApplyConfigLine.
   void ApplyRemoteConfig(const GoogleString& config, RewriteOptions* options);
@@ -732,6 +781,15 @@ class ServerContext {
   // Other RewriteDriverPool's whose lifetime we help manage for our subclasses.
   std::vector<RewriteDriverPool*> additional_driver_pools_;
 
+  // Pools for drivers made by NewCustomRewriteDriver, most recently used
+  // first, and indexed by options signature. Pools pushed off the end of the
+  // list while they still have drivers out are retired, and kept in
+  // retired_driver_pools_ until the last of them is released.
+  // Protected by rewrite_drivers_mutex_.
+  RewriteDriverPoolList custom_driver_pools_;
+  RewriteDriverPoolMap custom_driver_pool_map_;
+  std::set<RewriteDriverPool*> retired_driver_pools_;
+
   // RewriteDrivers that are currently in use.  This is retained
   // as a sanity check to make sure our system is coherent,
   // and to facilitate complete cleanup if a Shutdown occurs
@@ -791,6 +849,10 @@ class ServerContext {
   SimpleRandom simple_random_;
   // Owned by RewriteDriverFactory.
   const pagespeed::js::JsTokenizerPatterns* js_tokenizer_patterns_;
+  // Owned by RewriteDriverFactory.
+  CacheInterface* minified_javascript_cache_;
+  // Owned by RewriteDriverFactory.
+  CssRuleIndexCache* css_rule_index_cache_;
 
   scoped_ptr<CachePropertyStore> cache_property_store_;
 
@@ -40,7 +40,6 @@
 #include "pagespeed/kernel/base/ref_counted_ptr.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
-#include "pagespeed/kernel/base/string_writer.h"
 #include "pagespeed/kernel/base/writer.h"
 #include "pagespeed/kernel/http/response_headers.h"
 #include "pagespeed/kernel/util/url_escaper.h"
@@ -254,39 +253,35 @@ bool ResourceCombiner::WriteCombination(
     const ResourceVector& combine_resources,
     const OutputResourcePtr& combination,
     MessageHandler* handler) {
+  // Intersect the response headers from each input.
+  ResponseHeaders* output_headers = combination->response_headers();
+  DCHECK_EQ(0, output_headers->NumAttributes());
+
+  // We don't copy over all the resources from [0] because we don't
+  // want the input cache-control.  The output cache-control is set via
+  // RewriteDriver::BeginWrite when it calls
+  // RewriteDriver::SetDefaultLongCacheHeaders.
+  server_context_->MergeNonCachingResponseHeaders(
+      *combine_resources[0]->response_headers(), output_headers);
+  for (int i = 1, n = combine_resources.size(); i < n; ++i) {
+    output_headers->RemoveIfNotIn(*combine_resources[i]->response_headers());
+  }
+
+  // The pieces are written straight into the output resource, so the
+  // combination is never assembled in a separate string.
+  // TODO(morlovich): Fix combiners to deal with charsets.
+  Writer* writer = rewrite_driver_->BeginWrite(
+      combine_resources, CombinationContentType(),
+      StringPiece() /* not computing charset for now */, combination.get());
+  if (writer == NULL) {
+    return false;
+  }
   bool written = true;
-  // TODO(sligocki): Write directly to a temp file rather than doing the extra
-  // string copy.
-  GoogleString combined_contents;
-  StringWriter writer(&combined_contents);
   for (int i = 0, n = combine_resources.size(); written && (i < n); ++i) {
     ResourcePtr input(combine_resources[i]);
-    written = WritePiece(i, n, input.get(),
-                         combination.get(), &writer, handler);
-  }
-  if (written) {
-    // Intersect the response headers from each input.
-    ResponseHeaders* output_headers = combination->response_headers();
-    DCHECK_EQ(0, output_headers->NumAttributes());
-
-    // We don't copy over all the resources from [0] because we don't
-    // want the input cache-control.  The output cache-control is set via
-    // RewriteDriver::Write when it calls
-    // RewriteDriver::SetDefaultLongCacheHeaders.
-    server_context_->MergeNonCachingResponseHeaders(
-        *combine_resources[0]->response_headers(), output_headers);
-    for (int i = 1, n = combine_resources.size(); i < n; ++i) {
-      output_headers->RemoveIfNotIn(*combine_resources[i]->response_headers());
-    }
-
-    // TODO(morlovich): Fix combiners to deal with charsets.
-    written =
-        rewrite_driver_->Write(
-            combine_resources, combined_contents, CombinationContentType(),
-            StringPiece() /* not computing charset for now */,
-            combination.get());
+    written = WritePiece(i, n, input.get(), combination.get(), writer, handler);
   }
-  return written;
+  return rewrite_driver_->EndWrite(combination.get(), written);
 }
 
 bool ResourceCombiner::WritePiece(int index,
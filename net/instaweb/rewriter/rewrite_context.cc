@@ -51,6 +51,7 @@
 #include "net/instaweb/rewriter/public/url_namer.h"
 #include "pagespeed/controller/central_controller.h"
 #include "pagespeed/kernel/base/abstract_mutex.h"
+#include "pagespeed/kernel/base/atomic_int32.h"
 #include "pagespeed/kernel/base/function.h"
 #include "pagespeed/kernel/base/hasher.h"
 #include "pagespeed/kernel/base/message_handler.h"
@@ -193,6 +194,38 @@ class FreshenMetadataUpdateManager {
 // trigger the rewrite once the data is available.  There are two
 // versions of the callback.
 
+// Collects the tasks that the nested contexts whose metadata lookups went out
+// in one MultiGet queue on completion, and queues them all on the rewrite
+// thread with a single Sequence::AddAll once the last lookup is done.  A
+// MultiGet generally completes its keys together, and the parent has to
+// wait for all of its nested contexts anyway, so holding back the early
+// ones costs little.
+class RewriteContext::NestedLookupBatch {
+ public:
+  NestedLookupBatch(RewriteDriver* driver, int num_lookups)
+      : driver_(driver),
+        tasks_(num_lookups, static_cast<Function*>(NULL)),
+        outstanding_lookups_(num_lookups) {
+  }
+
+  // Records the task for the lookup at index, and queues the whole batch if
+  // this was the last one.  Each index must be reported exactly once.
+  void Done(int index, Function* task) {
+    tasks_[index] = task;
+    if (outstanding_lookups_.BarrierIncrement(-1) == 0) {
+      driver_->AddRewriteTasks(&tasks_);
+      delete this;
+    }
+  }
+
+ private:
+  RewriteDriver* driver_;
+  std::vector<Function*> tasks_;
+  AtomicInt32 outstanding_lookups_;
+
+  DISALLOW_COPY_AND_ASSIGN(NestedLookupBatch);
+};
+
 // Callback to wake up the RewriteContext when the partitioning is looked up
 // in the cache.  This takes care of parsing and validation of cached results.
 // The RewriteContext can then decide whether to queue the output-resource for a
@@ -207,7 +240,9 @@ class RewriteContext::OutputCacheCallback : public CacheInterface::Callback {
 
   OutputCacheCallback(RewriteContext* rc, CacheResultHandlerFunction function)
       : rewrite_context_(rc), function_(function),
-        cache_result_(new CacheLookupResult) {}
+        cache_result_(new CacheLookupResult),
+        batch_(NULL),
+        batch_index_(-1) {}
 
   virtual ~OutputCacheCallback() {}
 
@@ -220,12 +255,22 @@ class RewriteContext::OutputCacheCallback : public CacheInterface::Callback {
       cache_result_->cache_ok = true;
       rewrite_context_->stale_rewrite_ = true;
     }
-    RewriteDriver* rewrite_driver = rewrite_context_->Driver();
-    rewrite_driver->AddRewriteTask(MakeFunction(
-        rewrite_context_, function_, cache_result_.release()));
+    Function* task = MakeFunction(
+        rewrite_context_, function_, cache_result_.release());
+    if (batch_ != NULL) {
+      batch_->Done(batch_index_, task);
+    } else {
+      rewrite_context_->Driver()->AddRewriteTask(task);
+    }
     delete this;
   }
 
+  // Hands the result task to batch rather than queueing it directly.
+  void set_batch(NestedLookupBatch* batch, int index) {
+    batch_ = batch;
+    batch_index_ = index;
+  }
+
  protected:
   virtual bool ValidateCandidate(const GoogleString& key,
                                  CacheInterface::KeyState state) {
@@ -407,6 +452,8 @@ class RewriteContext::OutputCacheCallback : public CacheInterface::Callback {
   RewriteContext* rewrite_context_;
   CacheResultHandlerFunction function_;
   scoped_ptr<CacheLookupResult> cache_result_;
+  NestedLookupBatch* batch_;
+  int batch_index_;
 };
 
 // When serving on-the-fly resources, our system rewrites the metadata
@@ -1019,6 +1066,8 @@ RewriteContext::RewriteContext(RewriteDriver* driver,
     outstanding_rewrites_(0),
     resource_context_(resource_context),
     num_pending_nested_(0),
+    num_nested_fetches_(0),
+    nested_fetch_started_(false),
     parent_(parent),
     driver_((driver == NULL) ? parent->Driver() : driver),
     num_predecessors_(0),
@@ -1044,6 +1093,8 @@ RewriteContext::RewriteContext(RewriteDriver* driver,
 RewriteContext::~RewriteContext() {
   DCHECK_EQ(0, num_predecessors_);
   DCHECK_EQ(0, outstanding_fetches_);
+  DCHECK_EQ(0, num_nested_fetches_);
+  DCHECK(deferred_nested_fetches_.empty());
   DCHECK(successors_.empty());
   STLDeleteElements(&nested_);
 }
@@ -1107,6 +1158,11 @@ void RewriteContext::Initiate() {
 // with another Rewrite.  We would wait for all the preceding rewrites
 // to complete before starting this one.
 void RewriteContext::Start() {
+  StartWithBatchedLookup(NULL);
+}
+
+void RewriteContext::StartWithBatchedLookup(
+    CacheInterface::MultiGetRequest* lookups) {
   DCHECK(!started_);
   DCHECK_EQ(0, num_predecessors_);
   started_ = true;
@@ -1157,9 +1213,14 @@ void RewriteContext::Start() {
           this, &RewriteContext::OutputCacheDone))->Done(
               CacheInterface::kNotFound);
     } else {
-      metadata_cache->Get(
-          partition_key_, new OutputCacheCallback(
-              this, &RewriteContext::OutputCacheDone));
+      OutputCacheCallback* callback =
+          new OutputCacheCallback(this, &RewriteContext::OutputCacheDone);
+      if (lookups != NULL) {
+        lookups->push_back(
+            CacheInterface::KeyCallback(partition_key_, callback));
+      } else {
+        metadata_cache->Get(partition_key_, callback);
+      }
     }
   } else {
     if (previous_handler->slow()) {
@@ -1568,6 +1629,13 @@ GoogleString RewriteContext::LockName() const {
 }
 
 void RewriteContext::FetchInputs() {
+  if (has_parent() && !nested_fetch_started_) {
+    if (!parent_->TryStartNestedFetch(this)) {
+      return;
+    }
+    nested_fetch_started_ = true;
+  }
+
   ++num_predecessors_;
 
   for (int i = 0, n = slots_.size(); i < n; ++i) {
@@ -1688,7 +1756,34 @@ bool RewriteContext::ReadyToRewrite() const {
   return ready;
 }
 
+bool RewriteContext::TryStartNestedFetch(RewriteContext* nested) {
+  int max_fetches = Options()->max_concurrent_nested_fetches();
+  if ((max_fetches > 0) && (num_nested_fetches_ >= max_fetches)) {
+    deferred_nested_fetches_.push_back(nested);
+    return false;
+  }
+  ++num_nested_fetches_;
+  return true;
+}
+
+void RewriteContext::NestedFetchDone() {
+  DCHECK_LT(0, num_nested_fetches_);
+  if (deferred_nested_fetches_.empty()) {
+    --num_nested_fetches_;
+  } else {
+    // Hand our place straight to the next context in line.
+    RewriteContext* next = deferred_nested_fetches_.front();
+    deferred_nested_fetches_.pop_front();
+    next->nested_fetch_started_ = true;
+    next->CallFetchInputs();
+  }
+}
+
 void RewriteContext::Activate() {
+  if (ReadyToRewrite() && nested_fetch_started_) {
+    nested_fetch_started_ = false;
+    parent_->NestedFetchDone();
+  }
   if (ReadyToRewrite()) {
     if (!IsFetchRewrite()) {
       DCHECK(started_);
@@ -1752,11 +1847,13 @@ void RewriteContext::PartitionDone(RewriteResult result_or_busy) {
     // StartRewriteForFetch), so failing it due to load-shedding will not
     // prevent us from serving requests.
     CHECK_EQ(outstanding_rewrites_, num_outputs());
+    std::vector<Function*> invoke_rewrites;
+    invoke_rewrites.reserve(outstanding_rewrites_);
     for (int i = 0, n = outstanding_rewrites_; i < n; ++i) {
-      InvokeRewriteFunction* invoke_rewrite =
-          new InvokeRewriteFunction(this, i, outputs_[i]);
-      Driver()->AddLowPriorityRewriteTask(invoke_rewrite);
+      invoke_rewrites.push_back(
+          new InvokeRewriteFunction(this, i, outputs_[i]));
     }
+    Driver()->AddLowPriorityRewriteTasks(&invoke_rewrites);
   }
 }
 
@@ -1862,14 +1959,32 @@ void RewriteContext::StartNestedTasks() {
 }
 
 void RewriteContext::StartNestedTasksImpl() {
+  // Rather than having each nested context look itself up in the metadata
+  // cache, we collect their keys and issue a single MultiGet, so that a
+  // stylesheet with many images costs one round-trip to a remote cache
+  // rather than one per image.
+  CacheInterface::MultiGetRequest* lookups =
+      new CacheInterface::MultiGetRequest;
   for (int i = 0, n = nested_.size(); i < n; ++i) {
     RewriteContext* nested = nested_[i];
     if (!nested->chained()) {
-      nested->Start();
+      nested->StartWithBatchedLookup(lookups);
       DCHECK_EQ(n, static_cast<int>(nested_.size()))
           << "Cannot add new nested tasks once the nested tasks have started";
     }
   }
+  if (lookups->empty()) {
+    delete lookups;
+  } else {
+    // The lookups all come from StartWithBatchedLookup, so their callbacks
+    // are OutputCacheCallbacks.
+    NestedLookupBatch* batch = new NestedLookupBatch(Driver(), lookups->size());
+    for (int i = 0, n = lookups->size(); i < n; ++i) {
+      static_cast<OutputCacheCallback*>((*lookups)[i].callback)->set_batch(
+          batch, i);
+    }
+    FindServerContext()->metadata_cache()->MultiGet(lookups);
+  }
 }
 
 // Returns true if there is already an other_dependency input info with the
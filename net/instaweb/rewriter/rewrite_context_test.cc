@@ -48,6 +48,7 @@
 #include "net/instaweb/rewriter/public/single_rewrite_context.h"
 #include "net/instaweb/rewriter/public/test_rewrite_driver_factory.h"
 #include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/cache_interface.h"
 #include "pagespeed/kernel/base/charset_util.h"
 #include "pagespeed/kernel/base/gtest.h"
 #include "pagespeed/kernel/base/mem_file_system.h"
@@ -55,6 +56,7 @@
 #include "pagespeed/kernel/base/named_lock_manager.h"
 #include "pagespeed/kernel/base/named_lock_tester.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/shared_string.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/string.h"
@@ -84,6 +86,42 @@ namespace {
 // from repetitions of the driver's timeout).
 const int64 kRewriteDelayMs = 47;
 
+// Passes everything through to another cache, counting the MultiGet calls
+// and the keys they look up.
+class MultiGetCountingCache : public CacheInterface {
+ public:
+  explicit MultiGetCountingCache(CacheInterface* cache)
+      : cache_(cache), num_multi_gets_(0), num_multi_get_keys_(0) {}
+  virtual ~MultiGetCountingCache() {}
+
+  virtual void Get(const GoogleString& key, Callback* callback) {
+    cache_->Get(key, callback);
+  }
+  virtual void MultiGet(MultiGetRequest* request) {
+    ++num_multi_gets_;
+    num_multi_get_keys_ += request->size();
+    cache_->MultiGet(request);
+  }
+  virtual void Put(const GoogleString& key, const SharedString& value) {
+    cache_->Put(key, value);
+  }
+  virtual void Delete(const GoogleString& key) { cache_->Delete(key); }
+  virtual GoogleString Name() const { return "MultiGetCountingCache"; }
+  virtual bool IsBlocking() const { return cache_->IsBlocking(); }
+  virtual bool IsHealthy() const { return cache_->IsHealthy(); }
+  virtual void ShutDown() { cache_->ShutDown(); }
+
+  int num_multi_gets() const { return num_multi_gets_; }
+  int num_multi_get_keys() const { return num_multi_get_keys_; }
+
+ private:
+  CacheInterface* cache_;
+  int num_multi_gets_;
+  int num_multi_get_keys_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiGetCountingCache);
+};
+
 }  // namespace
 
 class RewriteContextTest : public RewriteContextTestBase {
@@ -2328,6 +2366,55 @@ TEST_F(RewriteContextTest, Nested) {
             rewritten_contents);
 }
 
+TEST_F(RewriteContextTest, NestedLookupsBatched) {
+  ResponseHeaders default_css_header;
+  SetDefaultLongCacheHeaders(&kContentTypeCss, &default_css_header);
+  SetFetchResponse(StrCat(kTestDomain, "x.css"), default_css_header,
+                   "a.css\nb.css\nc.css\n");
+  CacheInterface* metadata_cache = server_context()->metadata_cache();
+  MultiGetCountingCache counting_cache(metadata_cache);
+  server_context()->set_metadata_cache(&counting_cache);
+
+  const GoogleString kRewrittenUrl = Encode(
+      "", NestedFilter::kFilterId, "0", "x.css", "css");
+  InitNestedFilter(NestedFilter::kExpectNestedRewritesSucceed);
+  InitResources();
+  ValidateExpected("batched", CssLinkHref("x.css"),
+                   CssLinkHref(kRewrittenUrl));
+
+  // The metadata for the three nested rewrites is looked up in one go.
+  EXPECT_EQ(1, counting_cache.num_multi_gets());
+  EXPECT_EQ(3, counting_cache.num_multi_get_keys());
+  EXPECT_EQ(4, counting_url_async_fetcher()->fetch_count());
+  server_context()->set_metadata_cache(metadata_cache);
+}
+
+TEST_F(RewriteContextTest, NestedFetchesLimited) {
+  ResponseHeaders default_css_header;
+  SetDefaultLongCacheHeaders(&kContentTypeCss, &default_css_header);
+  SetFetchResponse(StrCat(kTestDomain, "x.css"), default_css_header,
+                   "a.css\nb.css\n");
+  options()->set_max_concurrent_nested_fetches(1);
+
+  const GoogleString kRewrittenUrl = Encode(
+      "", NestedFilter::kFilterId, "0", "x.css", "css");
+  InitNestedFilter(NestedFilter::kExpectNestedRewritesSucceed);
+  InitResources();
+
+  // With only one nested fetch allowed at a time, b.css is fetched once
+  // a.css has arrived; both still make it into the rewritten stylesheet.
+  ValidateExpected("limited", CssLinkHref("x.css"),
+                   CssLinkHref(kRewrittenUrl));
+  EXPECT_EQ(3, counting_url_async_fetcher()->fetch_count());
+
+  GoogleString rewritten_contents;
+  EXPECT_TRUE(FetchResourceUrl(StrCat(kTestDomain, kRewrittenUrl),
+                               &rewritten_contents));
+  EXPECT_EQ(StrCat(Encode(kTestDomain, "uc", "0", "a.css", "css"), "\n",
+                   Encode(kTestDomain, "uc", "0", "b.css", "css"), "\n"),
+            rewritten_contents);
+}
+
 TEST_F(RewriteContextTest, NestedFailed) {
   // Make sure that the was_optimized() bit is not set when the nested
   // rewrite fails (which it will since it's already all caps)
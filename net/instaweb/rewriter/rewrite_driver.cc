@@ -131,9 +131,12 @@
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/sha1_signature.h"
 #include "pagespeed/kernel/base/statistics.h"
+#include "pagespeed/kernel/base/split_writer.h"
 #include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
+#include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/base/writer.h"
 #include "pagespeed/kernel/cache/cache_interface.h"
@@ -152,6 +155,7 @@
 #include "pagespeed/kernel/http/google_url.h"
 #include "pagespeed/kernel/http/http_names.h"
 #include "pagespeed/kernel/http/request_headers.h"
+#include "pagespeed/kernel/http/response_headers.h"
 #include "pagespeed/kernel/thread/scheduler.h"
 #include "pagespeed/kernel/thread/scheduler_sequence.h"
 #include "pagespeed/kernel/util/statistics_logger.h"
@@ -276,6 +280,8 @@ RewriteDriver::RewriteDriver(MessageHandler* message_handler,
       xhtml_status_(kXhtmlUnknown),
       num_inline_preview_images_(0),
       num_bytes_in_(0),
+      caching_rewritten_html_(false),
+      rewritten_html_cacheable_(false),
       debug_filter_(NULL),
       can_rewrite_resources_(true),
       is_nested_(false),
@@ -455,6 +461,13 @@ void RewriteDriver::Clear() NO_THREAD_SAFETY_ANALYSIS {
   fast_blocking_rewrite_ = true;
   num_inline_preview_images_ = 0;
   num_bytes_in_ = 0;
+  caching_rewritten_html_ = false;
+  rewritten_html_cacheable_ = false;
+  rewritten_html_cache_input_.clear();
+  rewritten_html_cache_key_.clear();
+  rewritten_html_cache_output_.clear();
+  rewritten_html_split_writer_.reset(NULL);
+  rewritten_html_output_writer_.reset(NULL);
   flush_early_info_.reset(NULL);
   can_rewrite_resources_ = true;
   is_nested_ = false;
@@ -646,6 +659,9 @@ void RewriteDriver::Flush() {
 void RewriteDriver::FlushAsync(Function* callback) {
   DCHECK(request_context_.get() != NULL);
   TraceLiteral("RewriteDriver::FlushAsync()");
+  // Only documents rewritten in a single flush window are cached, as the
+  // parser and filters carry state from one window to the next.
+  StopCachingRewrittenHtml();
   if (debug_filter_ != NULL) {
     debug_filter_->StartRender();
   }
@@ -655,19 +671,15 @@ void RewriteDriver::FlushAsync(Function* callback) {
   // can modify urls.
   DetermineFiltersBehavior();
 
-  for (FilterList::iterator it = early_pre_render_filters_.begin();
-      it != early_pre_render_filters_.end(); ++it) {
-    HtmlFilter* filter = *it;
-    if (filter->is_enabled()) {
-      ApplyFilter(filter);
-    }
-  }
-  for (FilterList::iterator it = pre_render_filters_.begin();
-      it != pre_render_filters_.end(); ++it) {
-    HtmlFilter* filter = *it;
-    if (filter->is_enabled()) {
-      ApplyFilter(filter);
-    }
+  ApplyFilters(early_pre_render_filters_);
+  ApplyFilters(pre_render_filters_);
+
+  // The pre-render filters are done with this flush window, so text that
+  // arrives while we wait for the rewrites can be lexed into the next one.
+  // StartLexAhead edits the event queue, so it must run before the rewrites
+  // are initiated and can start rendering from the rewrite thread.
+  if (options()->lex_ahead_during_flush()) {
+    StartLexAhead();
   }
 
   int num_rewrites = rewrites_.size();
@@ -742,6 +754,12 @@ int64 RewriteDriver::ComputeCurrentFlushWindowRewriteDelayMs() {
   return deadline;
 }
 
+void RewriteDriver::LexAheadText(const StringPiece& text) {
+  ScopedMutex lock(dom_mutex_.get());
+  DCHECK(lexing_ahead());
+  ParseText(text);
+}
+
 void RewriteDriver::QueueFlushAsyncDone(int num_rewrites, Function* callback) {
   html_worker_->Add(MakeFunction(this, &RewriteDriver::FlushAsyncDone,
                                  num_rewrites, callback));
@@ -757,6 +775,9 @@ void RewriteDriver::FlushAsyncDone(int num_rewrites, Function* callback) {
     int still_pending_rewrites =
         ref_counts_.QueryCountMutexHeld(kRefPendingRewrites);
     int completed_rewrites = num_rewrites - still_pending_rewrites;
+    if (still_pending_rewrites > 0) {
+      rewritten_html_cacheable_ = false;
+    }
 
     // If the output cache lookup came as a HIT in after the deadline, that
     // means that (a) we can't use the result and (b) we don't need
@@ -903,6 +924,7 @@ void RewriteDriver::SetServerContext(ServerContext* server_context)
   set_timer(server_context->timer());
   rewrite_worker_ = server_context_->rewrite_workers()->NewSequence();
   html_worker_ = server_context_->html_workers()->NewSequence();
+  dom_mutex_.reset(server_context_->thread_system()->NewMutex());
   low_priority_rewrite_worker_ =
       server_context_->low_priority_rewrite_workers()->NewSequence();
   scheduler_->RegisterWorker(rewrite_worker_);
@@ -2170,14 +2192,32 @@ bool RewriteDriver::StartParseId(const StringPiece& url, const StringPiece& id,
   }
 
   can_rewrite_resources_ = server_context_->metadata_cache()->IsHealthy();
+  caching_rewritten_html_ = ret && can_rewrite_resources_ && !is_nested_ &&
+      (html_writer_filter_.get() != NULL) &&
+      options()->CanCacheRewrittenHtml();
+  rewritten_html_cacheable_ = caching_rewritten_html_;
   return ret;
 }
 
 void RewriteDriver::ParseTextInternal(const char* content, int size) {
   num_bytes_in_ += size;
   if (ShouldSkipParsing()) {
+    caching_rewritten_html_ = false;
     writer()->Write(content, message_handler());
-  } else if (debug_filter_ != NULL) {
+  } else if (caching_rewritten_html_ &&
+             (static_cast<int64>(rewritten_html_cache_input_.size() + size) <=
+              options()->flush_buffer_limit_bytes())) {
+    // Hold the text back until FinishParseAsync, which looks up the rewritten
+    // output of the whole document before lexing any of it.
+    rewritten_html_cache_input_.append(content, size);
+  } else {
+    StopCachingRewrittenHtml();
+    LexText(content, size);
+  }
+}
+
+void RewriteDriver::LexText(const char* content, int size) {
+  if (debug_filter_ != NULL) {
     debug_filter_->StartParse();
     HtmlParse::ParseTextInternal(content, size);
     debug_filter_->EndParse();
@@ -2273,7 +2313,12 @@ void RewriteDriver::RewriteComplete(RewriteContext* rewrite_context,
     // release_driver_ should be false since we moved a count between
     // categories, and didn't change the total.
     DCHECK(!release_driver_) << ref_counts_.DebugStringMutexHeld();
-    rewrite_context->Propagate(attached && permit_render);
+    {
+      // Rendering edits the DOM, which LexAheadText may be adding to from
+      // the HTML thread.
+      ScopedMutex dom_lock(dom_mutex_.get());
+      rewrite_context->Propagate(attached && permit_render);
+    }
     SignalIfRequired(signal_cookie);
   }
 }
@@ -2502,12 +2547,159 @@ void RewriteDriver::FinishParse() {
   wait.Block();
 }
 
+class RewriteDriver::RewrittenHtmlCacheCallback
+    : public CacheInterface::Callback {
+ public:
+  RewrittenHtmlCacheCallback(RewriteDriver* driver, Function* user_callback)
+      : driver_(driver),
+        user_callback_(user_callback),
+        found_(false) {
+  }
+  virtual ~RewrittenHtmlCacheCallback() {}
+
+ protected:
+  virtual bool ValidateCandidate(const GoogleString& key,
+                                 CacheInterface::KeyState state) {
+    if (state != CacheInterface::kAvailable) {
+      return false;
+    }
+    ResponseHeaders headers;
+    if (!http_value_.Link(value(), &headers, driver_->message_handler())) {
+      return false;
+    }
+    headers.ComputeCaching();
+    return (headers.CacheExpirationTimeMs() >
+            driver_->server_context()->timer()->NowMs());
+  }
+
+  virtual void Done(CacheInterface::KeyState state) {
+    found_ = (state == CacheInterface::kAvailable);
+    driver_->html_worker()->Add(
+        MakeFunction(this, &RewrittenHtmlCacheCallback::Finish));
+  }
+
+ private:
+  void Finish() {
+    StringPiece html;
+    if (found_ && http_value_.ExtractContents(&html)) {
+      driver_->FinishParseFromRewrittenHtmlCache(html, user_callback_);
+    } else {
+      driver_->FinishParseCachingRewrittenHtml(user_callback_);
+    }
+    delete this;
+  }
+
+  RewriteDriver* driver_;
+  Function* user_callback_;
+  bool found_;
+  HTTPValue http_value_;
+
+  DISALLOW_COPY_AND_ASSIGN(RewrittenHtmlCacheCallback);
+};
+
 void RewriteDriver::FinishParseAsync(Function* callback) {
+  if (caching_rewritten_html_) {
+    caching_rewritten_html_ = false;
+    rewritten_html_cache_key_ = RewrittenHtmlCacheKey();
+    server_context_->metadata_cache()->Get(
+        rewritten_html_cache_key_,
+        new RewrittenHtmlCacheCallback(this, callback));
+  } else {
+    FinishParseRewriting(callback);
+  }
+}
+
+void RewriteDriver::FinishParseRewriting(Function* callback) {
   HtmlParse::BeginFinishParse();
   FlushAsync(
       MakeFunction(this, &RewriteDriver::QueueFinishParseAfterFlush, callback));
 }
 
+GoogleString RewriteDriver::RewrittenHtmlCacheKey() const {
+  // Besides the options, filters may vary their output by the request URL,
+  // the user-agent and the Accept header (e.g. for webp), and the lexer by
+  // the content type.  Filters that depend on anything else are excluded by
+  // RewriteOptions::CanCacheRewrittenHtml.
+  const char* accept = NULL;
+  if (request_headers_.get() != NULL) {
+    accept = request_headers_->Lookup1(HttpAttributes::kAccept);
+  }
+  const char* content_type = NULL;
+  if (response_headers_ != NULL) {
+    content_type = response_headers_->Lookup1(HttpAttributes::kContentType);
+  }
+  GoogleString request = StrCat(
+      url(), "\n", user_agent_, "\n",
+      (accept == NULL) ? "" : accept, "\n",
+      (content_type == NULL) ? "" : content_type);
+  const Hasher* hasher = server_context_->hasher();
+  return StrCat("rhtml/", CacheFragment(), "/",
+                hasher->Hash(options()->signature()), "_",
+                hasher->Hash(request), "_",
+                hasher->Hash(rewritten_html_cache_input_));
+}
+
+void RewriteDriver::FinishParseFromRewrittenHtmlCache(StringPiece html,
+                                                      Function* callback) {
+  server_context_->rewrite_stats()->rewritten_html_cache_hits()->Add(1);
+  rewritten_html_cache_input_.clear();
+  writer_->Write(html, message_handler());
+  writer_->Flush(message_handler());
+  HtmlParse::BeginFinishParseWithoutFilters();
+  FinishParseAfterFlush(callback);
+}
+
+void RewriteDriver::FinishParseCachingRewrittenHtml(Function* callback) {
+  server_context_->rewrite_stats()->rewritten_html_cache_misses()->Add(1);
+  if (!rewritten_html_cache_input_.empty()) {
+    LexText(rewritten_html_cache_input_.data(),
+            static_cast<int>(rewritten_html_cache_input_.size()));
+    rewritten_html_cache_input_.clear();
+  }
+  rewritten_html_output_writer_.reset(
+      new StringWriter(&rewritten_html_cache_output_));
+  rewritten_html_split_writer_.reset(
+      new SplitWriter(writer_, rewritten_html_output_writer_.get()));
+  html_writer_filter_->set_writer(rewritten_html_split_writer_.get());
+  FinishParseRewriting(callback);
+}
+
+void RewriteDriver::StoreRewrittenHtml() {
+  if (rewritten_html_split_writer_.get() == NULL) {
+    return;
+  }
+  html_writer_filter_->set_writer(writer_);
+  if (rewritten_html_cacheable_) {
+    // Rewritten resource URLs embed the hash of the resources' contents, so
+    // the output is only kept as long as we would trust an unrevalidated
+    // resource.
+    ResponseHeaders headers;
+    headers.SetStatusAndReason(HttpStatus::kOK);
+    headers.SetDateAndCaching(server_context_->timer()->NowMs(),
+                              options()->implicit_cache_ttl_ms());
+    headers.ComputeCaching();
+    HTTPValue value;
+    value.SetHeaders(&headers);
+    value.Write(rewritten_html_cache_output_, message_handler());
+    server_context_->metadata_cache()->Put(rewritten_html_cache_key_,
+                                           value.share());
+  }
+  rewritten_html_split_writer_.reset(NULL);
+  rewritten_html_output_writer_.reset(NULL);
+  rewritten_html_cache_output_.clear();
+}
+
+void RewriteDriver::StopCachingRewrittenHtml() {
+  if (caching_rewritten_html_) {
+    caching_rewritten_html_ = false;
+    if (!rewritten_html_cache_input_.empty()) {
+      LexText(rewritten_html_cache_input_.data(),
+              static_cast<int>(rewritten_html_cache_input_.size()));
+      rewritten_html_cache_input_.clear();
+    }
+  }
+}
+
 void RewriteDriver::QueueFinishParseAfterFlush(Function* user_callback) {
   Function* finish_parse = MakeFunction(this,
                                         &RewriteDriver::FinishParseAfterFlush,
@@ -2521,12 +2713,14 @@ void RewriteDriver::FinishParseAfterFlush(Function* user_callback) {
   LogStats();
   WriteDomCohortIntoPropertyCache();
   dependency_tracker_->FinishedParsing();
+  StoreRewrittenHtml();
 
   // Update stats.
   RewriteStats* stats = server_context_->rewrite_stats();
   stats->rewrite_latency_histogram()->Add(
       server_context_->timer()->NowMs() - start_time_ms_);
   stats->total_rewrite_count()->IncBy(1);
+  stats->html_parse_allocations_histogram()->Add(num_allocations());
 
   // Update statistics log.
   StatisticsLogger* stats_logger =
@@ -2920,10 +3114,25 @@ void RewriteDriver::AddRewriteTask(Function* task) {
   }
 }
 
+void RewriteDriver::AddRewriteTasks(std::vector<Function*>* tasks) {
+  // See AddRewriteTask.
+  executing_rewrite_tasks_.set_value(true);
+
+  if (scheduler_sequence_.get() != NULL) {
+    scheduler_sequence_->AddAll(tasks);
+  } else {
+    rewrite_worker_->AddAll(tasks);
+  }
+}
+
 void RewriteDriver::AddLowPriorityRewriteTask(Function* task) {
   low_priority_rewrite_worker_->Add(task);
 }
 
+void RewriteDriver::AddLowPriorityRewriteTasks(std::vector<Function*>* tasks) {
+  low_priority_rewrite_worker_->AddAll(tasks);
+}
+
 OptionsAwareHTTPCacheCallback::OptionsAwareHTTPCacheCallback(
     const RewriteOptions* rewrite_options, const RequestContextPtr& request_ctx)
     : HTTPCache::Callback(request_ctx, RequestHeaders::Properties()),
@@ -3289,6 +3498,18 @@ bool RewriteDriver::Write(const ResourceVector& inputs,
                           const ContentType* type,
                           StringPiece charset,
                           OutputResource* output) {
+  Writer* writer = BeginWrite(inputs, type, charset, output);
+  if (writer == NULL) {
+    return false;
+  }
+  bool written = writer->Write(contents, message_handler());
+  return EndWrite(output, written);
+}
+
+Writer* RewriteDriver::BeginWrite(const ResourceVector& inputs,
+                                  const ContentType* type,
+                                  StringPiece charset,
+                                  OutputResource* output) {
   output->SetType(type);
   output->set_charset(charset);
   ResponseHeaders* meta_data = output->response_headers();
@@ -3316,51 +3537,57 @@ bool RewriteDriver::Write(const ResourceVector& inputs,
   server_context_->ApplyInputCacheControl(inputs, meta_data);
   server_context_->AddOriginalContentLengthHeader(inputs, meta_data);
 
-  // The URL for any resource we will write includes the hash of contents,
-  // so it can can live, essentially, forever. So compute this hash,
-  // and cache the output using meta_data's default headers which are to cache
-  // forever.
   MessageHandler* handler = message_handler();
   Writer* writer = output->BeginWrite(handler);
-  bool ret = (writer != NULL);
-  if (ret) {
-    ret = writer->Write(contents, handler);
-    output->EndWrite(handler);
-
-    HTTPCache* http_cache = server_context_->http_cache();
-    if (output->kind() != kOnTheFlyResource &&
-        output->kind() != kInlineResource &&
-        (http_cache->force_caching() || meta_data->IsProxyCacheable())) {
-      // This URL should already be mapped to the canonical rewrite domain,
-      // But we should store its unsharded form in the cache.
-      http_cache->Put(output->HttpCacheKey(), CacheFragment(),
-                      RequestHeaders::Properties(),
-                      options()->ComputeHttpOptions(),
-                      &output->value_, handler);
-    }
-
-    // If we're asked to, also save a debug dump
-    if (server_context_->store_outputs_in_file_system()) {
-      output->DumpToDisk(handler);
-    }
-
-    // If our URL is derived from some pre-existing URL (and not invented by
-    // us due to something like outlining), cache the mapping from original URL
-    // to the constructed one.
-    if (output->kind() == kRewrittenResource ||
-        output->kind() == kOnTheFlyResource) {
-      CachedResult* cached = output->EnsureCachedResultCreated();
-      cached->set_optimizable(true);
-      cached->set_url(output->url());  // Note: output->url() will be sharded.
-    }
-  } else {
+  if (writer == NULL) {
     // Note that we've already gotten a "could not open file" message;
     // this just serves to explain why and suggest a remedy.
     handler->Message(kInfo, "Could not create output resource"
                      " (bad filename prefix '%s'?)",
                      server_context_->filename_prefix().as_string().c_str());
   }
-  return ret;
+  return writer;
+}
+
+bool RewriteDriver::EndWrite(OutputResource* output, bool contents_written) {
+  // The URL for any resource we will write includes the hash of contents,
+  // so it can can live, essentially, forever. So compute this hash,
+  // and cache the output using the default headers set up by BeginWrite,
+  // which are to cache forever.
+  MessageHandler* handler = message_handler();
+  output->EndWrite(handler);
+  if (!contents_written) {
+    return false;
+  }
+
+  HTTPCache* http_cache = server_context_->http_cache();
+  if (output->kind() != kOnTheFlyResource &&
+      output->kind() != kInlineResource &&
+      (http_cache->force_caching() ||
+       output->response_headers()->IsProxyCacheable())) {
+    // This URL should already be mapped to the canonical rewrite domain,
+    // But we should store its unsharded form in the cache.
+    http_cache->Put(output->HttpCacheKey(), CacheFragment(),
+                    RequestHeaders::Properties(),
+                    options()->ComputeHttpOptions(),
+                    &output->value_, handler);
+  }
+
+  // If we're asked to, also save a debug dump
+  if (server_context_->store_outputs_in_file_system()) {
+    output->DumpToDisk(handler);
+  }
+
+  // If our URL is derived from some pre-existing URL (and not invented by
+  // us due to something like outlining), cache the mapping from original URL
+  // to the constructed one.
+  if (output->kind() == kRewrittenResource ||
+      output->kind() == kOnTheFlyResource) {
+    CachedResult* cached = output->EnsureCachedResultCreated();
+    cached->set_optimizable(true);
+    cached->set_url(output->url());  // Note: output->url() will be sharded.
+  }
+  return true;
 }
 
 void RewriteDriver::DetermineFiltersBehaviorImpl() {
@@ -28,6 +28,7 @@
 #include "net/instaweb/rewriter/public/beacon_critical_images_finder.h"
 #include "net/instaweb/rewriter/public/critical_images_finder.h"
 #include "net/instaweb/rewriter/public/critical_selector_finder.h"
+#include "net/instaweb/rewriter/public/css_rule_index.h"
 #include "net/instaweb/rewriter/public/experiment_matcher.h"
 #include "net/instaweb/rewriter/public/process_context.h"
 #include "net/instaweb/rewriter/public/rewrite_driver.h"
@@ -58,6 +59,8 @@
 #include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/cache/cache_batcher.h"
+#include "pagespeed/kernel/cache/lru_cache.h"
+#include "pagespeed/kernel/cache/threadsafe_cache.h"
 #include "pagespeed/kernel/http/http_options.h"
 #include "pagespeed/kernel/http/user_agent_matcher.h"
 #include "pagespeed/kernel/http/user_agent_normalizer.h"
@@ -68,6 +71,19 @@
 
 namespace net_instaweb {
 
+namespace {
+
+// Size of the in-memory cache of minified JavaScript.  This only needs to
+// hold the scripts that are popular across sites at any one time, such as
+// common libraries and analytics snippets.
+const size_t kMinifiedJavascriptCacheBytes = 8 * 1024 * 1024;
+
+// Size of the in-memory cache of indexed stylesheets used for critical CSS.
+// Like the above, this is meant for the stylesheets shared by many pages.
+const size_t kCssRuleIndexCacheBytes = 16 * 1024 * 1024;
+
+}  // namespace
+
 RewriteDriverFactory::RewriteDriverFactory(
     const ProcessContext& process_context, ThreadSystem* thread_system)
     : url_async_fetcher_(NULL),
@@ -84,6 +100,14 @@ RewriteDriverFactory::RewriteDriverFactory(
       thread_system_(new CheckingThreadSystem(thread_system)),
 #endif
       server_context_mutex_(thread_system_->NewMutex()),
+      minified_javascript_lru_cache_(
+          new LRUCache(kMinifiedJavascriptCacheBytes)),
+      minified_javascript_cache_(
+          new ThreadsafeCache(minified_javascript_lru_cache_.get(),
+                              thread_system_->NewMutex())),
+      css_rule_index_cache_(
+          new CssRuleIndexCache(kCssRuleIndexCacheBytes,
+                                thread_system_->NewMutex())),
       statistics_(&null_statistics_),
       worker_pools_(kNumWorkerPools, NULL),
       hostname_(GetHostname()) {
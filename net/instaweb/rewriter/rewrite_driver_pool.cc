@@ -18,14 +18,24 @@
 
 #include "net/instaweb/rewriter/public/rewrite_driver_pool.h"
 
+#include <algorithm>
+
+#include "base/logging.h"
 #include "net/instaweb/rewriter/public/rewrite_driver.h"
 #include "pagespeed/kernel/base/stl_util.h"
 
 namespace net_instaweb {
 
+const int RewriteDriverPool::kAdaptationWindow;
 const int RewriteDriverPool::kMaxDriversInPool;
 
-RewriteDriverPool::RewriteDriverPool() {}
+RewriteDriverPool::RewriteDriverPool()
+    : num_outstanding_(0),
+      hand_outs_in_window_(0),
+      window_peak_(0),
+      previous_window_peak_(0),
+      retired_(false) {
+}
 
 RewriteDriverPool::~RewriteDriverPool() {
   STLDeleteElements(&drivers_);
@@ -40,8 +50,25 @@ RewriteDriver* RewriteDriverPool::PopDriver() {
   return NULL;
 }
 
+void RewriteDriverPool::NoteDriverHandedOut() {
+  ++num_outstanding_;
+  window_peak_ = std::max(window_peak_, num_outstanding_);
+  if (++hand_outs_in_window_ >= kAdaptationWindow) {
+    previous_window_peak_ = window_peak_;
+    window_peak_ = num_outstanding_;
+    hand_outs_in_window_ = 0;
+  }
+}
+
+int RewriteDriverPool::Capacity() const {
+  return std::min(static_cast<int>(kMaxDriversInPool),
+                  std::max(window_peak_, previous_window_peak_));
+}
+
 void RewriteDriverPool::RecycleDriver(RewriteDriver* driver) {
-  if (drivers_.size() < kMaxDriversInPool) {
+  DCHECK_LT(0, num_outstanding_);
+  --num_outstanding_;
+  if (!retired_ && (num_idle() + num_outstanding_ < Capacity())) {
     drivers_.push_back(driver);
     driver->Clear();
   } else {
@@ -49,4 +76,9 @@ void RewriteDriverPool::RecycleDriver(RewriteDriver* driver) {
   }
 }
 
+void RewriteDriverPool::Retire() {
+  retired_ = true;
+  STLDeleteElements(&drivers_);
+}
+
 }  // namespace net_instaweb
@@ -2137,6 +2137,95 @@ TEST_F(RewriteDriverTest, SetRequestHeadersPopulatesWebpNoAccept) {
   EXPECT_FALSE(request_properties->SupportsWebpLosslessAlpha());
 }
 
+TEST_F(RewriteDriverTest, CacheRewrittenHtml) {
+  options()->set_cache_rewritten_html(true);
+  AddFilter(RewriteOptions::kRemoveComments);
+  rewrite_driver()->SetWriter(&write_to_string_);
+  RewriteStats* stats = server_context()->rewrite_stats();
+
+  const char kInput[] = "<p>a</p><!-- comment --><p>b</p>";
+  const char kOutput[] = "<p>a</p><p>b</p>";
+  ValidateExpected("cached", kInput, kOutput);
+  EXPECT_EQ(0, stats->rewritten_html_cache_hits()->Get());
+  EXPECT_EQ(1, stats->rewritten_html_cache_misses()->Get());
+
+  // A repeat of the document is served from the cache, a different document
+  // is not.
+  ValidateExpected("cached", kInput, kOutput);
+  EXPECT_EQ(1, stats->rewritten_html_cache_hits()->Get());
+  EXPECT_EQ(1, stats->rewritten_html_cache_misses()->Get());
+  ValidateExpected("cached", "<p>c</p><!-- comment -->", "<p>c</p>");
+  EXPECT_EQ(1, stats->rewritten_html_cache_hits()->Get());
+  EXPECT_EQ(2, stats->rewritten_html_cache_misses()->Get());
+
+  // Entries expire after the implicit cache TTL.
+  AdvanceTimeMs(options()->implicit_cache_ttl_ms() + 1);
+  ValidateExpected("cached", kInput, kOutput);
+  EXPECT_EQ(1, stats->rewritten_html_cache_hits()->Get());
+  EXPECT_EQ(3, stats->rewritten_html_cache_misses()->Get());
+}
+
+TEST_F(RewriteDriverTest, CacheRewrittenHtmlOnlyInSingleFlushWindow) {
+  options()->set_cache_rewritten_html(true);
+  AddFilter(RewriteOptions::kRemoveComments);
+  rewrite_driver()->SetWriter(&write_to_string_);
+  RewriteStats* stats = server_context()->rewrite_stats();
+
+  for (int i = 0; i < 2; ++i) {
+    rewrite_driver()->StartParse(StrCat(kTestDomain, "flushed.html"));
+    rewrite_driver()->ParseText("<p>a</p><!-- comment -->");
+    rewrite_driver()->Flush();
+    rewrite_driver()->ParseText("<p>b</p>");
+    rewrite_driver()->FinishParse();
+    EXPECT_EQ("<p>a</p><p>b</p>", output_buffer_);
+    output_buffer_.clear();
+  }
+  EXPECT_EQ(0, stats->rewritten_html_cache_hits()->Get());
+  EXPECT_EQ(0, stats->rewritten_html_cache_misses()->Get());
+}
+
+// A rewrite that hits the cache renders from the rewrite thread as soon as it
+// is initiated, which must not overlap with FlushAsync setting up look-ahead
+// for a <script> left open at the end of the window.
+TEST_F(RewriteDriverTest, LexAheadWithCachedRewrite) {
+  options()->set_lex_ahead_during_flush(true);
+  AddFilter(RewriteOptions::kRewriteCss);
+  rewrite_driver()->SetWriter(&write_to_string_);
+
+  const char kCss[] = "* { display: none; }";
+  const char kMinCss[] = "*{display:none}";
+  SetResponseWithDefaultHeaders("a.css", kContentTypeCss, kCss, 100);
+  GoogleString css_minified_url =
+      Encode("", RewriteOptions::kCssFilterId, hasher()->Hash(kMinCss),
+             "a.css", "css");
+
+  // Warm the cache, then rewrite the same link with a <script> open across
+  // the flush.
+  for (int i = 0; i < 2; ++i) {
+    rewrite_driver()->StartParse(StrCat(kTestDomain, "lex_ahead.html"));
+    rewrite_driver()->ParseText(StrCat(CssLinkHref("a.css"), "<script>"));
+    rewrite_driver()->Flush();
+    rewrite_driver()->ParseText("a=b;</script><p>c</p>");
+    rewrite_driver()->FinishParse();
+    EXPECT_EQ(StrCat(CssLinkHref(css_minified_url),
+                     "<script>a=b;</script><p>c</p>"),
+              output_buffer_);
+    output_buffer_.clear();
+  }
+}
+
+TEST_F(RewriteDriverTest, NoCacheRewrittenHtmlWithPerRequestFilter) {
+  options()->set_cache_rewritten_html(true);
+  AddFilter(RewriteOptions::kAddInstrumentation);
+  rewrite_driver()->SetWriter(&write_to_string_);
+  RewriteStats* stats = server_context()->rewrite_stats();
+
+  Parse("instrumented", "<p>a</p>");
+  Parse("instrumented", "<p>a</p>");
+  EXPECT_EQ(0, stats->rewritten_html_cache_hits()->Get());
+  EXPECT_EQ(0, stats->rewritten_html_cache_misses()->Get());
+}
+
 // Test classes created for using a managed rewrite driver, so that downstream
 // caching behavior (especially cache purging) can be tested. Since managed
 // rewrite drivers need their filters to be setup before the custom rewrite
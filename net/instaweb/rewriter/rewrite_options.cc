@@ -71,6 +71,7 @@ const char RewriteOptions::kBeaconReinstrumentTimeSec[] =
     "BeaconReinstrumentTimeSec";
 const char RewriteOptions::kBeaconUrl[] = "BeaconUrl";
 const char RewriteOptions::kCacheFragment[] = "CacheFragment";
+const char RewriteOptions::kCacheRewrittenHtml[] = "CacheRewrittenHtml";
 const char RewriteOptions::kCacheSmallImagesUnrewritten[] =
     "CacheSmallImagesUnrewritten";
 const char RewriteOptions::kClientDomainRewrite[] = "ClientDomainRewrite";
@@ -84,6 +85,8 @@ const char RewriteOptions::kCriticalImagesBeaconEnabled[] =
 const char RewriteOptions::kCssFlattenMaxBytes[] = "CssFlattenMaxBytes";
 const char RewriteOptions::kCssImageInlineMaxBytes[] = "CssImageInlineMaxBytes";
 const char RewriteOptions::kCssInlineMaxBytes[] = "CssInlineMaxBytes";
+const char RewriteOptions::kCssMinifyMinSavingsPercent[] =
+    "CssMinifyMinSavingsPercent";
 const char RewriteOptions::kCssOutlineMinBytes[] = "CssOutlineMinBytes";
 const char RewriteOptions::kCssPreserveURLs[] = "CssPreserveURLs";
 const char RewriteOptions::kDefaultCacheHtml[] = "DefaultCacheHtml";
@@ -191,6 +194,7 @@ const char RewriteOptions::kJsPreserveURLs[] = "JsPreserveURLs";
 const char RewriteOptions::kLazyloadImagesAfterOnload[] =
     "LazyloadImagesAfterOnload";
 const char RewriteOptions::kLazyloadImagesBlankUrl[] = "LazyloadImagesBlankUrl";
+const char RewriteOptions::kLexAheadDuringFlush[] = "LexAheadDuringFlush";
 const char RewriteOptions::kLoadFromFileCacheTtlMs[] = "LoadFromFileCacheTtlMs";
 const char RewriteOptions::kLogBackgroundRewrite[] = "LogBackgroundRewrite";
 const char RewriteOptions::kLogMobilizationSamples[] = "LogMobilizationSamples";
@@ -201,6 +205,8 @@ const char RewriteOptions::kMaxCacheableResponseContentLength[] =
     "MaxCacheableContentLength";
 const char RewriteOptions::kMaxCombinedCssBytes[] = "MaxCombinedCssBytes";
 const char RewriteOptions::kMaxCombinedJsBytes[] = "MaxCombinedJsBytes";
+const char RewriteOptions::kMaxConcurrentNestedFetches[] =
+    "MaxConcurrentNestedFetches";
 const char RewriteOptions::kMaxHtmlCacheTimeMs[] = "MaxHtmlCacheTimeMs";
 const char RewriteOptions::kMaxHtmlParseBytes[] = "MaxHtmlParseBytes";
 const char RewriteOptions::kMaxImageSizeLowResolutionBytes[] =
@@ -692,6 +698,34 @@ const RewriteOptions::Filter kRequiresScriptExecutionFilterSet[] = {
   // in a noscript block and the page will still load / function normally.
 };
 
+// List of filters whose output depends on more than the html, the request URL,
+// the User-Agent and Accept headers and the options, e.g. on the property
+// cache, on cookies or on the time, or which change the response headers.
+// The rewritten html cannot be cached while any of them is enabled.
+const RewriteOptions::Filter kRewrittenHtmlUncacheableFilterSet[] = {
+  RewriteOptions::kAddInstrumentation,
+  RewriteOptions::kCachePartialHtmlDeprecated,
+  RewriteOptions::kComputeCriticalCss,
+  RewriteOptions::kComputeVisibleTextDeprecated,
+  RewriteOptions::kConvertMetaTags,
+  RewriteOptions::kDebug,
+  RewriteOptions::kDelayImages,
+  RewriteOptions::kExperimentCollectMobImageInfo,
+  RewriteOptions::kFlushSubresources,
+  RewriteOptions::kHintPreloadSubresources,
+  RewriteOptions::kInlineImages,
+  RewriteOptions::kInsertDnsPrefetch,
+  RewriteOptions::kLazyloadImages,
+  RewriteOptions::kLocalStorageCache,
+  RewriteOptions::kMobilize,
+  RewriteOptions::kMobilizePrecompute,
+  RewriteOptions::kPrioritizeCriticalCss,
+  RewriteOptions::kResizeToRenderedImageDimensions,
+  RewriteOptions::kRewriteDomains,
+  RewriteOptions::kSplitHtml,
+  RewriteOptions::kSplitHtmlHelper,
+};
+
 // List of filters that require a 'head' element to exist.
 const RewriteOptions::Filter kAddHeadFilters[] = {
   RewriteOptions::kAddBaseTag,
@@ -1231,6 +1265,14 @@ void RewriteOptions::AddProperties() {
       kCssInlineMaxBytes,
       kQueryScope,
       "Number of bytes below which stylesheets will be inlined.", true);
+  AddBaseProperty(
+      0, &RewriteOptions::css_minify_min_savings_percent_, "cmsp",
+      kCssMinifyMinSavingsPercent,
+      kDirectoryScope,
+      "Stylesheets that an estimate of whitespace and comments says would "
+      "shrink by less than this percentage when minified are taken to be "
+      "minified already: only their URLs are rewritten, without parsing "
+      "them. 0 means stylesheets are always minified.", true);
   AddBaseProperty(
       kDefaultGoogleFontCssInlineMaxBytes,
       &RewriteOptions::google_font_css_inline_max_bytes_, "gfci",
@@ -1553,6 +1595,22 @@ void RewriteOptions::AddProperties() {
       "Attempt to mirror incoming flushes for html streams in the output "
       "when ProxyFetch is used.",
       true);
+  AddBaseProperty(
+      false, &RewriteOptions::lex_ahead_during_flush_, "lafl",
+      kLexAheadDuringFlush,
+      kDirectoryScope,
+      "Experimental: lex html that arrives while a flush window is being "
+      "rewritten, so lexing overlaps with the rewrites when ProxyFetch is "
+      "used.",
+      true);
+  AddBaseProperty(
+      false, &RewriteOptions::cache_rewritten_html_, "crwh",
+      kCacheRewrittenHtml,
+      kDirectoryScope,
+      "Experimental: cache the rewritten output of html documents that "
+      "arrive in a single flush window, and serve a repeat of the same "
+      "document from that cache without parsing or filtering it.",
+      true);
   AddBaseProperty(
       false, &RewriteOptions::enable_defer_js_experimental_, "edje",
       kEnableDeferJsExperimental,
@@ -2001,6 +2059,13 @@ void RewriteOptions::AddProperties() {
       kMaxCombinedJsBytes,
       kDirectoryScope,
       "Maximum size allowed for the combined JavaScript resource.", true);
+  AddBaseProperty(
+      0, &RewriteOptions::max_concurrent_nested_fetches_, "xcnf",
+      kMaxConcurrentNestedFetches,
+      kDirectoryScope,
+      "Maximum number of resources referenced from one resource, such as "
+      "the images in a stylesheet, that are fetched at the same time. "
+      "0 means there is no limit.", true);
   // Currently not applicable for mod_pagespeed.
   AddBaseProperty(
       -1, &RewriteOptions::override_caching_ttl_ms_, "octm",
@@ -3605,6 +3670,18 @@ bool RewriteOptions::RequiresAddHead() const {
   return false;
 }
 
+bool RewriteOptions::CanCacheRewrittenHtml() const {
+  if (!cache_rewritten_html() || !Enabled(kHtmlWriterFilter)) {
+    return false;
+  }
+  for (RewriteOptions::Filter filter : kRewrittenHtmlUncacheableFilterSet) {
+    if (Enabled(filter)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool RewriteOptions::UsePerOriginPropertyCachePage() const {
   return Enabled(kMobilize);
 }
@@ -926,6 +926,7 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kBeaconReinstrumentTimeSec,
     RewriteOptions::kBeaconUrl,
     RewriteOptions::kCacheFragment,
+    RewriteOptions::kCacheRewrittenHtml,
     RewriteOptions::kCacheSmallImagesUnrewritten,
     RewriteOptions::kClientDomainRewrite,
     RewriteOptions::kCombineAcrossPaths,
@@ -935,6 +936,7 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kCssFlattenMaxBytes,
     RewriteOptions::kCssImageInlineMaxBytes,
     RewriteOptions::kCssInlineMaxBytes,
+    RewriteOptions::kCssMinifyMinSavingsPercent,
     RewriteOptions::kCssOutlineMinBytes,
     RewriteOptions::kCssPreserveURLs,
     RewriteOptions::kDefaultCacheHtml,
@@ -1002,6 +1004,7 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kJsPreserveURLs,
     RewriteOptions::kLazyloadImagesAfterOnload,
     RewriteOptions::kLazyloadImagesBlankUrl,
+    RewriteOptions::kLexAheadDuringFlush,
     RewriteOptions::kLoadFromFileCacheTtlMs,
     RewriteOptions::kLogBackgroundRewrite,
     RewriteOptions::kLogMobilizationSamples,
@@ -1011,6 +1014,7 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kMaxCacheableResponseContentLength,
     RewriteOptions::kMaxCombinedCssBytes,
     RewriteOptions::kMaxCombinedJsBytes,
+    RewriteOptions::kMaxConcurrentNestedFetches,
     RewriteOptions::kMaxHtmlCacheTimeMs,
     RewriteOptions::kMaxHtmlParseBytes,
     RewriteOptions::kMaxImageSizeLowResolutionBytes,
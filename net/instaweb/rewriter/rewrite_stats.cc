@@ -45,6 +45,8 @@ const char kProactivelyFreshenUserFacingRequest[] =
 const char kFallbackResponsesServedWhileRevalidate[] =
     "num_fallback_responses_served_while_revalidate";
 const char kNumConditionalRefreshes[] = "num_conditional_refreshes";
+const char kRewrittenHtmlCacheHits[] = "rewritten_html_cache_hits";
+const char kRewrittenHtmlCacheMisses[] = "rewritten_html_cache_misses";
 
 const char kIproServed[] = "ipro_served";
 const char kIproNotInCache[] = "ipro_not_in_cache";
@@ -73,6 +75,7 @@ const char kFetchLatencyHistogram[] = "Pagespeed Resource Latency Histogram";
 const char kRewriteLatencyHistogram[] = "Rewrite Latency Histogram";
 const char kBackendLatencyHistogram[] =
     "Backend Fetch First Byte Latency Histogram";
+const char kHtmlParseAllocationsHistogram[] = "HTML Parse Allocations";
 
 // TimedVariable names.
 const char kTotalFetchCount[] = "total_fetch_count";
@@ -128,10 +131,13 @@ void RewriteStats::InitStats(Statistics* statistics) {
   statistics->AddHistogram(kFetchLatencyHistogram);
   statistics->AddHistogram(kRewriteLatencyHistogram);
   statistics->AddHistogram(kBackendLatencyHistogram);
+  statistics->AddHistogram(kHtmlParseAllocationsHistogram);
   statistics->AddVariable(kFallbackResponsesServed);
   statistics->AddVariable(kProactivelyFreshenUserFacingRequest);
   statistics->AddVariable(kFallbackResponsesServedWhileRevalidate);
   statistics->AddVariable(kNumConditionalRefreshes);
+  statistics->AddVariable(kRewrittenHtmlCacheHits);
+  statistics->AddVariable(kRewrittenHtmlCacheMisses);
   statistics->AddVariable(kIproServed);
   statistics->AddVariable(kIproNotInCache);
   statistics->AddVariable(kIproNotRewritable);
@@ -200,6 +206,10 @@ RewriteStats::RewriteStats(bool has_waveforms,
           stats->GetVariable(kFallbackResponsesServedWhileRevalidate)),
       num_conditional_refreshes_(
           stats->GetVariable(kNumConditionalRefreshes)),
+      rewritten_html_cache_hits_(
+          stats->GetVariable(kRewrittenHtmlCacheHits)),
+      rewritten_html_cache_misses_(
+          stats->GetVariable(kRewrittenHtmlCacheMisses)),
       ipro_served_(stats->GetVariable(kIproServed)),
       ipro_not_in_cache_(stats->GetVariable(kIproNotInCache)),
       ipro_not_rewritable_(stats->GetVariable(kIproNotRewritable)),
@@ -215,6 +225,8 @@ RewriteStats::RewriteStats(bool has_waveforms,
           stats->GetHistogram(kRewriteLatencyHistogram)),
       backend_latency_histogram_(
           stats->GetHistogram(kBackendLatencyHistogram)),
+      html_parse_allocations_histogram_(
+          stats->GetHistogram(kHtmlParseAllocationsHistogram)),
       total_fetch_count_(stats->GetTimedVariable(kTotalFetchCount)),
       total_rewrite_count_(stats->GetTimedVariable(kTotalRewriteCount)),
       num_rewrites_executed_(stats->GetTimedVariable(kRewritesExecuted)),
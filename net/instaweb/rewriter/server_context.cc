@@ -237,6 +237,24 @@ class GlobalOptionsRewriteDriverPool : public RewriteDriverPool {
   ServerContext* server_context_;
 };
 
+// Pool for the drivers NewCustomRewriteDriver makes for one particular set of
+// custom options, a frozen copy of which it owns.
+class CustomOptionsRewriteDriverPool : public RewriteDriverPool {
+ public:
+  explicit CustomOptionsRewriteDriverPool(RewriteOptions* options)
+      : options_(options) {
+  }
+
+  virtual const RewriteOptions* TargetOptions() const {
+    return options_.get();
+  }
+
+ private:
+  scoped_ptr<RewriteOptions> options_;
+};
+
+const int ServerContext::kMaxCustomDriverPools;
+
 ServerContext::ServerContext(RewriteDriverFactory* factory)
     : thread_system_(factory->thread_system()),
       rewrite_stats_(NULL),
@@ -276,7 +294,9 @@ ServerContext::ServerContext(RewriteDriverFactory* factory)
       experiment_matcher_(factory_->NewExperimentMatcher()),
       usage_data_reporter_(factory_->usage_data_reporter()),
       simple_random_(thread_system_->NewMutex()),
-      js_tokenizer_patterns_(factory_->js_tokenizer_patterns()) {
+      js_tokenizer_patterns_(factory_->js_tokenizer_patterns()),
+      minified_javascript_cache_(factory_->minified_javascript_cache()),
+      css_rule_index_cache_(factory_->css_rule_index_cache()) {
   // Make sure the excluded-attributes are in abc order so binary_search works.
   // Make sure to use the same comparator that we pass to the binary_search.
 #ifndef NDEBUG
@@ -327,6 +347,8 @@ ServerContext::~ServerContext() {
   STLDeleteElements(&active_rewrite_drivers_);
   available_rewrite_drivers_.reset();
   STLDeleteElements(&additional_driver_pools_);
+  STLDeleteElements(&custom_driver_pools_);
+  STLDeleteElements(&retired_driver_pools_);
 }
 
 // TODO(gee): These methods are out of order with respect to the .h #tech-debt
@@ -701,10 +723,21 @@ bool ServerContext::HandleBeacon(StringPiece params,
 
 RewriteDriver* ServerContext::NewCustomRewriteDriver(
     RewriteOptions* options, const RequestContextPtr& request_ctx) {
-  RewriteDriver* rewrite_driver = NewUnmanagedRewriteDriver(
-      NULL /* no pool as custom*/,
-      options,
-      request_ctx);
+  // AddFilters would do this anyway; we need the signature up front to find
+  // the pool.
+  ComputeSignature(options);
+  RewriteDriver* rewrite_driver = NULL;
+  RewriteDriverPool* pool;
+  {
+    ScopedMutex lock(rewrite_drivers_mutex_.get());
+    pool = ReserveCustomDriverPool(options, &rewrite_driver);
+  }
+  if (rewrite_driver != NULL) {
+    delete options;
+    return PrepareDriverFromPool(pool, rewrite_driver, request_ctx);
+  }
+
+  rewrite_driver = NewUnmanagedRewriteDriver(pool, options, request_ctx);
   {
     ScopedMutex lock(rewrite_drivers_mutex_.get());
     active_rewrite_drivers_.insert(rewrite_driver);
@@ -719,6 +752,52 @@ RewriteDriver* ServerContext::NewCustomRewriteDriver(
   return rewrite_driver;
 }
 
+RewriteDriverPool* ServerContext::ReserveCustomDriverPool(
+    const RewriteOptions* options, RewriteDriver** driver) {
+  if (!options->frozen() || trying_to_cleanup_rewrite_drivers_) {
+    return NULL;
+  }
+  const GoogleString& signature = options->signature();
+  RewriteDriverPoolMap::iterator p = custom_driver_pool_map_.find(signature);
+  RewriteDriverPool* pool;
+  if (p != custom_driver_pool_map_.end()) {
+    pool = *p->second;
+    // The signature leaves out a few fields, so double-check before letting
+    // this request share drivers built for the pool's options.
+    if (!pool->TargetOptions()->IsEqual(*options)) {
+      return NULL;
+    }
+    custom_driver_pools_.splice(custom_driver_pools_.begin(),
+                                custom_driver_pools_, p->second);
+    *driver = ReserveDriverFromPool(pool);
+    return pool;
+  }
+
+  if (static_cast<int>(custom_driver_pools_.size()) >= kMaxCustomDriverPools) {
+    RewriteDriverPool* victim = custom_driver_pools_.back();
+    custom_driver_pools_.pop_back();
+    custom_driver_pool_map_.erase(victim->TargetOptions()->signature());
+    if (victim->num_outstanding() == 0) {
+      delete victim;
+    } else {
+      victim->Retire();
+      retired_driver_pools_.insert(victim);
+    }
+  }
+  RewriteOptions* pool_options = options->Clone();
+  ComputeSignature(pool_options);
+  pool = new CustomOptionsRewriteDriverPool(pool_options);
+  custom_driver_pools_.push_front(pool);
+  custom_driver_pool_map_[signature] = custom_driver_pools_.begin();
+  pool->NoteDriverHandedOut();
+  return pool;
+}
+
+int ServerContext::num_custom_rewrite_driver_pools() {
+  ScopedMutex lock(rewrite_drivers_mutex_.get());
+  return custom_driver_pools_.size();
+}
+
 RewriteDriver* ServerContext::NewUnmanagedRewriteDriver(
     RewriteDriverPool* pool, RewriteOptions* options,
     const RequestContextPtr& request_ctx) {
@@ -743,48 +822,62 @@ RewriteDriver* ServerContext::NewRewriteDriver(
 
 RewriteDriver* ServerContext::NewRewriteDriverFromPool(
     RewriteDriverPool* pool, const RequestContextPtr& request_ctx) {
-  RewriteDriver* rewrite_driver = NULL;
-
-  const RewriteOptions* options = pool->TargetOptions();
+  RewriteDriver* rewrite_driver;
   {
     ScopedMutex lock(rewrite_drivers_mutex_.get());
-    while ((rewrite_driver = pool->PopDriver()) != NULL) {
-      // Note: there is currently some activity to make the RewriteOptions
-      // signature insensitive to changes that need not affect the metadata
-      // cache key.  As we are dependent on a comprehensive signature in
-      // order to correctly determine whether we can recycle a RewriteDriver,
-      // we would have to use a separate signature for metadata_cache_key
-      // vs this purpose.
-      //
-      // So for now, let us keep all the options incorporated into the
-      // signature, and revisit the issue of pulling options out if we
-      // find we are having poor hit-rate in the metadata cache during
-      // operations.
-      if (rewrite_driver->options()->IsEqual(*options)) {
-        break;
-      } else {
-        delete rewrite_driver;
-        rewrite_driver = NULL;
-      }
-    }
+    rewrite_driver = ReserveDriverFromPool(pool);
   }
+  return PrepareDriverFromPool(pool, rewrite_driver, request_ctx);
+}
 
-  if (rewrite_driver == NULL) {
-    rewrite_driver = NewUnmanagedRewriteDriver(
-        pool, options->Clone(), request_ctx);
-    if (factory_ != NULL) {
-      factory_->ApplyPlatformSpecificConfiguration(rewrite_driver);
-    }
-    rewrite_driver->AddFilters();
-    if (factory_ != NULL) {
-      factory_->AddPlatformSpecificRewritePasses(rewrite_driver);
+RewriteDriver* ServerContext::ReserveDriverFromPool(RewriteDriverPool* pool) {
+  RewriteDriver* rewrite_driver;
+  const RewriteOptions* options = pool->TargetOptions();
+  while ((rewrite_driver = pool->PopDriver()) != NULL) {
+    // Note: there is currently some activity to make the RewriteOptions
+    // signature insensitive to changes that need not affect the metadata
+    // cache key.  As we are dependent on a comprehensive signature in
+    // order to correctly determine whether we can recycle a RewriteDriver,
+    // we would have to use a separate signature for metadata_cache_key
+    // vs this purpose.
+    //
+    // So for now, let us keep all the options incorporated into the
+    // signature, and revisit the issue of pulling options out if we
+    // find we are having poor hit-rate in the metadata cache during
+    // operations.
+    if (rewrite_driver->options()->IsEqual(*options)) {
+      break;
+    } else {
+      delete rewrite_driver;
+      rewrite_driver = NULL;
     }
-  } else {
+  }
+  pool->NoteDriverHandedOut();
+  if (rewrite_driver != NULL) {
+    active_rewrite_drivers_.insert(rewrite_driver);
+  }
+  return rewrite_driver;
+}
+
+RewriteDriver* ServerContext::PrepareDriverFromPool(
+    RewriteDriverPool* pool, RewriteDriver* rewrite_driver,
+    const RequestContextPtr& request_ctx) {
+  if (rewrite_driver != NULL) {
     rewrite_driver->AddUserReference();
     rewrite_driver->set_request_context(request_ctx);
     ApplySessionFetchers(request_ctx, rewrite_driver);
+    return rewrite_driver;
   }
 
+  rewrite_driver = NewUnmanagedRewriteDriver(
+      pool, pool->TargetOptions()->Clone(), request_ctx);
+  if (factory_ != NULL) {
+    factory_->ApplyPlatformSpecificConfiguration(rewrite_driver);
+  }
+  rewrite_driver->AddFilters();
+  if (factory_ != NULL) {
+    factory_->AddPlatformSpecificRewritePasses(rewrite_driver);
+  }
   {
     ScopedMutex lock(rewrite_drivers_mutex_.get());
     active_rewrite_drivers_.insert(rewrite_driver);
@@ -812,6 +905,10 @@ void ServerContext::ReleaseRewriteDriverImpl(RewriteDriver* rewrite_driver) {
       delete rewrite_driver;
     } else {
       pool->RecycleDriver(rewrite_driver);
+      if (pool->retired() && (pool->num_outstanding() == 0)) {
+        retired_driver_pools_.erase(pool);
+        delete pool;
+      }
     }
   }
 }
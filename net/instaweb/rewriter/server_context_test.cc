@@ -43,6 +43,7 @@
 #include "net/instaweb/rewriter/public/resource.h"
 #include "net/instaweb/rewriter/public/resource_namer.h"
 #include "net/instaweb/rewriter/public/rewrite_driver.h"
+#include "net/instaweb/rewriter/public/rewrite_driver_pool.h"
 #include "net/instaweb/rewriter/public/rewrite_filter.h"
 #include "net/instaweb/rewriter/public/rewrite_options.h"
 #include "net/instaweb/rewriter/public/rewrite_query.h"
@@ -715,6 +716,99 @@ TEST_F(ServerContextTest, TestPlatformSpecificConfiguration) {
   custom_driver->Cleanup();
 }
 
+// Custom drivers with equal options are recycled rather than rebuilt.
+TEST_F(ServerContextTest, CustomDriversRecycledPerOptions) {
+  RewriteOptions* options = new RewriteOptions(factory()->thread_system());
+  options->EnableFilter(RewriteOptions::kCollapseWhitespace);
+  RewriteDriver* driver1 = server_context()->NewCustomRewriteDriver(
+      options->Clone(),
+      RequestContext::NewTestRequestContext(server_context()->thread_system()));
+  RewriteDriverPool* pool = driver1->controlling_pool();
+  ASSERT_TRUE(pool != NULL);
+  EXPECT_EQ(1, pool->num_outstanding());
+  driver1->Cleanup();
+  EXPECT_EQ(0, pool->num_outstanding());
+  EXPECT_EQ(1, pool->num_idle());
+
+  RewriteDriver* driver2 = server_context()->NewCustomRewriteDriver(
+      options->Clone(),
+      RequestContext::NewTestRequestContext(server_context()->thread_system()));
+  EXPECT_EQ(driver1, driver2);
+  EXPECT_EQ(pool, driver2->controlling_pool());
+  EXPECT_EQ(1, server_context()->num_custom_rewrite_driver_pools());
+
+  // Different options get a pool of their own.
+  options->EnableFilter(RewriteOptions::kRemoveComments);
+  RewriteDriver* driver3 = server_context()->NewCustomRewriteDriver(
+      options,
+      RequestContext::NewTestRequestContext(server_context()->thread_system()));
+  EXPECT_NE(driver2, driver3);
+  EXPECT_NE(pool, driver3->controlling_pool());
+  EXPECT_EQ(2, server_context()->num_custom_rewrite_driver_pools());
+  EXPECT_TRUE(driver3->options()->Enabled(RewriteOptions::kRemoveComments));
+  driver2->Cleanup();
+  driver3->Cleanup();
+}
+
+// The number of custom-options pools is bounded, and pools evicted while
+// their drivers are still in use stay valid until those are released.
+TEST_F(ServerContextTest, CustomDriverPoolsBounded) {
+  RewriteOptions* options = new RewriteOptions(factory()->thread_system());
+  options->set_cache_fragment("fragment-0");
+  RewriteDriver* oldest = server_context()->NewCustomRewriteDriver(
+      options,
+      RequestContext::NewTestRequestContext(server_context()->thread_system()));
+  RewriteDriverPool* oldest_pool = oldest->controlling_pool();
+  ASSERT_TRUE(oldest_pool != NULL);
+
+  for (int i = 1; i <= ServerContext::kMaxCustomDriverPools; ++i) {
+    options = new RewriteOptions(factory()->thread_system());
+    options->set_cache_fragment(StrCat("fragment-", IntegerToString(i)));
+    server_context()->NewCustomRewriteDriver(
+        options,
+        RequestContext::NewTestRequestContext(
+            server_context()->thread_system()))->Cleanup();
+  }
+  EXPECT_EQ(ServerContext::kMaxCustomDriverPools,
+            server_context()->num_custom_rewrite_driver_pools());
+  EXPECT_TRUE(oldest_pool->retired());
+
+  // A clone of a driver from a retired pool still works; it just won't be
+  // kept around afterwards.
+  RequestHeaders request_headers;
+  oldest->SetRequestHeaders(request_headers);
+  RewriteDriver* clone = oldest->Clone();
+  EXPECT_EQ(oldest_pool, clone->controlling_pool());
+  EXPECT_EQ(2, oldest_pool->num_outstanding());
+  clone->Cleanup();
+  EXPECT_EQ(0, oldest_pool->num_idle());
+  oldest->Cleanup();
+}
+
+// The standard pool only keeps as many idle drivers as were in use at once.
+TEST_F(ServerContextTest, StandardPoolSizedByConcurrency) {
+  RewriteDriverPool* pool = server_context()->standard_rewrite_driver_pool();
+  RequestContextPtr request_ctx(
+      RequestContext::NewTestRequestContext(server_context()->thread_system()));
+  RewriteDriver* drivers[3];
+  for (int i = 0; i < 3; ++i) {
+    drivers[i] = server_context()->NewRewriteDriver(request_ctx);
+  }
+  for (int i = 0; i < 3; ++i) {
+    drivers[i]->Cleanup();
+  }
+  int idle = pool->num_idle();
+  EXPECT_LE(3, pool->Capacity());
+  EXPECT_EQ(pool->Capacity(), idle + pool->num_outstanding());
+
+  // After two windows of serial traffic the pool shrinks back down to what
+  // that traffic needs.
+  for (int i = 0; i < 2 * RewriteDriverPool::kAdaptationWindow; ++i) {
+    server_context()->NewRewriteDriver(request_ctx)->Cleanup();
+  }
+  EXPECT_EQ(pool->num_outstanding() + 1, pool->Capacity());
+}
+
 // Tests that platform-specific rewriters are used for decoding fetches.
 TEST_F(ServerContextTest, TestPlatformSpecificRewritersDecoding) {
   GoogleString url = Encode("http://example.com/dir/123/",
@@ -132,6 +132,7 @@
         'rewriter/css_move_to_head_filter_test.cc',
         'rewriter/css_outline_filter_test.cc',
         'rewriter/css_rewrite_test_base.cc',
+        'rewriter/css_rule_index_test.cc',
         'rewriter/css_summarizer_base_test.cc',
         'rewriter/css_tag_scanner_test.cc',
         'rewriter/css_url_encoder_test.cc',
@@ -239,6 +240,7 @@
         '<(DEPTH)/pagespeed/controller/rpc_handler_test.cc',
         '<(DEPTH)/pagespeed/controller/schedule_rewrite_rpc_context_test.cc',
         '<(DEPTH)/pagespeed/controller/schedule_rewrite_rpc_handler_test.cc',
+        '<(DEPTH)/pagespeed/controller/shared_mem_central_controller_test.cc',
         '<(DEPTH)/pagespeed/controller/queued_expensive_operation_controller_test.cc',
         '<(DEPTH)/pagespeed/controller/work_bound_expensive_operation_controller_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/annotated_message_handler_test.cc',
@@ -306,6 +308,7 @@
         '<(DEPTH)/pagespeed/kernel/html/html_keywords_test.cc',
         '<(DEPTH)/pagespeed/kernel/html/html_name_test.cc',
         '<(DEPTH)/pagespeed/kernel/html/html_parse_test.cc',
+        '<(DEPTH)/pagespeed/kernel/html/minifying_html_writer_filter_test.cc',
         '<(DEPTH)/pagespeed/kernel/html/remove_comments_filter_test.cc',
         '<(DEPTH)/pagespeed/kernel/http/bot_checker_test.cc',
         '<(DEPTH)/pagespeed/kernel/http/caching_headers_test.cc',
@@ -517,6 +520,7 @@
       ],
       'sources': [
         'rewriter/css_minify_speed_test.cc',
+        'rewriter/css_rule_index_speed_test.cc',
         'rewriter/domain_lawyer_speed_test.cc',
         'rewriter/image_speed_test.cc',
         'rewriter/javascript_minify_speed_test.cc',
@@ -527,6 +531,7 @@
         '<(DEPTH)/pagespeed/kernel/base/wildcard_group.cc',
         '<(DEPTH)/pagespeed/kernel/cache/compressed_cache_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/cache/lru_cache_speed_test.cc',
+        '<(DEPTH)/pagespeed/kernel/html/html_keywords_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/html/html_parse_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/util/deque_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/util/url_escaper_speed_test.cc',
@@ -83,9 +83,9 @@ class ApacheRewriteDriverFactory : public SystemRewriteDriverFactory {
   static void Terminate();
 
   // Called by any ApacheServerContext whose configuration requires use of
-  // a scheduler thread. This will actually start one, so should only be
-  // called from child processes.
-  void SetNeedSchedulerThread();
+  // a scheduler thread, and by SystemRewriteDriverFactory::ChildInit. This
+  // will actually start one, so should only be called from child processes.
+  virtual void SetNeedSchedulerThread();
 
   // Needed by mod_instaweb.cc:ParseDirective().
   virtual void set_message_buffer_size(int x) {
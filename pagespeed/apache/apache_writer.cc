@@ -27,6 +27,8 @@
 
 namespace net_instaweb {
 
+const size_t ApacheWriter::kMinDirectWriteSize = 4096;
+
 ApacheWriter::ApacheWriter(request_rec* r, ThreadSystem* thread_system)
     : request_(r),
       headers_out_(false),
@@ -47,6 +49,29 @@ bool ApacheWriter::Write(const StringPiece& str, MessageHandler* handler) {
   return true;
 }
 
+bool ApacheWriter::WriteV(const StringPiece* pieces, int num_pieces,
+                          MessageHandler* handler) {
+  DCHECK(apache_request_thread_->IsCurrentThread());
+  DCHECK(headers_out_);
+  coalesce_buffer_.clear();
+  for (int i = 0; i < num_pieces; ++i) {
+    const StringPiece& piece = pieces[i];
+    if (piece.size() < kMinDirectWriteSize) {
+      piece.AppendToString(&coalesce_buffer_);
+    } else {
+      if (!coalesce_buffer_.empty()) {
+        ap_rwrite(coalesce_buffer_.data(), coalesce_buffer_.size(), request_);
+        coalesce_buffer_.clear();
+      }
+      ap_rwrite(piece.data(), piece.size(), request_);
+    }
+  }
+  if (!coalesce_buffer_.empty()) {
+    ap_rwrite(coalesce_buffer_.data(), coalesce_buffer_.size(), request_);
+  }
+  return true;
+}
+
 bool ApacheWriter::Flush(MessageHandler* handler) {
   DCHECK(apache_request_thread_->IsCurrentThread());
   DCHECK(headers_out_);
@@ -19,6 +19,7 @@
 
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/base/writer.h"
@@ -41,6 +42,15 @@ class ApacheWriter : public Writer {
   virtual bool Write(const StringPiece& str, MessageHandler* handler);
   virtual bool Flush(MessageHandler* handler);
 
+  // Coalesces runs of small pieces into a single ap_rwrite call, since each
+  // call pays for a trip through Apache's buffering filter.  Pieces of at
+  // least kMinDirectWriteSize bytes are passed to ap_rwrite as-is rather
+  // than being copied.
+  virtual bool WriteV(const StringPiece* pieces, int num_pieces,
+                      MessageHandler* handler);
+
+  static const size_t kMinDirectWriteSize;
+
   // Copies the contents of the specified response_headers to the Apache
   // headers_out structure.  This must be done before any bytes are flushed.
   //
@@ -73,6 +83,7 @@ class ApacheWriter : public Writer {
   int64 content_length_;
   ThreadSystem* thread_system_;
   scoped_ptr<ThreadSystem::ThreadId> apache_request_thread_;
+  GoogleString coalesce_buffer_;
 
   DISALLOW_COPY_AND_ASSIGN(ApacheWriter);
 };
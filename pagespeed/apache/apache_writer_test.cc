@@ -19,10 +19,12 @@
 #include "pagespeed/apache/apache_httpd_includes.h"
 #include "pagespeed/apache/header_util.h"
 #include "pagespeed/apache/mock_apache.h"
+#include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/gtest.h"
 #include "pagespeed/kernel/base/null_message_handler.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/null_thread_system.h"
 #include "pagespeed/kernel/http/response_headers.h"
 
@@ -84,6 +86,18 @@ TEST_F(ApacheWriterTest, SimpleUsage) {
   EXPECT_EQ("ap_rwrite(.)", MockApache::ActionsSinceLastCall());
 }
 
+TEST_F(ApacheWriterTest, WriteV) {
+  apache_writer_->OutputHeaders(response_headers_.get());
+  MockApache::ActionsSinceLastCall();
+
+  GoogleString large(ApacheWriter::kMinDirectWriteSize, 'x');
+  StringPiece pieces[] = {"<", "p", ">", large, "</p", ">"};
+  EXPECT_TRUE(apache_writer_->WriteV(pieces, arraysize(pieces),
+                                     &message_handler_));
+  EXPECT_EQ(StrCat("ap_rwrite(<p>) ap_rwrite(", large, ") ap_rwrite(</p>)"),
+            MockApache::ActionsSinceLastCall());
+}
+
 TEST_F(ApacheWriterTest, HTTP10) {
   // Test HTTP 1.0.
   response_headers_->set_major_version(1);
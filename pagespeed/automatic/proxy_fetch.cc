@@ -507,6 +507,7 @@ ProxyFetch::ProxyFetch(
       original_content_fetch_(original_content_fetch),
       driver_(driver),
       queue_run_job_created_(false),
+      lex_ahead_job_created_(false),
       mutex_(server_context->thread_system()->NewMutex()),
       network_flush_outstanding_(false),
       sequence_(NULL),
@@ -514,6 +515,7 @@ ProxyFetch::ProxyFetch(
       finishing_(false),
       done_result_(false),
       waiting_for_flush_to_finish_(false),
+      lexed_ahead_bytes_(0),
       idle_alarm_(NULL),
       factory_(factory),
       trusted_input_(false) {
@@ -536,6 +538,7 @@ ProxyFetch::ProxyFetch(
 ProxyFetch::~ProxyFetch() {
   DCHECK(done_called_) << "Callback should be called before destruction";
   DCHECK(!queue_run_job_created_);
+  DCHECK(!lex_ahead_job_created_);
   DCHECK(!network_flush_outstanding_);
   DCHECK(!done_outstanding_);
   DCHECK(!waiting_for_flush_to_finish_);
@@ -824,6 +827,7 @@ void ProxyFetch::ScheduleQueueExecutionIfNeeded() {
   // complete, so no need to queue it here.  The queuing will happen when
   // the PropertyCache lookup is complete or from FlushDone.
   if (waiting_for_flush_to_finish_ || (property_cache_callback_ != NULL)) {
+    ScheduleLexAheadIfNeeded();
     return;
   }
 
@@ -831,6 +835,48 @@ void ProxyFetch::ScheduleQueueExecutionIfNeeded() {
   sequence_->Add(MakeFunction(this, &ProxyFetch::ExecuteQueued));
 }
 
+void ProxyFetch::ScheduleLexAheadIfNeeded() {
+  mutex_->DCheckLocked();
+  if (!lex_ahead_job_created_ && waiting_for_flush_to_finish_ &&
+      !text_queue_.empty() && Options()->lex_ahead_during_flush()) {
+    lex_ahead_job_created_ = true;
+    sequence_->Add(MakeFunction(this, &ProxyFetch::LexAhead));
+  }
+}
+
+void ProxyFetch::LexAhead() {
+  StringStarVector v;
+  {
+    ScopedMutex lock(mutex_.get());
+    lex_ahead_job_created_ = false;
+
+    // The driver only takes look-ahead text until the flush window is
+    // written out, and FlushDone may already have run.
+    if (!waiting_for_flush_to_finish_ || !driver_->lexing_ahead()) {
+      return;
+    }
+
+    // Hold no more lexed text than ExecuteQueued would have let accumulate
+    // before forcing a flush.  Whatever doesn't fit stays queued.
+    size_t buffer_limit = Options()->flush_buffer_limit_bytes();
+    size_t num_chunks = 0;
+    while ((num_chunks < text_queue_.size()) &&
+           (lexed_ahead_bytes_ + text_queue_[num_chunks]->length() <=
+            buffer_limit)) {
+      lexed_ahead_bytes_ += text_queue_[num_chunks]->length();
+      ++num_chunks;
+    }
+    v.assign(text_queue_.begin(), text_queue_.begin() + num_chunks);
+    text_queue_.erase(text_queue_.begin(), text_queue_.begin() + num_chunks);
+  }
+
+  for (int i = 0, n = v.size(); i < n; ++i) {
+    GoogleString* str = v[i];
+    driver_->LexAheadText(*str);
+    delete str;
+  }
+}
+
 void ProxyFetch::PropertyCacheComplete(
     ProxyFetchPropertyCallbackCollector* callback_collector) {
   driver_->TraceLiteral("PropertyCache lookup completed");
@@ -1015,7 +1061,8 @@ void ProxyFetch::FlushDone() {
   DCHECK(waiting_for_flush_to_finish_);
   waiting_for_flush_to_finish_ = false;
 
-  if (!text_queue_.empty() || network_flush_outstanding_ || done_outstanding_) {
+  if (!text_queue_.empty() || network_flush_outstanding_ ||
+      done_outstanding_ || (lexed_ahead_bytes_ != 0)) {
     ScheduleQueueExecutionIfNeeded();
   }
 }
@@ -1032,11 +1079,15 @@ void ProxyFetch::ExecuteQueued() {
     ScopedMutex lock(mutex_.get());
     DCHECK(!waiting_for_flush_to_finish_);
 
-    size_t total = 0;
+    // Text lexed ahead during the previous flush is already in the driver.
+    size_t total = lexed_ahead_bytes_;
+    lexed_ahead_bytes_ = 0;
     size_t force_flush_chunk_count = 0;  // set only if force_flush is true.
     if (network_flush_outstanding_ && Options()->follow_flushes()) {
       force_flush = true;
       force_flush_chunk_count = text_queue_.size();
+    } else if (total >= buffer_limit) {
+      force_flush = true;
     } else {
       // See if we should force a flush based on how much stuff has
       // accumulated.
@@ -1111,6 +1162,11 @@ void ProxyFetch::ExecuteQueued() {
     }
     driver_->ExecuteFlushIfRequestedAsync(
         MakeFunction(this, &ProxyFetch::FlushDone));
+
+    // Whatever a partial flush left queued can be lexed while the flush is
+    // being rewritten.
+    ScopedMutex lock(mutex_.get());
+    ScheduleLexAheadIfNeeded();
   } else if (do_finish) {
     CancelIdleAlarm();
     Finish(done_result);
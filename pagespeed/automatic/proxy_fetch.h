@@ -405,6 +405,15 @@ class ProxyFetch : public SharedAsyncFetch {
   // held.
   void ScheduleQueueExecutionIfNeeded();
 
+  // While a flush is being rewritten, parses buffered text into the
+  // RewriteDriver's look-ahead queue, so that it is already lexed when the
+  // next flush window starts.  See RewriteOptions::lex_ahead_during_flush.
+  // Runs in sequence_.
+  void LexAhead();
+
+  // Schedules LexAhead if it has anything to do. Assumes mutex held.
+  void ScheduleLexAheadIfNeeded();
+
   // Frees up the RewriteDriver (via FinishParse or Cleanup),
   // calls the callback (nulling out callback_ to ensure that we don't
   // do it again), notifies the ProxyInterface that the fetch is
@@ -474,6 +483,9 @@ class ProxyFetch : public SharedAsyncFetch {
   // execute it yet.
   bool queue_run_job_created_;
 
+  // True if we have queued up LexAhead but did not execute it yet.
+  bool lex_ahead_job_created_;
+
   // As the UrlAsyncFetcher calls our Write & Flush methods, we collect
   // the text in text_queue, and note the Flush call in
   // network_flush_requested_, returning control to the fetcher as quickly
@@ -507,6 +519,10 @@ class ProxyFetch : public SharedAsyncFetch {
   // on actually dispatching things queued up above.
   bool waiting_for_flush_to_finish_;
 
+  // Bytes LexAhead has parsed since the last ExecuteQueued.  They count
+  // towards flush_buffer_limit_bytes() as if they were still queued.
+  size_t lexed_ahead_bytes_;
+
   // Alarm used to keep track of inactivity, in order to help issue
   // flushes. Must only be accessed from the thread context of sequence_
   QueuedAlarm* idle_alarm_;
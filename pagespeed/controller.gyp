@@ -68,6 +68,9 @@
         'controller/schedule_rewrite_callback.cc',
         'controller/schedule_rewrite_rpc_context.cc',
         'controller/schedule_rewrite_rpc_handler.cc',
+        'controller/shared_mem_central_controller.cc',
+        'controller/shared_mem_central_controller_server.cc',
+        'controller/shared_mem_controller_channel.cc',
         'controller/work_bound_expensive_operation_controller.cc',
       ],
       'include_dirs': [
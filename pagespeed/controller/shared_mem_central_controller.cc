@@ -0,0 +1,324 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pagespeed/controller/shared_mem_central_controller.h"
+
+#include <unistd.h>
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/message_handler.h"
+#include "pagespeed/kernel/base/thread.h"
+
+namespace net_instaweb {
+
+const char SharedMemCentralController::kSharedMemControllerRejections[] =
+    "shm-central-controller-rejections";
+
+namespace {
+
+// How long the completion thread sleeps if nobody wakes it. Wakeups normally
+// arrive through the channel's futex; this just bounds how long a lost wakeup
+// or a shutdown can go unnoticed.
+const int64 kCompletionWaitMs = 100;
+
+typedef SharedMemControllerChannel Channel;
+
+class ExpensiveOperationContextImpl : public ExpensiveOperationContext {
+ public:
+  ExpensiveOperationContextImpl(Channel* channel,
+                                ExpensiveOperationCallback* callback)
+      : channel_(channel), callback_(callback), slot_(-1) {
+    // SetTransactionContext steals ownership, which means we will never outlive
+    // the callback.
+    callback_->SetTransactionContext(this);
+  }
+
+  ~ExpensiveOperationContextImpl() {
+    Done();
+  }
+
+  void set_slot(int slot) { slot_ = slot; }
+
+  void Done() override {
+    if (slot_ >= 0) {
+      channel_->SetState(slot_, Channel::kSucceeded);
+      channel_->WakeServer();
+      slot_ = -1;
+    }
+  }
+
+  void CallRun() {
+    callback_->CallRun();
+  }
+
+  void CallCancel() {
+    slot_ = -1;  // Controller denied us, so don't try to release.
+    callback_->CallCancel();
+  }
+
+ private:
+  Channel* channel_;
+  ExpensiveOperationCallback* callback_;
+  int slot_;
+};
+
+class ScheduleRewriteContextImpl : public ScheduleRewriteContext {
+ public:
+  ScheduleRewriteContextImpl(Channel* channel,
+                             ScheduleRewriteCallback* callback)
+      : channel_(channel), callback_(callback), slot_(-1) {
+    // SetTransactionContext steals ownership, which means we will never outlive
+    // the callback.
+    callback_->SetTransactionContext(this);
+  }
+
+  ~ScheduleRewriteContextImpl() {
+    MarkSucceeded();
+  }
+
+  void set_slot(int slot) { slot_ = slot; }
+
+  void MarkSucceeded() override {
+    Finish(Channel::kSucceeded);
+  }
+
+  void MarkFailed() override {
+    Finish(Channel::kFailed);
+  }
+
+  void CallRun() {
+    callback_->CallRun();
+  }
+
+  void CallCancel() {
+    slot_ = -1;  // Controller denied us, so don't try to release.
+    callback_->CallCancel();
+  }
+
+ private:
+  void Finish(Channel::SlotState state) {
+    if (slot_ >= 0) {
+      channel_->SetState(slot_, state);
+      channel_->WakeServer();
+      slot_ = -1;
+    }
+  }
+
+  Channel* channel_;
+  ScheduleRewriteCallback* callback_;
+  int slot_;
+};
+
+}  // namespace
+
+class SharedMemCentralController::CompletionThread
+    : public ThreadSystem::Thread {
+ public:
+  CompletionThread(ThreadSystem* thread_system,
+                   SharedMemCentralController* controller)
+      : Thread(thread_system, "shm_controller_client",
+               ThreadSystem::kJoinable),
+        controller_(controller) {}
+
+  ~CompletionThread() override {
+    if (this->Started()) {
+      this->Join();
+    }
+  }
+
+ private:
+  void Run() override { controller_->CompletionLoop(); }
+
+  SharedMemCentralController* controller_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompletionThread);
+};
+
+SharedMemCentralController::SharedMemCentralController(
+    AbstractSharedMem* shm, const GoogleString& path, int num_slots,
+    ThreadSystem* thread_system, Statistics* statistics,
+    MessageHandler* handler)
+    : channel_(shm, path, num_slots, handler),
+      thread_system_(thread_system),
+      handler_(handler),
+      rejections_(statistics->GetVariable(kSharedMemControllerRejections)),
+      mutex_(thread_system_->NewMutex()),
+      state_(UNATTACHED),
+      pending_(num_slots, nullptr) {
+}
+
+SharedMemCentralController::~SharedMemCentralController() {
+  ShutDown();
+}
+
+void SharedMemCentralController::InitStats(Statistics* statistics) {
+  statistics->AddVariable(kSharedMemControllerRejections);
+}
+
+bool SharedMemCentralController::EnsureRunning() {
+  // Caller holds mutex_.
+  if (state_ == UNATTACHED) {
+    // If we can't attach or start the thread now we won't be able to later,
+    // so give up for good rather than retrying on every request.
+    state_ = SHUTDOWN;
+    if (channel_.Attach()) {
+      std::unique_ptr<CompletionThread> thread(
+          new CompletionThread(thread_system_, this));
+      if (thread->Start()) {
+        completion_thread_ = std::move(thread);
+        state_ = RUNNING;
+      } else {
+        handler_->Message(
+            kError, "Couldn't start thread for talking to the controller!");
+      }
+    }
+  }
+  return state_ == RUNNING;
+}
+
+template <typename ContextT, typename CallbackT>
+void SharedMemCentralController::StartContext(
+    SharedMemControllerChannel::RequestType type, StringPiece key,
+    CallbackT* callback) {
+  ContextT* context = new ContextT(&channel_, callback);
+  Function* granted =
+      MakeFunction(context, &ContextT::CallRun, &ContextT::CallCancel);
+  {
+    ScopedMutex lock(mutex_.get());
+    if (EnsureRunning()) {
+      int slot = channel_.ClaimSlot();
+      if (slot >= 0) {
+        // Everything the completion thread needs must be written before the
+        // request is published; the controller's answer is ordered after it.
+        DCHECK(pending_[slot] == nullptr);
+        context->set_slot(slot);
+        pending_[slot] = granted;
+        channel_.PublishRequest(slot, type, key);
+        return;
+      }
+    }
+  }
+  rejections_->Add(1);
+  granted->CallCancel();
+}
+
+void SharedMemCentralController::ScheduleExpensiveOperation(
+    ExpensiveOperationCallback* callback) {
+  StartContext<ExpensiveOperationContextImpl>(Channel::kExpensiveOperation,
+                                              "", callback);
+}
+
+void SharedMemCentralController::ScheduleRewrite(
+    ScheduleRewriteCallback* callback) {
+  StartContext<ScheduleRewriteContextImpl>(Channel::kScheduleRewrite,
+                                           callback->key(), callback);
+}
+
+void SharedMemCentralController::DispatchCompletions() {
+  const int32 pid = getpid();
+  for (int i = 0, n = channel_.num_slots(); i < n; ++i) {
+    Channel::SlotState state = channel_.state(i);
+    if ((state != Channel::kGranted && state != Channel::kDenied) ||
+        channel_.owner_pid(i) != pid || pending_[i] == nullptr) {
+      continue;
+    }
+    Function* callback = pending_[i];
+    pending_[i] = nullptr;
+    if (state == Channel::kGranted) {
+      channel_.SetState(i, Channel::kRunning);
+      callback->CallRun();
+    } else {
+      channel_.SetState(i, Channel::kFree);
+      callback->CallCancel();
+    }
+  }
+}
+
+void SharedMemCentralController::WithdrawRequest(int slot) {
+  // The controller may be answering while we do this, so retry until one of
+  // our transitions sticks.
+  for (;;) {
+    switch (channel_.state(slot)) {
+      case Channel::kRequested:
+        // The controller hasn't picked it up yet.
+        if (channel_.CompareAndSwapState(slot, Channel::kRequested,
+                                         Channel::kFree)) {
+          return;
+        }
+        break;
+      case Channel::kScheduled:
+        if (channel_.CompareAndSwapState(slot, Channel::kScheduled,
+                                         Channel::kAbandoned)) {
+          return;
+        }
+        break;
+      case Channel::kGranted:
+        if (channel_.CompareAndSwapState(slot, Channel::kGranted,
+                                         Channel::kFailed)) {
+          return;
+        }
+        break;
+      case Channel::kDenied:
+        if (channel_.CompareAndSwapState(slot, Channel::kDenied,
+                                         Channel::kFree)) {
+          return;
+        }
+        break;
+      default:
+        LOG(DFATAL) << "Unexpected state for pending slot " << slot;
+        return;
+    }
+  }
+}
+
+void SharedMemCentralController::CompletionLoop() {
+  while (!shutdown_requested_.value()) {
+    int32 sequence = channel_.client_sequence();
+    DispatchCompletions();
+    if (channel_.IsShutDown()) {
+      break;
+    }
+    channel_.WaitForClientWakeup(sequence, kCompletionWaitMs);
+  }
+}
+
+void SharedMemCentralController::ShutDown() {
+  {
+    ScopedMutex lock(mutex_.get());
+    bool running = (state_ == RUNNING);
+    // This will reject all further requests.
+    state_ = SHUTDOWN;
+    if (!running) {
+      return;
+    }
+  }
+  shutdown_requested_.set_value(true);
+  completion_thread_.reset();  // Joins the thread.
+
+  // Nobody else touches pending_ now. Withdraw every request still
+  // outstanding and cancel its callback: hand back grants we never ran, and
+  // leave requests the controller is still deciding on for it to release.
+  for (int i = 0, n = pending_.size(); i < n; ++i) {
+    Function* callback = pending_[i];
+    if (callback == nullptr) {
+      continue;
+    }
+    pending_[i] = nullptr;
+    WithdrawRequest(i);
+    callback->CallCancel();
+  }
+  channel_.WakeServer();
+}
+
+}  // namespace net_instaweb
@@ -0,0 +1,126 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PAGESPEED_CONTROLLER_SHARED_MEM_CENTRAL_CONTROLLER_H_
+#define PAGESPEED_CONTROLLER_SHARED_MEM_CENTRAL_CONTROLLER_H_
+
+#include <memory>
+#include <vector>
+
+#include "pagespeed/controller/central_controller.h"
+#include "pagespeed/controller/expensive_operation_callback.h"
+#include "pagespeed/controller/schedule_rewrite_callback.h"
+#include "pagespeed/controller/shared_mem_controller_channel.h"
+#include "pagespeed/kernel/base/abstract_mutex.h"
+#include "pagespeed/kernel/base/atomic_bool.h"
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/function.h"
+#include "pagespeed/kernel/base/statistics.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/thread_annotations.h"
+#include "pagespeed/kernel/base/thread_system.h"
+
+namespace net_instaweb {
+
+class AbstractSharedMem;
+class MessageHandler;
+
+// CentralController implementation that forwards all requests to a
+// SharedMemCentralControllerServer running in the controller process, via a
+// SharedMemControllerChannel. This gives the same cross-process scheduling as
+// CentralControllerRpcClient, but a request is just a slot claim plus a futex
+// wakeup, with no serialization or socket traffic.
+//
+// The channel segment must have been created by the root process (see
+// SharedMemControllerChannel::Initialize) before any worker calls in. We
+// attach lazily on first use, after the worker has forked. A thread per worker
+// process waits for the controller's decisions and dispatches the callbacks;
+// like the gRPC client, it relies on CentralControllerCallback to requeue the
+// real work onto the caller's Sequence.
+//
+// If the channel is full, cannot be attached, or the controller has shut down,
+// requests are cancelled immediately.
+class SharedMemCentralController : public CentralController {
+ public:
+  static const char kSharedMemControllerRejections[];
+
+  SharedMemCentralController(AbstractSharedMem* shm, const GoogleString& path,
+                             int num_slots, ThreadSystem* thread_system,
+                             Statistics* statistics, MessageHandler* handler);
+  virtual ~SharedMemCentralController();
+
+  // CentralController implementation.
+  void ScheduleExpensiveOperation(
+      ExpensiveOperationCallback* callback) override;
+  void ScheduleRewrite(ScheduleRewriteCallback* callback) override;
+  void ShutDown() override LOCKS_EXCLUDED(mutex_);
+
+  static void InitStats(Statistics* stats);
+
+ private:
+  enum State {
+    UNATTACHED,
+    RUNNING,
+    SHUTDOWN,
+  };
+
+  class CompletionThread;
+
+  // Attaches to the channel and starts the completion thread if that hasn't
+  // happened yet. Returns false if requests cannot be sent.
+  bool EnsureRunning() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Common code that creates the transaction context for callback, claims a
+  // slot for it and publishes the request, or cancels callback if that isn't
+  // possible.
+  template <typename ContextT, typename CallbackT>
+  void StartContext(SharedMemControllerChannel::RequestType type,
+                    StringPiece key, CallbackT* callback)
+      LOCKS_EXCLUDED(mutex_);
+
+  // Invoked on the completion thread. Dispatches every slot owned by this
+  // process that the controller has granted or denied since the last call.
+  void DispatchCompletions();
+
+  // Completion thread body; returns once shutdown_requested_ is set.
+  void CompletionLoop();
+
+  // Takes back a request this process has posted, from whatever point the
+  // controller has got to with it. Called from ShutDown, after the completion
+  // thread has exited.
+  void WithdrawRequest(int slot);
+
+  SharedMemControllerChannel channel_;
+  ThreadSystem* thread_system_;
+  MessageHandler* handler_;
+  Variable* rejections_;
+
+  std::unique_ptr<AbstractMutex> mutex_;
+  State state_ GUARDED_BY(mutex_);
+  AtomicBool shutdown_requested_;
+
+  // Local callback for each slot this process has posted, indexed by slot.
+  // Entries are written before the slot is published to the controller and
+  // read only after the controller's response, so the slot state transitions
+  // order all accesses and no lock is needed.
+  std::vector<Function*> pending_;
+
+  std::unique_ptr<CompletionThread> completion_thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedMemCentralController);
+};
+
+}  // namespace net_instaweb
+
+#endif  // PAGESPEED_CONTROLLER_SHARED_MEM_CENTRAL_CONTROLLER_H_
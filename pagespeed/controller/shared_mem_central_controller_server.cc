@@ -0,0 +1,234 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pagespeed/controller/shared_mem_central_controller_server.h"
+
+#include <signal.h>
+#include <sys/types.h>
+#include <cerrno>
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/function.h"
+
+namespace net_instaweb {
+
+const int64 SharedMemCentralControllerServer::kReapIntervalMs =
+    Timer::kSecondMs;
+
+typedef SharedMemControllerChannel Channel;
+
+SharedMemCentralControllerServer::SharedMemCentralControllerServer(
+    AbstractSharedMem* shm, const GoogleString& path, int num_slots,
+    ExpensiveOperationController* expensive_operation_controller,
+    ScheduleRewriteController* rewrite_controller, Timer* timer,
+    MessageHandler* handler)
+    : channel_(shm, path, num_slots, handler),
+      expensive_operation_controller_(expensive_operation_controller),
+      rewrite_controller_(rewrite_controller),
+      timer_(timer),
+      handler_(handler),
+      generation_(0),
+      wake_clients_(false),
+      keys_(num_slots),
+      dead_claimants_(num_slots, 0) {
+}
+
+SharedMemCentralControllerServer::~SharedMemCentralControllerServer() {
+}
+
+int SharedMemCentralControllerServer::Setup() {
+  if (!channel_.Attach()) {
+    PS_LOG_ERROR(handler_, "SharedMemCentralControllerServer failed to start");
+    return 1;
+  }
+  generation_ = channel_.NewGeneration();
+
+  // If we are a replacement for a controller that crashed, requests it had
+  // queued but not yet answered are lost along with it. Re-queue them so the
+  // workers waiting on them get an answer. Anything it granted will be freed
+  // without notification once the worker finishes, since our controllers
+  // never knew about it.
+  // Requests their workers abandoned can just be freed.
+  for (int i = 0, n = channel_.num_slots(); i < n; ++i) {
+    if (!channel_.CompareAndSwapState(i, Channel::kScheduled,
+                                      Channel::kRequested)) {
+      channel_.CompareAndSwapState(i, Channel::kAbandoned, Channel::kFree);
+    }
+  }
+  return 0;
+}
+
+int SharedMemCentralControllerServer::Run() {
+  PS_LOG_INFO(handler_,
+              "SharedMemCentralControllerServer processing requests with "
+              "%d slots", channel_.num_slots());
+
+  int64 next_reap_ms = 0;
+  while (!stop_requested_.value()) {
+    int32 sequence = channel_.server_sequence();
+    int64 now_ms = timer_->NowMs();
+    bool reap = (now_ms >= next_reap_ms);
+    if (reap) {
+      next_reap_ms = now_ms + kReapIntervalMs;
+    }
+    ProcessSlots(reap);
+    channel_.WaitForServerWakeup(sequence, kReapIntervalMs);
+  }
+
+  // Cancels anything still queued, which answers the waiting workers, then
+  // tells workers to stop sending us requests.
+  rewrite_controller_->ShutDown();
+  channel_.MarkShutDown();
+
+  PS_LOG_INFO(handler_, "SharedMemCentralControllerServer terminated");
+  return 0;
+}
+
+void SharedMemCentralControllerServer::Stop() {
+  PS_LOG_INFO(handler_, "Shutting down SharedMemCentralControllerServer.");
+  stop_requested_.set_value(true);
+  channel_.WakeServer();
+}
+
+void SharedMemCentralControllerServer::ProcessSlots(bool reap_dead_owners) {
+  for (int i = 0, n = channel_.num_slots(); i < n; ++i) {
+    Channel::SlotState state = channel_.state(i);
+    switch (state) {
+      case Channel::kRequested:
+        if (!reap_dead_owners || !ReapIfOwnerDead(i, state)) {
+          StartRequest(i);
+        }
+        break;
+      case Channel::kSucceeded:
+        FinishRequest(i, true);
+        break;
+      case Channel::kFailed:
+        FinishRequest(i, false);
+        break;
+      case Channel::kClaimed:
+      case Channel::kGranted:
+      case Channel::kRunning:
+      case Channel::kDenied:
+        if (reap_dead_owners) {
+          ReapIfOwnerDead(i, state);
+        }
+        break;
+      case Channel::kFree:
+      case Channel::kScheduled:
+      case Channel::kAbandoned:
+        // Grant or Deny will deal with scheduled and abandoned slots.
+        break;
+    }
+  }
+  if (wake_clients_) {
+    wake_clients_ = false;
+    channel_.WakeClients();
+  }
+}
+
+void SharedMemCentralControllerServer::StartRequest(int slot) {
+  // The controllers may call Grant or Deny synchronously, so the slot has to
+  // be marked kScheduled first. This fails if the worker withdrew the request
+  // as it shut down, in which case the slot is no longer ours.
+  if (!channel_.CompareAndSwapState(slot, Channel::kRequested,
+                                    Channel::kScheduled)) {
+    return;
+  }
+  channel_.set_generation(slot, generation_);
+  Function* callback = MakeFunction(
+      this, &SharedMemCentralControllerServer::Grant,
+      &SharedMemCentralControllerServer::Deny, slot);
+  if (channel_.type(slot) == Channel::kScheduleRewrite) {
+    keys_[slot] = channel_.key(slot);
+    rewrite_controller_->ScheduleRewrite(keys_[slot], callback);
+  } else {
+    expensive_operation_controller_->ScheduleExpensiveOperation(callback);
+  }
+}
+
+void SharedMemCentralControllerServer::FinishRequest(int slot,
+                                                     bool succeeded) {
+  // Only notify the controllers about grants they actually made.
+  if (channel_.generation(slot) == generation_) {
+    if (channel_.type(slot) == Channel::kScheduleRewrite) {
+      if (succeeded) {
+        rewrite_controller_->NotifyRewriteComplete(keys_[slot]);
+      } else {
+        rewrite_controller_->NotifyRewriteFailed(keys_[slot]);
+      }
+    } else {
+      expensive_operation_controller_->NotifyExpensiveOperationComplete();
+    }
+  }
+  keys_[slot].clear();
+  channel_.SetState(slot, Channel::kFree);
+}
+
+bool SharedMemCentralControllerServer::ReapIfOwnerDead(
+    int slot, Channel::SlotState state) {
+  int32 owner_pid = channel_.owner_pid(slot);
+  if (kill(owner_pid, 0) == 0 || errno != ESRCH) {
+    return false;
+  }
+  // The worker may be mid-transition if the pid was just recycled, so only
+  // take the slot back if it's still in the state we saw.
+  switch (state) {
+    case Channel::kClaimed:
+      // ClaimSlot writes owner_pid just after claiming, so we may have read
+      // the previous owner's. Only reap once two passes have found the same
+      // dead owner, by which time a live worker would long since have
+      // published its request.
+      if (dead_claimants_[slot] != owner_pid) {
+        dead_claimants_[slot] = owner_pid;
+        return false;
+      }
+      dead_claimants_[slot] = 0;
+      return channel_.CompareAndSwapState(slot, state, Channel::kFree);
+    case Channel::kRequested:
+    case Channel::kDenied:
+      // The controllers don't know about these.
+      return channel_.CompareAndSwapState(slot, state, Channel::kFree);
+    default:
+      if (channel_.CompareAndSwapState(slot, state, Channel::kFailed)) {
+        FinishRequest(slot, false);
+        return true;
+      }
+      return false;
+  }
+}
+
+void SharedMemCentralControllerServer::Grant(int slot) {
+  if (!channel_.CompareAndSwapState(slot, Channel::kScheduled,
+                                    Channel::kGranted)) {
+    // The worker abandoned the request, so nobody will run it. Hand the grant
+    // straight back.
+    DCHECK_EQ(Channel::kAbandoned, channel_.state(slot));
+    FinishRequest(slot, false);
+    return;
+  }
+  wake_clients_ = true;
+}
+
+void SharedMemCentralControllerServer::Deny(int slot) {
+  if (!channel_.CompareAndSwapState(slot, Channel::kScheduled,
+                                    Channel::kDenied)) {
+    DCHECK_EQ(Channel::kAbandoned, channel_.state(slot));
+    keys_[slot].clear();
+    channel_.SetState(slot, Channel::kFree);
+    return;
+  }
+  wake_clients_ = true;
+}
+
+}  // namespace net_instaweb
@@ -0,0 +1,104 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PAGESPEED_CONTROLLER_SHARED_MEM_CENTRAL_CONTROLLER_SERVER_H_
+#define PAGESPEED_CONTROLLER_SHARED_MEM_CENTRAL_CONTROLLER_SERVER_H_
+
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "pagespeed/controller/expensive_operation_controller.h"
+#include "pagespeed/controller/schedule_rewrite_controller.h"
+#include "pagespeed/controller/shared_mem_controller_channel.h"
+#include "pagespeed/kernel/base/atomic_bool.h"
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/message_handler.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/timer.h"
+#include "pagespeed/system/controller_process.h"
+
+namespace net_instaweb {
+
+class AbstractSharedMem;
+
+// ControllerProcess implementation that serves SharedMemCentralController
+// clients through a SharedMemControllerChannel, delegating the actual
+// decisions to the same controllers CentralControllerRpcServer uses.
+//
+// All controller calls, including the Run/Cancel callbacks they make, happen
+// on the thread executing Run(), so the controllers need no extra locking on
+// our account.
+class SharedMemCentralControllerServer : public ControllerProcess {
+ public:
+  // How often we look for slots owned by worker processes that have exited
+  // and give their resources back to the controllers.
+  static const int64 kReapIntervalMs;
+
+  // The channel segment must already have been created with the same path and
+  // num_slots. Takes ownership of both controllers.
+  SharedMemCentralControllerServer(
+      AbstractSharedMem* shm, const GoogleString& path, int num_slots,
+      ExpensiveOperationController* expensive_operation_controller,
+      ScheduleRewriteController* rewrite_controller, Timer* timer,
+      MessageHandler* handler);
+  virtual ~SharedMemCentralControllerServer();
+
+  // ControllerProcess implementation.
+  int Setup() override;
+  int Run() override;
+  void Stop() override;
+
+  // Handles every slot that needs the controller's attention, reaping slots
+  // of dead workers too if reap_dead_owners is set. Exposed for tests, which
+  // may prefer to drive the server without a dedicated thread.
+  void ProcessSlots(bool reap_dead_owners);
+
+ private:
+  void StartRequest(int slot);
+  void FinishRequest(int slot, bool succeeded);
+  // Takes slot back if the worker that owns it has exited and it is still in
+  // state. Returns whether it did.
+  bool ReapIfOwnerDead(int slot, SharedMemControllerChannel::SlotState state);
+
+  // Callbacks handed to the controllers for each scheduled slot.
+  void Grant(int slot);
+  void Deny(int slot);
+
+  SharedMemControllerChannel channel_;
+  std::unique_ptr<ExpensiveOperationController> expensive_operation_controller_;
+  std::unique_ptr<ScheduleRewriteController> rewrite_controller_;
+  Timer* timer_;
+  MessageHandler* handler_;
+  AtomicBool stop_requested_;
+  int32 generation_;
+
+  // Set by Grant and Deny; ProcessSlots then wakes the workers once for the
+  // whole batch of decisions.
+  bool wake_clients_;
+
+  // Key of each slot we have scheduled, copied out of shared memory so that
+  // we notify the controller with exactly what we scheduled.
+  std::vector<GoogleString> keys_;
+
+  // For each slot, the dead owner_pid it had when a reaping pass last found
+  // it kClaimed, or 0. See ReapIfOwnerDead.
+  std::vector<int32> dead_claimants_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedMemCentralControllerServer);
+};
+
+}  // namespace net_instaweb
+
+#endif  // PAGESPEED_CONTROLLER_SHARED_MEM_CENTRAL_CONTROLLER_SERVER_H_
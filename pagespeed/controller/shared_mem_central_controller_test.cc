@@ -0,0 +1,415 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pagespeed/controller/shared_mem_central_controller.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <memory>
+#include <vector>
+
+#include "base/logging.h"
+#include "pagespeed/controller/expensive_operation_callback.h"
+#include "pagespeed/controller/expensive_operation_controller.h"
+#include "pagespeed/controller/schedule_rewrite_callback.h"
+#include "pagespeed/controller/schedule_rewrite_controller.h"
+#include "pagespeed/controller/shared_mem_central_controller_server.h"
+#include "pagespeed/controller/shared_mem_controller_channel.h"
+#include "pagespeed/kernel/base/function.h"
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/mock_timer.h"
+#include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/sharedmem/inprocess_shared_mem.h"
+#include "pagespeed/kernel/thread/queued_worker_pool.h"
+#include "pagespeed/kernel/thread/worker_test_base.h"
+#include "pagespeed/kernel/util/simple_stats.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const char kSegment[] = "controller_channel";
+const char kKey1[] = "key1";
+const char kKey2[] = "key2";
+
+// Returns the pid of a process that has already exited.
+int32 DeadPid() {
+  pid_t pid = fork();
+  if (pid == 0) {
+    _exit(0);
+  }
+  CHECK_LT(0, pid);
+  CHECK_EQ(pid, waitpid(pid, NULL, 0));
+  return pid;
+}
+
+// Grants or denies every request immediately, or holds on to them if hold_ is
+// set, and records what it was told. Only ever called from the thread driving
+// the server.
+class FakeScheduleRewriteController : public ScheduleRewriteController {
+ public:
+  FakeScheduleRewriteController() : deny_(false), hold_(false) {}
+
+  void ScheduleRewrite(const GoogleString& key, Function* callback) override {
+    scheduled_.push_back(key);
+    if (hold_) {
+      held_.push_back(callback);
+    } else if (deny_) {
+      callback->CallCancel();
+    } else {
+      callback->CallRun();
+    }
+  }
+
+  void NotifyRewriteComplete(const GoogleString& key) override {
+    completed_.push_back(key);
+  }
+
+  void NotifyRewriteFailed(const GoogleString& key) override {
+    failed_.push_back(key);
+  }
+
+  bool deny_;
+  bool hold_;
+  std::vector<Function*> held_;
+  StringVector scheduled_;
+  StringVector completed_;
+  StringVector failed_;
+};
+
+class FakeExpensiveOperationController : public ExpensiveOperationController {
+ public:
+  FakeExpensiveOperationController() : scheduled_(0), completed_(0) {}
+
+  void ScheduleExpensiveOperation(Function* callback) override {
+    ++scheduled_;
+    callback->CallRun();
+  }
+
+  void NotifyExpensiveOperationComplete() override { ++completed_; }
+
+  int scheduled_;
+  int completed_;
+};
+
+struct Result {
+  explicit Result(ThreadSystem* thread_system)
+      : ran(false), cancelled(false), fail(false), sync(thread_system) {}
+
+  bool ran;
+  bool cancelled;
+  bool fail;  // Whether to MarkFailed rather than MarkSucceeded on Run.
+  WorkerTestBase::SyncPoint sync;
+};
+
+class TestRewriteCallback : public ScheduleRewriteCallback {
+ public:
+  TestRewriteCallback(const GoogleString& key, Sequence* sequence,
+                      Result* result)
+      : ScheduleRewriteCallback(key, sequence), result_(result) {}
+
+ private:
+  void RunImpl(scoped_ptr<ScheduleRewriteContext>* context) override {
+    // Mark explicitly, so the controller has heard back by the time we notify
+    // the test.
+    if (result_->fail) {
+      (*context)->MarkFailed();
+    } else {
+      (*context)->MarkSucceeded();
+    }
+    result_->ran = true;
+    result_->sync.Notify();
+  }
+
+  void CancelImpl() override {
+    result_->cancelled = true;
+    result_->sync.Notify();
+  }
+
+  Result* result_;
+};
+
+class TestExpensiveCallback : public ExpensiveOperationCallback {
+ public:
+  TestExpensiveCallback(Sequence* sequence, Result* result)
+      : ExpensiveOperationCallback(sequence), result_(result) {}
+
+ private:
+  void RunImpl(scoped_ptr<ExpensiveOperationContext>* context) override {
+    (*context)->Done();
+    result_->ran = true;
+    result_->sync.Notify();
+  }
+
+  void CancelImpl() override {
+    result_->cancelled = true;
+    result_->sync.Notify();
+  }
+
+  Result* result_;
+};
+
+// Inheriting from WorkerTestBase since it has useful stuff like SyncPoint.
+class SharedMemCentralControllerTest : public WorkerTestBase {
+ protected:
+  SharedMemCentralControllerTest()
+      : shm_(thread_runtime_.get()),
+        stats_(thread_runtime_.get()),
+        timer_(thread_runtime_->NewMutex(), MockTimer::kApr_5_2010_ms),
+        worker_(new QueuedWorkerPool(1, "shm_controller_test",
+                                     thread_runtime_.get())),
+        sequence_(worker_->NewSequence()),
+        rewrite_controller_(new FakeScheduleRewriteController),
+        expensive_controller_(new FakeExpensiveOperationController) {
+    SharedMemCentralController::InitStats(&stats_);
+  }
+
+  ~SharedMemCentralControllerTest() override {
+    if (client_ != nullptr) {
+      client_->ShutDown();
+    }
+    worker_->ShutDown();
+  }
+
+  void Init(int num_slots) {
+    root_.reset(
+        new SharedMemControllerChannel(&shm_, kSegment, num_slots, &handler_));
+    ASSERT_TRUE(root_->Initialize());
+    // The server owns the fake controllers.
+    server_.reset(new SharedMemCentralControllerServer(
+        &shm_, kSegment, num_slots, expensive_controller_,
+        rewrite_controller_, &timer_, &handler_));
+    ASSERT_EQ(0, server_->Setup());
+    client_.reset(new SharedMemCentralController(
+        &shm_, kSegment, num_slots, thread_runtime_.get(), &stats_,
+        &handler_));
+  }
+
+  int Rejections() {
+    return stats_.GetVariable(
+        SharedMemCentralController::kSharedMemControllerRejections)->Get();
+  }
+
+  InProcessSharedMem shm_;
+  SimpleStats stats_;
+  MockTimer timer_;
+  NullMessageHandler handler_;
+  scoped_ptr<QueuedWorkerPool> worker_;
+  Sequence* sequence_;
+  FakeScheduleRewriteController* rewrite_controller_;
+  FakeExpensiveOperationController* expensive_controller_;
+  std::unique_ptr<SharedMemControllerChannel> root_;
+  std::unique_ptr<SharedMemCentralControllerServer> server_;
+  std::unique_ptr<SharedMemCentralController> client_;
+};
+
+TEST_F(SharedMemCentralControllerTest, RewriteGrantedAndSucceeded) {
+  Init(4);
+  Result result(thread_runtime_.get());
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey1, sequence_, &result));
+  server_->ProcessSlots(false);
+  result.sync.Wait();
+  EXPECT_TRUE(result.ran);
+  EXPECT_FALSE(result.cancelled);
+
+  // Pick up the completion.
+  server_->ProcessSlots(false);
+  ASSERT_EQ(1, rewrite_controller_->scheduled_.size());
+  EXPECT_EQ(kKey1, rewrite_controller_->scheduled_[0]);
+  ASSERT_EQ(1, rewrite_controller_->completed_.size());
+  EXPECT_EQ(kKey1, rewrite_controller_->completed_[0]);
+  EXPECT_EQ(0, rewrite_controller_->failed_.size());
+  EXPECT_EQ(0, Rejections());
+}
+
+TEST_F(SharedMemCentralControllerTest, RewriteGrantedAndFailed) {
+  Init(4);
+  Result result(thread_runtime_.get());
+  result.fail = true;
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey1, sequence_, &result));
+  server_->ProcessSlots(false);
+  result.sync.Wait();
+  EXPECT_TRUE(result.ran);
+
+  server_->ProcessSlots(false);
+  EXPECT_EQ(0, rewrite_controller_->completed_.size());
+  ASSERT_EQ(1, rewrite_controller_->failed_.size());
+  EXPECT_EQ(kKey1, rewrite_controller_->failed_[0]);
+}
+
+TEST_F(SharedMemCentralControllerTest, RewriteDenied) {
+  Init(4);
+  rewrite_controller_->deny_ = true;
+  Result result(thread_runtime_.get());
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey1, sequence_, &result));
+  server_->ProcessSlots(false);
+  result.sync.Wait();
+  EXPECT_FALSE(result.ran);
+  EXPECT_TRUE(result.cancelled);
+
+  // A denied request must not be reported back to the controller, and its
+  // slot must be reusable.
+  server_->ProcessSlots(false);
+  EXPECT_EQ(0, rewrite_controller_->completed_.size());
+  EXPECT_EQ(0, rewrite_controller_->failed_.size());
+
+  rewrite_controller_->deny_ = false;
+  Result result2(thread_runtime_.get());
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey2, sequence_, &result2));
+  server_->ProcessSlots(false);
+  result2.sync.Wait();
+  EXPECT_TRUE(result2.ran);
+}
+
+TEST_F(SharedMemCentralControllerTest, ExpensiveOperation) {
+  Init(4);
+  Result result(thread_runtime_.get());
+  client_->ScheduleExpensiveOperation(
+      new TestExpensiveCallback(sequence_, &result));
+  server_->ProcessSlots(false);
+  result.sync.Wait();
+  EXPECT_TRUE(result.ran);
+
+  server_->ProcessSlots(false);
+  EXPECT_EQ(1, expensive_controller_->scheduled_);
+  EXPECT_EQ(1, expensive_controller_->completed_);
+}
+
+TEST_F(SharedMemCentralControllerTest, RejectWhenFull) {
+  Init(1);
+  Result result1(thread_runtime_.get());
+  Result result2(thread_runtime_.get());
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey1, sequence_, &result1));
+  // Nothing has been processed, so the only slot is still taken.
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey2, sequence_, &result2));
+  result2.sync.Wait();
+  EXPECT_TRUE(result2.cancelled);
+  EXPECT_EQ(1, Rejections());
+
+  server_->ProcessSlots(false);
+  result1.sync.Wait();
+  EXPECT_TRUE(result1.ran);
+}
+
+TEST_F(SharedMemCentralControllerTest, LongKeysStayDistinct) {
+  Init(4);
+  GoogleString prefix(2 * SharedMemControllerChannel::kMaxKeyLength, 'a');
+  GoogleString key1 = StrCat(prefix, "1");
+  GoogleString key2 = StrCat(prefix, "2");
+  Result result1(thread_runtime_.get());
+  Result result2(thread_runtime_.get());
+  client_->ScheduleRewrite(new TestRewriteCallback(key1, sequence_, &result1));
+  client_->ScheduleRewrite(new TestRewriteCallback(key2, sequence_, &result2));
+  server_->ProcessSlots(false);
+  result1.sync.Wait();
+  result2.sync.Wait();
+
+  ASSERT_EQ(2, rewrite_controller_->scheduled_.size());
+  EXPECT_NE(rewrite_controller_->scheduled_[0],
+            rewrite_controller_->scheduled_[1]);
+  EXPECT_GE(SharedMemControllerChannel::kMaxKeyLength,
+            rewrite_controller_->scheduled_[0].size());
+}
+
+TEST_F(SharedMemCentralControllerTest, ShutDownCancelsOutstanding) {
+  Init(4);
+  Result result(thread_runtime_.get());
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey1, sequence_, &result));
+  client_->ShutDown();
+  result.sync.Wait();
+  EXPECT_TRUE(result.cancelled);
+
+  // The controller never saw the request.
+  server_->ProcessSlots(false);
+  EXPECT_EQ(0, rewrite_controller_->scheduled_.size());
+
+  // Further requests are rejected outright.
+  Result result2(thread_runtime_.get());
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey2, sequence_, &result2));
+  result2.sync.Wait();
+  EXPECT_TRUE(result2.cancelled);
+}
+
+TEST_F(SharedMemCentralControllerTest, LateGrantAfterShutDownIsReleased) {
+  Init(4);
+  rewrite_controller_->hold_ = true;
+  Result result(thread_runtime_.get());
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey1, sequence_, &result));
+  server_->ProcessSlots(false);
+  ASSERT_EQ(1, rewrite_controller_->held_.size());
+  client_->ShutDown();
+  result.sync.Wait();
+  EXPECT_TRUE(result.cancelled);
+
+  // Nobody will run the rewrite the controller grants now, so the server has
+  // to hand it straight back.
+  rewrite_controller_->held_[0]->CallRun();
+  ASSERT_EQ(1, rewrite_controller_->failed_.size());
+  EXPECT_EQ(kKey1, rewrite_controller_->failed_[0]);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(SharedMemControllerChannel::kFree, root_->state(i));
+  }
+}
+
+TEST_F(SharedMemCentralControllerTest, ReapsSlotsOfDeadWorkers) {
+  Init(2);
+  int32 dead_pid = DeadPid();
+  // One worker died between claiming a slot and publishing its request, and
+  // another right after publishing it.
+  int claimed = root_->ClaimSlot();
+  ASSERT_LE(0, claimed);
+  root_->set_owner_pid(claimed, dead_pid);
+  int requested = root_->ClaimSlot();
+  ASSERT_LE(0, requested);
+  root_->PublishRequest(requested, SharedMemControllerChannel::kScheduleRewrite,
+                        kKey1);
+  root_->set_owner_pid(requested, dead_pid);
+
+  server_->ProcessSlots(true);
+  EXPECT_EQ(0, rewrite_controller_->scheduled_.size());
+  EXPECT_EQ(SharedMemControllerChannel::kFree, root_->state(requested));
+  // The owner of a claimed slot may be stale at first, so it takes a second
+  // pass to reap it.
+  EXPECT_EQ(SharedMemControllerChannel::kClaimed, root_->state(claimed));
+  server_->ProcessSlots(true);
+  EXPECT_EQ(SharedMemControllerChannel::kFree, root_->state(claimed));
+}
+
+TEST_F(SharedMemCentralControllerTest, ServerShutDownRejects) {
+  Init(4);
+  server_->Stop();
+  EXPECT_EQ(0, server_->Run());
+  Result result(thread_runtime_.get());
+  client_->ScheduleRewrite(
+      new TestRewriteCallback(kKey1, sequence_, &result));
+  result.sync.Wait();
+  EXPECT_TRUE(result.cancelled);
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
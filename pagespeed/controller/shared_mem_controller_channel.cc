@@ -0,0 +1,304 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pagespeed/controller/shared_mem_controller_channel.h"
+
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/abstract_shared_mem.h"
+#include "pagespeed/kernel/base/message_handler.h"
+#include "pagespeed/kernel/base/string_hash.h"
+#include "pagespeed/kernel/base/timer.h"
+
+namespace net_instaweb {
+
+namespace SharedMemControllerData {
+
+// Memory structure:
+//
+// Header (padded to 64 bytes)
+// State words: one Atomic32 per slot, packed so the controller and workers
+//              can scan for work without touching the slot payloads
+//              (padded to 64 bytes).
+// Slot 0
+// ...
+// Slot num_slots - 1
+struct Header {
+  base::subtle::Atomic32 server_sequence;
+  base::subtle::Atomic32 client_sequence;
+  base::subtle::Atomic32 shut_down;
+  base::subtle::Atomic32 generation;
+};
+
+struct Slot {
+  int32 owner_pid;
+  int32 type;
+  int32 generation;
+  char key[SharedMemControllerChannel::kMaxKeyLength + 1];
+};
+
+inline size_t Align64(size_t in) {
+  return (in + 63) & ~63;
+}
+
+inline size_t StatesOffset() {
+  return Align64(sizeof(Header));
+}
+
+inline size_t SlotsOffset(int num_slots) {
+  return StatesOffset() +
+         Align64(num_slots * sizeof(base::subtle::Atomic32));
+}
+
+inline size_t SegmentSize(int num_slots) {
+  return SlotsOffset(num_slots) + num_slots * sizeof(Slot);
+}
+
+// futex(2) works on any 32-bit word in a MAP_SHARED mapping, across
+// processes, as long as we don't use the FUTEX_PRIVATE_FLAG variants.
+void FutexWait(volatile base::subtle::Atomic32* word, int32 seen,
+               int64 timeout_ms) {
+#ifdef __linux__
+  struct timespec timeout;
+  timeout.tv_sec = timeout_ms / Timer::kSecondMs;
+  timeout.tv_nsec = (timeout_ms % Timer::kSecondMs) * Timer::kMsUs * 1000;
+  // Returns immediately with EAGAIN if *word != seen, and may also return
+  // spuriously; callers always re-scan, so we don't care why we woke.
+  syscall(SYS_futex, const_cast<base::subtle::Atomic32*>(word), FUTEX_WAIT,
+          seen, &timeout, NULL, 0);
+#else
+  // Poll at a modest rate rather than spinning.
+  int64 remaining_ms = timeout_ms;
+  while (remaining_ms > 0 && base::subtle::Acquire_Load(word) == seen) {
+    usleep(Timer::kMsUs);
+    --remaining_ms;
+  }
+#endif
+}
+
+void FutexWakeAll(volatile base::subtle::Atomic32* word) {
+  base::subtle::Barrier_AtomicIncrement(word, 1);
+#ifdef __linux__
+  syscall(SYS_futex, const_cast<base::subtle::Atomic32*>(word), FUTEX_WAKE,
+          kint32max, NULL, NULL, 0);
+#endif
+}
+
+}  // namespace SharedMemControllerData
+
+namespace Data = SharedMemControllerData;
+
+SharedMemControllerChannel::SharedMemControllerChannel(
+    AbstractSharedMem* shm, const GoogleString& path, int num_slots,
+    MessageHandler* handler)
+    : shm_runtime_(shm),
+      path_(path),
+      num_slots_(num_slots),
+      handler_(handler),
+      pid_(0),
+      next_slot_hint_(0) {
+  CHECK_GT(num_slots_, 0);
+}
+
+SharedMemControllerChannel::~SharedMemControllerChannel() {
+}
+
+bool SharedMemControllerChannel::Initialize() {
+  segment_.reset(shm_runtime_->CreateSegment(
+      path_, Data::SegmentSize(num_slots_), handler_));
+  if (segment_ == nullptr) {
+    handler_->MessageS(kError,
+                       "Unable to create memory segment for controller.");
+    return false;
+  }
+  // CreateSegment zeroes memory, so all slots start out kFree.
+  pid_ = getpid();
+  return true;
+}
+
+bool SharedMemControllerChannel::Attach() {
+  segment_.reset(shm_runtime_->AttachToSegment(
+      path_, Data::SegmentSize(num_slots_), handler_));
+  if (segment_ == nullptr) {
+    handler_->MessageS(kError,
+                       "Unable to attach to controller memory segment.");
+    return false;
+  }
+  pid_ = getpid();
+  return true;
+}
+
+void SharedMemControllerChannel::GlobalCleanup(AbstractSharedMem* shm,
+                                               const GoogleString& path,
+                                               MessageHandler* handler) {
+  shm->DestroySegment(path, handler);
+}
+
+Data::Header* SharedMemControllerChannel::header() const {
+  DCHECK(segment_ != nullptr);
+  return reinterpret_cast<Data::Header*>(
+      const_cast<char*>(segment_->Base()));
+}
+
+volatile base::subtle::Atomic32* SharedMemControllerChannel::state_word(
+    int index) const {
+  DCHECK_GE(index, 0);
+  DCHECK_LT(index, num_slots_);
+  volatile char* states = segment_->Base() + Data::StatesOffset();
+  return reinterpret_cast<volatile base::subtle::Atomic32*>(states) + index;
+}
+
+Data::Slot* SharedMemControllerChannel::slot(int index) const {
+  DCHECK_GE(index, 0);
+  DCHECK_LT(index, num_slots_);
+  char* slots = const_cast<char*>(segment_->Base()) +
+                Data::SlotsOffset(num_slots_);
+  return reinterpret_cast<Data::Slot*>(slots) + index;
+}
+
+int SharedMemControllerChannel::ClaimSlot() {
+  if (segment_ == nullptr || IsShutDown()) {
+    return -1;
+  }
+
+  // Spread concurrent claimants over the table so they don't all contend on
+  // the first free slot.
+  int start = base::subtle::NoBarrier_AtomicIncrement(&next_slot_hint_, 1);
+  start = static_cast<uint32>(start) % num_slots_;
+  for (int i = 0; i < num_slots_; ++i) {
+    int index = (start + i) % num_slots_;
+    if (CompareAndSwapState(index, kFree, kClaimed)) {
+      // The controller may read this before it is written, but it gives a
+      // claimed slot plenty of time before reaping it.
+      slot(index)->owner_pid = pid_;
+      return index;
+    }
+  }
+  return -1;
+}
+
+void SharedMemControllerChannel::PublishRequest(int index, RequestType type,
+                                                StringPiece key) {
+  DCHECK_EQ(kClaimed, state(index));
+  Data::Slot* s = slot(index);
+  s->type = type;
+  if (key.size() <= static_cast<size_t>(kMaxKeyLength)) {
+    memcpy(s->key, key.data(), key.size());
+    s->key[key.size()] = '\0';
+  } else {
+    uint64 hash = HashString<CasePreserve, uint64>(key.data(), key.size());
+    GoogleString suffix =
+        StrCat("#", Integer64ToString(static_cast<int64>(hash)));
+    size_t prefix_size = kMaxKeyLength - suffix.size();
+    memcpy(s->key, key.data(), prefix_size);
+    memcpy(s->key + prefix_size, suffix.data(), suffix.size());
+    s->key[kMaxKeyLength] = '\0';
+  }
+  // Release store, so the payload above is visible to the controller before
+  // it sees kRequested.
+  SetState(index, kRequested);
+  WakeServer();
+}
+
+SharedMemControllerChannel::RequestType SharedMemControllerChannel::type(
+    int index) const {
+  return static_cast<RequestType>(slot(index)->type);
+}
+
+int32 SharedMemControllerChannel::owner_pid(int index) const {
+  return slot(index)->owner_pid;
+}
+
+GoogleString SharedMemControllerChannel::key(int index) const {
+  return GoogleString(slot(index)->key);
+}
+
+void SharedMemControllerChannel::set_owner_pid(int index, int32 pid) {
+  slot(index)->owner_pid = pid;
+}
+
+int32 SharedMemControllerChannel::NewGeneration() {
+  return base::subtle::Barrier_AtomicIncrement(&header()->generation, 1);
+}
+
+int32 SharedMemControllerChannel::generation(int index) const {
+  return slot(index)->generation;
+}
+
+void SharedMemControllerChannel::set_generation(int index, int32 generation) {
+  slot(index)->generation = generation;
+}
+
+SharedMemControllerChannel::SlotState SharedMemControllerChannel::state(
+    int index) const {
+  return static_cast<SlotState>(base::subtle::Acquire_Load(state_word(index)));
+}
+
+void SharedMemControllerChannel::SetState(int index, SlotState new_state) {
+  base::subtle::Release_Store(state_word(index), new_state);
+}
+
+bool SharedMemControllerChannel::CompareAndSwapState(int index,
+                                                     SlotState expected,
+                                                     SlotState new_state) {
+  // Acquire, so the winner of a kFree -> kClaimed race also observes the
+  // previous owner's writes to the payload.
+  return base::subtle::Acquire_CompareAndSwap(state_word(index), expected,
+                                              new_state) == expected;
+}
+
+int32 SharedMemControllerChannel::server_sequence() const {
+  return base::subtle::Acquire_Load(&header()->server_sequence);
+}
+
+int32 SharedMemControllerChannel::client_sequence() const {
+  return base::subtle::Acquire_Load(&header()->client_sequence);
+}
+
+void SharedMemControllerChannel::WakeServer() {
+  Data::FutexWakeAll(&header()->server_sequence);
+}
+
+void SharedMemControllerChannel::WakeClients() {
+  Data::FutexWakeAll(&header()->client_sequence);
+}
+
+void SharedMemControllerChannel::WaitForServerWakeup(int32 seen_sequence,
+                                                     int64 timeout_ms) {
+  Data::FutexWait(&header()->server_sequence, seen_sequence, timeout_ms);
+}
+
+void SharedMemControllerChannel::WaitForClientWakeup(int32 seen_sequence,
+                                                     int64 timeout_ms) {
+  Data::FutexWait(&header()->client_sequence, seen_sequence, timeout_ms);
+}
+
+void SharedMemControllerChannel::MarkShutDown() {
+  base::subtle::Release_Store(&header()->shut_down, 1);
+  WakeClients();
+}
+
+bool SharedMemControllerChannel::IsShutDown() const {
+  return base::subtle::Acquire_Load(&header()->shut_down) != 0;
+}
+
+}  // namespace net_instaweb
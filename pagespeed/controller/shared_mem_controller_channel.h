@@ -0,0 +1,187 @@
+// Copyright 2016 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PAGESPEED_CONTROLLER_SHARED_MEM_CONTROLLER_CHANNEL_H_
+#define PAGESPEED_CONTROLLER_SHARED_MEM_CONTROLLER_CHANNEL_H_
+
+#include <memory>
+
+#include "pagespeed/kernel/base/atomicops.h"
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+
+namespace net_instaweb {
+
+class AbstractSharedMem;
+class AbstractSharedMemSegment;
+class MessageHandler;
+
+namespace SharedMemControllerData {
+
+struct Header;
+struct Slot;
+
+}  // namespace SharedMemControllerData
+
+// Transport between worker processes and the controller process that lives
+// entirely in a shared memory segment, so a scheduling decision costs a
+// couple of atomic operations and a futex wakeup rather than a gRPC round
+// trip. Used by SharedMemCentralController (in workers) and
+// SharedMemCentralControllerServer (in the controller process).
+//
+// The segment holds a fixed number of transaction slots. Every slot carries a
+// request (type and key, written by the worker) and its completion (written
+// by the controller). Ownership of a slot is passed back and forth by atomic
+// transitions of its state word, so no mutex is ever taken:
+//
+//  worker:      kFree -> kClaimed -> kRequested
+//  controller:  kRequested -> kScheduled -> kGranted | kDenied
+//  worker:      kGranted -> kRunning -> kSucceeded | kFailed
+//               kDenied -> kFree
+//  controller:  kSucceeded | kFailed -> kFree
+//
+// A worker that shuts down with requests outstanding withdraws them, leaving
+// the controller to release whatever it decides on later:
+//
+//  worker:      kRequested -> kFree
+//               kScheduled -> kAbandoned
+//               kGranted -> kFailed
+//  controller:  kAbandoned -> kFree
+//
+// The controller also takes back the slots of workers that have exited; see
+// SharedMemCentralControllerServer.
+//
+// Each side sleeps on its own futex word in the header, which the other side
+// bumps after publishing a transition it needs to act on. On platforms
+// without futexes, waiters fall back to polling with the same timeouts.
+//
+// Keys longer than kMaxKeyLength are truncated and suffixed with a hash of
+// the full key, so distinct long keys remain distinct with high probability.
+class SharedMemControllerChannel {
+ public:
+  enum SlotState {
+    kFree = 0,
+    kClaimed,
+    kRequested,
+    kScheduled,
+    kGranted,
+    kDenied,
+    kRunning,
+    kSucceeded,
+    kFailed,
+    kAbandoned,
+  };
+
+  enum RequestType {
+    kExpensiveOperation = 0,
+    kScheduleRewrite,
+  };
+
+  static const int kMaxKeyLength = 256;
+
+  // The channel uses a segment derived from 'path'. You must call Initialize()
+  // in the root process, and Attach() in the processes using the channel.
+  SharedMemControllerChannel(AbstractSharedMem* shm, const GoogleString& path,
+                             int num_slots, MessageHandler* handler);
+  ~SharedMemControllerChannel();
+
+  // Creates and zeroes the segment. Returns whether successful.
+  bool Initialize();
+
+  // Connects to a segment created by Initialize(). Returns whether successful.
+  bool Attach();
+
+  // Removes the segment. Should be called from the root process on exit with
+  // the same shm and path passed to the instance that was Initialize()d.
+  static void GlobalCleanup(AbstractSharedMem* shm, const GoogleString& path,
+                            MessageHandler* handler);
+
+  int num_slots() const { return num_slots_; }
+
+  // Worker side: atomically takes a free slot (kFree -> kClaimed), records
+  // this process as its owner and returns its index, or -1 if every slot is
+  // busy or the controller has shut down. The caller can record whatever
+  // local bookkeeping it needs for the slot before calling PublishRequest,
+  // which fills in the request and hands the slot to the controller
+  // (kClaimed -> kRequested).
+  int ClaimSlot();
+  void PublishRequest(int slot, RequestType type, StringPiece key);
+
+  // Accessors for the request half of a slot. Only meaningful while the slot
+  // is in a state between kRequested and kAbandoned, except for owner_pid,
+  // which is set from kClaimed on.
+  RequestType type(int slot) const;
+  int32 owner_pid(int slot) const;
+  GoogleString key(int slot) const;
+
+  // Exposed for tests, which use it to simulate workers that have exited.
+  void set_owner_pid(int slot, int32 pid);
+
+  // Controller side: the controller bumps the generation each time it
+  // (re)starts and stamps it into every slot it schedules, so that a restarted
+  // controller can tell completions of its own grants from leftovers of its
+  // predecessor.
+  int32 NewGeneration();
+  int32 generation(int slot) const;
+  void set_generation(int slot, int32 generation);
+
+  // Current state of a slot, with acquire semantics.
+  SlotState state(int slot) const;
+
+  // Publishes a transition made by the current owner of slot, with release
+  // semantics.
+  void SetState(int slot, SlotState new_state);
+
+  // Atomically moves slot from 'expected' to 'new_state'; returns false if
+  // the slot was not in 'expected'.
+  bool CompareAndSwapState(int slot, SlotState expected, SlotState new_state);
+
+  // Futex-style wakeup words for each side. Read the sequence number before
+  // scanning the slots, then pass it to the wait call: the wait returns
+  // immediately if the other side has bumped it in the meantime.
+  int32 server_sequence() const;
+  int32 client_sequence() const;
+  void WakeServer();
+  void WakeClients();
+  void WaitForServerWakeup(int32 seen_sequence, int64 timeout_ms);
+  void WaitForClientWakeup(int32 seen_sequence, int64 timeout_ms);
+
+  // Tells workers that the controller has gone away and they should stop
+  // posting requests.
+  void MarkShutDown();
+  bool IsShutDown() const;
+
+ private:
+  SharedMemControllerData::Header* header() const;
+  SharedMemControllerData::Slot* slot(int index) const;
+  volatile base::subtle::Atomic32* state_word(int index) const;
+
+  AbstractSharedMem* shm_runtime_;
+  const GoogleString path_;
+  const int num_slots_;
+  MessageHandler* handler_;
+  std::unique_ptr<AbstractSharedMemSegment> segment_;
+  int32 pid_;
+
+  // Where to start looking for a free slot in ClaimSlot. Only a hint, so
+  // races on it are benign.
+  base::subtle::Atomic32 next_slot_hint_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedMemControllerChannel);
+};
+
+}  // namespace net_instaweb
+
+#endif  // PAGESPEED_CONTROLLER_SHARED_MEM_CONTROLLER_CHANNEL_H_
@@ -220,6 +220,7 @@
         'instaweb_root':  '<(DEPTH)/pagespeed',
       },
       'sources': [
+        'kernel/html/html_entity.gperf',
         'kernel/html/html_name.gperf',
       ],
       # TODO(morlovich): Move gperf.gypi to pagespeed/, changing all
@@ -246,6 +247,7 @@
         'kernel/html/html_node.cc',
         'kernel/html/html_parse.cc',
         'kernel/html/html_writer_filter.cc',
+        'kernel/html/minifying_html_writer_filter.cc',
         'kernel/html/remove_comments_filter.cc',
       ],
       'dependencies': [
@@ -359,6 +361,7 @@
         '<(DEPTH)',
       ],
       'dependencies': [
+        'pagespeed_base',
         'pagespeed_base_core',
         'js_tokenizer',
         'pagespeed_javascript_gperf',
@@ -19,6 +19,7 @@
 #ifndef PAGESPEED_KERNEL_BASE_ARENA_H_
 #define PAGESPEED_KERNEL_BASE_ARENA_H_
 
+#include <algorithm>
 #include <vector>
 #include <cstddef>
 
@@ -37,7 +38,7 @@ class Arena {
   // this much room for our work area, as it keeps things simple.
   static const size_t kAlign = 8;
 
-  Arena() {
+  Arena() : num_chunks_allocated_(0) {
     InitEmpty();
   }
 
@@ -78,6 +79,15 @@ class Arena {
   // Cleans up all the objects in the arena. You must call this explicitly.
   void DestroyObjects();
 
+  // Exchanges the objects held by this arena with those held by other, so
+  // that a batch of objects can outlive the arena it was allocated in.
+  // Lifetime chunk counts stay with their arena.
+  void Swap(Arena* other);
+
+  // Number of chunks this arena has allocated from the heap over its whole
+  // lifetime; this is not reset by DestroyObjects.
+  int64 num_chunks_allocated() const { return num_chunks_allocated_; }
+
   // Rounds block size up to 8; we always align to it, even on 32-bit.
   static size_t ExpandToAlign(size_t in) {
     return (in + kAlign - 1) & ~(kAlign - 1);
@@ -128,12 +138,14 @@ class Arena {
   char* scratch_;
 
   std::vector<Chunk*> chunks_;
+  int64 num_chunks_allocated_;
 };
 
 template<typename T>
 void Arena<T>::AddChunk() {
   Chunk* chunk = new Chunk();
   chunks_.push_back(chunk);
+  ++num_chunks_allocated_;
   next_alloc_ = chunk->buf;
   chunk_end_ = next_alloc_ + Chunk::kSize;
   last_link_ = &scratch_;
@@ -154,6 +166,21 @@ void Arena<T>::DestroyObjects() {
   InitEmpty();
 }
 
+template<typename T>
+void Arena<T>::Swap(Arena* other) {
+  std::swap(next_alloc_, other->next_alloc_);
+  std::swap(chunk_end_, other->chunk_end_);
+  chunks_.swap(other->chunks_);
+
+  // A fresh chunk links its first object via scratch_, which must stay with
+  // the arena rather than travel with the chunks.
+  char** link = (other->last_link_ == &other->scratch_) ?
+      &scratch_ : other->last_link_;
+  other->last_link_ = (last_link_ == &scratch_) ?
+      &other->scratch_ : last_link_;
+  last_link_ = link;
+}
+
 template<typename T>
 void Arena<T>::InitEmpty() {
   // The way this is initialized ensures that the next call to allocate
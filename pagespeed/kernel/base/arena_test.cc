@@ -175,6 +175,37 @@ TEST_F(ArenaTest, TestReuse) {
   TestCombo(20000, 10000);
 }
 
+TEST_F(ArenaTest, TestChunkCount) {
+  EXPECT_EQ(0, arena_.num_chunks_allocated());
+  TestCombo(1, 0);
+  EXPECT_EQ(1, arena_.num_chunks_allocated());
+
+  // The count covers the arena's lifetime, across DestroyObjects calls,
+  // and grows by a chunk at a time rather than an object at a time.
+  ClearStats();
+  TestCombo(10000, 0);
+  EXPECT_LT(1, arena_.num_chunks_allocated());
+  EXPECT_GT(10000 / 10, arena_.num_chunks_allocated());
+}
+
+TEST_F(ArenaTest, TestSwap) {
+  Arena<Base> other;
+  CheckPtr(new (&arena_) KidA(this));
+  CheckPtr(new (&other) KidB(this));
+  CheckPtr(new (&other) KidB(this));
+  arena_.Swap(&other);
+
+  // Both arenas must keep allocating correctly after the swap.
+  CheckPtr(new (&arena_) KidB(this));
+  CheckPtr(new (&other) KidA(this));
+  arena_.DestroyObjects();
+  EXPECT_EQ(0, destroyed_a_);
+  EXPECT_EQ(3, destroyed_b_);
+  other.DestroyObjects();
+  EXPECT_EQ(2, destroyed_a_);
+  EXPECT_EQ(1, other.num_chunks_allocated());
+}
+
 // Tests for alignment helper.
 TEST_F(ArenaTest, TestAlign) {
   // A few that work regardless of arch, to sanity-check
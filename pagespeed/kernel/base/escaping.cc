@@ -18,35 +18,31 @@
 
 #include "pagespeed/kernel/base/escaping.h"
 
+#include <algorithm>
 #include <cstddef>
 
 #include "strings/stringpiece_utils.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/writer.h"
 
 namespace net_instaweb {
 
+namespace {
+
 // We escape backslash, double-quote, CR and LF while forming a string
 // from the code. Single quotes are escaped as well, if we don't know we're
-// explicitly double-quoting.  Appends to *escaped.
+// explicitly double-quoting.  Appends original[begin, end) to *escaped;
+// since the escaping of some characters depends on the ones after them,
+// this may look at original beyond end.
 //
 // This is /almost/ completely right: U+2028 and U+2029 are
 // line terminators as well (ECMA 262-5 --- 7.3, 7.8.4), so should really be
 // escaped, too, but we don't have the encoding here.
-void EscapeToJsStringLiteral(const StringPiece& original,
-                             bool add_quotes,
-                             GoogleString* escaped) {
-  // Optimistically assume no escaping will be required and reserve enough space
-  // for that result.  This assumes that either escaped is empty (or nearly so),
-  // or reserve(...) behaves sanely and only vector doubles rather than
-  // increasing size linearly.  The latter is true in gcc at least (but not true
-  // of some implementations of std::vector, thus the caveat).
-  escaped->reserve(escaped->size() + original.size() + (add_quotes ? 2 : 0));
-  if (add_quotes) {
-    (*escaped) += "\"";
-  }
-  for (size_t c = 0; c < original.length(); ++c) {
+void AppendJsEscapedRange(const StringPiece& original, size_t begin,
+                          size_t end, bool add_quotes, GoogleString* escaped) {
+  for (size_t c = begin; c < end; ++c) {
     switch (original[c]) {
       case '\\':
         (*escaped) += "\\\\";
@@ -102,11 +98,54 @@ void EscapeToJsStringLiteral(const StringPiece& original,
         (*escaped) += original[c];
     }
   }
+}
+
+// Size of the pieces in which the Writer form of EscapeToJsStringLiteral
+// escapes its input.
+const size_t kJsEscapeChunkSize = 32 * 1024;
+
+}  // namespace
+
+void EscapeToJsStringLiteral(const StringPiece& original,
+                             bool add_quotes,
+                             GoogleString* escaped) {
+  // Optimistically assume no escaping will be required and reserve enough space
+  // for that result.  This assumes that either escaped is empty (or nearly so),
+  // or reserve(...) behaves sanely and only vector doubles rather than
+  // increasing size linearly.  The latter is true in gcc at least (but not true
+  // of some implementations of std::vector, thus the caveat).
+  escaped->reserve(escaped->size() + original.size() + (add_quotes ? 2 : 0));
+  if (add_quotes) {
+    (*escaped) += "\"";
+  }
+  AppendJsEscapedRange(original, 0, original.size(), add_quotes, escaped);
   if (add_quotes) {
     (*escaped) += "\"";
   }
 }
 
+bool EscapeToJsStringLiteral(const StringPiece& original,
+                             bool add_quotes,
+                             Writer* writer,
+                             MessageHandler* handler) {
+  bool ok = true;
+  if (add_quotes) {
+    ok &= writer->Write("\"", handler);
+  }
+  GoogleString buffer;
+  for (size_t begin = 0; begin < original.size();
+       begin += kJsEscapeChunkSize) {
+    size_t end = std::min(original.size(), begin + kJsEscapeChunkSize);
+    buffer.clear();
+    AppendJsEscapedRange(original, begin, end, add_quotes, &buffer);
+    ok &= writer->Write(buffer, handler);
+  }
+  if (add_quotes) {
+    ok &= writer->Write("\"", handler);
+  }
+  return ok;
+}
+
 void EscapeToJsonStringLiteral(const StringPiece& original,
                                bool add_quotes,
                                GoogleString* escaped) {
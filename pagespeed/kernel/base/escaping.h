@@ -24,12 +24,23 @@
 
 namespace net_instaweb {
 
+class MessageHandler;
+class Writer;
+
 // Appends version of original escaped for JS string syntax, safe for inclusion
 // into HTML, to *escaped, (optionally with quotes, if asked).
 void EscapeToJsStringLiteral(const StringPiece& original,
                              bool add_quotes,
                              GoogleString* escaped);
 
+// As above, but writes the escaped string to writer a piece at a time, so
+// that escaping a large input does not need a second copy of it.  Returns
+// false if a write failed.
+bool EscapeToJsStringLiteral(const StringPiece& original,
+                             bool add_quotes,
+                             Writer* writer,
+                             MessageHandler* handler);
+
 // Appends version of original escaped for JSON string syntax to *escaped,
 // (optionally with quotes, if asked).
 //
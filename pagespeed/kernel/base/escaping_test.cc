@@ -19,6 +19,8 @@
 #include "pagespeed/kernel/base/escaping.h"
 
 #include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/string_writer.h"
 
 namespace net_instaweb {
 
@@ -110,6 +112,26 @@ TEST_F(EscapingTest, JsonEscapeAppend) {
   EXPECT_EQ("\"ab\"cd", out);
 }
 
+// The Writer form escapes in pieces; make sure sequences that are escaped
+// based on what follows them come out the same when they straddle a piece
+// boundary.
+TEST_F(EscapingTest, JsEscapeToWriter) {
+  const int kChunkSize = 32 * 1024;
+  NullMessageHandler handler;
+  for (int offset = -8; offset <= 1; ++offset) {
+    GoogleString in(kChunkSize + offset, 'x');
+    StrAppend(&in, "</script><!-- --> \"'\n", in);
+    for (int quoted = 0; quoted < 2; ++quoted) {
+      bool add_quotes = (quoted == 1);
+      GoogleString expected, out;
+      EscapeToJsStringLiteral(in, add_quotes, &expected);
+      StringWriter writer(&out);
+      EXPECT_TRUE(EscapeToJsStringLiteral(in, add_quotes, &writer, &handler));
+      EXPECT_EQ(expected, out) << offset;
+    }
+  }
+}
+
 }  // namespace
 
 }  // namespace net_instaweb
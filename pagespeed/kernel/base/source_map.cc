@@ -87,72 +87,65 @@ GoogleString EncodeVlq(const int32 input_val) {
   return result;
 }
 
+MappingsEncoder::MappingsEncoder(GoogleString* result)
+    : result_(result),
+      empty_(true),
+      first_segment_in_line_(true) {
+}
+
 // Encode to the compact mappings format, which is a ;-separated list of
 // ,-separated lists of base64 VLQ values.
-bool EncodeMappings(const MappingVector& mappings,
-                    GoogleString* result) {
-  int current_gen_line = 0;
-  bool first_segment_in_line = true;
-  for (int i = 0, mappings_size = mappings.size(); i < mappings_size; ++i) {
-    if (mappings[i].gen_line < current_gen_line) {
-      LOG(DFATAL) << "Mappings are not sorted.";
-      return false;
-    }
-
-    // gen_line is not encoded into the fields, instead each line in the
-    // generated file is ; delineated in the VLQ.
-    while (mappings[i].gen_line > current_gen_line) {
-      *result += ";";
-      first_segment_in_line = true;
-      ++current_gen_line;
-    }
-
-    // Fields to encode in base64 VLQ.
-    // 1) Generated column number
-    if (first_segment_in_line) {
-      // First segment for each line must list absolute column number.
-      *result += EncodeVlq(mappings[i].gen_col);
-    } else {
-      // Subsequent ones will list column number as a diff from previous one
-      // as a space saving measure.
-      *result += EncodeVlq(mappings[i].gen_col - mappings[i - 1].gen_col);
-    }
+bool MappingsEncoder::Add(const Mapping& mapping) {
+  if (mapping.gen_line < prev_.gen_line) {
+    LOG(DFATAL) << "Mappings are not sorted.";
+    return false;
+  }
 
-    // 2) Source file number
-    if (i == 0) {
-      // First segment of the file must list absolute numbers.
-      *result += EncodeVlq(mappings[i].src_file);
-    } else {
-      // Subsequent ones list diffs.
-      *result += EncodeVlq(mappings[i].src_file - mappings[i - 1].src_file);
-    }
+  // gen_line is not encoded into the fields, instead each line in the
+  // generated file is ; delineated in the VLQ.
+  if (mapping.gen_line > prev_.gen_line) {
+    result_->append(mapping.gen_line - prev_.gen_line, ';');
+    first_segment_in_line_ = true;
+  } else if (!first_segment_in_line_) {
+    // Segments on the same line are comma-separated.
+    *result_ += ",";
+  }
 
-    // 3) Source line number
-    if (i == 0) {
-      *result += EncodeVlq(mappings[i].src_line);
-    } else {
-      *result += EncodeVlq(mappings[i].src_line - mappings[i - 1].src_line);
-    }
+  // Fields to encode in base64 VLQ.
+  // 1) Generated column number
+  if (first_segment_in_line_) {
+    // First segment for each line must list absolute column number.
+    *result_ += EncodeVlq(mapping.gen_col);
+  } else {
+    // Subsequent ones will list column number as a diff from previous one
+    // as a space saving measure.
+    *result_ += EncodeVlq(mapping.gen_col - prev_.gen_col);
+  }
 
-    // 4) Source column number
-    if (i == 0) {
-      *result += EncodeVlq(mappings[i].src_col);
-    } else {
-      *result += EncodeVlq(mappings[i].src_col - mappings[i - 1].src_col);
-    }
+  // 2) Source file number, 3) source line number and 4) source column
+  // number.  The first segment of the file must list absolute numbers;
+  // subsequent ones list diffs.  prev_ starts out all zeros, so the diffs
+  // are the absolute numbers for the first segment.
+  *result_ += EncodeVlq(mapping.src_file - prev_.src_file);
+  *result_ += EncodeVlq(mapping.src_line - prev_.src_line);
+  *result_ += EncodeVlq(mapping.src_col - prev_.src_col);
 
-    // Note: We do not add (5) Names.
+  // Note: We do not add (5) Names.
 
-    first_segment_in_line = false;
+  prev_ = mapping;
+  empty_ = false;
+  first_segment_in_line_ = false;
+  return true;
+}
 
-    // Segments are comma-separated, but don't add a trailing comma nor a comma
-    // if a semicolon (line change) will be added.
-    if (i + 1 < mappings_size &&
-        mappings[i + 1].gen_line == current_gen_line) {
-      *result += ",";
+bool EncodeMappings(const MappingVector& mappings,
+                    GoogleString* result) {
+  MappingsEncoder encoder(result);
+  for (int i = 0, mappings_size = mappings.size(); i < mappings_size; ++i) {
+    if (!encoder.Add(mappings[i])) {
+      return false;
     }
   }
-
   return true;
 }
 
@@ -181,27 +174,35 @@ bool Encode(StringPiece generated_url,
   GoogleString encoded_mappings;
   bool success = EncodeMappings(mappings, &encoded_mappings);
   if (success) {
-    Json::Value json;
-    json["version"] = 3;
-    if (!generated_url.empty()) {
-      json["file"] = PercentEncode(generated_url).c_str();
-    }
-    // Sources array with one value.
-    json["sources"][0] = PercentEncode(source_url).c_str();
-    // Note: We do not provide names functionality.
-    json["names"] = Json::arrayValue;  // Empty array.
-    json["mappings"] = encoded_mappings.c_str();
-
-    // Standard XSSI protection.
-    // http://www.html5rocks.com/en/tutorials/developertools/sourcemaps/#toc-xssi
-    *encoded_source_map += ")]}'\n";
-
-    Json::FastWriter writer;
-    *encoded_source_map += writer.write(json);
+    EncodeWithEncodedMappings(generated_url, source_url, encoded_mappings,
+                              encoded_source_map);
   }
   return success;
 }
 
+void EncodeWithEncodedMappings(StringPiece generated_url,
+                               StringPiece source_url,
+                               StringPiece encoded_mappings,
+                               GoogleString* encoded_source_map) {
+  Json::Value json;
+  json["version"] = 3;
+  if (!generated_url.empty()) {
+    json["file"] = PercentEncode(generated_url).c_str();
+  }
+  // Sources array with one value.
+  json["sources"][0] = PercentEncode(source_url).c_str();
+  // Note: We do not provide names functionality.
+  json["names"] = Json::arrayValue;  // Empty array.
+  json["mappings"] = encoded_mappings.as_string().c_str();
+
+  // Standard XSSI protection.
+  // http://www.html5rocks.com/en/tutorials/developertools/sourcemaps/#toc-xssi
+  *encoded_source_map += ")]}'\n";
+
+  Json::FastWriter writer;
+  *encoded_source_map += writer.write(json);
+}
+
 }  // namespace source_map
 
 }  // namespace net_instaweb
@@ -55,6 +55,30 @@ struct Mapping {
 
 typedef std::vector<Mapping> MappingVector;
 
+// Encodes mappings one at a time into the compact ;- and ,-separated VLQ
+// format used for the "mappings" field, so that producers of very long
+// mapping sequences need not hold them all in a MappingVector.  Only the
+// previous mapping is remembered.
+class MappingsEncoder {
+ public:
+  // Appends to *result, which must outlive the encoder.
+  explicit MappingsEncoder(GoogleString* result);
+
+  // Mappings MUST be added sorted by gen_line and then gen_col.  Returns
+  // false, and appends nothing, if mapping is out of order.
+  bool Add(const Mapping& mapping);
+
+  bool empty() const { return empty_; }
+
+ private:
+  GoogleString* result_;
+  Mapping prev_;
+  bool empty_;
+  bool first_segment_in_line_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappingsEncoder);
+};
+
 // Encodes generated_url, source_url and mappings into encoded_source_map
 // which will be the contents of a JSON Source Map v3 file.
 // Bool returned answers question "Did this succeed?"
@@ -64,6 +88,12 @@ bool Encode(StringPiece generated_url,  // optional: "" to ignore.
             const MappingVector& mappings,
             GoogleString* encoded_source_map);
 
+// As above, but for mappings already encoded with a MappingsEncoder.
+void EncodeWithEncodedMappings(StringPiece generated_url,
+                               StringPiece source_url,
+                               StringPiece encoded_mappings,
+                               GoogleString* encoded_source_map);
+
 // TODO(sligocki)-maybe: Do we want a decoder as well? Might be nice for
 // testing purposes, then we could throw a lot of random examples at it and
 // make sure they Encode -> Decode back to the original.
@@ -165,6 +165,18 @@ double SplitHistogram::MinimumInternal() {
   return rw_->Minimum();
 }
 
+double SplitHistogram::WindowMsInternal() {
+  return rw_->WindowMs();
+}
+
+double SplitHistogram::WindowCountInternal() {
+  return rw_->WindowCount();
+}
+
+double SplitHistogram::WindowPercentileInternal(const double perc) {
+  return rw_->WindowPercentile(perc);
+}
+
 AbstractMutex* SplitHistogram::lock() {
   return lock_.get();
 }
@@ -109,6 +109,9 @@ class SplitHistogram : public Histogram {
   virtual double CountInternal();
   virtual double MaximumInternal();
   virtual double MinimumInternal();
+  virtual double WindowMsInternal();
+  virtual double WindowCountInternal();
+  virtual double WindowPercentileInternal(const double perc);
 
   virtual AbstractMutex* lock();
 
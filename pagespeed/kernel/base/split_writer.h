@@ -42,6 +42,13 @@ class SplitWriter : public Writer {
     return ret;
   }
 
+  virtual bool WriteV(const StringPiece* pieces, int num_pieces,
+                      MessageHandler* handler) {
+    bool ret = writer1_->WriteV(pieces, num_pieces, handler);
+    ret &= writer2_->WriteV(pieces, num_pieces, handler);
+    return ret;
+  }
+
   virtual bool Flush(MessageHandler* handler) {
     bool ret = writer1_->Flush(handler);
     ret &= writer2_->Flush(handler);
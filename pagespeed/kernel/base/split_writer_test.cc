@@ -18,6 +18,7 @@
 
 #include "pagespeed/kernel/base/split_writer.h"
 
+#include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/gtest.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
@@ -53,6 +54,17 @@ TEST(SplitWriterTest, SplitsWrite) {
   EXPECT_TRUE(split_writer.Flush(NULL));
 }
 
+TEST(SplitWriterTest, SplitsWriteV) {
+  GoogleString str1, str2;
+  StringWriter writer1(&str1), writer2(&str2);
+  SplitWriter split_writer(&writer1, &writer2);
+
+  StringPiece pieces[] = {"Hello", ", ", "", "World!"};
+  EXPECT_TRUE(split_writer.WriteV(pieces, arraysize(pieces), NULL));
+  EXPECT_EQ("Hello, World!", str1);
+  EXPECT_EQ("Hello, World!", str2);
+}
+
 class FailWriter : public Writer {
  public:
   virtual bool Write(const StringPiece& str, MessageHandler* handler) {
@@ -82,6 +94,12 @@ TEST(SplitWriterTest, WritesToBothEvenOnFailure) {
   EXPECT_FALSE(split_fail_second.Write("Hello, World!", NULL));
   EXPECT_EQ("Hello, World!", str);
   EXPECT_FALSE(split_fail_second.Flush(NULL));
+
+  // WriteV falls back to Write for FailWriter, and stops at the first piece.
+  str.clear();
+  StringPiece pieces[] = {"Hello, ", "World!"};
+  EXPECT_FALSE(split_fail_first.WriteV(pieces, arraysize(pieces), NULL));
+  EXPECT_EQ("Hello, World!", str);
 }
 
 }  // namespace
@@ -28,6 +28,7 @@
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/string_writer.h"
+#include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/base/writer.h"
 
 namespace net_instaweb {
@@ -184,6 +185,14 @@ void Histogram::Render(int index, Writer* writer, MessageHandler* handler) {
   {
     ScopedMutex hold(lock());
     StringWriter string_writer(&buf);
+    if (WindowMsInternal() > 0) {
+      string_writer.Write(StringPrintf(
+          "<div>Last %.0f s: Count %.0f, Median %.0f, 99%% %.0f, "
+          "99.9%% %.0f</div>\n",
+          WindowMsInternal() / Timer::kSecondMs, WindowCountInternal(),
+          WindowPercentileInternal(50), WindowPercentileInternal(99),
+          WindowPercentileInternal(99.9)), handler);
+    }
     WriteRawHistogramData(&string_writer, handler);
   }
 
@@ -214,6 +223,7 @@ const char kHistogramProlog[] =
     "      <td>90%</td>\n"
     "      <td>95%</td>\n"
     "      <td>99%</td>\n"
+    "      <td>99.9%</td>\n"
     "    </tr></thead><tbody>\n";
 
 const char kHistogramRowFormat[] =
@@ -223,6 +233,7 @@ const char kHistogramRowFormat[] =
     "        <td>%.0f</td><td>%.1f</td><td>%.1f</td>\n"  // count, avg, stddev
     "        <td>%.0f</td><td>%.0f</td><td>%.0f</td>\n"  // min, median, max
     "        <td>%.0f</td><td>%.0f</td><td>%.0f</td>\n"  // 90%, 95%, 99%
+    "        <td>%.0f</td>\n"                             // 99.9%
     "     </tr>\n";
 
 const char kHistogramEpilog[] =
@@ -332,7 +343,8 @@ GoogleString Histogram::HtmlTableRow(const GoogleString& title, int index) {
       MaximumInternal(),
       PercentileInternal(90),
       PercentileInternal(95),
-      PercentileInternal(99));
+      PercentileInternal(99),
+      PercentileInternal(99.9));
 }
 
 void Statistics::RenderTimedVariables(Writer* writer,
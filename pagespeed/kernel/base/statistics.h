@@ -207,6 +207,22 @@ class Histogram {
     return Percentile(50);
   }
 
+  // Windowed views, covering the values added during the most recent
+  // complete time window.  Histograms that don't keep windows report a
+  // WindowMs() of 0, as do ones whose first window hasn't ended yet.
+  double WindowMs() {
+    ScopedMutex hold(lock());
+    return WindowMsInternal();
+  }
+  double WindowCount() {
+    ScopedMutex hold(lock());
+    return WindowCountInternal();
+  }
+  double WindowPercentile(const double perc) {
+    ScopedMutex hold(lock());
+    return WindowPercentileInternal(perc);
+  }
+
   // Formats the histogram statistics as an HTML table row.  This
   // is intended for use in Statistics::RenderHistograms.
   //
@@ -236,6 +252,9 @@ class Histogram {
   virtual double CountInternal() = 0;
   virtual double MaximumInternal() = 0;
   virtual double MinimumInternal() = 0;
+  virtual double WindowMsInternal() { return 0; }
+  virtual double WindowCountInternal() { return 0; }
+  virtual double WindowPercentileInternal(const double perc) { return 0; }
 
   virtual AbstractMutex* lock() = 0;
 
@@ -33,6 +33,20 @@ bool StringWriter::Write(const StringPiece& str, MessageHandler* handler) {
   return true;
 }
 
+bool StringWriter::WriteV(const StringPiece* pieces, int num_pieces,
+                          MessageHandler* handler) {
+  // Grow the string at most once for the whole batch.
+  size_t size = string_->size();
+  for (int i = 0; i < num_pieces; ++i) {
+    size += pieces[i].size();
+  }
+  string_->reserve(size);
+  for (int i = 0; i < num_pieces; ++i) {
+    string_->append(pieces[i].data(), pieces[i].size());
+  }
+  return true;
+}
+
 bool StringWriter::Flush(MessageHandler* message_handler) {
   return true;
 }
@@ -34,6 +34,8 @@ class StringWriter : public Writer {
   explicit StringWriter(GoogleString* str) : string_(str) { }
   virtual ~StringWriter();
   virtual bool Write(const StringPiece& str, MessageHandler* message_handler);
+  virtual bool WriteV(const StringPiece* pieces, int num_pieces,
+                      MessageHandler* message_handler);
   virtual bool Flush(MessageHandler* message_handler);
   virtual bool Dump(Writer* writer, MessageHandler* message_handler);
  private:
@@ -62,6 +62,10 @@ template<class CharTransform> class SymbolTable {
   // Remember a string in the table, returning it as an Atom.
   Atom Intern(const StringPiece& src);
 
+  // Sizes the table so that num_symbols symbols can be interned without
+  // rehashing.  Note that Clear() releases this capacity.
+  void Reserve(size_t num_symbols) { string_map_.resize(num_symbols); }
+
   // Returns the number of bytes allocated on behalf of the data,
   // excluding any overhead added by the symbol table.
   size_t string_bytes_allocated() const { return string_bytes_allocated_; }
@@ -23,6 +23,16 @@ namespace net_instaweb {
 Writer::~Writer() {
 }
 
+bool Writer::WriteV(const StringPiece* pieces, int num_pieces,
+                    MessageHandler* handler) {
+  for (int i = 0; i < num_pieces; ++i) {
+    if (!Write(pieces[i], handler)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Writer::Dump(Writer* writer, MessageHandler* message_handler) {
   return false;
 }
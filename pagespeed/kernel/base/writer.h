@@ -34,6 +34,14 @@ class Writer {
   virtual bool Write(const StringPiece& str, MessageHandler* handler) = 0;
   virtual bool Flush(MessageHandler* message_handler) = 0;
 
+  // Writes num_pieces StringPieces, in order, as if by consecutive calls to
+  // Write.  The pieces need only remain valid for the duration of the call.
+  // Writers with a significant per-call cost should override this to handle
+  // the whole batch at once; the default implementation just calls Write for
+  // each piece, stopping at the first failure.
+  virtual bool WriteV(const StringPiece* pieces, int num_pieces,
+                      MessageHandler* handler);
+
   // Dumps the contents of what's been written to the Writer.  Many
   // Writer implementations will not be able to do this, and the default
   // implementation will return false.  But StringWriter and
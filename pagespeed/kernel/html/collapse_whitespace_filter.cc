@@ -79,46 +79,49 @@ void CollapseWhitespaceFilter::EndElement(HtmlElement* element) {
 void CollapseWhitespaceFilter::Characters(HtmlCharactersNode* characters) {
   if (keyword_stack_.empty()) {
     // Mutate the contents-string in-place for speed.
-    GoogleString* contents = characters->mutable_contents();
-    // It is safe to directly mutate the bytes in the string because
-    // we are only going to shrink it, never grow it.
-    char* read_ptr = &(*contents)[0];
-    char* write_ptr = read_ptr;
-    char* end = read_ptr + contents->size();
-    int in_whitespace = 0;  // Used for pointer-subtraction so newlines dominate
-    for (; read_ptr != end; ++read_ptr) {
-      char ch = *read_ptr;
-      switch (ch) {
-        // See http://www.w3.org/TR/html401/struct/text.html#h-9.1
-        case ' ':
-        case '\t':
-        case '\r':
-        case '\f':
-          // Add whitespace if the previous character was not already
-          // whitespace.  Note that the whitespace may be overwritten
-          // by a newline.  This extra branch could be avoided if we folded
-          // the current whitespace-state into the switch via an OR.
-          if (in_whitespace == 0) {
-            *write_ptr++ = ch;
-            in_whitespace = 1;
-          }
-          break;
-        case '\n':
-          // If the previous character was a whitespace, then back up
-          // so that the 'write' in the default case will overwrite the
-          // previous whitespace with a newline.  Avoid branches.
-          write_ptr -= in_whitespace;
-          in_whitespace = 1;
-          *write_ptr++ = ch;
-          break;
-        default:
-          in_whitespace = 0;
+    CollapseWhitespace(characters->mutable_contents());
+  }
+}
+
+void CollapseWhitespaceFilter::CollapseWhitespace(GoogleString* text) {
+  // It is safe to directly mutate the bytes in the string because
+  // we are only going to shrink it, never grow it.
+  char* read_ptr = &(*text)[0];
+  char* write_ptr = read_ptr;
+  char* end = read_ptr + text->size();
+  int in_whitespace = 0;  // Used for pointer-subtraction so newlines dominate
+  for (; read_ptr != end; ++read_ptr) {
+    char ch = *read_ptr;
+    switch (ch) {
+      // See http://www.w3.org/TR/html401/struct/text.html#h-9.1
+      case ' ':
+      case '\t':
+      case '\r':
+      case '\f':
+        // Add whitespace if the previous character was not already
+        // whitespace.  Note that the whitespace may be overwritten
+        // by a newline.  This extra branch could be avoided if we folded
+        // the current whitespace-state into the switch via an OR.
+        if (in_whitespace == 0) {
           *write_ptr++ = ch;
-          break;
-      }
+          in_whitespace = 1;
+        }
+        break;
+      case '\n':
+        // If the previous character was a whitespace, then back up
+        // so that the 'write' in the default case will overwrite the
+        // previous whitespace with a newline.  Avoid branches.
+        write_ptr -= in_whitespace;
+        in_whitespace = 1;
+        *write_ptr++ = ch;
+        break;
+      default:
+        in_whitespace = 0;
+        *write_ptr++ = ch;
+        break;
     }
-    contents->resize(write_ptr - contents->data());
   }
+  text->resize(write_ptr - text->data());
 }
 
 }  // namespace net_instaweb
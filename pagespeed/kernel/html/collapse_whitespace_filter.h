@@ -24,6 +24,7 @@
 #include "pagespeed/kernel/html/empty_html_filter.h"
 #include "pagespeed/kernel/html/html_name.h"
 #include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/string.h"
 
 namespace net_instaweb {
 class HtmlParse;
@@ -49,6 +50,14 @@ class CollapseWhitespaceFilter : public EmptyHtmlFilter {
   virtual void EndElement(HtmlElement* element);
   virtual void Characters(HtmlCharactersNode* characters);
   virtual const char* Name() const { return "CollapseWhitespace"; }
+  virtual bool CanBeFused() const { return true; }
+
+  // Returns true if we are inside a tag whose whitespace must be left alone,
+  // e.g. <pre>.
+  bool InSensitiveTag() const { return !keyword_stack_.empty(); }
+
+  // Collapses runs of whitespace in text, in place.
+  static void CollapseWhitespace(GoogleString* text);
 
  private:
   HtmlParse* html_parse_;
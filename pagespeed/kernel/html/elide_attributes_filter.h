@@ -38,6 +38,7 @@ class ElideAttributesFilter : public EmptyHtmlFilter {
 
   virtual void StartElement(HtmlElement* element);
   virtual const char* Name() const { return "ElideAttributes"; }
+  virtual bool CanBeFused() const { return true; }
 
  private:
   struct AttrValue {
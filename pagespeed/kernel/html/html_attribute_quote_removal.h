@@ -52,6 +52,7 @@ class HtmlAttributeQuoteRemoval : public EmptyHtmlFilter {
   }
 
   virtual const char* Name() const { return "HtmlAttributeQuoteRemoval"; }
+  virtual bool CanBeFused() const { return true; }
 
  private:
   int total_quotes_removed_;
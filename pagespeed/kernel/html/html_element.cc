@@ -63,11 +63,14 @@ void HtmlElement::MarkAsDead(const HtmlEventListIterator& end) {
 }
 
 void HtmlElement::SynthesizeEvents(const HtmlEventListIterator& iter,
-                                   HtmlEventList* queue) {
+                                   HtmlEventList* queue,
+                                   Arena<HtmlEvent>* arena) {
   // We use -1 as a bogus line number, since these events are synthetic.
-  HtmlEvent* start_tag = new HtmlStartElementEvent(this, Data::kMaxLineNumber);
+  HtmlEvent* start_tag =
+      new (arena) HtmlStartElementEvent(this, Data::kMaxLineNumber);
   set_begin(queue->insert(iter, start_tag));
-  HtmlEvent* end_tag = new HtmlEndElementEvent(this, Data::kMaxLineNumber);
+  HtmlEvent* end_tag =
+      new (arena) HtmlEndElementEvent(this, Data::kMaxLineNumber);
   set_end(queue->insert(iter, end_tag));
 }
 
@@ -174,7 +177,7 @@ void HtmlElement::AddAttribute(const Attribute& src_attr) {
   if (src_attr.decoded_value_computed_) {
     attr->decoded_value_computed_ = true;
     attr->decoding_error_ = src_attr.decoding_error_;
-    Attribute::CopyValue(src_attr.decoded_value_.get(), &attr->decoded_value_);
+    attr->SetDecodedValue(src_attr.decoded_value_);
   }
   data_->attributes_.Append(attr);
 }
@@ -188,7 +191,7 @@ void HtmlElement::AddAttribute(const HtmlName& name,
                                   quote_style);
   attr->decoded_value_computed_ = true;
   attr->decoding_error_ = false;
-  Attribute::CopyValue(decoded_value, &attr->decoded_value_);
+  attr->SetDecodedValue(decoded_value);
   data_->attributes_.Append(attr);
 }
 
@@ -219,7 +222,8 @@ HtmlElement::Attribute::Attribute(const HtmlName& name,
     : name_(name),
       quote_style_(quote_style),
       decoding_error_(false),
-      decoded_value_computed_(false) {
+      decoded_value_computed_(false),
+      decoded_value_(NULL) {
   CopyValue(escaped_value, &escaped_value_);
 }
 
@@ -228,36 +232,43 @@ HtmlElement::Attribute::Attribute(const HtmlName& name,
 // ownership of value.
 void HtmlElement::Attribute::SetValue(const StringPiece& decoded_value) {
   GoogleString buf;
-  // Note that we execute the lines in this order in case value
-  // is a substring of value_.  This copies the value just prior
-  // to deallocation of the old value_.
-  const char* escaped_chars = escaped_value_.get();
-  DCHECK(decoded_value.data() + decoded_value.size() < escaped_chars ||
-         escaped_chars + strlen(escaped_chars) < decoded_value.data())
-      << "Setting unescaped value from substring of escaped value.";
+  // decoded_value may be a substring of our current value, which may in turn
+  // share escaped_value_'s buffer, so keep the old buffers alive until we are
+  // done copying.
+  scoped_array<char> old_escaped_value(escaped_value_.release());
+  scoped_array<char> old_decoded_value(decoded_value_storage_.release());
   CopyValue(HtmlKeywords::Escape(decoded_value, &buf), &escaped_value_);
-  CopyValue(decoded_value, &decoded_value_);
+  SetDecodedValue(decoded_value);
 }
 
 void HtmlElement::Attribute::SetEscapedValue(const StringPiece& escaped_value) {
-  GoogleString buf;
-  // Note that we execute the lines in this order in case value
-  // is a substring of value_.  This copies the value just prior
-  // to deallocation of the old value_.
-  const char* value_chars = decoded_value_.get();
-  if (value_chars != NULL) {
-    DCHECK(value_chars + strlen(value_chars) < escaped_value.data() ||
-           escaped_value.data() + escaped_value.size() < value_chars)
-        << "Setting escaped value from substring of unescaped value.";
-  }
-
-  decoded_value_.reset();
+  // escaped_value may be a substring of our current escaped or decoded
+  // value.  CopyValue copies the value before deallocating the old
+  // escaped_value_, and we keep the old decoded storage alive until the
+  // copy is done.
+  scoped_array<char> old_decoded_value(decoded_value_storage_.release());
+  decoded_value_ = NULL;
   decoding_error_ = false;
   decoded_value_computed_ = false;
 
   CopyValue(escaped_value, &escaped_value_);
 }
 
+void HtmlElement::Attribute::SetDecodedValue(
+    const StringPiece& decoded_value) const {
+  const char* escaped_chars = escaped_value_.get();
+  if ((decoded_value.data() != NULL) && (escaped_chars != NULL) &&
+      (decoded_value == escaped_chars)) {
+    // Most attribute values contain nothing that needs escaping, so rather
+    // than keeping a second copy we just point into escaped_value_.
+    decoded_value_storage_.reset();
+    decoded_value_ = escaped_chars;
+  } else {
+    CopyValue(decoded_value, &decoded_value_storage_);
+    decoded_value_ = decoded_value_storage_.get();
+  }
+}
+
 const char* HtmlElement::Attribute::quote_str() const {
   switch (quote_style_) {
     case NO_QUOTE:
@@ -274,7 +285,7 @@ void HtmlElement::Attribute::ComputeDecodedValue() const {
   GoogleString buf;
   StringPiece unescaped_value = HtmlKeywords::Unescape(
       escaped_value_.get(), &buf, &decoding_error_);
-  CopyValue(unescaped_value, &decoded_value_);
+  SetDecodedValue(unescaped_value);
   decoded_value_computed_ = true;
 }
 
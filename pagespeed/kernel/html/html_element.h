@@ -119,7 +119,7 @@ class HtmlElement : public HtmlNode {
       if (!decoded_value_computed_) {
         ComputeDecodedValue();
       }
-      return decoded_value_.get();
+      return decoded_value_;
     }
 
     void set_decoding_error(bool x) { decoding_error_ = x; }
@@ -171,6 +171,11 @@ class HtmlElement : public HtmlNode {
    private:
     void ComputeDecodedValue() const;
 
+    // Points decoded_value_ at a copy of decoded_value, or at escaped_value_
+    // if the two are identical.  Doesn't touch decoded_value_computed_ or
+    // decoding_error_.
+    void SetDecodedValue(const StringPiece& decoded_value) const;
+
     // This should only be called from AddAttribute
     Attribute(const HtmlName& name, const StringPiece& escaped_value,
               QuoteStyle quote_style);
@@ -209,7 +214,12 @@ class HtmlElement : public HtmlNode {
     // Note that we do not decode non-ASCII characters but we can
     // represent them in escaped_value_.  We can get 8-bit characters
     // into decoded_value_ via &#129; etc.
-    mutable scoped_array<char> decoded_value_;
+    //
+    // When decoding doesn't change anything, which is the common case,
+    // decoded_value_ shares escaped_value_'s buffer; otherwise it points to
+    // decoded_value_storage_.
+    mutable scoped_array<char> decoded_value_storage_;
+    mutable const char* decoded_value_;
 
     DISALLOW_COPY_AND_ASSIGN(Attribute);
   };
@@ -347,7 +357,8 @@ class HtmlElement : public HtmlNode {
 
  protected:
   virtual void SynthesizeEvents(const HtmlEventListIterator& iter,
-                                HtmlEventList* queue);
+                                HtmlEventList* queue,
+                                Arena<HtmlEvent>* arena);
 
   virtual HtmlEventListIterator begin() const { return data_->begin_; }
   virtual HtmlEventListIterator end() const { return data_->end_; }
@@ -19,6 +19,10 @@
 #ifndef PAGESPEED_KERNEL_HTML_HTML_EVENT_H_
 #define PAGESPEED_KERNEL_HTML_HTML_EVENT_H_
 
+#include <cstddef>
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/arena.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
@@ -51,6 +55,17 @@ class HtmlEvent {
 
   int line_number() const { return line_number_; }
 
+  // Events live in an arena owned by HtmlParse, which destroys them in bulk
+  // once no event of the flush window can be referenced any more.  Code that
+  // is done with an event just drops the pointer.
+  void* operator new(size_t size, Arena<HtmlEvent>* arena) {
+    return arena->Allocate(size);
+  }
+
+  void operator delete(void* ptr, Arena<HtmlEvent>* arena) {
+    LOG(FATAL) << "HtmlEvent must not be deleted directly.";
+  }
+
  private:
   int line_number_;
 
@@ -142,6 +142,17 @@ class HtmlFilter {
   // that is not page-critical.
   virtual ScriptUsage GetScriptUsage() const = 0;
 
+  // Returns true if this filter may share a single traversal of the flush
+  // window with adjacent fusable filters, each event being dispatched to all
+  // of them back-to-back (see HtmlParse::ApplyFilters).  A filter returning
+  // true promises that its event handlers only look at or mutate the node of
+  // the current event (e.g. its attributes or contents) and its ancestors;
+  // they must not insert, delete, move, replace or defer nodes, nor look
+  // ahead in the event stream.  Its Flush() must not mutate the DOM either.
+  // Filters that don't meet this contract act as barriers between fused
+  // groups, so the default is false.
+  virtual bool CanBeFused() const { return false; }
+
   // The name of this filter -- used for logging and debugging.
   virtual const char* Name() const = 0;
 
@@ -20,6 +20,7 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <map>
 #include <utility>
 
@@ -34,115 +35,6 @@ namespace net_instaweb {
 
 namespace {
 
-struct HtmlKeywordsSequence {
-  const char* sequence;
-  const unsigned char value[3];
-};
-
-// TODO(jmarantz): the multi-byte sequences are not working yet.
-HtmlKeywordsSequence kHtmlKeywordsSequences[] = {
-  { "AElig", {0xC6, 0x0} },
-  { "Aacute", {0xC1, 0x0} },
-  { "Acirc", {0xC2, 0x0} },
-  { "Agrave", {0xC0, 0x0} },
-  { "Aring", {0xC5, 0x0} },
-  { "Atilde", {0xC3, 0x0} },
-  { "Auml", {0xC4, 0x0} },
-  { "Ccedil", {0xC7, 0x0} },
-  { "ETH", {0xD0, 0x0} },
-  { "Eacute", {0xC9, 0x0} },
-  { "Ecirc", {0xCA, 0x0} },
-  { "Egrave", {0xC8, 0x0} },
-  { "Euml", {0xCB, 0x0} },
-  { "Iacute", {0xCD, 0x0} },
-  { "Icirc", {0xCE, 0x0} },
-  { "Igrave", {0xCC, 0x0} },
-  { "Iuml", {0xCF, 0x0} },
-  { "Ntilde", {0xD1, 0x0} },
-  { "Oacute", {0xD3, 0x0} },
-  { "Ocirc", {0xD4, 0x0} },
-  { "Ograve", {0xD2, 0x0} },
-  { "Oslash", {0xD8, 0x0} },
-  { "Otilde", {0xD5, 0x0} },
-  { "Ouml", {0xD6, 0x0} },
-  { "THORN", {0xDE, 0x0} },
-  { "Uacute", {0xDA, 0x0} },
-  { "Ucirc", {0xDB, 0x0} },
-  { "Ugrave", {0xD9, 0x0} },
-  { "Uuml", {0xDC, 0x0} },
-  { "Yacute", {0xDD, 0x0} },
-  { "aacute", {0xE1, 0x0} },
-  { "acirc", {0xE2, 0x0} },
-  { "acute", {0xB4, 0x0} },
-  { "aelig", {0xE6, 0x0} },
-  { "agrave", {0xE0, 0x0} },
-  { "amp", {0x26, 0x0} },
-  { "aring", {0xE5, 0x0} },
-  { "atilde", {0xE3, 0x0} },
-  { "auml", {0xE4, 0x0} },
-  { "brvbar", {0xA6, 0x0} },
-  { "ccedil", {0xE7, 0x0} },
-  { "cedil", {0xB8, 0x0} },
-  { "cent", {0xA2, 0x0} },
-  { "copy", {0xA9, 0x0} },
-  { "curren", {0xA4, 0x0} },
-  { "deg", {0xB0, 0x0} },
-  { "divide", {0xF7, 0x0} },
-  { "eacute", {0xE9, 0x0} },
-  { "ecirc", {0xEA, 0x0} },
-  { "egrave", {0xE8, 0x0} },
-  { "eth", {0xF0, 0x0} },
-  { "euml", {0xEB, 0x0} },
-  { "frac12", {0xBD, 0x0} },
-  { "frac14", {0xBC, 0x0} },
-  { "frac34", {0xBE, 0x0} },
-  { "gt", {0x3E, 0x0} },
-  { "iacute", {0xED, 0x0} },
-  { "icirc", {0xEE, 0x0} },
-  { "iexcl", {0xA1, 0x0} },
-  { "igrave", {0xEC, 0x0} },
-  { "iquest", {0xBF, 0x0} },
-  { "iuml", {0xEF, 0x0} },
-  { "laquo", {0xAB, 0x0} },
-  { "lt", {0x3C, 0x0} },
-  { "macr", {0xAF, 0x0} },
-  { "micro", {0xB5, 0x0} },
-  { "middot", {0xB7, 0x0} },
-  { "nbsp", {0xA0, 0x0} },
-  { "not", {0xAC, 0x0} },
-  { "ntilde", {0xF1, 0x0} },
-  { "oacute", {0xF3, 0x0} },
-  { "ocirc", {0xF4, 0x0} },
-  { "ograve", {0xF2, 0x0} },
-  { "ordf", {0xAA, 0x0} },
-  { "ordm", {0xBA, 0x0} },
-  { "oslash", {0xF8, 0x0} },
-  { "otilde", {0xF5, 0x0} },
-  { "ouml", {0xF6, 0x0} },
-  { "para", {0xB6, 0x0} },
-  { "plusmn", {0xB1, 0x0} },
-  { "pound", {0xA3, 0x0} },
-  { "quot", {0x22, 0x0} },
-  { "raquo", {0xBB, 0x0} },
-  { "reg", {0xAE, 0x0} },
-  { "sect", {0xA7, 0x0} },
-  { "shy", {0xAD, 0x0} },
-  { "sup1", {0xB9, 0x0} },
-  { "sup2", {0xB2, 0x0} },
-  { "sup3", {0xB3, 0x0} },
-  { "szlig", {0xDF, 0x0} },
-  { "thorn", {0xFE, 0x0} },
-  { "times", {0xD7, 0x0} },
-  { "uacute", {0xFA, 0x0} },
-  { "ucirc", {0xFB, 0x0} },
-  { "ugrave", {0xF9, 0x0} },
-  { "uml", {0xA8, 0x0} },
-  { "uuml", {0xFC, 0x0} },
-  { "yacute", {0xFD, 0x0} },
-  { "yen", {0xA5, 0x0} },
-  { "yuml", {0xFF, 0x0} }
-};
-
 // http://www.w3.org/TR/html4/sgml/entities.html contains a list of multi-byte
 // codes.  When we see any of these in an HTML attribute, we cannot currently
 // unescape it, because we have no general strategy for multi-byte encoding.
@@ -373,6 +265,35 @@ const char kParagraphTerminators[] =
 // TODO(jmarantz): handle & test Ruby containment.
 // const char kRubyElements[] = "ruby rt rp ";
 
+// Returns the offset of the first byte in data that is either '&' or has its
+// high bit set, or size if there is none.  Attribute values are mostly plain
+// ASCII without escapes, so we scan a machine word at a time and only drop
+// down to individual bytes for the word containing a hit, and for the tail.
+size_t FindAmpersandOrHighBit(const char* data, size_t size) {
+  static const uint64 kOnes = 0x0101010101010101ULL;
+  static const uint64 kHighBits = 0x8080808080808080ULL;
+  static const uint64 kAmpersands = kOnes * '&';
+  size_t i = 0;
+  for (; i + sizeof(uint64) <= size; i += sizeof(uint64)) {
+    uint64 word;
+    memcpy(&word, data + i, sizeof(word));
+    // A byte of word ^ kAmpersands is zero iff the byte is '&'.  The
+    // (x - kOnes) & ~x trick sets the high bit of some byte iff x has a
+    // zero byte; or-ing in word itself catches the 8-bit characters.
+    uint64 x = word ^ kAmpersands;
+    if ((((x - kOnes) & ~x) | word) & kHighBits) {
+      break;
+    }
+  }
+  for (; i < size; ++i) {
+    uint8 ch = static_cast<uint8>(data[i]);
+    if ((ch == '&') || (ch > 127)) {
+      return i;
+    }
+  }
+  return size;
+}
+
 }  // namespace
 
 HtmlKeywords* HtmlKeywords::singleton_ = NULL;
@@ -386,40 +307,53 @@ HtmlKeywords::HtmlKeywords() {
 
 void HtmlKeywords::InitEscapeSequences() {
   unescape_insensitive_map_.set_deleted_key("");
-  unescape_sensitive_map_.set_deleted_key("");
-  escape_map_.set_deleted_key("");
 
   StringSetInsensitive case_sensitive_symbols;
-  for (size_t i = 0; i < arraysize(kHtmlKeywordsSequences); ++i) {
-    // Put all symbols in the case-sensitive map
-    const HtmlKeywordsSequence& seq = kHtmlKeywordsSequences[i];
-    unescape_sensitive_map_[seq.sequence] =
-        reinterpret_cast<const char*>(seq.value);
-
+  for (EntityIterator iter; !iter.AtEnd(); iter.Next()) {
     // Don't populate the case-insensitive map for symbols that we've
     // already determined are case-sensitive.
-    if (case_sensitive_symbols.find(seq.sequence) ==
+    if (case_sensitive_symbols.find(iter.name()) ==
         case_sensitive_symbols.end()) {
       // If this symbol is already present in the insensitive map, then it
       // must be case-sensitive.  E.g. &AElig; and &aelig; are distinct.
       StringStringSparseHashMapInsensitive::iterator p =
-          unescape_insensitive_map_.find(seq.sequence);
+          unescape_insensitive_map_.find(iter.name());
       if (p != unescape_insensitive_map_.end()) {
         // As this symbol is case-sensitive, we must remove it from the
         // case-insensitive map.  This way we will report an error for
         // &Aelig;, rather than &AElig; or &aelig; unpredictably.
         unescape_insensitive_map_.erase(p);
-        case_sensitive_symbols.insert(seq.sequence);
+        case_sensitive_symbols.insert(iter.name());
       } else {
-        unescape_insensitive_map_[seq.sequence] =
-            reinterpret_cast<const char*>(seq.value);
+        unescape_insensitive_map_[iter.name()] = iter.value();
       }
+    }
+  }
 
-      // For now, we will only generate symbolic escaped-names for
-      // single-byte sequences
-      if (strlen(reinterpret_cast<const char*>(seq.value)) == 1) {
-        escape_map_[reinterpret_cast<const char*>(seq.value)] = seq.sequence;
-      }
+  // Precompute the escaped form of every byte.  According to
+  // http://www.htmlescape.net/htmlescape_tool.html, single-quote does not
+  // need to be escaped.  However, input HTML might have used single-quote to
+  // quote attribute values, in which case we better escape any single-quotes
+  // in the value.
+  //
+  // EscapeHelper does not know what quoting was used.
+  // TODO(jmarantz): in remove_quotes filter, switch between ' and " for
+  // quoting based on whatever is in the attr value.
+  for (int ch = 0; ch < 256; ++ch) {
+    if (!IsHtmlSpace(ch) &&
+        ((ch > 127) || (ch < 32) || (ch == '"') || (ch == '\'') ||
+         (ch == '&') || (ch == '<') || (ch == '>'))) {
+      escape_table_[ch] = StringPrintf("&#%02d;", ch);
+    }
+  }
+  // For now, we will only generate symbolic escaped-names for single-byte
+  // sequences, which is all the entity table holds.
+  for (EntityIterator iter; !iter.AtEnd(); iter.Next()) {
+    const char* value = iter.value();
+    DCHECK_EQ(1U, strlen(value)) << iter.name();
+    int ch = static_cast<unsigned char>(value[0]);
+    if (!escape_table_[ch].empty()) {
+      escape_table_[ch] = StrCat("&", iter.name(), ";");
     }
   }
 
@@ -463,17 +397,19 @@ StringPiece HtmlKeywords::UnescapeHelper(const StringPiece& escaped,
   }
   *decoding_error = true;
 
-  // It would be nice to short-circuit the loop below via a memchr
-  // looking for "&".  Unfortunately we must at least also scan for
-  // 8-bit characters, as we cannot unescape those in a manner that's
-  // bidirectionally safe.  Consider CanonicalAttributesTest.Spanish,
-  // where a non-utf8 multi-byte 8-bit character is present.  If we
-  // short-circuit looking for "&" we'll wind up escaping each piece
-  // of the multi-byte sequence individually and that will not reverse
-  // properly.
-  // if (memchr(escaped.data(), '&', escaped.size()) == NULL) {
-  //   return escaped;
-  // }
+  // We can't short-circuit the loop below via a memchr looking for "&".
+  // We must also scan for 8-bit characters, as we cannot unescape those
+  // in a manner that's bidirectionally safe.  Consider
+  // CanonicalAttributesTest.Spanish, where a non-utf8 multi-byte 8-bit
+  // character is present.  If we short-circuit looking for "&" we'll wind
+  // up escaping each piece of the multi-byte sequence individually and that
+  // will not reverse properly.  So we look for both at once, and skip
+  // everything before the first hit.
+  size_t start = FindAmpersandOrHighBit(escaped.data(), escaped.size());
+  if (start == escaped.size()) {
+    *decoding_error = false;
+    return escaped;
+  }
 
   buf->clear();
 
@@ -487,7 +423,7 @@ StringPiece HtmlKeywords::UnescapeHelper(const StringPiece& escaped,
   bool hex_mode = false;
   bool in_escape = false;
   bool found_ampersand = false;
-  for (size_t i = 0; i < escaped.size(); ++i) {
+  for (size_t i = start; i < escaped.size(); ++i) {
     uint8 ch = static_cast<uint8>(escaped[i]);
     if (!in_escape) {
       if (ch == '&') {
@@ -581,10 +517,9 @@ bool HtmlKeywords::TryUnescape(bool accumulate_numeric_code,
     // code-points) whereas some are case-insensitive (&quot; and
     // &QUOT; both work.  So do the case-sensitive lookup first, and
     // if that fails, do an insensitive lookup.
-    StringStringSparseHashMapSensitive::const_iterator p =
-        unescape_sensitive_map_.find(escape);
-    if (p != unescape_sensitive_map_.end()) {
-      *buf += p->second;
+    const char* value = LookupEntity(escape);
+    if (value != NULL) {
+      *buf += value;
     } else {
       // The sensitive lookup failed, but allow, for example, &QUOT; to work
       // in place of &quot;.  However, note that "yuml" is single
@@ -646,35 +581,17 @@ StringPiece HtmlKeywords::EscapeHelper(const StringPiece& unescaped,
   }
   buf->clear();
 
-  GoogleString char_to_escape;
+  const char* data = unescaped.data();
+  size_t run_start = 0;
   for (size_t i = 0; i < unescaped.size(); ++i) {
-    int ch = static_cast<unsigned char>(unescaped[i]);
-    // According to http://www.htmlescape.net/htmlescape_tool.html,
-    // single-quote does not need to be escaped.  However, input HTML
-    // might have used single-quote to quote attribute values, in
-    // which case we better escape any single-quotes in the value.
-    //
-    // This function, unfortunately, does not know what quoting was used.
-    // TODO(jmarantz): in remove_quotes filter, switch between ' and " for
-    // quoting based on whatever is in the attr value.
-    if (!IsHtmlSpace(ch) &&
-        ((ch > 127) || (ch < 32) || (ch == '"') || (ch == '\'') ||
-         (ch == '&') || (ch == '<') || (ch == '>'))) {
-      char_to_escape.clear();
-      char_to_escape += ch;
-      StringStringSparseHashMapSensitive::const_iterator p =
-          escape_map_.find(char_to_escape);
-      if (p == escape_map_.end()) {
-        StringAppendF(buf, "&#%02d;", static_cast<int>(ch));
-      } else {
-        *buf += '&';
-        *buf += p->second;
-        *buf += ';';
-      }
-    } else {
-      *buf += unescaped[i];
+    const GoogleString& escaped = escape_table_[static_cast<uint8>(data[i])];
+    if (!escaped.empty()) {
+      buf->append(data + run_start, i - run_start);
+      *buf += escaped;
+      run_start = i + 1;
     }
   }
+  buf->append(data + run_start, unescaped.size() - run_start);
   return StringPiece(*buf);
 }
 
@@ -128,6 +128,22 @@ class HtmlKeywords {
   typedef std::vector<KeywordPair> KeywordPairVec;
   typedef std::vector<HtmlName::Keyword> KeywordVec;
 
+  // Iterates over the case-sensitive entity table generated by gperf from
+  // html_entity.gperf.
+  class EntityIterator {
+   public:
+    EntityIterator() : index_(-1) { Next(); }
+    bool AtEnd() const;
+    void Next();
+    const char* name() const;
+    const char* value() const;
+
+   private:
+    int index_;
+
+    // Implicit copy and assign ok.  The members can be safely copied by bits.
+  };
+
   HtmlKeywords();
   const char* UnescapeAttributeValue();
   void InitEscapeSequences();
@@ -158,6 +174,11 @@ class HtmlKeywords {
                    bool was_terminated,
                    GoogleString* buf) const;
 
+  // Returns the single-byte value of the named character reference, doing a
+  // case-sensitive perfect-hash lookup, or NULL if the name is not known.
+  // Defined in html_entity.gperf.
+  static const char* LookupEntity(const StringPiece& name);
+
   // Encodes two keyword enums as a KeywordPair, represented as an int32.
   static KeywordPair MakeKeywordPair(HtmlName::Keyword k1,
                                      HtmlName::Keyword k2) {
@@ -197,13 +218,13 @@ class HtmlKeywords {
     GoogleString, const char*,
     CaseFoldStringHash,
     CaseFoldStringEqual> StringStringSparseHashMapInsensitive;
-  typedef sparse_hash_map<
-    GoogleString, const char*,
-    CasePreserveStringHash> StringStringSparseHashMapSensitive;
 
   StringStringSparseHashMapInsensitive unescape_insensitive_map_;
-  StringStringSparseHashMapSensitive unescape_sensitive_map_;
-  StringStringSparseHashMapSensitive escape_map_;
+
+  // The escaped form of every byte value, indexed by the unsigned byte.
+  // Bytes that are safe to leave as-is map to the empty string, so
+  // EscapeHelper can copy runs of them in one append.
+  GoogleString escape_table_[256];
 
   // Note that this is left immutable after being filled in, so it's OK
   // to take pointers into it.
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures attribute-value escaping and unescaping, which HtmlLexer and
+// HtmlWriterFilter do for every attribute on attribute-heavy pages.  The
+// values are a mix of plain URLs, query strings with &amp; and text with
+// named entities.
+//
+// Disclaimer: comparing runs over time and across different machines
+// can be misleading.  When contemplating an algorithm change, always do
+// interleaved runs with the old & new algorithm.
+
+#include "pagespeed/kernel/html/html_keywords.h"
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/benchmark.h"
+#include "pagespeed/kernel/base/string.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const char* kEscapedValues[] = {
+  "http://icds.portal.att.net/test/yModule/GreyDot.jpg",
+  "stylesheet",
+  "text/javascript",
+  "nav-item nav-item-selected",
+  "http://list.taobao.com/market/baby.htm?spm=1.151829.71436.25&amp;"
+  "cat=50032645&amp;sort=_bid&amp;spercent=95&amp;isprepay=1",
+  "Fish &amp; Chips &mdash; &quot;The Best&quot; in town",
+  "caf&eacute; cr&egrave;me br&ucirc;l&eacute;e",
+  "200",
+};
+
+const char* kUnescapedValues[] = {
+  "http://icds.portal.att.net/test/yModule/GreyDot.jpg",
+  "stylesheet",
+  "text/javascript",
+  "nav-item nav-item-selected",
+  "http://list.taobao.com/market/baby.htm?spm=1.151829.71436.25&"
+  "cat=50032645&sort=_bid&spercent=95&isprepay=1",
+  "Fish & Chips \"The Best\" in town",
+  "caf\xE9 cr\xE8me br\xFBl\xE9" "e",
+  "200",
+};
+
+static void BM_UnescapeAttributes(int iters) {
+  StopBenchmarkTiming();
+  HtmlKeywords::Init();
+  GoogleString buf;
+  bool decoding_error;
+  int64 bytes = 0;
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0, n = arraysize(kEscapedValues); j < n; ++j) {
+      StringPiece value(kEscapedValues[j]);
+      HtmlKeywords::Unescape(value, &buf, &decoding_error);
+      bytes += value.size();
+    }
+  }
+  SetBenchmarkBytesProcessed(bytes);
+}
+BENCHMARK(BM_UnescapeAttributes);
+
+static void BM_EscapeAttributes(int iters) {
+  StopBenchmarkTiming();
+  HtmlKeywords::Init();
+  GoogleString buf;
+  int64 bytes = 0;
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0, n = arraysize(kUnescapedValues); j < n; ++j) {
+      StringPiece value(kUnescapedValues[j]);
+      HtmlKeywords::Escape(value, &buf);
+      bytes += value.size();
+    }
+  }
+  SetBenchmarkBytesProcessed(bytes);
+}
+BENCHMARK(BM_EscapeAttributes);
+
+}  // namespace
+
+}  // namespace net_instaweb
@@ -271,6 +271,20 @@ TEST_F(HtmlKeywordsTest, ListView) {
   EXPECT_STREQ(kListView, Unescape(kListView, &buf));
 }
 
+TEST_F(HtmlKeywordsTest, EscapeAtWordBoundaries) {
+  // Unescape scans 8 bytes at a time for '&' and 8-bit characters, so put
+  // them at varying offsets within long values, including the tail.
+  GoogleString buf;
+  for (int i = 0; i < 20; ++i) {
+    GoogleString prefix(i, 'x');
+    Unchanged(prefix);
+    BiTest(StrCat(prefix, "&amp;y"), StrCat(prefix, "&y"));
+    BiTest(StrCat("y&quot;", prefix), StrCat("y\"", prefix));
+    EXPECT_TRUE(UnescapeEncodingError(StrCat(prefix, "\200", prefix)));
+    EXPECT_STREQ(StrCat(prefix, "&"), Unescape(StrCat(prefix, "&"), &buf));
+  }
+}
+
 TEST_F(HtmlKeywordsTest, DoubleAmpersand) {
   GoogleString buf;
   EXPECT_STREQ("&&", Unescape("&&", &buf));
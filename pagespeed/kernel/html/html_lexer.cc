@@ -23,6 +23,7 @@
 #include <cstdarg>
 #include <cstddef>  // for size_t
 #include <cstdio>
+#include <cstring>
 
 #include "base/logging.h"
 #include "strings/stringpiece_utils.h"
@@ -146,6 +147,26 @@ bool IsInSet(const HtmlName::Keyword* keywords, int num,
 #define IS_IN_SET(keywords, keyword) \
     IsInSet(keywords, arraysize(keywords), keyword)
 
+// Returns a pointer to the first occurrence of c in [text, end), or end if
+// there is none.  memchr is vectorized by the C library, so this is much
+// faster than a byte loop over long runs.
+inline const char* FindByte(const char* text, const char* end, char c) {
+  const void* found = memchr(text, c, end - text);
+  return (found == NULL) ? end : static_cast<const char*>(found);
+}
+
+// Bytes that EvalScriptTag needs to look at: '-' for "<!--", and anything
+// that can follow "</script" or "<script".
+inline bool IsScriptTagDelimiter(char c) {
+  switch (c) {
+    case '-': case '/': case '>':
+    case '\t': case '\n': case '\f': case '\r': case ' ':
+      return true;
+    default:
+      return false;
+  }
+}
+
 }  // namespace
 
 // TODO(jmarantz): support multi-byte encodings
@@ -639,7 +660,7 @@ void HtmlLexer::EvalScriptTag(char c) {
 // Emits raw uninterpreted characters.
 void HtmlLexer::EmitLiteral() {
   if (!literal_.empty()) {
-    html_parse_->AddEvent(new HtmlCharactersEvent(
+    html_parse_->AddEvent(new (html_parse_->event_arena()) HtmlCharactersEvent(
         html_parse_->NewCharactersNode(Parent(), literal_), tag_start_line_));
     literal_.clear();
   }
@@ -656,10 +677,12 @@ void HtmlLexer::EmitComment() {
       (token_.find("[endif]") != GoogleString::npos)) {
     HtmlIEDirectiveNode* node =
         html_parse_->NewIEDirectiveNode(Parent(), token_);
-    html_parse_->AddEvent(new HtmlIEDirectiveEvent(node, tag_start_line_));
+    html_parse_->AddEvent(new (html_parse_->event_arena())
+                          HtmlIEDirectiveEvent(node, tag_start_line_));
   } else {
     HtmlCommentNode* node = html_parse_->NewCommentNode(Parent(), token_);
-    html_parse_->AddEvent(new HtmlCommentEvent(node, tag_start_line_));
+    html_parse_->AddEvent(new (html_parse_->event_arena())
+                          HtmlCommentEvent(node, tag_start_line_));
   }
   token_.clear();
   state_ = START;
@@ -667,7 +690,7 @@ void HtmlLexer::EmitComment() {
 
 void HtmlLexer::EmitCdata() {
   literal_.clear();
-  html_parse_->AddEvent(new HtmlCdataEvent(
+  html_parse_->AddEvent(new (html_parse_->event_arena()) HtmlCdataEvent(
       html_parse_->NewCdataNode(Parent(), token_), tag_start_line_));
   token_.clear();
   state_ = START;
@@ -1015,7 +1038,7 @@ void HtmlLexer::EmitTagClose(HtmlElement::Style style) {
 
 void HtmlLexer::EmitDirective() {
   literal_.clear();
-  html_parse_->AddEvent(new HtmlDirectiveEvent(
+  html_parse_->AddEvent(new (html_parse_->event_arena()) HtmlDirectiveEvent(
       html_parse_->NewDirectiveNode(Parent(), token_), line_));
   // Update the doctype; note that if this is not a doctype directive, Parse()
   // will return false and not alter doctype_.
@@ -1037,6 +1060,10 @@ void HtmlLexer::Parse(const char* text, int size) {
       // Return without doing anything if skip_parsing_ is true.
       return;
     }
+    i += ConsumeRun(text + i, size - i);
+    if (i == size) {
+      break;
+    }
     char c = text[i];
     if (c == '\n') {
       ++line_;
@@ -1086,6 +1113,58 @@ void HtmlLexer::Parse(const char* text, int size) {
   }
 }
 
+int HtmlLexer::ConsumeRun(const char* text, int size) {
+  // Find the first byte that the Eval method for state_ would do anything
+  // with besides buffering it.  Everything before it can be buffered in one
+  // go.  States whose tokens are generally short aren't worth scanning.
+  const char* end = text + size;
+  GoogleString* token = NULL;
+  const char* stop;
+  switch (state_) {
+    case START:
+      stop = FindByte(text, end, '<');
+      break;
+    case COMMENT_BODY:
+      stop = FindByte(text, end, '-');
+      token = &token_;
+      break;
+    case CDATA_BODY:
+      stop = FindByte(text, end, ']');
+      token = &token_;
+      break;
+    case DIRECTIVE:
+      stop = FindByte(text, end, '>');
+      token = &token_;
+      break;
+    case TAG_ATTR_VALDQ:
+      stop = FindByte(text, end, '"');
+      token = &attr_value_;
+      break;
+    case TAG_ATTR_VALSQ:
+      stop = FindByte(text, end, '\'');
+      token = &attr_value_;
+      break;
+    case LITERAL_TAG:
+    case BOGUS_COMMENT:
+      stop = FindByte(text, end, '>');
+      break;
+    case SCRIPT_TAG:
+      stop = std::find_if(text, end, IsScriptTagDelimiter);
+      break;
+    default:
+      return 0;
+  }
+  int run = stop - text;
+  if (run != 0) {
+    line_ += std::count(text, stop, '\n');
+    literal_.append(text, run);
+    if (token != NULL) {
+      token->append(text, run);
+    }
+  }
+  return run;
+}
+
 // The HTML-input sloppiness in these three methods is applied independent
 // of whether we think the document is XHTML, either via doctype or
 // mime-type.  The internet is full of lies.  See Issue 252:
@@ -129,6 +129,13 @@ class HtmlLexer {
   inline void EvalDirective(char c);
   inline void EvalBogusComment(char c);
 
+  // Buffers the longest prefix of text, up to size bytes, that cannot take
+  // the lexer out of state_, exactly as the per-byte Eval methods would have,
+  // and returns its length.  This lets Parse skip through long runs of text,
+  // comments, scripts and attribute values without dispatching on every
+  // byte.
+  int ConsumeRun(const char* text, int size);
+
   // Makes an element based on token_, which will be parsed as the tag
   // name.
   void MakeElement();
@@ -29,7 +29,9 @@ HtmlLeafNode::HtmlLeafNode(HtmlElement* parent,
                            const HtmlEventListIterator& iter,
                            const StringPiece& contents)
     : HtmlNode(parent),
-      data_(new Data(iter, contents)) {
+      contents_(contents.data(), contents.size()),
+      is_live_(true),
+      iter_(iter) {
 }
 
 HtmlLeafNode::~HtmlLeafNode() {}
@@ -40,54 +42,62 @@ GoogleString HtmlLeafNode::ToString() const {
 }
 
 void HtmlLeafNode::MarkAsDead(const HtmlEventListIterator& end) {
-  if (data_.get() != NULL) {
-    set_iter(end);
-    data_->is_live_ = false;
-  }
+  set_iter(end);
+  is_live_ = false;
+}
+
+void HtmlLeafNode::FreeData() {
+  is_live_ = false;
+  GoogleString().swap(contents_);
 }
 
 HtmlCdataNode::~HtmlCdataNode() {}
 
 void HtmlCdataNode::SynthesizeEvents(const HtmlEventListIterator& iter,
-                                     HtmlEventList* queue) {
+                                     HtmlEventList* queue,
+                                     Arena<HtmlEvent>* arena) {
   // We use -1 as a bogus line number, since the event is synthetic.
-  HtmlCdataEvent* event = new HtmlCdataEvent(this, -1);
+  HtmlCdataEvent* event = new (arena) HtmlCdataEvent(this, -1);
   set_iter(queue->insert(iter, event));
 }
 
 HtmlCharactersNode::~HtmlCharactersNode() {}
 
 void HtmlCharactersNode::SynthesizeEvents(const HtmlEventListIterator& iter,
-                                          HtmlEventList* queue) {
+                                          HtmlEventList* queue,
+                                          Arena<HtmlEvent>* arena) {
   // We use -1 as a bogus line number, since the event is synthetic.
-  HtmlCharactersEvent* event = new HtmlCharactersEvent(this, -1);
+  HtmlCharactersEvent* event = new (arena) HtmlCharactersEvent(this, -1);
   set_iter(queue->insert(iter, event));
 }
 
 HtmlCommentNode::~HtmlCommentNode() {}
 
 void HtmlCommentNode::SynthesizeEvents(const HtmlEventListIterator& iter,
-                                       HtmlEventList* queue) {
+                                       HtmlEventList* queue,
+                                       Arena<HtmlEvent>* arena) {
   // We use -1 as a bogus line number, since the event is synthetic.
-  HtmlCommentEvent* event = new HtmlCommentEvent(this, -1);
+  HtmlCommentEvent* event = new (arena) HtmlCommentEvent(this, -1);
   set_iter(queue->insert(iter, event));
 }
 
 HtmlIEDirectiveNode::~HtmlIEDirectiveNode() {}
 
 void HtmlIEDirectiveNode::SynthesizeEvents(const HtmlEventListIterator& iter,
-                                         HtmlEventList* queue) {
+                                         HtmlEventList* queue,
+                                         Arena<HtmlEvent>* arena) {
   // We use -1 as a bogus line number, since the event is synthetic.
-  HtmlIEDirectiveEvent* event = new HtmlIEDirectiveEvent(this, -1);
+  HtmlIEDirectiveEvent* event = new (arena) HtmlIEDirectiveEvent(this, -1);
   set_iter(queue->insert(iter, event));
 }
 
 HtmlDirectiveNode::~HtmlDirectiveNode() {}
 
 void HtmlDirectiveNode::SynthesizeEvents(const HtmlEventListIterator& iter,
-                                         HtmlEventList* queue) {
+                                         HtmlEventList* queue,
+                                         Arena<HtmlEvent>* arena) {
   // We use -1 as a bogus line number, since the event is synthetic.
-  HtmlDirectiveEvent* event = new HtmlDirectiveEvent(this, -1);
+  HtmlDirectiveEvent* event = new (arena) HtmlDirectiveEvent(this, -1);
   set_iter(queue->insert(iter, event));
 }
 
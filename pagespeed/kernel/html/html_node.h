@@ -73,9 +73,11 @@ class HtmlNode {
   // Create new event object(s) representing this node, and insert them into
   // the queue just before the given iterator; also, update this node object as
   // necessary so that begin() and end() will return iterators pointing to
-  // the new event(s).  The line number for each event should probably be -1.
+  // the new event(s).  The events are allocated in arena.  The line number
+  // for each event should probably be -1.
   virtual void SynthesizeEvents(const HtmlEventListIterator& iter,
-                                HtmlEventList* queue) = 0;
+                                HtmlEventList* queue,
+                                Arena<HtmlEvent>* arena) = 0;
 
   // Return an iterator pointing to the first event associated with this node.
   virtual HtmlEventListIterator begin() const = 0;
@@ -103,22 +105,24 @@ class HtmlNode {
 class HtmlLeafNode : public HtmlNode {
  public:
   virtual ~HtmlLeafNode();
-  virtual bool live() const { return (data_.get() != NULL) && data_->is_live_; }
+  virtual bool live() const { return is_live_; }
   virtual void MarkAsDead(const HtmlEventListIterator& end);
   virtual GoogleString ToString() const;
 
-  const GoogleString& contents() const { return data_->contents_; }
+  const GoogleString& contents() const { return contents_; }
   virtual HtmlEventListIterator begin() const {
-    return data_->iter_;
+    return iter_;
   }
   virtual HtmlEventListIterator end() const {
-    return data_->iter_;
+    return iter_;
   }
   void set_iter(const HtmlEventListIterator& iter) {
-    data_->iter_ = iter;
+    iter_ = iter;
   }
 
-  void FreeData() { data_.reset(NULL); }
+  // Releases the contents of a node that has been flushed.  The node itself
+  // lives in the HtmlParse arena until the end of the document.
+  void FreeData();
 
  protected:
   HtmlLeafNode(HtmlElement* parent, const HtmlEventListIterator& iter,
@@ -126,21 +130,15 @@ class HtmlLeafNode : public HtmlNode {
 
   // Write-access to the contents is protected by default, and made
   // accessible by subclasses that need to expose this method.
-  GoogleString* mutable_contents() { return &data_->contents_; }
+  GoogleString* mutable_contents() { return &contents_; }
 
  private:
-  struct Data {
-    Data(const HtmlEventListIterator& iter, const StringPiece& contents)
-        : contents_(contents.data(), contents.size()),
-          is_live_(true),
-          iter_(iter) {
-    }
-    GoogleString contents_;
-    bool is_live_;
-    HtmlEventListIterator iter_;
-  };
-
-  scoped_ptr<Data> data_;
+  // These are held directly in the arena-allocated node, rather than in a
+  // separately allocated struct, so that a leaf costs one heap allocation
+  // (for the contents, if they are long) rather than two.
+  GoogleString contents_;
+  bool is_live_;
+  HtmlEventListIterator iter_;
 };
 
 // Leaf node representing a CDATA section
@@ -151,7 +149,8 @@ class HtmlCdataNode : public HtmlLeafNode {
 
  protected:
   virtual void SynthesizeEvents(const HtmlEventListIterator& iter,
-                                HtmlEventList* queue);
+                                HtmlEventList* queue,
+                                Arena<HtmlEvent>* arena);
 
  private:
   HtmlCdataNode(HtmlElement* parent,
@@ -177,7 +176,8 @@ class HtmlCharactersNode : public HtmlLeafNode {
 
  protected:
   virtual void SynthesizeEvents(const HtmlEventListIterator& iter,
-                                HtmlEventList* queue);
+                                HtmlEventList* queue,
+                                Arena<HtmlEvent>* arena);
 
  private:
   HtmlCharactersNode(HtmlElement* parent,
@@ -197,7 +197,8 @@ class HtmlCommentNode : public HtmlLeafNode {
 
  protected:
   virtual void SynthesizeEvents(const HtmlEventListIterator& iter,
-                                HtmlEventList* queue);
+                                HtmlEventList* queue,
+                                Arena<HtmlEvent>* arena);
 
  private:
   HtmlCommentNode(HtmlElement* parent,
@@ -217,7 +218,8 @@ class HtmlIEDirectiveNode : public HtmlLeafNode {
 
  protected:
   virtual void SynthesizeEvents(const HtmlEventListIterator& iter,
-                                HtmlEventList* queue);
+                                HtmlEventList* queue,
+                                Arena<HtmlEvent>* arena);
 
  private:
   HtmlIEDirectiveNode(HtmlElement* parent,
@@ -237,7 +239,8 @@ class HtmlDirectiveNode : public HtmlLeafNode {
 
  protected:
   virtual void SynthesizeEvents(const HtmlEventListIterator& iter,
-                                HtmlEventList* queue);
+                                HtmlEventList* queue,
+                                Arena<HtmlEvent>* arena);
 
  private:
   HtmlDirectiveNode(HtmlElement* parent,
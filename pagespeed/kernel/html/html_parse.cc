@@ -44,6 +44,20 @@
 
 namespace net_instaweb {
 
+namespace {
+
+// Names that are not keywords, or are keywords spelled in non-canonical case,
+// are interned in string_table_.  Custom elements and data-* attributes tend
+// to recur across the documents a parser is recycled for, so the table is
+// kept between documents until it grows beyond this many bytes.
+const size_t kMaxRetainedSymbolBytes = 16 * 1024;
+
+// The number of distinct interned names we size string_table_ for, so that a
+// typical page does not rehash it.
+const size_t kExpectedSymbols = 256;
+
+}  // namespace
+
 HtmlParse::HtmlParse(MessageHandler* message_handler)
     : lexer_(NULL),  // Can't initialize here, since "this" should not be used
                      // in the initializer list (it generates an error in
@@ -57,21 +71,28 @@ HtmlParse::HtmlParse(MessageHandler* message_handler)
       need_sanity_check_(false),
       coalesce_characters_(true),
       need_coalesce_characters_(false),
+      fuse_filters_(true),
       url_valid_(false),
       log_rewrite_timing_(false),
       running_filters_(false),
       buffer_events_(false),
+      lexing_ahead_(false),
+      chunks_allocated_at_start_(0),
+      num_elements_(0),
       parse_start_time_us_(0),
+      delayed_start_literal_(NULL),
       timer_(NULL),
       current_filter_(NULL),
       dynamically_disabled_filter_list_(NULL) {
   lexer_ = new HtmlLexer(this);
   HtmlKeywords::Init();
+  string_table_.Reserve(kExpectedSymbols);
 }
 
 HtmlParse::~HtmlParse() {
   delete lexer_;
-  STLDeleteElements(&queue_);
+  queue_.clear();
+  lookahead_queue_.clear();
   STLDeleteElements(&event_listeners_);
   ClearElements();
 }
@@ -81,7 +102,7 @@ void HtmlParse::AddFilter(HtmlFilter* html_filter) {
 }
 
 HtmlEventListIterator HtmlParse::Last() {
-  HtmlEventListIterator p = queue_.end();
+  HtmlEventListIterator p = LexerQueue()->end();
   --p;
   return p;
 }
@@ -109,9 +130,11 @@ void HtmlParse::CheckParentFromAddEvent(HtmlEvent* event) {
 
 void HtmlParse::AddEvent(HtmlEvent* event) {
   CheckParentFromAddEvent(event);
-  queue_.push_back(event);
-  need_sanity_check_ = true;
-  need_coalesce_characters_ = true;
+  LexerQueue()->push_back(event);
+  if (!lexing_ahead_) {
+    need_sanity_check_ = true;
+    need_coalesce_characters_ = true;
+  }
 
   // If this is a leaf-node event, we need to set the iterator of the
   // corresponding leaf node to point to this event's position in the queue.
@@ -222,6 +245,7 @@ HtmlElement* HtmlParse::NewElement(HtmlElement* parent, const HtmlName& name) {
 #endif
   HtmlElement* element =
       new (&nodes_) HtmlElement(parent, name, queue_.end(), queue_.end());
+  ++num_elements_;
   if (IsOptionallyClosedTag(name.keyword())) {
     // When we programmatically insert HTML nodes we should default to
     // including an explicit close-tag if they are optionally closed
@@ -233,7 +257,7 @@ HtmlElement* HtmlParse::NewElement(HtmlElement* parent, const HtmlName& name) {
 
 void HtmlParse::AddElement(HtmlElement* element, int line_number) {
   HtmlStartElementEvent* event =
-      new HtmlStartElementEvent(element, line_number);
+      new (event_arena()) HtmlStartElementEvent(element, line_number);
   AddEvent(event);
   element->set_begin(Last());
   element->set_begin_line_number(line_number);
@@ -241,7 +265,8 @@ void HtmlParse::AddElement(HtmlElement* element, int line_number) {
 
 bool HtmlParse::StartParseId(const StringPiece& url, const StringPiece& id,
                              const ContentType& content_type) {
-  delayed_start_literal_.reset();
+  DCHECK(!lexing_ahead_);
+  delayed_start_literal_ = NULL;
   determine_filter_behavior_called_ = false;
   buffer_events_ = false;
 
@@ -269,7 +294,7 @@ bool HtmlParse::StartParseId(const StringPiece& url, const StringPiece& id,
     message_handler_->Message(kWarning, "HtmlParse: Invalid document url %s",
                               url_.c_str());
   } else {
-    string_table_.Clear();
+    TrimSymbolTable();
     google_url_.Swap(&gurl);
     line_number_ = 1;
     id.CopyToString(&id_);
@@ -277,7 +302,11 @@ bool HtmlParse::StartParseId(const StringPiece& url, const StringPiece& id,
       parse_start_time_us_ = timer_->NowUs();
       InfoHere("HtmlParse::StartParse");
     }
-    AddEvent(new HtmlStartDocumentEvent(line_number_));
+    chunks_allocated_at_start_ = nodes_.num_chunks_allocated() +
+        events_.num_chunks_allocated() +
+        lookahead_events_.num_chunks_allocated();
+    num_elements_ = 0;
+    AddEvent(new (&events_) HtmlStartDocumentEvent(line_number_));
     lexer_->StartParse(id, content_type);
   }
   return url_valid_;
@@ -305,10 +334,20 @@ void HtmlParse::FinishParse() {
 void HtmlParse::BeginFinishParse() {
   DCHECK(url_valid_) << "Invalid to call FinishParse on invalid input";
   if (url_valid_) {
+    DCHECK(!lexing_ahead_);
     lexer_->FinishParse();
-    DCHECK(delayed_start_literal_.get() == NULL);
-    delayed_start_literal_.reset();
-    AddEvent(new HtmlEndDocumentEvent(line_number_));
+    DCHECK(delayed_start_literal_ == NULL);
+    delayed_start_literal_ = NULL;
+    AddEvent(new (&events_) HtmlEndDocumentEvent(line_number_));
+  }
+}
+
+void HtmlParse::BeginFinishParseWithoutFilters() {
+  DCHECK(url_valid_) << "Invalid to call FinishParse on invalid input";
+  if (url_valid_) {
+    DCHECK(!lexing_ahead_);
+    lexer_->FinishParse();
+    ClearEvents();
   }
 }
 
@@ -320,7 +359,16 @@ void HtmlParse::EndFinishParse() {
 }
 
 void HtmlParse::Clear() {
-  string_table_.Clear();
+  TrimSymbolTable();
+}
+
+void HtmlParse::TrimSymbolTable() {
+  // No node from a previous document is live at this point, so none of its
+  // names refer into the table, and it is safe either to keep or to drop it.
+  if (string_table_.string_bytes_allocated() > kMaxRetainedSymbolBytes) {
+    string_table_.Clear();
+    string_table_.Reserve(kExpectedSymbols);
+  }
 }
 
 void HtmlParse::ParseTextInternal(const char* text, int size) {
@@ -417,6 +465,75 @@ void HtmlParse::ApplyFilter(HtmlFilter* filter) {
   current_filter_ = NULL;
 }
 
+void HtmlParse::ApplyFilters(const FilterList& filters) {
+  FilterVector fused;
+  for (FilterList::const_iterator i = filters.begin(); i != filters.end();
+       ++i) {
+    HtmlFilter* filter = *i;
+    if (!filter->is_enabled()) {
+      continue;
+    }
+
+    // A filter with an outstanding deferral needs ApplyFilter to splice the
+    // deferred events out of the queue before it runs, so it can't be fused.
+    if (fuse_filters_ && filter->CanBeFused() &&
+        (open_deferred_nodes_.find(filter) == open_deferred_nodes_.end())) {
+      fused.push_back(filter);
+      continue;
+    }
+
+    // Everything else is a barrier: all the fused filters ahead of it must
+    // finish with the flush window before it may mutate the queue.
+    ApplyFusedFilters(fused);
+    fused.clear();
+    ApplyFilter(filter);
+  }
+  ApplyFusedFilters(fused);
+}
+
+void HtmlParse::ApplyFusedFilters(const FilterVector& filters) {
+  if (filters.size() <= 1) {
+    if (!filters.empty()) {
+      ApplyFilter(filters[0]);
+    }
+    return;
+  }
+
+  DCHECK(current_filter_ == NULL);
+  if (coalesce_characters_ && need_coalesce_characters_) {
+    CoalesceAdjacentCharactersNodes();
+    DelayLiteralTag();
+    need_coalesce_characters_ = false;
+  }
+
+  ShowProgress(StrCat("ApplyFusedFilters:", filters[0]->Name(), "...",
+                      filters.back()->Name()).c_str());
+  int num_filters = filters.size();
+  size_t queue_size = queue_.size();
+  for (current_ = queue_.begin(); current_ != queue_.end(); ++current_) {
+    HtmlEvent* event = *current_;
+    line_number_ = event->line_number();
+    for (int i = 0; i < num_filters; ++i) {
+      current_filter_ = filters[i];
+      event->Run(current_filter_);
+    }
+    DCHECK(!skip_increment_) << "fused filter " << current_filter_->Name()
+                             << " changed the structure of the DOM";
+  }
+  DCHECK_EQ(queue_size, queue_.size());
+
+  for (int i = 0; i < num_filters; ++i) {
+    current_filter_ = filters[i];
+    current_filter_->Flush();
+  }
+
+  if (need_sanity_check_) {
+    SanityCheck();
+    need_sanity_check_ = false;
+  }
+  current_filter_ = NULL;
+}
+
 void HtmlParse::NextEvent() {
   if (skip_increment_) {
     skip_increment_ = false;
@@ -434,7 +551,6 @@ void HtmlParse::CoalesceAdjacentCharactersNodes() {
     if ((node != NULL) && (prev != NULL)) {
       prev->Append(node->contents());
       current_ = queue_.erase(current_);  // returns element after erased
-      delete event;
       node->MarkAsDead(queue_.end());
       need_sanity_check_ = true;
     } else {
@@ -457,7 +573,7 @@ void HtmlParse::DelayLiteralTag() {
     // tag.  We are not going to process this within the current
     // flush window, but instead wait till the EndElement arrives
     // from the lexer.
-    delayed_start_literal_.reset(event);
+    delayed_start_literal_ = event;
     queue_.erase(current_);
   }
   current_ = queue_.end();
@@ -562,13 +678,10 @@ void HtmlParse::Flush() {
   if (url_valid_ && !buffer_events_) {
     ShowProgress("Flush");
 
-    for (FilterList::iterator i = filters_.begin(); i != filters_.end(); ++i) {
-      HtmlFilter* filter = *i;
-      if (filter->is_enabled()) {
-        ApplyFilter(filter);
-      }
-    }
+    ApplyFilters(filters_);
     ClearEvents();
+  } else if (lexing_ahead_) {
+    FinishLexAhead();
   }
 }
 
@@ -596,11 +709,65 @@ void HtmlParse::ClearEvents() {
         }
       }
     }
-    delete event;
   }
   queue_.clear();
   need_sanity_check_ = false;
   need_coalesce_characters_ = false;
+
+  // If no event outlives this flush window, we can reclaim them all now
+  // rather than at the end of the document.  Anything lexed ahead is still
+  // live, so it moves into the emptied arena, to be reclaimed with the next
+  // window.
+  if (deferred_nodes_.empty() && (delayed_start_literal_ == NULL)) {
+    events_.DestroyObjects();
+    events_.Swap(&lookahead_events_);
+  }
+  if (lexing_ahead_) {
+    FinishLexAhead();
+  }
+}
+
+void HtmlParse::StartLexAhead() {
+  DCHECK(!running_filters_);
+  DCHECK(lookahead_queue_.empty());
+
+  // A literal tag left open at the end of the window must be held back
+  // before the lexer can close it in the look-ahead queue, even if no
+  // filter has run on this window yet.
+  if (coalesce_characters_ && need_coalesce_characters_) {
+    CoalesceAdjacentCharactersNodes();
+    DelayLiteralTag();
+    need_coalesce_characters_ = false;
+  }
+  lexing_ahead_ = true;
+}
+
+void HtmlParse::FinishLexAhead() {
+  lexing_ahead_ = false;
+  if (lookahead_queue_.empty()) {
+    return;
+  }
+
+  // std::list::splice keeps the iterators held by nodes valid.
+  queue_.splice(queue_.end(), lookahead_queue_);
+  for (int i = 0, n = lookahead_closes_.size(); i < n; ++i) {
+    HtmlEventListIterator end = lookahead_closes_[i].first;
+    HtmlElement* element = (*end)->GetElementIfEndEvent();
+    DCHECK(element != NULL);
+    if (element->style() != HtmlElement::INVISIBLE) {
+      element->set_style(lookahead_closes_[i].second);
+    }
+    element->set_end(end);
+  }
+  lookahead_closes_.clear();
+  need_sanity_check_ = true;
+  need_coalesce_characters_ = true;
+}
+
+int64 HtmlParse::num_allocations() const {
+  return (nodes_.num_chunks_allocated() + events_.num_chunks_allocated() +
+          lookahead_events_.num_chunks_allocated() -
+          chunks_allocated_at_start_) + num_elements_;
 }
 
 size_t HtmlParse::GetEventQueueSize() {
@@ -678,7 +845,7 @@ void HtmlParse::InsertNodeBeforeEvent(const HtmlEventListIterator& event,
                                       HtmlNode* new_node) {
   need_sanity_check_ = true;
   need_coalesce_characters_ = true;
-  new_node->SynthesizeEvents(event, &queue_);
+  new_node->SynthesizeEvents(event, &queue_, &events_);
 }
 
 void HtmlParse::InsertNodeAfterEvent(const HtmlEventListIterator& event,
@@ -894,8 +1061,6 @@ bool HtmlParse::DeleteNode(HtmlNode* node) {
         message_handler_->Check(nested_node->live(), "!nested_node->live()");
         nested_node->MarkAsDead(queue_.end());
       }
-
-      delete event;
     }
 
     // Our iteration should have covered the passed-in element as well.
@@ -1025,6 +1190,13 @@ bool HtmlParse::IsInEventWindow(const HtmlEventListIterator& iter) const {
 void HtmlParse::ClearElements() {
   ClearDeferredNodes();
   nodes_.DestroyObjects();
+  if (queue_.empty() && lookahead_queue_.empty()) {
+    delayed_start_literal_ = NULL;
+    lexing_ahead_ = false;
+    lookahead_closes_.clear();
+    events_.DestroyObjects();
+    lookahead_events_.DestroyObjects();
+  }
   DCHECK(!running_filters_);
 }
 
@@ -1150,11 +1322,20 @@ void HtmlParse::FatalErrorHere(const char* msg, ...) {
 
 void HtmlParse::CloseElement(
     HtmlElement* element, HtmlElement::Style style, int line_number) {
-  if (delayed_start_literal_.get() != NULL) {
+  if (delayed_start_literal_ != NULL) {
     HtmlElement* element = delayed_start_literal_->GetElementIfStartEvent();
     DCHECK(element != NULL);
+    if (lexing_ahead_) {
+      // The held-back start event belongs to events_, which the next Flush
+      // reclaims once no literal tag is delayed, but it is about to join the
+      // look-ahead queue that outlives that Flush.  Give it a copy from the
+      // look-ahead arena.
+      delayed_start_literal_ = new (&lookahead_events_) HtmlStartElementEvent(
+          element, delayed_start_literal_->line_number());
+    }
     bool insert_at_begin = true;
-    if (!queue_.empty()) {
+    HtmlEventList* queue = LexerQueue();
+    if (!queue->empty()) {
       // We have been holding back "<script>" until the lexer tells us the
       // tag is closed here.  But we want to insert the <script> tag *before*
       // the previous characters block, if any.
@@ -1164,15 +1345,15 @@ void HtmlParse::CloseElement(
       // in the debug filter, we must put the <script> after that, so
       // walk back from current, past the Character block, if any.  We
       // don't expect anything other than a Character block here.
-      HtmlEventListIterator p = queue_.end();
+      HtmlEventListIterator p = queue->end();
       --p;
       HtmlEvent* event = *p;
       HtmlCharactersNode* node = event->GetCharactersNode();
       if (node != NULL) {
-        if (p != queue_.begin()) {
+        if (p != queue->begin()) {
           --p;
-          element->set_begin(
-              queue_.insert(p, delayed_start_literal_.release()));
+          element->set_begin(queue->insert(p, delayed_start_literal_));
+          delayed_start_literal_ = NULL;
           insert_at_begin = false;
         }
       } else {
@@ -1189,19 +1370,28 @@ void HtmlParse::CloseElement(
       }
     }
     if (insert_at_begin) {
-      queue_.push_front(delayed_start_literal_.release());
-      element->set_begin(queue_.begin());
+      queue->push_front(delayed_start_literal_);
+      delayed_start_literal_ = NULL;
+      element->set_begin(queue->begin());
     }
-    DCHECK(delayed_start_literal_.get() == NULL);
+    DCHECK(delayed_start_literal_ == NULL);
   }
 
   HtmlEndElementEvent* end_event =
-      new HtmlEndElementEvent(element, line_number);
-  if (element->style() != HtmlElement::INVISIBLE) {
-    element->set_style(style);
+      new (event_arena()) HtmlEndElementEvent(element, line_number);
+  if (lexing_ahead_) {
+    // The element may have started in the current flush window, and filters
+    // working on that window must not see it as closed (and hence
+    // rewritable) until its end event has joined the queue.
+    AddEvent(end_event);
+    lookahead_closes_.push_back(std::make_pair(Last(), style));
+  } else {
+    if (element->style() != HtmlElement::INVISIBLE) {
+      element->set_style(style);
+    }
+    AddEvent(end_event);
+    element->set_end(Last());
   }
-  AddEvent(end_event);
-  element->set_end(Last());
   element->set_end_line_number(line_number);
 }
 
@@ -1288,8 +1478,8 @@ bool HtmlParse::InsertComment(StringPiece unescaped) {
     if (parent != NULL && IsLiteralTag(parent->keyword())) {
       return false;
     }
-    AddEvent(
-        new HtmlCommentEvent(NewCommentNode(lexer_->Parent(), escaped), 0));
+    AddEvent(new (event_arena()) HtmlCommentEvent(
+        NewCommentNode(lexer_->Parent(), escaped), 0));
   }
   return true;
 }
@@ -1401,8 +1591,7 @@ void HtmlParse::ClearDeferredNodes() {
       message_handler_->Message(
           kWarning, "Removed node %s never replaced", node->ToString().c_str());
     }
-    STLDeleteElements(events);
-    delete events;
+    delete events;  // The events themselves are owned by events_.
   }
   deferred_nodes_.clear();
   deferred_deleted_nodes_.clear();
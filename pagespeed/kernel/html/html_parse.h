@@ -76,6 +76,10 @@ typedef std::set <const HtmlEvent*> ConstHtmlEventSet;
 //     foreach event in flush-window
 //       apply filter to event
 //
+// Adjacent filters that promise not to restructure the DOM (see
+// HtmlFilter::CanBeFused) are instead run together, each event being applied
+// to all of them before moving on to the next.
+//
 // Filters may mutate the event streams as they are being processed,
 // and these mutations be seen by downstream filters.  The filters can
 // mutate any event that has not been flushed.  Supported mutations include:
@@ -439,6 +443,9 @@ class HtmlParse {
   // Run a filter on the current queue of parse nodes.
   void ApplyFilter(HtmlFilter* filter);
 
+  // Controls whether ApplyFilters may fuse filters.  Defaults to true.
+  void set_fuse_filters(bool x) { fuse_filters_ = x; }
+
   // Provide timer to helping to report timing of each filter.  You must also
   // set_log_rewrite_timing(true) to turn on this reporting.
   void set_timer(Timer* timer) { timer_ = timer; }
@@ -465,6 +472,23 @@ class HtmlParse {
   // Returns whether we have exceeded the size limit.
   bool size_limit_exceeded() const;
 
+  // Returns the number of heap allocations made for the nodes and events of
+  // the current document so far: one per arena chunk holding them, plus one
+  // for the attribute data of each element.
+  int64 num_allocations() const;
+
+  // Experimental: lets the lexer run ahead of the filters.  Call this once
+  // the filters are done with the current flush window but before it is
+  // flushed, e.g. while waiting for asynchronous rewrites.  Until the next
+  // Flush, text passed to ParseText is lexed into a look-ahead queue that the
+  // filters still working on the current window never see; elements closed
+  // there are not marked closed until then either.  Flush then makes the
+  // look-ahead queue the start of the next flush window.  The lexer still
+  // builds nodes in the shared DOM, so callers that edit the DOM from another
+  // thread meanwhile must serialize that with ParseText.
+  void StartLexAhead();
+  bool lexing_ahead() const { return lexing_ahead_; }
+
   // For debugging purposes. If this vector is supplied, DetermineEnabledFilters
   // will populate it with the list of Filters that were disabled, plus the
   // associated reason, if supplied by the Filter. Caller retains ownership
@@ -519,6 +543,8 @@ class HtmlParse {
   typedef std::map<const HtmlNode*, HtmlEventList*> NodeToEventListMap;
   typedef std::map<HtmlFilter*, DeferredNode> FilterElementMap;
   typedef std::set<const HtmlNode*> NodeSet;
+  typedef std::vector<std::pair<HtmlEventListIterator, HtmlElement::Style> >
+      PendingCloseVector;
 
   // HtmlParse::FinishParse() is equivalent to the sequence of
   // BeginFinishParse(); Flush(); EndFinishParse().
@@ -526,8 +552,15 @@ class HtmlParse {
   void BeginFinishParse();
   void EndFinishParse();
 
+  // Alternative to BeginFinishParse(); Flush() for callers that already have
+  // the rewritten output of the document: ends lexing and discards any
+  // queued events without running the filters over them.  EndFinishParse()
+  // must still be called afterwards.
+  void BeginFinishParseWithoutFilters();
+
   // Clears any cached state we have while this object is laying
-  // around for recycling.
+  // around for recycling.  Interned names are kept unless they have grown
+  // too large; see TrimSymbolTable.
   void Clear();
 
   // Returns the number of events on the event queue.
@@ -590,9 +623,25 @@ class HtmlParse {
   // Same, but over a passed-in list of filters.
   void DisableFiltersInjectingScripts(const FilterList& filters);
 
+  // Runs every enabled filter in filters, in order, on the current queue of
+  // parse nodes.  Runs of adjacent filters whose CanBeFused() is true share a
+  // single traversal of the queue, unless fusing has been turned off with
+  // set_fuse_filters(false).  The results are identical either way.
+  void ApplyFilters(const FilterList& filters);
+
  private:
   void ApplyFilterHelper(HtmlFilter* filter);
-  HtmlEventListIterator Last();  // Last element in queue
+  // Runs a group of fusable filters over the queue in a single traversal.
+  void ApplyFusedFilters(const FilterVector& filters);
+  // The queue the lexer appends to: queue_, or lookahead_queue_ while
+  // lexing ahead.
+  HtmlEventList* LexerQueue() {
+    return lexing_ahead_ ? &lookahead_queue_ : &queue_;
+  }
+  HtmlEventListIterator Last();  // Last element in LexerQueue()
+  // Appends the look-ahead queue to queue_ and applies the element closes it
+  // held back.
+  void FinishLexAhead();
   bool IsInEventWindow(const HtmlEventListIterator& iter) const;
   void InsertNodeBeforeEvent(const HtmlEventListIterator& event,
                              HtmlNode* new_node);
@@ -620,8 +669,15 @@ class HtmlParse {
   // Visible for testing only, via HtmlTestingPeer
   friend class HtmlTestingPeer;
   void AddEvent(HtmlEvent* event);
+  Arena<HtmlEvent>* event_arena() {
+    return lexing_ahead_ ? &lookahead_events_ : &events_;
+  }
   void SetCurrent(HtmlNode* node);
   void set_coalesce_characters(bool x) { coalesce_characters_ = x; }
+
+  // Drops the interned names if they exceed a size budget; otherwise they
+  // are retained for the next document.
+  void TrimSymbolTable();
   size_t symbol_table_size() const {
     return string_table_.string_bytes_allocated();
   }
@@ -638,7 +694,19 @@ class HtmlParse {
   FilterList filters_;
   HtmlLexer* lexer_;
   Arena<HtmlNode> nodes_;
+
+  // Events are reclaimed in bulk when a flush window is cleared, unless some
+  // are still held in deferred_nodes_ or delayed_start_literal_, in which
+  // case they live until the end of the document.
+  Arena<HtmlEvent> events_;
   HtmlEventList queue_;
+
+  // Events lexed ahead of the current flush window (see StartLexAhead).
+  // They get their own arena so that reclaiming events_ at the end of the
+  // window leaves them alone; the two arenas swap once events_ is empty.
+  Arena<HtmlEvent> lookahead_events_;
+  HtmlEventList lookahead_queue_;
+  PendingCloseVector lookahead_closes_;
   HtmlEventListIterator current_;
   // Have we deleted current? Then we shouldn't do certain manipulations to it.
   MessageHandler* message_handler_;
@@ -653,12 +721,18 @@ class HtmlParse {
   bool need_sanity_check_;
   bool coalesce_characters_;
   bool need_coalesce_characters_;
+  bool fuse_filters_;
   bool url_valid_;
   bool log_rewrite_timing_;  // Should we time the speed of parsing?
   bool running_filters_;
   bool buffer_events_;
+  bool lexing_ahead_;
+  // Snapshot of the arenas' chunk counts when the document started, and the
+  // number of elements created since, for num_allocations().
+  int64 chunks_allocated_at_start_;
+  int64 num_elements_;
   int64 parse_start_time_us_;
-  scoped_ptr<HtmlEvent> delayed_start_literal_;
+  HtmlEvent* delayed_start_literal_;  // Owned by one of the event arenas.
   Timer* timer_;
   HtmlFilter* current_filter_;      // Filter currently running in ApplyFilter
 
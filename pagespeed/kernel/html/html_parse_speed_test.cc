@@ -44,7 +44,12 @@
 #include "pagespeed/kernel/base/stdio_file_system.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/html/collapse_whitespace_filter.h"
+#include "pagespeed/kernel/html/elide_attributes_filter.h"
+#include "pagespeed/kernel/html/html_attribute_quote_removal.h"
 #include "pagespeed/kernel/html/html_writer_filter.h"
+#include "pagespeed/kernel/html/minifying_html_writer_filter.h"
+#include "pagespeed/kernel/html/remove_comments_filter.h"
 
 namespace net_instaweb {
 
@@ -166,6 +171,142 @@ static void BM_ParseAndSerializeReuseParserX50(int iters) {
 }
 BENCHMARK(BM_ParseAndSerializeReuseParserX50);
 
+// Compares HTML minification done by a chain of separate filters, as
+// html_minifier_main used to, against MinifyingHtmlWriterFilter.
+static void BM_MinifySeparateFilters(int iters) {
+  StopBenchmarkTiming();
+  StringPiece text = GetHtmlText();
+  if (text.empty()) {
+    return;
+  }
+
+  NullWriter writer;
+  NullMessageHandler handler;
+  HtmlParse parser(&handler);
+  RemoveCommentsFilter remove_comments_filter(&parser);
+  ElideAttributesFilter elide_attributes_filter(&parser);
+  HtmlAttributeQuoteRemoval quote_removal_filter(&parser);
+  CollapseWhitespaceFilter collapse_whitespace_filter(&parser);
+  HtmlWriterFilter writer_filter(&parser);
+  parser.AddFilter(&remove_comments_filter);
+  parser.AddFilter(&elide_attributes_filter);
+  parser.AddFilter(&quote_removal_filter);
+  parser.AddFilter(&collapse_whitespace_filter);
+  parser.AddFilter(&writer_filter);
+  writer_filter.set_writer(&writer);
+
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    parser.StartParse("http://example.com/benchmark");
+    parser.ParseText(text);
+    parser.FinishParse();
+  }
+  SetBenchmarkBytesProcessed(static_cast<int64>(iters) * text.size());
+}
+BENCHMARK(BM_MinifySeparateFilters);
+
+static void BM_MinifyCombinedFilter(int iters) {
+  StopBenchmarkTiming();
+  StringPiece text = GetHtmlText();
+  if (text.empty()) {
+    return;
+  }
+
+  NullWriter writer;
+  NullMessageHandler handler;
+  HtmlParse parser(&handler);
+  MinifyingHtmlWriterFilter writer_filter(&parser);
+  parser.AddFilter(&writer_filter);
+  writer_filter.set_writer(&writer);
+
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    parser.StartParse("http://example.com/benchmark");
+    parser.ParseText(text);
+    parser.FinishParse();
+  }
+  SetBenchmarkBytesProcessed(static_cast<int64>(iters) * text.size());
+}
+BENCHMARK(BM_MinifyCombinedFilter);
+
+// Synthetic documents that keep the lexer mostly in one kind of state, so
+// that the throughput (reported in MB/s) of each can be tracked separately.
+enum StateMix {
+  kTextMix,       // Long runs of character data.
+  kCommentMix,    // Long comments.
+  kScriptMix,     // Long inline scripts.
+  kAttributeMix,  // Long quoted attribute values.
+  kTagMix,        // Many short tags with little text in between.
+};
+
+GoogleString MakeStateMixDocument(StateMix mix) {
+  static const size_t kTargetSize = 1 << 20;
+  static const char kWords[] =
+      "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+      "eiusmod tempor incididunt ut labore et dolore magna aliqua.\n";
+  GoogleString text = "<html><body>\n";
+  while (text.size() < kTargetSize) {
+    switch (mix) {
+      case kTextMix:
+        StrAppend(&text, "<p>", kWords, kWords, kWords, kWords, "</p>\n");
+        break;
+      case kCommentMix:
+        StrAppend(&text, "<!-- ", kWords, kWords, kWords, kWords, " -->\n");
+        break;
+      case kScriptMix:
+        StrAppend(&text, "<script>var s = \"", kWords, kWords,
+                  "\";\nif (a < b && c-- > 0) { f(s, '", kWords,
+                  "'); }\n</script>\n");
+        break;
+      case kAttributeMix:
+        StrAppend(&text, "<img alt=\"", kWords, "\" title='", kWords, "'",
+                  " src=\"http://example.com/", kWords, "\">\n");
+        break;
+      case kTagMix:
+        StrAppend(&text, "<ul><li><a href=x>a</a><li><b>b</b><br/></ul>\n");
+        break;
+    }
+  }
+  StrAppend(&text, "</body></html>\n");
+  return text;
+}
+
+void ParseStateMix(int iters, StateMix mix) {
+  StopBenchmarkTiming();
+  GoogleString text = MakeStateMixDocument(mix);
+  NullWriter writer;
+  NullMessageHandler handler;
+  HtmlParse parser(&handler);
+  HtmlWriterFilter writer_filter(&parser);
+  parser.AddFilter(&writer_filter);
+  writer_filter.set_writer(&writer);
+
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    parser.StartParse("http://example.com/benchmark");
+    parser.ParseText(text);
+    parser.FinishParse();
+  }
+  SetBenchmarkBytesProcessed(static_cast<int64>(iters) * text.size());
+}
+
+static void BM_ParseText(int iters) { ParseStateMix(iters, kTextMix); }
+BENCHMARK(BM_ParseText);
+
+static void BM_ParseComments(int iters) { ParseStateMix(iters, kCommentMix); }
+BENCHMARK(BM_ParseComments);
+
+static void BM_ParseScripts(int iters) { ParseStateMix(iters, kScriptMix); }
+BENCHMARK(BM_ParseScripts);
+
+static void BM_ParseAttributes(int iters) {
+  ParseStateMix(iters, kAttributeMix);
+}
+BENCHMARK(BM_ParseAttributes);
+
+static void BM_ParseTags(int iters) { ParseStateMix(iters, kTagMix); }
+BENCHMARK(BM_ParseTags);
+
 }  // namespace
 
 }  // namespace net_instaweb
@@ -207,6 +207,19 @@ TEST_F(HtmlParseTest, NestedDivInBr) {
      "<br><div>hello</div></br>");
 }
 
+TEST_F(HtmlParseTest, AllocationsAreBatched) {
+  // Each <p>x</p> produces two nodes and three events.  The nodes and events
+  // come out of arena chunks, so apart from each element's data we should
+  // see far fewer allocations than events.
+  GoogleString html;
+  for (int i = 0; i < 1000; ++i) {
+    html += "<p>x</p>";
+  }
+  ValidateNoChanges("allocations_are_batched", html);
+  EXPECT_LE(1000, html_parse_.num_allocations());
+  EXPECT_GT(1200, html_parse_.num_allocations());
+}
+
 // bug 2465145 - Sequential defaulted attribute tags lost
 TEST_F(HtmlParseTest, SequentialDefaultedTagsLost) {
   // This test cannot work with libxml, but since we use our own
@@ -615,6 +628,30 @@ TEST_F(HtmlAnnotationTest, CorrectTaggify) {
   ResetAnnotation();
 }
 
+// The lexer buffers runs of bytes that can't change its state in bulk, so
+// make sure that splitting such runs at every possible point makes no
+// difference.
+TEST_F(HtmlAnnotationTest, RunsSplitAcrossChunks) {
+  static const char kHtml[] =
+      "<div title=\"a 'quoted'\nvalue\" alt='single\n\"quoted\"'>\n"
+      "text &amp; more text\n<!-- a - comment -- with dashes -->"
+      "<![CDATA[ some ] cdata ]] ]]>"
+      "<script>var a = b--; /* <!-- <script> </script> --> */</script >"
+      "<style>p {}</style><?bogus - comment><!doctype html>tail</div>";
+  html_parse_.StartParse("http://test.com/whole.html");
+  html_parse_.ParseText(kHtml);
+  html_parse_.FinishParse();
+  GoogleString whole_annotation = annotation();
+  ResetAnnotation();
+
+  html_parse_.StartParse("http://test.com/chunked.html");
+  for (int i = 0, n = STATIC_STRLEN(kHtml); i < n; ++i) {
+    html_parse_.ParseText(kHtml + i, 1);
+  }
+  html_parse_.FinishParse();
+  EXPECT_EQ(whole_annotation, annotation());
+}
+
 TEST_F(HtmlAnnotationTest, WeirdAttributes) {
   // Just about everything can be an attribute
   ValidateNoChanges("weird_attr", "<a ,=\"foo\">");
@@ -1049,6 +1086,57 @@ TEST_F(HtmlAnnotationTest, FlushDoesNotBreakScriptTag) {
                annotation());
 }
 
+TEST_F(HtmlAnnotationTest, LexAheadGoesToNextFlushWindow) {
+  annotation_.set_annotate_flush(true);
+  html_parse_.StartParse("http://test.com/lex_ahead.html");
+  html_parse_.ParseText("<div><p>a");
+  html_parse_.StartLexAhead();
+  html_parse_.ParseText("b</p></div><i>c</i>");
+  EXPECT_TRUE(html_parse_.lexing_ahead());
+  html_parse_.Flush();
+  EXPECT_FALSE(html_parse_.lexing_ahead());
+  EXPECT_STREQ("+div +p[F]", annotation());
+  html_parse_.FinishParse();
+  EXPECT_STREQ("+div +p[F] 'ab' -p(e) -div(e) +i 'c' -i(e)[F]",
+               annotation());
+}
+
+TEST_F(HtmlAnnotationTest, LexAheadDelayedScriptTag) {
+  annotation_.set_annotate_flush(true);
+  html_parse_.StartParse("http://test.com/lex_ahead_script.html");
+  html_parse_.ParseText("<div></div><script>");
+  html_parse_.StartLexAhead();
+  html_parse_.ParseText("a=b;</script>");
+  html_parse_.Flush();
+  EXPECT_STREQ("+div -div(e)[F]", annotation());
+  html_parse_.FinishParse();
+  EXPECT_STREQ("+div -div(e)[F] +script 'a=b;' -script(e)[F]", annotation());
+}
+
+TEST_F(HtmlAnnotationTest, LexAheadClosesScriptFromPreviousWindow) {
+  SetupWriter();
+  annotation_.set_annotate_flush(true);
+  html_parse_.StartParse("http://test.com/lex_ahead_script_close.html");
+  html_parse_.ParseText("<div></div><script src=a.js>");
+  html_parse_.Flush();
+  html_parse_.ParseText("a=b;");
+  html_parse_.StartLexAhead();
+  html_parse_.ParseText("c=d;</script><p>e</p>");
+  html_parse_.Flush();
+  EXPECT_STREQ("+div -div(e)[F][F]", annotation());
+
+  // Lex enough into the next window that its events reuse whatever the
+  // Flush above reclaimed; the <script> start event must not be among it.
+  for (int i = 0; i < 100; ++i) {
+    html_parse_.ParseText("<i>f</i>");
+  }
+  html_parse_.FinishParse();
+  EXPECT_EQ(0, output_buffer_.find(
+      "<div></div><script src=a.js>a=b;c=d;</script><p>e</p><i>f</i>"));
+  EXPECT_NE(GoogleString::npos,
+            annotation().find("[F][F] +script 'a=b;c=d;' -script(e) +p"));
+}
+
 TEST_F(HtmlAnnotationTest, FlushDoesNotBreakScriptTagWithComment) {
   SetupWriter();
   annotation_.set_annotate_flush(true);
@@ -1174,6 +1262,33 @@ TEST_F(HtmlParseTest, MakeName) {
   }
 }
 
+TEST_F(HtmlParseTest, InternedNamesRetainedAcrossDocuments) {
+  static const char kCustom[] =
+      "<my-widget data-track-id=1 data-track-kind=x></my-widget>";
+  html_parse_.StartParse("http://test.com/custom1.html");
+  html_parse_.ParseText(kCustom);
+  html_parse_.FinishParse();
+  size_t size = HtmlTestingPeer::symbol_table_size(&html_parse_);
+  EXPECT_LT(0, size);
+
+  // The same custom names on the next page reuse the interned copies.
+  html_parse_.StartParse("http://test.com/custom2.html");
+  html_parse_.ParseText(kCustom);
+  html_parse_.FinishParse();
+  EXPECT_EQ(size, HtmlTestingPeer::symbol_table_size(&html_parse_));
+
+  // But the table is dropped at the next document once it grows too large.
+  html_parse_.StartParse("http://test.com/many_names.html");
+  for (int i = 0; i < 5000; ++i) {
+    html_parse_.ParseText(StrCat("<x-", IntegerToString(i), "/>"));
+  }
+  html_parse_.FinishParse();
+  EXPECT_LT(size, HtmlTestingPeer::symbol_table_size(&html_parse_));
+  html_parse_.StartParse("http://test.com/custom3.html");
+  EXPECT_EQ(0, HtmlTestingPeer::symbol_table_size(&html_parse_));
+  html_parse_.FinishParse();
+}
+
 // bug 2508140 : <noscript> in <head>
 TEST_F(HtmlParseTestNoBody, NoscriptInHead) {
   // Some real websites (ex: google.com) have <noscript> in the <head> even
@@ -1419,8 +1534,7 @@ class EventListManipulationTest : public HtmlParseTest {
     static const char kUrl[] = "http://html.parse.test/event_list_test.html";
     ASSERT_TRUE(html_parse_.StartParse(kUrl));
     node1_ = html_parse_.NewCharactersNode(NULL, "1");
-    HtmlTestingPeer::AddEvent(&html_parse_,
-                              new HtmlCharactersEvent(node1_, -1));
+    HtmlTestingPeer::AddCharactersEvent(&html_parse_, node1_);
     node2_ = html_parse_.NewCharactersNode(NULL, "2");
     node3_ = html_parse_.NewCharactersNode(NULL, "3");
     // Note: the last 2 are not added in SetUp.
@@ -1493,8 +1607,8 @@ TEST_F(EventListManipulationTest, TestDeleteOnly) {
 
 TEST_F(EventListManipulationTest, TestDeleteFirst) {
   HtmlTestingPeer::set_coalesce_characters(&html_parse_, false);
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node3_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node3_);
   html_parse_.DeleteNode(node1_);
   CheckExpected("23");
   html_parse_.DeleteNode(node2_);
@@ -1505,8 +1619,8 @@ TEST_F(EventListManipulationTest, TestDeleteFirst) {
 
 TEST_F(EventListManipulationTest, TestDeleteLast) {
   HtmlTestingPeer::set_coalesce_characters(&html_parse_, false);
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node3_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node3_);
   html_parse_.DeleteNode(node3_);
   CheckExpected("12");
   html_parse_.DeleteNode(node2_);
@@ -1517,8 +1631,8 @@ TEST_F(EventListManipulationTest, TestDeleteLast) {
 
 TEST_F(EventListManipulationTest, TestDeleteMiddle) {
   HtmlTestingPeer::set_coalesce_characters(&html_parse_, false);
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node3_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node3_);
   html_parse_.DeleteNode(node2_);
   CheckExpected("13");
 }
@@ -1529,8 +1643,8 @@ TEST_F(EventListManipulationTest, TestDeleteMiddle) {
 // parent-pointer check.
 TEST_F(EventListManipulationTest, TestAddParentToSequence) {
   HtmlTestingPeer::set_coalesce_characters(&html_parse_, false);
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node3_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node3_);
   HtmlElement* div = html_parse_.NewElement(NULL, HtmlName::kDiv);
   EXPECT_TRUE(html_parse_.AddParentToSequence(node1_, node3_, div));
   CheckExpected("<div>123</div>");
@@ -1577,17 +1691,17 @@ TEST_F(EventListManipulationTest, TestAppendChild) {
 
 TEST_F(EventListManipulationTest, TestAddParentToSequenceDifferentParents) {
   HtmlTestingPeer::set_coalesce_characters(&html_parse_, false);
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
   HtmlElement* div = html_parse_.NewElement(NULL, HtmlName::kDiv);
   EXPECT_TRUE(html_parse_.AddParentToSequence(node1_, node2_, div));
   CheckExpected("<div>12</div>");
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node3_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node3_);
   CheckExpected("<div>12</div>3");
   EXPECT_FALSE(html_parse_.AddParentToSequence(node2_, node3_, div));
 }
 
 TEST_F(EventListManipulationTest, TestDeleteGroup) {
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
   HtmlElement* div = html_parse_.NewElement(NULL, HtmlName::kDiv);
   EXPECT_TRUE(html_parse_.AddParentToSequence(node1_, node2_, div));
   CheckExpected("<div>12</div>");
@@ -1599,11 +1713,11 @@ TEST_F(EventListManipulationTest, TestMoveElementIntoParent1) {
   HtmlElement* head = html_parse_.NewElement(NULL, HtmlName::kHead);
   EXPECT_TRUE(html_parse_.AddParentToSequence(node1_, node1_, head));
   CheckExpected("<head>1</head>");
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
   HtmlElement* div = html_parse_.NewElement(NULL, HtmlName::kDiv);
   EXPECT_TRUE(html_parse_.AddParentToSequence(node2_, node2_, div));
   CheckExpected("<head>1</head><div>2</div>");
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node3_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node3_);
   CheckExpected("<head>1</head><div>2</div>3");
   HtmlTestingPeer::SetCurrent(&html_parse_, div);
   EXPECT_TRUE(html_parse_.MoveCurrentInto(head));
@@ -1615,8 +1729,8 @@ TEST_F(EventListManipulationTest, TestMoveElementIntoParent2) {
   HtmlElement* head = html_parse_.NewElement(NULL, HtmlName::kHead);
   EXPECT_TRUE(html_parse_.AddParentToSequence(node1_, node1_, head));
   CheckExpected("<head>1</head>");
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node3_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node3_);
   CheckExpected("<head>1</head>23");
   HtmlElement* div = html_parse_.NewElement(NULL, HtmlName::kDiv);
   EXPECT_TRUE(html_parse_.AddParentToSequence(node3_, node3_, div));
@@ -1642,10 +1756,10 @@ TEST_F(EventListManipulationTest, TestDeleteSavingChildrenEnd) {
 TEST_F(EventListManipulationTest, TestMoveCurrentBefore) {
   // Setup events.
   HtmlTestingPeer::set_coalesce_characters(&html_parse_, false);
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
   HtmlElement* div = html_parse_.NewElement(NULL, HtmlName::kDiv);
   EXPECT_TRUE(html_parse_.AddParentToSequence(node1_, node2_, div));
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node3_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node3_);
   CheckExpected("<div>12</div>3");
   HtmlTestingPeer::SetCurrent(&html_parse_, node3_);
 
@@ -1673,7 +1787,7 @@ TEST_F(EventListManipulationTest, TestMoveCurrentBefore) {
 
 TEST_F(EventListManipulationTest, TestCoalesceOnAdd) {
   CheckExpected("1");
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
   CheckExpected("12");
 
   // this will coalesce node1 and node2 togethers.  So there is only
@@ -1687,11 +1801,11 @@ TEST_F(EventListManipulationTest, TestCoalesceOnDelete) {
   CheckExpected("1");
   HtmlElement* div = html_parse_.NewElement(NULL, HtmlName::kDiv);
   html_parse_.AddElement(div, -1);
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
   HtmlTestingPeer testing_peer;
   testing_peer.SetNodeParent(node2_, div);
   html_parse_.CloseElement(div, HtmlElement::EXPLICIT_CLOSE, -1);
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node3_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node3_);
   CheckExpected("1<div>2</div>3");
 
   // Removing the div, leaving the children intact...
@@ -1709,7 +1823,7 @@ TEST_F(EventListManipulationTest, TestHasChildren) {
   HtmlElement* div = html_parse_.NewElement(NULL, HtmlName::kDiv);
   html_parse_.AddElement(div, -1);
   EXPECT_FALSE(html_parse_.HasChildrenInFlushWindow(div));
-  HtmlTestingPeer::AddEvent(&html_parse_, new HtmlCharactersEvent(node2_, -1));
+  HtmlTestingPeer::AddCharactersEvent(&html_parse_, node2_);
   HtmlTestingPeer testing_peer;
   testing_peer.SetNodeParent(node2_, div);
 
@@ -1994,6 +2108,32 @@ TEST_F(AttributeManipulationTest, ModifyKeepAttribute) {
                 " selected />");
 }
 
+TEST_F(AttributeManipulationTest, DecodedValueSharing) {
+  // Values that need no decoding don't get a second copy...
+  HtmlElement::Attribute* href = node_->FindAttribute(HtmlName::kHref);
+  ASSERT_TRUE(href != NULL);
+  EXPECT_EQ(href->escaped_value(), href->DecodedValueOrNull());
+
+  // ... but values that do keep their decoded form separately.
+  href->SetValue("a&b");
+  EXPECT_STREQ("a&amp;b", href->escaped_value());
+  EXPECT_STREQ("a&b", href->DecodedValueOrNull());
+
+  // It's fine to set a value from part of the current, shared, value.
+  href->SetValue("http://www.google.com/");
+  href->SetValue(StringPiece(href->DecodedValueOrNull()).substr(7));
+  EXPECT_STREQ("www.google.com/", href->DecodedValueOrNull());
+  EXPECT_EQ(href->escaped_value(), href->DecodedValueOrNull());
+  CheckExpected("<a href=\"www.google.com/\" id=37 class='search!'"
+                " selected />");
+
+  // Likewise for setting the escaped value from the separately stored
+  // decoded value.
+  href->SetValue("a&b");
+  href->SetEscapedValue(href->DecodedValueOrNull());
+  EXPECT_STREQ("a&b", href->escaped_value());
+}
+
 TEST_F(AttributeManipulationTest, BadUrl) {
   EXPECT_FALSE(html_parse_.StartParse(")(*&)(*&(*"));
 
@@ -3213,5 +3353,92 @@ TEST_F(HtmlParseTestNoBody, InsertExternalScriptAfterEndOfHead) {
                    "<head>text</head><script src=\"inserted\"></script>");
 }
 
+// Records the events it sees into a log shared with other filters, so the
+// order in which the parser dispatched them can be checked.  Also upper-cases
+// characters nodes so we can see that each filter observes the mutations
+// made by the filters ahead of it.
+class FusionTracingFilter : public EmptyHtmlFilter {
+ public:
+  FusionTracingFilter(const char* name, bool can_be_fused, GoogleString* log)
+      : name_(name), can_be_fused_(can_be_fused), log_(log) {}
+
+  virtual void StartElement(HtmlElement* element) {
+    StrAppend(log_, name_, "+", element->name_str(), " ");
+  }
+  virtual void EndElement(HtmlElement* element) {
+    StrAppend(log_, name_, "-", element->name_str(), " ");
+  }
+  virtual void Characters(HtmlCharactersNode* characters) {
+    StrAppend(log_, name_, "'", characters->contents(), "' ");
+    UpperString(characters->mutable_contents());
+  }
+  virtual void Flush() { StrAppend(log_, name_, "[F] "); }
+
+  virtual bool CanBeFused() const { return can_be_fused_; }
+  virtual const char* Name() const { return name_; }
+
+ private:
+  const char* name_;
+  bool can_be_fused_;
+  GoogleString* log_;
+
+  DISALLOW_COPY_AND_ASSIGN(FusionTracingFilter);
+};
+
+class HtmlParseFusionTest : public HtmlParseTestNoBody {
+ protected:
+  HtmlParseFusionTest()
+      : a_("a", true, &log_),
+        b_("b", true, &log_),
+        barrier_("x", false, &log_),
+        c_("c", true, &log_) {}
+
+  virtual bool AddHtmlTags() const { return false; }
+
+  GoogleString log_;
+  FusionTracingFilter a_;
+  FusionTracingFilter b_;
+  FusionTracingFilter barrier_;
+  FusionTracingFilter c_;
+};
+
+TEST_F(HtmlParseFusionTest, FusedFiltersShareTraversal) {
+  html_parse_.AddFilter(&a_);
+  html_parse_.AddFilter(&b_);
+  SetupWriter();
+  ValidateExpected("fused", "<p>x</p>", "<p>X</p>");
+  EXPECT_EQ("a+p b+p a'x' b'X' a-p b-p a[F] b[F] ", log_);
+}
+
+TEST_F(HtmlParseFusionTest, FusionDisabled) {
+  html_parse_.set_fuse_filters(false);
+  html_parse_.AddFilter(&a_);
+  html_parse_.AddFilter(&b_);
+  SetupWriter();
+  ValidateExpected("unfused", "<p>x</p>", "<p>X</p>");
+  EXPECT_EQ("a+p a'x' a-p a[F] b+p b'X' b-p b[F] ", log_);
+}
+
+TEST_F(HtmlParseFusionTest, NonFusableFilterIsBarrier) {
+  html_parse_.AddFilter(&a_);
+  html_parse_.AddFilter(&b_);
+  html_parse_.AddFilter(&barrier_);
+  html_parse_.AddFilter(&c_);
+  SetupWriter();
+  ValidateExpected("barrier", "<p>x</p>", "<p>X</p>");
+  EXPECT_EQ("a+p b+p a'x' b'X' a-p b-p a[F] b[F] "
+            "x+p x'X' x-p x[F] "
+            "c+p c'X' c-p c[F] ", log_);
+}
+
+TEST_F(HtmlParseFusionTest, DisabledFilterDoesNotBreakFusion) {
+  DisableTestFilter disabled("disabled", false, "");
+  html_parse_.AddFilter(&a_);
+  html_parse_.AddFilter(&disabled);
+  html_parse_.AddFilter(&b_);
+  SetupWriter();
+  ValidateExpected("disabled", "<p>x</p>", "<p>X</p>");
+  EXPECT_EQ("a+p b+p a'x' b'X' a-p b-p a[F] b[F] ", log_);
+}
 
 }  // namespace net_instaweb
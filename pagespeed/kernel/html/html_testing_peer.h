@@ -23,13 +23,12 @@
 
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/html/html_element.h"
+#include "pagespeed/kernel/html/html_event.h"
 #include "pagespeed/kernel/html/html_node.h"
 #include "pagespeed/kernel/html/html_parse.h"
 
 namespace net_instaweb {
 
-class HtmlEvent;
-
 class HtmlTestingPeer {
  public:
   HtmlTestingPeer() { }
@@ -40,6 +39,10 @@ class HtmlTestingPeer {
   static void AddEvent(HtmlParse* parser, HtmlEvent* event) {
     parser->AddEvent(event);
   }
+  // Adds a synthetic event for node, allocated in parser's event arena.
+  static void AddCharactersEvent(HtmlParse* parser, HtmlCharactersNode* node) {
+    parser->AddEvent(new (parser->event_arena()) HtmlCharactersEvent(node, -1));
+  }
   static void SetCurrent(HtmlParse* parser, HtmlNode* node) {
     parser->SetCurrent(node);
   }
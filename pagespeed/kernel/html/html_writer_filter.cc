@@ -47,14 +47,13 @@ void HtmlWriterFilter::Clear() {
   lazy_close_element_ = NULL;
   column_ = 0;
   write_errors_ = 0;
+  pending_.clear();
 }
 
 void HtmlWriterFilter::TerminateLazyCloseElement() {
   if (lazy_close_element_ != NULL) {
     lazy_close_element_ = NULL;
-    if (!writer_->Write(">", html_parse_->message_handler())) {
-      ++write_errors_;
-    }
+    pending_.push_back(">");
     ++column_;
   }
 }
@@ -70,8 +69,16 @@ void HtmlWriterFilter::EmitBytes(const StringPiece& str) {
       break;
     }
   }
-  if (!writer_->Write(str, html_parse_->message_handler())) {
-    ++write_errors_;
+  pending_.push_back(str);
+}
+
+void HtmlWriterFilter::WritePending() {
+  if (!pending_.empty()) {
+    if (!writer_->WriteV(&pending_[0], pending_.size(),
+                         html_parse_->message_handler())) {
+      ++write_errors_;
+    }
+    pending_.clear();
   }
 }
 
@@ -80,6 +87,8 @@ void HtmlWriterFilter::EmitName(const HtmlName& name) {
     name.value().CopyToString(&case_fold_buffer_);
     LowerString(&case_fold_buffer_);
     EmitBytes(case_fold_buffer_);
+    // case_fold_buffer_ is reused for the next name, so write it out now.
+    WritePending();
   } else {
     EmitBytes(name.value());
   }
@@ -134,6 +143,7 @@ void HtmlWriterFilter::StartElement(HtmlElement* element) {
   } else {
     EmitBytes(">");
   }
+  WritePending();
 }
 
 // Compute the tag-closing style for an element. If the style was specified
@@ -208,34 +218,40 @@ void HtmlWriterFilter::EndElement(HtmlElement* element) {
       // Nothing new to write; the ">" was written in StartElement
       break;
   }
+  WritePending();
 }
 
 void HtmlWriterFilter::Characters(HtmlCharactersNode* chars) {
   EmitBytes(chars->contents());
+  WritePending();
 }
 
 void HtmlWriterFilter::Cdata(HtmlCdataNode* cdata) {
   EmitBytes("<![CDATA[");
   EmitBytes(cdata->contents());
   EmitBytes("]]>");
+  WritePending();
 }
 
 void HtmlWriterFilter::Comment(HtmlCommentNode* comment) {
   EmitBytes("<!--");
   EmitBytes(comment->contents());
   EmitBytes("-->");
+  WritePending();
 }
 
 void HtmlWriterFilter::IEDirective(HtmlIEDirectiveNode* directive) {
   EmitBytes("<!--");
   EmitBytes(directive->contents());
   EmitBytes("-->");
+  WritePending();
 }
 
 void HtmlWriterFilter::Directive(HtmlDirectiveNode* directive) {
   EmitBytes("<!");
   EmitBytes(directive->contents());
   EmitBytes(">");
+  WritePending();
 }
 
 void HtmlWriterFilter::StartDocument() {
@@ -244,6 +260,7 @@ void HtmlWriterFilter::StartDocument() {
 
 void HtmlWriterFilter::EndDocument() {
   EmitBytes("");  // flushes any lazily closed elements at end of the document.
+  WritePending();
 }
 
 void HtmlWriterFilter::Flush() {
@@ -54,6 +54,7 @@ class HtmlWriterFilter : public HtmlFilter {
   // This filter will not change urls.
   virtual bool CanModifyUrls() { return false; }
   ScriptUsage GetScriptUsage() const override { return kNeverInjectsScripts; }
+  bool CanBeFused() const override { return true; }
 
   void set_max_column(int max_column) { max_column_ = max_column; }
   void set_case_fold(bool case_fold) { case_fold_ = case_fold; }
@@ -69,9 +70,16 @@ class HtmlWriterFilter : public HtmlFilter {
   // Terminates the current lazy close element if it is not already terminated.
   void TerminateLazyCloseElement();
 
- private:
+  // Queues str to be written by the next WritePending call.  str must stay
+  // valid until then, which is the case for node contents, names and
+  // attribute values as long as we write everything an event produced
+  // before returning from its handler.
   void EmitBytes(const StringPiece& str);
 
+  // Hands all the bytes queued by EmitBytes to the writer in one call.
+  void WritePending();
+
+ private:
   // Emits an HTML name, possibly case-folded depending on the
   // caller-specified option.
   void EmitName(const HtmlName& name);
@@ -98,6 +106,9 @@ class HtmlWriterFilter : public HtmlFilter {
   bool case_fold_;
   GoogleString case_fold_buffer_;
 
+  // Fragments produced by the current event, waiting for WritePending.
+  StringPieceVector pending_;
+
   DISALLOW_COPY_AND_ASSIGN(HtmlWriterFilter);
 };
 
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/html/minifying_html_writer_filter.h"
+
+#include "pagespeed/kernel/html/html_node.h"
+
+namespace net_instaweb {
+
+class HtmlParse;
+
+MinifyingHtmlWriterFilter::MinifyingHtmlWriterFilter(HtmlParse* html_parse)
+    : HtmlWriterFilter(html_parse),
+      elide_attributes_filter_(html_parse),
+      quote_removal_filter_(html_parse),
+      collapse_whitespace_filter_(html_parse),
+      has_pending_text_(false) {
+}
+
+MinifyingHtmlWriterFilter::MinifyingHtmlWriterFilter(
+    HtmlParse* html_parse,
+    const RemoveCommentsFilter::OptionsInterface* options)
+    : HtmlWriterFilter(html_parse),
+      options_(options),
+      elide_attributes_filter_(html_parse),
+      quote_removal_filter_(html_parse),
+      collapse_whitespace_filter_(html_parse),
+      has_pending_text_(false) {
+}
+
+MinifyingHtmlWriterFilter::~MinifyingHtmlWriterFilter() {}
+
+void MinifyingHtmlWriterFilter::WritePendingText() {
+  if (has_pending_text_) {
+    if (!collapse_whitespace_filter_.InSensitiveTag()) {
+      CollapseWhitespaceFilter::CollapseWhitespace(&pending_text_);
+    }
+    EmitBytes(pending_text_);
+    WritePending();
+    pending_text_.clear();
+    has_pending_text_ = false;
+  }
+}
+
+void MinifyingHtmlWriterFilter::StartDocument() {
+  HtmlWriterFilter::StartDocument();
+  collapse_whitespace_filter_.StartDocument();
+  pending_text_.clear();
+  has_pending_text_ = false;
+}
+
+void MinifyingHtmlWriterFilter::EndDocument() {
+  WritePendingText();
+  HtmlWriterFilter::EndDocument();
+}
+
+void MinifyingHtmlWriterFilter::StartElement(HtmlElement* element) {
+  WritePendingText();
+  collapse_whitespace_filter_.StartElement(element);
+  elide_attributes_filter_.StartElement(element);
+  quote_removal_filter_.StartElement(element);
+  HtmlWriterFilter::StartElement(element);
+}
+
+void MinifyingHtmlWriterFilter::EndElement(HtmlElement* element) {
+  WritePendingText();
+  collapse_whitespace_filter_.EndElement(element);
+  HtmlWriterFilter::EndElement(element);
+}
+
+void MinifyingHtmlWriterFilter::Cdata(HtmlCdataNode* cdata) {
+  WritePendingText();
+  HtmlWriterFilter::Cdata(cdata);
+}
+
+void MinifyingHtmlWriterFilter::Comment(HtmlCommentNode* comment) {
+  if ((options_.get() != NULL) &&
+      options_->IsRetainedComment(comment->contents())) {
+    WritePendingText();
+    HtmlWriterFilter::Comment(comment);
+  }
+  // Otherwise the comment is dropped, and any text on either side of it
+  // stays pending so it is collapsed as one run.
+}
+
+void MinifyingHtmlWriterFilter::IEDirective(HtmlIEDirectiveNode* directive) {
+  WritePendingText();
+  HtmlWriterFilter::IEDirective(directive);
+}
+
+void MinifyingHtmlWriterFilter::Characters(HtmlCharactersNode* characters) {
+  pending_text_.append(characters->contents());
+  has_pending_text_ = true;
+}
+
+void MinifyingHtmlWriterFilter::Directive(HtmlDirectiveNode* directive) {
+  WritePendingText();
+  HtmlWriterFilter::Directive(directive);
+}
+
+void MinifyingHtmlWriterFilter::Flush() {
+  // HtmlParse does not coalesce characters nodes across flush windows, so
+  // neither do we.
+  WritePendingText();
+  HtmlWriterFilter::Flush();
+}
+
+}  // namespace net_instaweb
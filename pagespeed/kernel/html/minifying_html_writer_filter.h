@@ -0,0 +1,92 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PAGESPEED_KERNEL_HTML_MINIFYING_HTML_WRITER_FILTER_H_
+#define PAGESPEED_KERNEL_HTML_MINIFYING_HTML_WRITER_FILTER_H_
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/html/collapse_whitespace_filter.h"
+#include "pagespeed/kernel/html/elide_attributes_filter.h"
+#include "pagespeed/kernel/html/html_attribute_quote_removal.h"
+#include "pagespeed/kernel/html/html_writer_filter.h"
+#include "pagespeed/kernel/html/remove_comments_filter.h"
+
+namespace net_instaweb {
+
+class HtmlParse;
+
+// Serializes HTML like HtmlWriterFilter while applying, in the same pass,
+// the transformations of RemoveCommentsFilter, ElideAttributesFilter,
+// HtmlAttributeQuoteRemoval and CollapseWhitespaceFilter.  Use it in place of
+// those four filters followed by an HtmlWriterFilter; the output is
+// byte-identical.
+//
+// Comments are dropped by not writing them rather than by deleting them from
+// the DOM, and collapsed text is written from a scratch buffer rather than
+// being stored back into the characters nodes, so the parse tree is left
+// untouched apart from the element attributes.  This filter must therefore
+// be the last one in the chain.
+//
+// As with the separate filters, whitespace is collapsed across the text on
+// both sides of a removed comment, mirroring HtmlParse's coalescing of
+// adjacent characters nodes (which is on by default).
+class MinifyingHtmlWriterFilter : public HtmlWriterFilter {
+ public:
+  explicit MinifyingHtmlWriterFilter(HtmlParse* html_parse);
+
+  // Takes ownership of options, which may be NULL.  See
+  // RemoveCommentsFilter::OptionsInterface.
+  MinifyingHtmlWriterFilter(
+      HtmlParse* html_parse,
+      const RemoveCommentsFilter::OptionsInterface* options);
+  virtual ~MinifyingHtmlWriterFilter();
+
+  virtual void StartDocument();
+  virtual void EndDocument();
+  virtual void StartElement(HtmlElement* element);
+  virtual void EndElement(HtmlElement* element);
+  virtual void Cdata(HtmlCdataNode* cdata);
+  virtual void Comment(HtmlCommentNode* comment);
+  virtual void IEDirective(HtmlIEDirectiveNode* directive);
+  virtual void Characters(HtmlCharactersNode* characters);
+  virtual void Directive(HtmlDirectiveNode* directive);
+  virtual void Flush();
+
+  virtual const char* Name() const { return "MinifyingHtmlWriter"; }
+
+ private:
+  // Collapses and writes the text accumulated from consecutive Characters
+  // events, if any.
+  void WritePendingText();
+
+  scoped_ptr<const RemoveCommentsFilter::OptionsInterface> options_;
+  ElideAttributesFilter elide_attributes_filter_;
+  HtmlAttributeQuoteRemoval quote_removal_filter_;
+  CollapseWhitespaceFilter collapse_whitespace_filter_;
+
+  // Text from Characters events that has not been written yet, because a
+  // following removed comment and more text may need to be collapsed with it.
+  GoogleString pending_text_;
+  bool has_pending_text_;
+
+  DISALLOW_COPY_AND_ASSIGN(MinifyingHtmlWriterFilter);
+};
+
+}  // namespace net_instaweb
+
+#endif  // PAGESPEED_KERNEL_HTML_MINIFYING_HTML_WRITER_FILTER_H_
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/html/minifying_html_writer_filter.h"
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
+#include "pagespeed/kernel/html/collapse_whitespace_filter.h"
+#include "pagespeed/kernel/html/elide_attributes_filter.h"
+#include "pagespeed/kernel/html/html_attribute_quote_removal.h"
+#include "pagespeed/kernel/html/html_parse.h"
+#include "pagespeed/kernel/html/html_writer_filter.h"
+#include "pagespeed/kernel/html/remove_comments_filter.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const char kUrl[] = "http://example.com/minify.html";
+
+// Parses html, flushing after the first flush_at bytes if flush_at > 0.
+void Parse(HtmlParse* html_parse, StringPiece html, int flush_at) {
+  html_parse->StartParse(kUrl);
+  if (flush_at > 0) {
+    html_parse->ParseText(html.substr(0, flush_at));
+    html_parse->Flush();
+    html.remove_prefix(flush_at);
+  }
+  html_parse->ParseText(html);
+  html_parse->FinishParse();
+}
+
+class MinifyingHtmlWriterFilterTest : public testing::Test {
+ protected:
+  MinifyingHtmlWriterFilterTest()
+      : html_parse_(&handler_),
+        writer_filter_(&html_parse_),
+        string_writer_(&output_) {
+    writer_filter_.set_writer(&string_writer_);
+    html_parse_.AddFilter(&writer_filter_);
+  }
+
+  // Minifies html the way html_minifier_main used to, with a separate
+  // filter for each transformation.
+  GoogleString MinifyWithSeparateFilters(StringPiece html, int flush_at) {
+    HtmlParse html_parse(&handler_);
+    RemoveCommentsFilter remove_comments_filter(&html_parse);
+    ElideAttributesFilter elide_attributes_filter(&html_parse);
+    HtmlAttributeQuoteRemoval quote_removal_filter(&html_parse);
+    CollapseWhitespaceFilter collapse_whitespace_filter(&html_parse);
+    HtmlWriterFilter writer_filter(&html_parse);
+    GoogleString output;
+    StringWriter string_writer(&output);
+    writer_filter.set_writer(&string_writer);
+    html_parse.AddFilter(&remove_comments_filter);
+    html_parse.AddFilter(&elide_attributes_filter);
+    html_parse.AddFilter(&quote_removal_filter);
+    html_parse.AddFilter(&collapse_whitespace_filter);
+    html_parse.AddFilter(&writer_filter);
+    Parse(&html_parse, html, flush_at);
+    return output;
+  }
+
+  // Checks that the combined filter produces the same bytes as the separate
+  // filters, both in a single flush window and split at every position.
+  void CheckMatchesSeparateFilters(StringPiece html) {
+    for (int flush_at = 0; flush_at < static_cast<int>(html.size());
+         ++flush_at) {
+      output_.clear();
+      Parse(&html_parse_, html, flush_at);
+      EXPECT_EQ(MinifyWithSeparateFilters(html, flush_at), output_)
+          << "flush_at=" << flush_at;
+    }
+  }
+
+  NullMessageHandler handler_;
+  HtmlParse html_parse_;
+  MinifyingHtmlWriterFilter writer_filter_;
+  GoogleString output_;
+  StringWriter string_writer_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(MinifyingHtmlWriterFilterTest);
+};
+
+TEST_F(MinifyingHtmlWriterFilterTest, Minifies) {
+  output_.clear();
+  Parse(&html_parse_,
+        "<html>\n<body>  <!-- comment -->\n  <p class=\"a\">hello   world"
+        "</p>\n<form method=\"get\"><input type=\"checkbox\" checked=\"checked\">"
+        "</form></body></html>\n", 0);
+  EXPECT_EQ("<html>\n<body>\n<p class=a>hello world</p>\n<form>"
+            "<input type=checkbox checked></form></body></html>\n", output_);
+}
+
+TEST_F(MinifyingHtmlWriterFilterTest, WhitespaceAroundRemovedComment) {
+  CheckMatchesSeparateFilters("<div>a  \n<!--x-->\n  b</div>");
+  CheckMatchesSeparateFilters("<div>a <!--x--><!--y-->  b</div>");
+  CheckMatchesSeparateFilters("<pre>a  <!--x-->  b</pre> c  <!--y--> d");
+}
+
+TEST_F(MinifyingHtmlWriterFilterTest, BriefCloseAroundRemovedComment) {
+  CheckMatchesSeparateFilters("<div><br/><!--x--></br></div>");
+  CheckMatchesSeparateFilters("<svg><path d=\"M0\"/><!--x--></svg>");
+}
+
+TEST_F(MinifyingHtmlWriterFilterTest, ElidedLastAttributeBriefClose) {
+  CheckMatchesSeparateFilters(
+      "<!doctype html><script type=\"text/javascript\" async=\"async\"/>");
+  CheckMatchesSeparateFilters("<col span=\"1\" class=\"x\"/><col span=1 />");
+}
+
+TEST_F(MinifyingHtmlWriterFilterTest, Xhtml) {
+  CheckMatchesSeparateFilters(
+      "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Strict//EN\" "
+      "\"http://www.w3.org/TR/xhtml1/DTD/xhtml1-strict.dtd\">"
+      "<option selected=\"selected\" value=\"v\">  x  </option>");
+}
+
+TEST_F(MinifyingHtmlWriterFilterTest, ScriptsAndIEDirectives) {
+  CheckMatchesSeparateFilters(
+      "<head><!--[if IE]>  <link rel=stylesheet href=ie.css> <![endif]-->"
+      "<script>  var a  =  '<!-- not a comment -->';  </script></head>"
+      "<body><textarea>  keep   <!--x-->  this </textarea></body>");
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
@@ -19,6 +19,7 @@
 #include "pagespeed/kernel/base/source_map.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/writer.h"
 #include "pagespeed/kernel/js/js_keywords.h"
 #include "pagespeed/kernel/js/js_tokenizer.h"
 
@@ -575,25 +576,70 @@ void UpdateLineAndCol(StringPiece text, int* line, int* col) {
   }
 }
 
+// prev is the last mapping recorded, or NULL if there is none yet.
 bool ShouldRecordStep(
-    const net_instaweb::source_map::MappingVector& mapping,
+    const net_instaweb::source_map::Mapping* prev,
     const net_instaweb::source_map::Mapping& next) {
   // Should record first mapping.
-  if (mapping.empty()) {
+  if (prev == NULL) {
     return true;
   }
 
-  const net_instaweb::source_map::Mapping& prev = mapping.back();
-  if (next.gen_line == prev.gen_line) {
+  if (next.gen_line == prev->gen_line) {
     // Should record iff different number of newlines or different num of cols.
-    return (next.src_line != prev.src_line ||
-            next.gen_col - prev.gen_col != next.src_col - prev.src_col);
+    return (next.src_line != prev->src_line ||
+            next.gen_col - prev->gen_col != next.src_col - prev->src_col);
   }
 
   // If line changes, we should record it.
   return true;
 }
 
+// Size of the chunks in which MinifyUtf8JsToWriter hands its output to the
+// writer.
+const size_t kOutputChunkSize = 32 * 1024;
+
+// Gathers the many small tokens emitted by the minifier into chunks of at
+// most kOutputChunkSize bytes before writing them out.
+class ChunkedOutput {
+ public:
+  ChunkedOutput(net_instaweb::Writer* writer,
+                net_instaweb::MessageHandler* handler)
+      : writer_(writer), handler_(handler), ok_(true) {
+    buffer_.reserve(kOutputChunkSize);
+  }
+
+  void Append(StringPiece text) {
+    if (buffer_.size() + text.size() > kOutputChunkSize) {
+      Flush();
+      if (text.size() >= kOutputChunkSize) {
+        // Big tokens (or the unparsed remainder after an error) go straight
+        // through rather than being copied.
+        ok_ &= writer_->Write(text, handler_);
+        return;
+      }
+    }
+    text.AppendToString(&buffer_);
+  }
+
+  // Returns false if any write so far has failed.
+  bool Flush() {
+    if (!buffer_.empty()) {
+      ok_ &= writer_->Write(buffer_, handler_);
+      buffer_.clear();
+    }
+    return ok_;
+  }
+
+ private:
+  net_instaweb::Writer* writer_;
+  net_instaweb::MessageHandler* handler_;
+  GoogleString buffer_;
+  bool ok_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChunkedOutput);
+};
+
 }  // namespace
 
 JsMinifyingTokenizer::JsMinifyingTokenizer(
@@ -601,7 +647,7 @@ JsMinifyingTokenizer::JsMinifyingTokenizer(
     : tokenizer_(patterns, input), whitespace_(kNoWhitespace),
       prev_type_(JsKeywords::kEndOfInput), prev_token_(),
       next_type_(JsKeywords::kEndOfInput), next_token_(),
-      mappings_(NULL) {}
+      mappings_(NULL), mappings_encoder_(NULL), has_encoded_mapping_(false) {}
 
 JsMinifyingTokenizer::JsMinifyingTokenizer(
     const JsTokenizerPatterns* patterns, StringPiece input,
@@ -609,7 +655,18 @@ JsMinifyingTokenizer::JsMinifyingTokenizer(
     : tokenizer_(patterns, input), whitespace_(kNoWhitespace),
       prev_type_(JsKeywords::kEndOfInput), prev_token_(),
       next_type_(JsKeywords::kEndOfInput), next_token_(),
-      mappings_(mappings),
+      mappings_(mappings), mappings_encoder_(NULL),
+      has_encoded_mapping_(false),
+      current_position_(0, 0, 0, 0, 0), next_position_(0, 0, 0, 0, 0) {}
+
+JsMinifyingTokenizer::JsMinifyingTokenizer(
+    const JsTokenizerPatterns* patterns, StringPiece input,
+    net_instaweb::source_map::MappingsEncoder* mappings_encoder)
+    : tokenizer_(patterns, input), whitespace_(kNoWhitespace),
+      prev_type_(JsKeywords::kEndOfInput), prev_token_(),
+      next_type_(JsKeywords::kEndOfInput), next_token_(),
+      mappings_(NULL), mappings_encoder_(mappings_encoder),
+      has_encoded_mapping_(false),
       current_position_(0, 0, 0, 0, 0), next_position_(0, 0, 0, 0, 0) {}
 
 JsMinifyingTokenizer::~JsMinifyingTokenizer() {}
@@ -617,9 +674,20 @@ JsMinifyingTokenizer::~JsMinifyingTokenizer() {}
 JsKeywords::Type JsMinifyingTokenizer::NextToken(StringPiece* token_out) {
   net_instaweb::source_map::Mapping token_out_position;
   const JsKeywords::Type type = NextTokenHelper(token_out, &token_out_position);
-  if (mappings_ != NULL && type != JsKeywords::kEndOfInput &&
-      ShouldRecordStep(*mappings_, token_out_position)) {
-    mappings_->push_back(token_out_position);
+  if (type != JsKeywords::kEndOfInput) {
+    if (mappings_ != NULL) {
+      if (ShouldRecordStep(mappings_->empty() ? NULL : &mappings_->back(),
+                           token_out_position)) {
+        mappings_->push_back(token_out_position);
+      }
+    } else if (mappings_encoder_ != NULL) {
+      if (ShouldRecordStep(has_encoded_mapping_ ? &encoded_mapping_ : NULL,
+                           token_out_position) &&
+          mappings_encoder_->Add(token_out_position)) {
+        encoded_mapping_ = token_out_position;
+        has_encoded_mapping_ = true;
+      }
+    }
   }
   // Update generated file line and col # with the output token.
   // Note: We use a helper function to avoid having to add this before every
@@ -769,6 +837,31 @@ bool MinifyUtf8JsWithSourceMap(
   }
 }
 
+bool MinifyUtf8JsToWriter(
+    const JsTokenizerPatterns* patterns, StringPiece input,
+    net_instaweb::Writer* writer, net_instaweb::MessageHandler* handler,
+    net_instaweb::source_map::MappingsEncoder* mappings_encoder) {
+  JsMinifyingTokenizer tokenizer(patterns, input, mappings_encoder);
+  ChunkedOutput output(writer, handler);
+  while (true) {
+    StringPiece token;
+    switch (tokenizer.NextToken(&token)) {
+      case JsKeywords::kEndOfInput:
+        DCHECK(token.empty());
+        DCHECK(!tokenizer.has_error());
+        return output.Flush();
+      case JsKeywords::kError:
+        DCHECK(tokenizer.has_error());
+        output.Append(token);
+        output.Flush();
+        return false;
+      default:
+        output.Append(token);
+        break;
+    }
+  }
+}
+
 bool MinifyJs(const StringPiece& input, GoogleString* out) {
   return legacy::MinifyJs(input, out);
 }
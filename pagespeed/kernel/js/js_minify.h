@@ -22,6 +22,11 @@
 #include "pagespeed/kernel/js/js_keywords.h"
 #include "pagespeed/kernel/js/js_tokenizer.h"
 
+namespace net_instaweb {
+class MessageHandler;
+class Writer;
+}  // namespace net_instaweb
+
 namespace pagespeed {
 
 namespace js {
@@ -52,6 +57,13 @@ class JsMinifyingTokenizer {
       const JsTokenizerPatterns* patterns, StringPiece input,
       net_instaweb::source_map::MappingVector* mappings);
 
+  // Version that encodes source mappings as it goes rather than collecting
+  // them, which takes a fraction of the memory for large inputs.  The same
+  // ASCII-only caveat applies.
+  JsMinifyingTokenizer(
+      const JsTokenizerPatterns* patterns, StringPiece input,
+      net_instaweb::source_map::MappingsEncoder* mappings_encoder);
+
   ~JsMinifyingTokenizer();
 
   // Gets the next token type from the input,
@@ -77,6 +89,10 @@ class JsMinifyingTokenizer {
   JsKeywords::Type next_type_;
   StringPiece next_token_;
   net_instaweb::source_map::MappingVector* mappings_;
+  net_instaweb::source_map::MappingsEncoder* mappings_encoder_;
+  // Last mapping given to mappings_encoder_, if has_encoded_mapping_.
+  net_instaweb::source_map::Mapping encoded_mapping_;
+  bool has_encoded_mapping_;
   net_instaweb::source_map::Mapping current_position_;
   net_instaweb::source_map::Mapping next_position_;
 
@@ -105,6 +121,17 @@ bool MinifyUtf8JsWithSourceMap(
     StringPiece input, GoogleString* output,
     net_instaweb::source_map::MappingVector* mappings);
 
+// Minifies like MinifyUtf8JsWithSourceMap, but streams the output to writer
+// in chunks of bounded size instead of building it up in a string, and
+// encodes the source mappings incrementally into mappings_encoder (which may
+// be NULL if they are not wanted).  Returns false if the code did not parse
+// or a write failed; in the former case the rest of the input is passed
+// through unmodified as above.
+bool MinifyUtf8JsToWriter(
+    const JsTokenizerPatterns* patterns, StringPiece input,
+    net_instaweb::Writer* writer, net_instaweb::MessageHandler* handler,
+    net_instaweb::source_map::MappingsEncoder* mappings_encoder);
+
 ///////////////////////////////////////////////////////////////////////////////
 // Below is the old JsMinify implementation.  It has several known issues that
 // the newer implementation above fixes, but for now is still more
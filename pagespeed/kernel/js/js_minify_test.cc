@@ -17,9 +17,12 @@
 
 #include "pagespeed/kernel/base/google_message_handler.h"
 #include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/source_map.h"
 #include "pagespeed/kernel/base/stdio_file_system.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
 #include "pagespeed/kernel/js/js_keywords.h"
 
 namespace {
@@ -699,4 +702,36 @@ TEST_F(JsMinifyTest, SourceMapsComplex) {
   EXPECT_EQ(expected_map, MappingsToString(mappings));
 }
 
+// Checks that streaming to a Writer gives the same output and source map as
+// minifying into a string, including across output chunk boundaries.
+TEST_F(JsMinifyTest, MinifyToWriterMatchesString) {
+  GoogleString big;
+  for (int i = 0; i < 100; ++i) {
+    StrAppend(&big, kBeforeCompilation, "\n");
+  }
+  // The third input fails to parse half way through.
+  const GoogleString inputs[] = {
+    kBeforeCompilation, big,
+    net_instaweb::StrCat(big, "var s = 'unclosed;\n", big), "",
+  };
+  for (int i = 0, n = arraysize(inputs); i < n; ++i) {
+    GoogleString expected;
+    net_instaweb::source_map::MappingVector mappings;
+    bool expected_ok = pagespeed::js::MinifyUtf8JsWithSourceMap(
+        &patterns_, inputs[i], &expected, &mappings);
+    GoogleString expected_mappings;
+    ASSERT_TRUE(net_instaweb::source_map::EncodeMappings(
+        mappings, &expected_mappings));
+
+    GoogleString output, encoded_mappings;
+    net_instaweb::StringWriter writer(&output);
+    net_instaweb::NullMessageHandler handler;
+    net_instaweb::source_map::MappingsEncoder encoder(&encoded_mappings);
+    EXPECT_EQ(expected_ok, pagespeed::js::MinifyUtf8JsToWriter(
+        &patterns_, inputs[i], &writer, &handler, &encoder)) << i;
+    EXPECT_EQ(expected, output) << i;
+    EXPECT_EQ(expected_mappings, encoded_mappings) << i;
+  }
+}
+
 }  // namespace
@@ -296,6 +296,222 @@ const char* const kLineContinuationRegex =
     "(in|instanceof)($|[^$_\\p{Lu}\\p{Ll}\\p{Lt}\\p{Lm}\\p{Lo}\\p{Nl}\\p{Mn}"
     "\\p{Mc}\\p{Nd}\\p{Pc}\xE2\x80\x8C\xE2\x80\x8D\\\\])";
 
+// Bits stored in JsTokenizerPatterns::char_classes for each byte value.  The
+// regexes above are only needed for the sake of unicode; the Scan* functions
+// below use these bits to tokenize plain ASCII input without them, and tell
+// the caller to fall back to the regex when they run into anything else.
+enum CharClassBits {
+  kIdentifierStartChar = 1 << 0,  // [$_A-Za-z\\]
+  kIdentifierPartChar = 1 << 1,   // [$_A-Za-z0-9\\]
+  kHorizontalSpaceChar = 1 << 2,  // [ \t\f\v]
+  kLinebreakChar = 1 << 3,        // [\n\r]
+  kNonAsciiChar = 1 << 4,         // [\x80-\xFF]
+  kDecimalDigitChar = 1 << 5,     // [0-9]
+  kOctalDigitChar = 1 << 6,       // [0-7]
+  kHexDigitChar = 1 << 7,         // [0-9A-Fa-f]
+};
+
+// U+2028 LINE SEPARATOR and U+2029 PARAGRAPH SEPARATOR, the only non-ASCII
+// linebreaks, are encoded in UTF-8 as E2 80 A8 and E2 80 A9.  Any other
+// non-ASCII byte is just content as far as comments and strings go.
+const unsigned char kUnicodeLinebreakLeadByte = 0xE2;
+
+// Returns the size of the line comment at the start of input, not including
+// the linebreak that ends it, or -1 if the comment may end in a unicode
+// linebreak and so must be matched with line_comment_pattern.
+int ScanLineComment(const uint8* char_classes, StringPiece input) {
+  int index = 2;  // For "//".
+  if (strings::StartsWith(input, "<!--")) {
+    index = 4;
+  } else if (strings::StartsWith(input, "-->")) {
+    index = 3;
+  }
+  for (int size = input.size(); index < size; ++index) {
+    const unsigned char ch = input[index];
+    if ((char_classes[ch] & kLinebreakChar) != 0) {
+      break;
+    } else if (ch == kUnicodeLinebreakLeadByte) {
+      return -1;
+    }
+  }
+  return index;
+}
+
+// Returns the size of the string literal at the start of input, or 0 if an
+// unescaped linebreak ends it before the closing quote.  Returns -1 if the
+// literal may contain a unicode linebreak, or is not closed before the end
+// of input; string_literal_pattern must then decide where it ends (for the
+// latter case, the regex backtracks to try treating backslashes as literal
+// characters, which we don't want to replicate here).
+int ScanString(StringPiece input) {
+  const char quote = input[0];
+  for (int index = 1, size = input.size(); index < size; ++index) {
+    const unsigned char ch = input[index];
+    if (ch == quote) {
+      return index + 1;
+    } else if (ch == '\\') {
+      // An escape sequence is a backslash followed by any one character,
+      // where \r\n and \n\r count as one.
+      if (index + 1 == size) {
+        return -1;
+      }
+      const unsigned char next = input[++index];
+      if (next == kUnicodeLinebreakLeadByte) {
+        return -1;
+      } else if (index + 1 < size &&
+                 ((next == '\r' && input[index + 1] == '\n') ||
+                  (next == '\n' && input[index + 1] == '\r'))) {
+        ++index;
+      }
+    } else if (ch == '\n' || ch == '\r') {
+      return 0;
+    } else if (ch == kUnicodeLinebreakLeadByte) {
+      return -1;
+    }
+  }
+  return -1;
+}
+
+// Returns the size of the numeric literal at the start of input, following
+// kNumericLiteralPosixRegex: the longest of a hexadecimal, octal or decimal
+// literal.  Returns 0 if there is none.
+int ScanNumber(const uint8* char_classes, StringPiece input) {
+  const int size = input.size();
+  int longest = 0;
+  if (input[0] == '0') {
+    // Hexadecimal: 0[xX][0-9a-fA-F]+
+    if (size > 1 && (input[1] == 'x' || input[1] == 'X')) {
+      int index = 2;
+      while (index < size &&
+             (char_classes[static_cast<uint8>(input[index])] &
+              kHexDigitChar) != 0) {
+        ++index;
+      }
+      if (index > 2) {
+        longest = index;
+      }
+    }
+    // Octal: 0[0-7]+
+    int index = 1;
+    while (index < size &&
+           (char_classes[static_cast<uint8>(input[index])] &
+            kOctalDigitChar) != 0) {
+      ++index;
+    }
+    if (index > 1 && index > longest) {
+      longest = index;
+    }
+  }
+  // Decimal: an integer part that is either a single zero, or starts with a
+  // nonzero digit, or has an 8 or 9 in it somewhere; or else no integer part
+  // but a decimal point followed by at least one digit.
+  int index = 0;
+  if (input[0] == '.') {
+    index = 1;
+    while (index < size &&
+           (char_classes[static_cast<uint8>(input[index])] &
+            kDecimalDigitChar) != 0) {
+      ++index;
+    }
+    if (index == 1) {
+      return longest;
+    }
+  } else if ((char_classes[static_cast<uint8>(input[0])] &
+              kDecimalDigitChar) != 0) {
+    bool has_non_octal_digit = false;
+    index = 1;
+    while (index < size &&
+           (char_classes[static_cast<uint8>(input[index])] &
+            kDecimalDigitChar) != 0) {
+      has_non_octal_digit |= (input[index] >= '8');
+      ++index;
+    }
+    if (input[0] == '0' && !has_non_octal_digit) {
+      index = 1;
+    }
+    // An optional decimal point and fractional part.
+    if (index < size && input[index] == '.') {
+      ++index;
+      while (index < size &&
+             (char_classes[static_cast<uint8>(input[index])] &
+              kDecimalDigitChar) != 0) {
+        ++index;
+      }
+    }
+  } else {
+    return longest;
+  }
+  // An optional exponent.
+  if (index < size && (input[index] == 'e' || input[index] == 'E')) {
+    int exponent_end = index + 1;
+    if (exponent_end < size &&
+        (input[exponent_end] == '+' || input[exponent_end] == '-')) {
+      ++exponent_end;
+    }
+    const int digits_start = exponent_end;
+    while (exponent_end < size &&
+           (char_classes[static_cast<uint8>(input[exponent_end])] &
+            kDecimalDigitChar) != 0) {
+      ++exponent_end;
+    }
+    if (exponent_end > digits_start) {
+      index = exponent_end;
+    }
+  }
+  return (index > longest) ? index : longest;
+}
+
+// Returns the size of the operator at the start of input, following
+// kOperatorRegex, or 0 if there is none.
+int ScanOperator(StringPiece input) {
+  const int size = input.size();
+  const char first = input[0];
+  const char second = (size > 1) ? input[1] : '\0';
+  switch (first) {
+    case '~':
+      return 1;
+    case '&':
+    case '|':
+    case '+':
+    case '-':
+      // && || ++ --, or else as for * below.
+      if (second == first) {
+        return 2;
+      }
+      FALLTHROUGH_INTENDED;
+    case '*':
+    case '/':
+    case '%':
+    case '^':
+      // * *= / /= % %= ^ ^= & &= | |= + += - -=
+      return (second == '=') ? 2 : 1;
+    case '!':
+    case '=': {
+      // ! != !== = == ===
+      int index = 1;
+      while (index < size && index < 3 && input[index] == '=') {
+        ++index;
+      }
+      return index;
+    }
+    case '<':
+    case '>': {
+      // < <= << <<= > >= >> >>= >>> >>>=
+      const int max_repeat = (first == '<') ? 2 : 3;
+      int index = 1;
+      while (index < size && index < max_repeat && input[index] == first) {
+        ++index;
+      }
+      if (index < size && input[index] == '=') {
+        ++index;
+      }
+      return index;
+    }
+    default:
+      return 0;
+  }
+}
+
 }  // namespace
 
 JsTokenizer::JsTokenizer(const JsTokenizerPatterns* patterns,
@@ -584,6 +800,10 @@ JsKeywords::Type JsTokenizer::ConsumeBlockComment(StringPiece* token_out) {
 }
 
 JsKeywords::Type JsTokenizer::ConsumeLineComment(StringPiece* token_out) {
+  const int size = ScanLineComment(patterns_->char_classes, input_);
+  if (size >= 0) {
+    return Emit(JsKeywords::kComment, size, token_out);
+  }
   Re2StringPiece unconsumed = StringPieceToRe2(input_);
   Re2StringPiece linebreak;
   if (!RE2::Consume(&unconsumed, patterns_->line_comment_pattern, &linebreak)) {
@@ -714,21 +934,19 @@ bool JsTokenizer::TryConsumeIdentifierOrKeyword(
   // into a non-ASCII byte will we resort to RE2.
   int index = 0;
   {
+    const uint8* char_classes = patterns_->char_classes;
     bool use_regex = false;
-    const unsigned char first = input_[0];
-    if (first >= 0x80) {
+    const uint8 first_class = char_classes[static_cast<uint8>(input_[0])];
+    if ((first_class & kNonAsciiChar) != 0) {
       use_regex = true;
-    } else if (('a' <= first && first <= 'z') || first == '_' ||
-               ('A' <= first && first <= 'Z') || first == '$' ||
-               first == '\\') {
+    } else if ((first_class & kIdentifierStartChar) != 0) {
       int size = input_.size();
       for (index = 1; index < size; ++index) {
-        const unsigned char ch = input_[index];
-        if (ch >= 0x80) {
+        const uint8 ch_class = char_classes[static_cast<uint8>(input_[index])];
+        if ((ch_class & kNonAsciiChar) != 0) {
           use_regex = true;
           break;
-        } else if (!net_instaweb::IsAsciiAlphaNumeric(ch) && ch != '_' &&
-                   ch != '$' && ch != '\\') {
+        } else if ((ch_class & kIdentifierPartChar) == 0) {
           break;
         }
       }
@@ -868,27 +1086,25 @@ bool JsTokenizer::TryConsumeIdentifierOrKeyword(
 
 JsKeywords::Type JsTokenizer::ConsumeNumber(StringPiece* token_out) {
   DCHECK(!input_.empty());
-  Re2StringPiece unconsumed = StringPieceToRe2(input_);
-  if (!RE2::Consume(&unconsumed, patterns_->numeric_literal_pattern)) {
+  const int size = ScanNumber(patterns_->char_classes, input_);
+  if (size == 0) {
     // We only call ConsumeNumber when we're sure we're looking at a numeric
     // literal, so this ought not happen even for pathalogical input.
     LOG(DFATAL) << "Failed to match number pattern: " << input_.substr(0, 50);
     return Error(token_out);
   }
   PushExpression();
-  return Emit(JsKeywords::kNumber, input_.size() - unconsumed.size(),
-              token_out);
+  return Emit(JsKeywords::kNumber, size, token_out);
 }
 
 JsKeywords::Type JsTokenizer::ConsumeOperator(StringPiece* token_out) {
   DCHECK(!input_.empty());
-  Re2StringPiece unconsumed = StringPieceToRe2(input_);
-  if (!RE2::Consume(&unconsumed, patterns_->operator_pattern)) {
+  const int size = ScanOperator(input_);
+  if (size == 0) {
     // Unrecognized character:
     return Error(token_out);
   }
-  const JsKeywords::Type type =
-      Emit(JsKeywords::kOperator, input_.size() - unconsumed.size(), token_out);
+  const JsKeywords::Type type = Emit(JsKeywords::kOperator, size, token_out);
   const StringPiece token = *token_out;
   // Is this a postfix operator?  We treat those differently than prefix or
   // unary operators.
@@ -1013,15 +1229,22 @@ JsKeywords::Type JsTokenizer::ConsumeSlash(StringPiece* token_out) {
 JsKeywords::Type JsTokenizer::ConsumeString(StringPiece* token_out) {
   DCHECK(!input_.empty());
   DCHECK(input_[0] == '"' || input_[0] == '\'');
-  Re2StringPiece unconsumed = StringPieceToRe2(input_);
-  if (!RE2::Consume(&unconsumed, patterns_->string_literal_pattern) ||
-      input_[input_.size() - unconsumed.size() - 1] != input_[0]) {
+  int size = ScanString(input_);
+  if (size < 0) {
+    Re2StringPiece unconsumed = StringPieceToRe2(input_);
+    if (!RE2::Consume(&unconsumed, patterns_->string_literal_pattern) ||
+        input_[input_.size() - unconsumed.size() - 1] != input_[0]) {
+      size = 0;
+    } else {
+      size = input_.size() - unconsumed.size();
+    }
+  }
+  if (size == 0) {
     // EOF or an unescaped linebreak in the string will cause an error.
     return Error(token_out);
   }
   PushExpression();
-  return Emit(JsKeywords::kStringLiteral, input_.size() - unconsumed.size(),
-              token_out);
+  return Emit(JsKeywords::kStringLiteral, size, token_out);
 }
 
 bool JsTokenizer::TryConsumeWhitespace(
@@ -1032,17 +1255,18 @@ bool JsTokenizer::TryConsumeWhitespace(
   // RE2 here mainly for the unicode support, but most JS files are plain
   // ASCII.  So first try to match against ASCII whitespace; only if we run
   // into a non-ASCII byte will we resort to RE2.
+  const uint8* char_classes = patterns_->char_classes;
   bool has_linebreak = false;
   bool use_regex = false;
   int token_size = 0, size = input_.size();
   for (; token_size < size; ++token_size) {
-    const unsigned char ch = input_[token_size];
-    if (ch >= 0x80) {
+    const uint8 ch_class = char_classes[static_cast<uint8>(input_[token_size])];
+    if ((ch_class & kNonAsciiChar) != 0) {
       use_regex = true;
       break;
-    } else if (ch == '\n' || ch == '\r') {
+    } else if ((ch_class & kLinebreakChar) != 0) {
       has_linebreak = true;
-    } else if (ch != ' ' && ch != '\t' && ch != '\f' && ch != '\v') {
+    } else if ((ch_class & kHorizontalSpaceChar) == 0) {
       break;
     }
   }
@@ -1291,6 +1515,29 @@ JsTokenizerPatterns::JsTokenizerPatterns()
   DCHECK(string_literal_pattern.ok());
   DCHECK(whitespace_pattern.ok());
   DCHECK(line_continuation_pattern.ok());
+
+  for (int ch = 0; ch < 256; ++ch) {
+    uint8 bits = 0;
+    if (ch >= 0x80) {
+      bits |= kNonAsciiChar;
+    } else if ('0' <= ch && ch <= '9') {
+      bits |= kIdentifierPartChar | kDecimalDigitChar;
+      if (ch <= '7') {
+        bits |= kOctalDigitChar;
+      }
+    } else if (net_instaweb::IsAsciiAlphaNumeric(ch) || ch == '_' ||
+               ch == '$' || ch == '\\') {
+      bits |= kIdentifierStartChar | kIdentifierPartChar;
+    } else if (ch == ' ' || ch == '\t' || ch == '\f' || ch == '\v') {
+      bits |= kHorizontalSpaceChar;
+    } else if (ch == '\n' || ch == '\r') {
+      bits |= kLinebreakChar;
+    }
+    if (net_instaweb::IsHexDigit(ch)) {
+      bits |= kHexDigitChar;
+    }
+    char_classes[ch] = bits;
+  }
 }
 
 JsTokenizerPatterns::~JsTokenizerPatterns() {}
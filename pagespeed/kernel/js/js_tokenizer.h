@@ -184,7 +184,8 @@ class JsTokenizer {
   DISALLOW_COPY_AND_ASSIGN(JsTokenizer);
 };
 
-// Structure to store RE2 patterns that can be shared by instances of
+// Structure to store RE2 patterns (and a lookup table that lets us avoid them
+// for plain ASCII input) that can be shared by instances of
 // JsTokenizer.  These patterns are slightly expensive to compile, so we'd
 // rather not create one for every JsTokenizer instance, but unfortunately C++
 // static initializers can run in non-deterministic order and cause other
@@ -205,6 +206,10 @@ struct JsTokenizerPatterns {
   const RE2 whitespace_pattern;
   const RE2 line_continuation_pattern;
 
+  // Character-class bits for each byte value, used to tokenize the common
+  // ASCII cases without the regexes above.
+  uint8 char_classes[256];
+
  private:
   DISALLOW_COPY_AND_ASSIGN(JsTokenizerPatterns);
 };
@@ -22,6 +22,7 @@
 #include "pagespeed/kernel/base/stdio_file_system.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/js/js_keywords.h"
+#include "pagespeed/kernel/util/re2.h"
 
 using pagespeed::JsKeywords;
 using pagespeed::js::JsTokenizer;
@@ -1586,6 +1587,58 @@ TEST_F(JsTokenizerTest, Latin1Input) {
   ExpectEndOfInput();
 }
 
+// Numbers, operators and (mostly) strings are scanned by hand rather than
+// with the regexes in JsTokenizerPatterns; make sure the two agree on where
+// such tokens end.
+TEST_F(JsTokenizerTest, ScannersAgreeWithPatterns) {
+  JsTokenizerPatterns patterns;
+  StringPiece token;
+
+  const char* const kNumbers[] = {
+    "0", "07", "08", "0778", "0x1F", "0x", "0X1g", "1.5e+3", "1e", "1.e5",
+    "09.5", "07.5", ".5e-2", "5..a", "0e5", "00.5", "0119e2x",
+  };
+  for (const char* number : kNumbers) {
+    Re2StringPiece unconsumed(number);
+    ASSERT_TRUE(RE2::Consume(&unconsumed, patterns.numeric_literal_pattern));
+    JsTokenizer tokenizer(&patterns, number);
+    EXPECT_EQ(JsKeywords::kNumber, tokenizer.NextToken(&token)) << number;
+    EXPECT_EQ(strlen(number) - unconsumed.size(), token.size()) << number;
+  }
+
+  const char* const kOperators[] = {
+    "&&=", "||", "+++", "-=", "~~", "!==", "!===", "<<=", "<<<", ">>>=",
+    ">>>>", "%=", "^^", "*==", "&|", "=>",
+  };
+  for (const char* op : kOperators) {
+    Re2StringPiece unconsumed(op);
+    ASSERT_TRUE(RE2::Consume(&unconsumed, patterns.operator_pattern));
+    JsTokenizer tokenizer(&patterns, op);
+    EXPECT_EQ(JsKeywords::kOperator, tokenizer.NextToken(&token)) << op;
+    EXPECT_EQ(strlen(op) - unconsumed.size(), token.size()) << op;
+  }
+
+  const char* const kStrings[] = {
+    "'a\\'b'", "\"a\\\r\nb\\\n\r\"", "'it\\'s", "'a\\", "'a\nb'",
+    "'\xC3\xA9\\\xC3\xA9'", "'a\xE2\x80\xA8" "b'", "'a\\\xE2\x80\xA8" "b'",
+    "\"a'\"", "'\xE2\x82\xAC'",
+  };
+  for (const char* str : kStrings) {
+    Re2StringPiece unconsumed(str);
+    const bool ok =
+        RE2::Consume(&unconsumed, patterns.string_literal_pattern) &&
+        str[strlen(str) - unconsumed.size() - 1] == str[0];
+    JsTokenizer tokenizer(&patterns, str);
+    if (ok) {
+      EXPECT_EQ(JsKeywords::kStringLiteral, tokenizer.NextToken(&token))
+          << str;
+      EXPECT_EQ(strlen(str) - unconsumed.size(), token.size()) << str;
+    } else {
+      EXPECT_EQ(JsKeywords::kError, tokenizer.NextToken(&token)) << str;
+    }
+  }
+}
+
 TEST_F(JsTokenizerTest, JsonHeuristic) {
   // Sometimes we put JSON data through the JavaScript tokenizer.  Most JSON
   // will parse just fine, but JSON object literals, without parse context to
@@ -17,9 +17,11 @@
 #include "pagespeed/kernel/sharedmem/shared_mem_statistics.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 #include <limits>
+#include <vector>
 
 #include "base/logging.h"
 #include "pagespeed/kernel/base/abstract_mutex.h"
@@ -31,6 +33,7 @@
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/util/statistics_logger.h"
 
 namespace net_instaweb {
@@ -52,6 +55,34 @@ const char kStatisticsObjName[] = "statistics";
 // statistics.
 const char kTimestampVariable[] = "timestamp_";
 
+// Default length of the windows histograms report on.
+const int64 kDefaultHistogramWindowMs = Timer::kMinuteMs;
+
+// C++11 has no atomic arithmetic on doubles, so these use compare-and-swap
+// loops.  compare_exchange_weak reloads *target into current on failure.
+void AtomicAdd(std::atomic<double>* target, double delta) {
+  double current = target->load(std::memory_order_relaxed);
+  while (!target->compare_exchange_weak(current, current + delta,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+void AtomicMin(std::atomic<double>* target, double value) {
+  double current = target->load(std::memory_order_relaxed);
+  while ((value < current) &&
+         !target->compare_exchange_weak(current, value,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+void AtomicMax(std::atomic<double>* target, double value) {
+  double current = target->load(std::memory_order_relaxed);
+  while ((value > current) &&
+         !target->compare_exchange_weak(current, value,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
 }  // namespace
 
 // Our shared memory storage format is an array of (mutex, int64).
@@ -89,6 +120,11 @@ SharedMemStatistics::Hist* SharedMemStatistics::NewHistogram(
   return new Hist(name, this);
 }
 
+SharedMemStatistics::TVar* SharedMemStatistics::NewTimedVariable(
+    StringPiece name) {
+  return new TVar(name, this);
+}
+
 int64 SharedMemVariable::GetLockHeld() const {
   return *value_ptr_;
 }
@@ -121,9 +157,79 @@ AbstractMutex* SharedMemVariable::mutex() const {
   return mutex_.get();
 }
 
+SharedMemBatchedVariable::SharedMemBatchedVariable(StringPiece name,
+                                                   Statistics* stats)
+    : impl_(name, stats),
+      timer_(NULL),
+      flush_interval_ms_(0),
+      pending_delta_(0),
+      next_flush_ms_(0),
+      last_value_(0) {
+}
+
+SharedMemBatchedVariable::~SharedMemBatchedVariable() {
+}
+
+void SharedMemBatchedVariable::EnableBatching(Timer* timer,
+                                              int64 flush_interval_ms) {
+  if (impl_.mutex() == NULL) {
+    return;
+  }
+  timer_ = timer;
+  flush_interval_ms_ = flush_interval_ms;
+  // Anything pending was inherited from the process we forked from, which
+  // will flush it itself.
+  pending_delta_ = 0;
+  next_flush_ms_ = timer_->NowMs() + flush_interval_ms_;
+  last_value_ = impl_.Get();
+}
+
+int64 SharedMemBatchedVariable::FlushPending() const {
+  DCHECK(batching());
+  next_flush_ms_ = timer_->NowMs() + flush_interval_ms_;
+  int64 delta = pending_delta_.exchange(0);
+  int64 value;
+  {
+    ScopedMutex hold_lock(impl_.mutex());
+    value = impl_.GetLockHeld() + delta;
+    impl_.SetReturningPreviousValueLockHeld(value);
+  }
+  last_value_ = value;
+  return value;
+}
+
+int64 SharedMemBatchedVariable::Get() const {
+  if (!batching()) {
+    return impl_.Get();
+  }
+  return FlushPending();
+}
+
+void SharedMemBatchedVariable::Clear() {
+  if (batching()) {
+    pending_delta_ = 0;
+    last_value_ = 0;
+  }
+  impl_.Set(0);
+}
+
+int64 SharedMemBatchedVariable::AddHelper(int64 delta) {
+  if (!batching()) {
+    return impl_.AddHelper(delta);
+  }
+  int64 pending = (pending_delta_ += delta);
+  if (timer_->NowMs() >= next_flush_ms_) {
+    return FlushPending();
+  }
+  return last_value_ + pending;
+}
+
 SharedMemHistogram::SharedMemHistogram(StringPiece name, Statistics* stats)
     : num_buckets_(kDefaultNumBuckets + kOutOfBoundsCatcherBuckets),
-      buffer_(NULL) {
+      buffer_(NULL),
+      lock_free_(false),
+      timer_(NULL),
+      window_ms_(0) {
 }
 
 SharedMemHistogram::~SharedMemHistogram() {
@@ -157,6 +263,10 @@ void SharedMemHistogram::AttachTo(
   }
   buffer_ = reinterpret_cast<HistogramBody*>(const_cast<char*>(
       segment->Base() + offset + segment->SharedMutexSize()));
+  // Atomics that need a lock get a process-local one, which does nothing to
+  // keep other processes out, so then we use mutex_ as well.
+  lock_free_ = buffer_->count_.is_lock_free() &&
+      buffer_->sum_.is_lock_free() && buffer_->values_[0].is_lock_free();
 }
 
 void SharedMemHistogram::Reset() {
@@ -164,6 +274,13 @@ void SharedMemHistogram::Reset() {
   buffer_ = NULL;
 }
 
+void SharedMemHistogram::EnableWindows(Timer* timer, int64 window_ms) {
+  if (window_ms > 0) {
+    timer_ = timer;
+    window_ms_ = window_ms;
+  }
+}
+
 int SharedMemHistogram::FindBucket(double value) {
   DCHECK(buffer_ != NULL);
   // We add +1 in most of these case here to skip the leftmost catcher bucket.
@@ -185,11 +302,7 @@ int SharedMemHistogram::FindBucket(double value) {
   }
 }
 
-void SharedMemHistogram::Add(double value) {
-  if (buffer_ == NULL) {
-    return;
-  }
-  ScopedMutex hold_lock(mutex_.get());
+int SharedMemHistogram::BucketIndex(double value) {
   // See if we should put the value in one of the out-of-bounds catcher buckets,
   // in which case we will change index from -1.
   int index = -1;
@@ -216,41 +329,87 @@ void SharedMemHistogram::Add(double value) {
 
   if (index < 0 || index >= num_buckets_) {
     LOG(ERROR) << "Invalid bucket index found for" << value;
+    return -1;
+  }
+  return index;
+}
+
+void SharedMemHistogram::Add(double value) {
+  if (buffer_ == NULL) {
+    return;
+  }
+  // The bucket bounds are fixed before values are added, so we can work out
+  // the index without holding mutex_.
+  int index = BucketIndex(value);
+  if (index == -1) {
     return;
   }
-  buffer_->values_[index]++;
-  // Update actual min & max values;
-  if (buffer_->count_ == 0) {
-    buffer_->min_ = value;
-    buffer_->max_ = value;
-  } else if (value < buffer_->min_) {
-    buffer_->min_ = value;
-  } else if (value > buffer_->max_) {
-    buffer_->max_ = value;
+  if (lock_free_) {
+    RecordValue(index, value);
+  } else {
+    ScopedMutex hold_lock(mutex_.get());
+    RecordValue(index, value);
+  }
+}
+
+void SharedMemHistogram::RecordValue(int index, double value) {
+  buffer_->values_[index].fetch_add(1, std::memory_order_relaxed);
+  AtomicMin(&buffer_->min_, value);
+  AtomicMax(&buffer_->max_, value);
+  AtomicAdd(&buffer_->sum_, value);
+  AtomicAdd(&buffer_->sum_of_squares_, value * value);
+  // Count last, so that a reader that sees a value counted also sees it in
+  // min_ and max_.
+  buffer_->count_.fetch_add(1, std::memory_order_release);
+}
+
+void SharedMemHistogram::MaybeRollWindow() {
+  if ((buffer_ == NULL) || (timer_ == NULL)) {
+    return;
+  }
+  int64 now_ms = timer_->NowMs();
+  ScopedMutex hold_lock(mutex_.get());
+  int64 elapsed_ms = now_ms - buffer_->window_start_ms_;
+  if (elapsed_ms < window_ms_) {
+    return;
+  }
+  int64* start_counts = window_start_counts();
+  int64* last_counts = last_window_counts();
+  for (int i = 0; i < num_buckets_; ++i) {
+    int64 count = buffer_->values_[i].load(std::memory_order_relaxed);
+    last_counts[i] = count - start_counts[i];
+    start_counts[i] = count;
   }
-  buffer_->count_++;
-  buffer_->sum_ += value;
-  buffer_->sum_of_squares_ += value * value;
+  // If nothing rolled the window over for a while, the last window is
+  // longer than window_ms_, and says so.
+  buffer_->last_window_ms_ = elapsed_ms;
+  buffer_->window_start_ms_ = now_ms;
 }
 
 void SharedMemHistogram::Clear() {
   if (buffer_ == NULL) {
     return;
   }
-
   ScopedMutex hold_lock(mutex_.get());
   ClearInternal();
 }
 
 void SharedMemHistogram::ClearInternal() {
-  // Throw away data.
-  buffer_->min_ = 0;
-  buffer_->max_ = 0;
+  // Throw away data.  Adds racing with this may leave the fields slightly
+  // inconsistent with each other, which the readers tolerate.
+  buffer_->min_ = std::numeric_limits<double>::infinity();
+  buffer_->max_ = -std::numeric_limits<double>::infinity();
   buffer_->count_ = 0;
   buffer_->sum_ = 0;
   buffer_->sum_of_squares_ = 0;
+  buffer_->window_start_ms_ = (timer_ == NULL) ? 0 : timer_->NowMs();
+  buffer_->last_window_ms_ = 0;
+  int64* start_counts = window_start_counts();
+  int64* last_counts = last_window_counts();
   for (int i = 0; i < num_buckets_; ++i) {
     buffer_->values_[i] = 0;
+    start_counts[i] = 0;
+    last_counts[i] = 0;
   }
 }
 
@@ -311,10 +470,11 @@ double SharedMemHistogram::AverageInternal() {
   if (buffer_ == NULL) {
     return -1.0;
   }
-  if (buffer_->count_ == 0) {
+  double count = buffer_->count_.load(std::memory_order_acquire);
+  if (count == 0) {
     return 0.0;
   }
-  return buffer_->sum_ / buffer_->count_;
+  return buffer_->sum_ / count;
 }
 
 // Return estimated value that is larger than perc% of all data.
@@ -324,19 +484,34 @@ double SharedMemHistogram::PercentileInternal(const double perc) {
   if (buffer_ == NULL) {
     return -1.0;
   }
-  if (buffer_->count_ == 0 || perc < 0) {
+  // Work from a snapshot of the buckets, so that Adds racing with us
+  // can't make the counts disagree with their total.
+  std::vector<int64> counts(num_buckets_);
+  for (int i = 0; i < num_buckets_; ++i) {
+    counts[i] = buffer_->values_[i].load(std::memory_order_relaxed);
+  }
+  return PercentileOfCounts(counts, perc);
+}
+
+double SharedMemHistogram::PercentileOfCounts(const std::vector<int64>& counts,
+                                              double perc) {
+  double total = 0;
+  for (int i = 0; i < num_buckets_; ++i) {
+    total += counts[i];
+  }
+  if (total == 0 || perc < 0) {
     return 0.0;
   }
   // Floor of count_below is the number of values below the percentile.
   // We are indeed looking for the next value in histogram.
-  double count_below = floor(buffer_->count_ * perc / 100);
+  double count_below = floor(total * perc / 100);
   double count = 0;
   int i;
   // Find the bucket which is closest to the bucket that contains
   // the number we want.
   for (i = 0; i < num_buckets_; ++i) {
-    if (count + buffer_->values_[i] <= count_below) {
-      count += buffer_->values_[i];
+    if (count + counts[i] <= count_below) {
+      count += counts[i];
       if (count == count_below) {
         // The first number in (i+1)th bucket is the number we want. Its
         // estimated value is the lower-bound of (i+1)th bucket.
@@ -349,7 +524,7 @@ double SharedMemHistogram::PercentileInternal(const double perc) {
   // The (count_below + 1 - count)th number in bucket i is the number we want.
   // However, we do not know its exact value as we do not have a trace of all
   // values.
-  double fraction = (count_below + 1 - count) / BucketCount(i);
+  double fraction = (count_below + 1 - count) / counts[i];
   double bound = std::min(BucketWidth(), buffer_->max_ - BucketStart(i));
   double ret = BucketStart(i) + fraction * bound;
   return ret;
@@ -359,13 +534,14 @@ double SharedMemHistogram::StandardDeviationInternal() {
   if (buffer_ == NULL) {
     return -1.0;
   }
-  if (buffer_->count_ == 0) {
+  double count = buffer_->count_.load(std::memory_order_acquire);
+  if (count == 0) {
     return 0.0;
   }
-  const double v = (buffer_->sum_of_squares_ * buffer_->count_ -
-                   buffer_->sum_ * buffer_->sum_) /
-                   (buffer_->count_ * buffer_->count_);
-  if (v < buffer_->sum_of_squares_ * std::numeric_limits<double>::epsilon()) {
+  double sum = buffer_->sum_;
+  double sum_of_squares = buffer_->sum_of_squares_;
+  const double v = (sum_of_squares * count - sum * sum) / (count * count);
+  if (v < sum_of_squares * std::numeric_limits<double>::epsilon()) {
     return 0.0;
   }
   return std::sqrt(v);
@@ -375,13 +551,16 @@ double SharedMemHistogram::CountInternal() {
   if (buffer_ == NULL) {
     return -1.0;
   }
-  return buffer_->count_;
+  return buffer_->count_.load(std::memory_order_acquire);
 }
 
 double SharedMemHistogram::MaximumInternal() {
   if (buffer_ == NULL) {
     return -1.0;
   }
+  if (buffer_->count_.load(std::memory_order_acquire) == 0) {
+    return 0.0;
+  }
   return buffer_->max_;
 }
 
@@ -389,9 +568,40 @@ double SharedMemHistogram::MinimumInternal() {
   if (buffer_ == NULL) {
     return -1.0;
   }
+  if (buffer_->count_.load(std::memory_order_acquire) == 0) {
+    return 0.0;
+  }
   return buffer_->min_;
 }
 
+double SharedMemHistogram::WindowMsInternal() {
+  if (buffer_ == NULL) {
+    return 0.0;
+  }
+  return buffer_->last_window_ms_;
+}
+
+double SharedMemHistogram::WindowCountInternal() {
+  if (buffer_ == NULL) {
+    return 0.0;
+  }
+  const int64* last_counts = last_window_counts();
+  double count = 0;
+  for (int i = 0; i < num_buckets_; ++i) {
+    count += last_counts[i];
+  }
+  return count;
+}
+
+double SharedMemHistogram::WindowPercentileInternal(const double perc) {
+  if (buffer_ == NULL) {
+    return 0.0;
+  }
+  const int64* last_counts = last_window_counts();
+  std::vector<int64> counts(last_counts, last_counts + num_buckets_);
+  return PercentileOfCounts(counts, perc);
+}
+
 double SharedMemHistogram::BucketStart(int index) {
   if (buffer_ == NULL) {
     return -1.0;
@@ -428,7 +638,7 @@ double SharedMemHistogram::BucketCount(int index) {
   if (index < 0 || index >= num_buckets_) {
     return -1.0;
   }
-  return buffer_->values_[index];
+  return buffer_->values_[index].load(std::memory_order_relaxed);
 }
 
 double SharedMemHistogram::BucketWidth() {
@@ -454,7 +664,8 @@ SharedMemStatistics::SharedMemStatistics(
     const GoogleString& filename_prefix, AbstractSharedMem* shm_runtime,
     MessageHandler* message_handler, FileSystem* file_system, Timer* timer)
     : shm_runtime_(shm_runtime), filename_prefix_(filename_prefix),
-      frozen_(false) {
+      frozen_(false), timer_(timer), flush_interval_ms_(0),
+      histogram_window_ms_(kDefaultHistogramWindowMs) {
   if (logging) {
     if (logging_file.size() > 0) {
       SharedMemVariable* timestamp_impl =
@@ -471,6 +682,21 @@ SharedMemStatistics::SharedMemStatistics(
 }
 
 SharedMemStatistics::~SharedMemStatistics() {
+  // The variables outlive segment_, so this is our last chance to hand over
+  // their pending deltas.
+  FlushPendingUpdates();
+}
+
+void SharedMemStatistics::FlushPendingUpdates() {
+  for (size_t i = 0; i < variables_size(); ++i) {
+    SharedMemBatchedVariable* var = variables(i);
+    if (var->batching() && (var->pending_delta_ != 0)) {
+      var->FlushPending();
+    }
+  }
+  for (size_t i = 0; i < histograms_size(); ++i) {
+    histograms(i)->MaybeRollWindow();
+  }
 }
 
 bool SharedMemStatistics::InitMutexes(size_t per_var,
@@ -555,6 +781,9 @@ bool SharedMemStatistics::Init(bool parent,
   for (size_t i = 0; i < variables_size(); ++i, pos += per_var) {
     if (ok) {
       variables(i)->impl()->AttachTo(segment_.get(), pos, message_handler);
+      if (flush_interval_ms_ > 0) {
+        variables(i)->EnableBatching(timer_, flush_interval_ms_);
+      }
     } else {
       variables(i)->impl()->Reset();
     }
@@ -572,6 +801,7 @@ bool SharedMemStatistics::Init(bool parent,
     SharedMemHistogram* hist = histograms(i);
     if (ok) {
       hist->AttachTo(segment_.get(), pos, message_handler);
+      hist->EnableWindows(timer_, histogram_window_ms_);
       if (parent) {
         hist->Init();
       }
@@ -595,6 +825,7 @@ bool SharedMemStatistics::Init(bool parent,
 
 void SharedMemStatistics::GlobalCleanup(MessageHandler* message_handler) {
   if (segment_.get() != NULL) {
+    FlushPendingUpdates();
     shm_runtime_->DestroySegment(SegmentName(), message_handler);
   }
 }
@@ -17,7 +17,9 @@
 #ifndef PAGESPEED_KERNEL_SHAREDMEM_SHARED_MEM_STATISTICS_H_
 #define PAGESPEED_KERNEL_SHAREDMEM_SHARED_MEM_STATISTICS_H_
 
+#include <atomic>
 #include <cstddef>
+#include <vector>
 
 #include "pagespeed/kernel/base/abstract_mutex.h"
 #include "pagespeed/kernel/base/abstract_shared_mem.h"
@@ -39,8 +41,12 @@ class Timer;
 // These statistics will be shared amongst all processes and threads
 // spawned by our host.  Note that we will be obtaining a per-variable mutex for
 // every read and write to these variables.  Since this may be expensive,
-// we may need each thread to keep a local cache and infrequently write
-// through to this Statistics object.  TODO(abliss): actually do this.
+// Variables (but not UpDownCounters, which are used for cross-process
+// coordination) can instead accumulate Adds in each process and write them
+// through about once per flush interval; see
+// SharedMemStatistics::EnableBatchedUpdates and SharedMemBatchedVariable.
+// Histograms record with atomic counters in shared memory, and only fall back
+// to their mutex on platforms where those atomics aren't lock-free.
 //
 // Because we must allocate shared memory segments and mutexes before any child
 // processes and threads are created, all AddVariable calls must be done in
@@ -65,6 +71,7 @@ class SharedMemVariable : public MutexedScalar {
   virtual int64 SetReturningPreviousValueLockHeld(int64 value);
 
  private:
+  friend class SharedMemBatchedVariable;
   friend class SharedMemStatistics;
   friend class SharedMemTimedVariable;
 
@@ -89,6 +96,61 @@ class SharedMemVariable : public MutexedScalar {
   DISALLOW_COPY_AND_ASSIGN(SharedMemVariable);
 };
 
+// The Variable handed out by SharedMemStatistics.  Every Add normally goes
+// straight to the underlying SharedMemVariable.  Once EnableBatching has been
+// called, Adds instead accumulate in a per-process atomic, which is written
+// through to shared memory by the first Add after the flush interval, by a
+// read through this object, and by SharedMemStatistics::FlushPendingUpdates.
+// The SharedMemVariable itself is always exact, so callers that use it
+// directly through the MutexedScalar interface, like StatisticsLogger, are
+// unaffected.
+class SharedMemBatchedVariable : public Variable {
+ public:
+  SharedMemBatchedVariable(StringPiece name, Statistics* stats);
+  virtual ~SharedMemBatchedVariable();
+
+  // Writes through any delta pending in this process first.
+  virtual int64 Get() const;
+  virtual StringPiece GetName() const { return impl_.GetName(); }
+  // Discards any delta pending in this process.
+  virtual void Clear();
+
+  SharedMemVariable* impl() { return &impl_; }
+
+ protected:
+  // A batched Add returns the value this process last wrote through plus
+  // its pending delta, so it does not reflect recent Adds by other processes.
+  virtual int64 AddHelper(int64 delta);
+
+ private:
+  friend class SharedMemStatistics;
+
+  // Makes AddHelper accumulate deltas locally, writing them through to shared
+  // memory once flush_interval_ms has passed since the last write.  Must be
+  // called after the SharedMemVariable is attached.
+  void EnableBatching(Timer* timer, int64 flush_interval_ms);
+
+  bool batching() const { return timer_ != NULL; }
+
+  // Writes through any delta pending in this process, returning the new
+  // value.  Requires batching().
+  int64 FlushPending() const;
+
+  // Mutable since Get() writes pending deltas through.
+  mutable SharedMemVariable impl_;
+
+  // Batching state; timer_ is NULL unless EnableBatching was called with an
+  // attached SharedMemVariable.
+  Timer* timer_;
+  int64 flush_interval_ms_;
+  mutable std::atomic<int64> pending_delta_;
+  mutable std::atomic<int64> next_flush_ms_;
+  // The value in shared memory as of our last write-through.
+  mutable std::atomic<int64> last_value_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedMemBatchedVariable);
+};
+
 class SharedMemHistogram : public Histogram {
  public:
   SharedMemHistogram(StringPiece name, Statistics* stats);
@@ -118,13 +180,17 @@ class SharedMemHistogram : public Histogram {
   // use.
   size_t AllocationSize(AbstractSharedMem* shm_runtime) {
     // Shared memory space should include a mutex, HistogramBody and the storage
-    // for the actual buckets.
+    // for the actual buckets, followed by the two per-bucket window arrays.
     return shm_runtime->SharedMutexSize() + sizeof(HistogramBody) +
-        sizeof(double) * NumBuckets();
+        sizeof(int64) * 3 * NumBuckets();
   }
 
  protected:
+  // Every read of the histogram goes through here before calling the
+  // *Internal methods, so this is also where a finished window is rolled
+  // over.
   virtual AbstractMutex* lock() {
+    MaybeRollWindow();
     return mutex_.get();
   }
   virtual double AverageInternal();
@@ -133,6 +199,9 @@ class SharedMemHistogram : public Histogram {
   virtual double CountInternal();
   virtual double MaximumInternal();
   virtual double MinimumInternal();
+  virtual double WindowMsInternal();
+  virtual double WindowCountInternal();
+  virtual double WindowPercentileInternal(const double perc);
   virtual double BucketStart(int index);
   virtual double BucketCount(int index);
 
@@ -148,10 +217,30 @@ class SharedMemHistogram : public Histogram {
   // Finds a bucket that should contain the given value. Note that this does
   // not consider the catcher buckets for out-of-range values.
   int FindBucket(double value);
+  // Returns the bucket value belongs in, or -1 if we can't tell.
+  int BucketIndex(double value);
   void Init();
   void DCheckRanges() const;
   void Reset();
   void ClearInternal();  // expects mutex_ held, buffer_ != NULL
+
+  // Updates the counters for a value in bucket index.  Needs no lock if
+  // lock_free_, and mutex_ held otherwise.
+  void RecordValue(int index, double value);
+
+  // Keeps windowed views of window_ms long, measured with timer.  Must be
+  // called before Init.
+  void EnableWindows(Timer* timer, int64 window_ms);
+
+  // If the current window has run its length, makes it the one reported by
+  // the Window* methods and starts a new one.  Must not be called with
+  // mutex_ held.
+  void MaybeRollWindow();
+
+  // Computes the perc-th percentile of the values counted in counts, which
+  // has num_buckets_ entries.
+  double PercentileOfCounts(const std::vector<int64>& counts, double perc);
+
   const GoogleString name_;
   scoped_ptr<AbstractMutex> mutex_;
   // TODO(fangfei): implement a non-shared-mem histogram.
@@ -163,25 +252,56 @@ class SharedMemHistogram : public Histogram {
     // Maximum value allowed in Histogram,
     // numeric_limits<double>::max() by default.
     double max_value_;
-    // Real minimum value.
-    double min_;
-    // Real maximum value.
-    double max_;
-    double count_;
-    double sum_;
-    double sum_of_squares_;
-    // Histogram buckets data.
-    double values_[1];
+    // The fields below record values.  Add updates them without taking
+    // mutex_ when these atomics are lock-free, and so safe to share between
+    // processes.
+    // Real minimum value; +infinity while empty.
+    std::atomic<double> min_;
+    // Real maximum value; -infinity while empty.
+    std::atomic<double> max_;
+    std::atomic<int64> count_;
+    std::atomic<double> sum_;
+    std::atomic<double> sum_of_squares_;
+    // Window bookkeeping, guarded by mutex_.  last_window_ms_ is 0 until
+    // the first window has ended.
+    int64 window_start_ms_;
+    int64 last_window_ms_;
+    // Histogram buckets data, num_buckets_ long.  It is followed by two more
+    // num_buckets_ long arrays of int64, guarded by mutex_: the bucket counts
+    // as of the start of the current window, and the counts added during the
+    // last complete window.
+    std::atomic<int64> values_[1];
   };
+  int64* window_start_counts() {
+    return reinterpret_cast<int64*>(buffer_->values_ + num_buckets_);
+  }
+  int64* last_window_counts() {
+    return window_start_counts() + num_buckets_;
+  }
+
   // Number of buckets in this histogram.
   int num_buckets_;
   HistogramBody* buffer_;  // may be NULL if init failed.
+  // Whether the counters in buffer_ can be updated without taking mutex_.
+  bool lock_free_;
+
+  // Window state; timer_ is NULL unless EnableWindows was called with a
+  // positive window_ms.
+  Timer* timer_;
+  int64 window_ms_;
+
   DISALLOW_COPY_AND_ASSIGN(SharedMemHistogram);
 };
 
-class SharedMemStatistics : public ScalarStatisticsTemplate<
-  SharedMemVariable, SharedMemHistogram, FakeTimedVariable> {
+class SharedMemStatistics : public StatisticsTemplate<
+  SharedMemBatchedVariable, UpDownTemplate<SharedMemVariable>,
+  SharedMemHistogram, FakeTimedVariable> {
  public:
+  typedef SharedMemBatchedVariable Var;
+  typedef UpDownTemplate<SharedMemVariable> UpDown;
+  typedef SharedMemHistogram Hist;
+  typedef FakeTimedVariable TVar;
+
   SharedMemStatistics(int64 logging_interval_ms,
                       int64 max_logfile_size_kb,
                       const StringPiece& logging_file, bool logging,
@@ -220,10 +340,36 @@ class SharedMemStatistics : public ScalarStatisticsTemplate<
     return console_logger_.get();
   }
 
+  // If flush_interval_ms is positive, Variables accumulate Adds in each
+  // process, which keeps the shared-memory mutexes off hot paths.  Pending
+  // Adds are written to shared memory by the first Add after the interval
+  // has passed, by reads through this object, and by FlushPendingUpdates.
+  // A process that may go idle should therefore call FlushPendingUpdates
+  // about once per interval, so that other processes see its updates within
+  // roughly that time.  Histograms don't need batching, since they record
+  // into shared memory with atomic counters.  Must be called before Init();
+  // by default every Add is written through.
+  void EnableBatchedUpdates(int64 flush_interval_ms) {
+    flush_interval_ms_ = flush_interval_ms;
+  }
+  int64 flush_interval_ms() const { return flush_interval_ms_; }
+
+  // Histograms report the values added during their last complete window of
+  // this length, in addition to all-time values; 0 disables the windows.
+  // Defaults to one minute.  Must be called before Init().
+  void set_histogram_window_ms(int64 window_ms) {
+    histogram_window_ms_ = window_ms;
+  }
+
+  // Writes through Adds that are pending in this process, and rolls over
+  // any histogram windows that have ended.
+  void FlushPendingUpdates();
+
  protected:
   virtual Var* NewVariable(StringPiece name);
   virtual UpDown* NewUpDownCounter(StringPiece name);
   virtual Hist* NewHistogram(StringPiece name);
+  virtual TVar* NewTimedVariable(StringPiece name);
 
  private:
   // Create mutexes in the segment, with per_var bytes being used,
@@ -236,6 +382,9 @@ class SharedMemStatistics : public ScalarStatisticsTemplate<
   GoogleString filename_prefix_;
   scoped_ptr<AbstractSharedMemSegment> segment_;
   bool frozen_;
+  Timer* timer_;
+  int64 flush_interval_ms_;
+  int64 histogram_window_ms_;
   // TODO(sligocki): Rename.
   scoped_ptr<StatisticsLogger> console_logger_;
 
@@ -35,6 +35,7 @@ namespace {
 const char kPrefix[] = "/prefix/";
 const char kVar1[] = "v1";
 const char kVar2[] = "num_flushes";
+const char kVar3[] = "batched";
 const char kHist1[] = "H1";
 const char kHist2[] = "Html Time us Histogram";
 
@@ -84,7 +85,8 @@ bool SharedMemStatisticsTestBase::CreateChild(TestMethod method) {
 bool SharedMemStatisticsTestBase::AddVars(SharedMemStatistics* stats) {
   UpDownCounter* v1 = stats->AddUpDownCounter(kVar1);
   UpDownCounter* v2 = stats->AddUpDownCounter(kVar2);
-  return ((v1 != NULL) && (v2 != NULL));
+  Variable* v3 = stats->AddVariable(kVar3);
+  return ((v1 != NULL) && (v2 != NULL) && (v3 != NULL));
 }
 
 bool SharedMemStatisticsTestBase::AddHistograms(SharedMemStatistics* stats) {
@@ -271,6 +273,115 @@ void SharedMemStatisticsTestBase::TestSetReturningPrevious() {
   EXPECT_EQ(10, v1->Get());
 }
 
+void SharedMemStatisticsTestBase::TestBatchedVariable() {
+  const int64 kFlushIntervalMs = 100;
+  stats_->EnableBatchedUpdates(kFlushIntervalMs);
+  ParentInit();
+
+  // A second, unbatched, view of the same segment stands in for another
+  // process.
+  scoped_ptr<SharedMemStatistics> other(ChildInit());
+  ASSERT_TRUE(other.get() != NULL);
+  Variable* batched = stats_->GetVariable(kVar3);
+  Variable* observer = other->GetVariable(kVar3);
+
+  batched->Add(1);
+  batched->Add(2);
+  EXPECT_EQ(0, observer->Get());
+
+  // Once the interval passes, the next Add writes everything through.
+  timer_->AdvanceMs(kFlushIntervalMs);
+  batched->Add(3);
+  EXPECT_EQ(6, observer->Get());
+
+  // Reading through the batching object flushes too.
+  batched->Add(4);
+  EXPECT_EQ(6, observer->Get());
+  EXPECT_EQ(10, batched->Get());
+  EXPECT_EQ(10, observer->Get());
+
+  // A batched Add returns what this process knows of the value.
+  EXPECT_EQ(15, batched->Add(5));
+  EXPECT_EQ(10, observer->Get());
+  timer_->AdvanceMs(kFlushIntervalMs);
+  EXPECT_EQ(15 + (1 << 30), batched->Add(1 << 30));
+  EXPECT_EQ(15 + (1 << 30), observer->Get());
+
+  // Clearing drops anything pending.
+  batched->Add(5);
+  batched->Clear();
+  EXPECT_EQ(0, observer->Get());
+  EXPECT_EQ(0, batched->Get());
+
+  // UpDownCounters are never batched.
+  stats_->GetUpDownCounter(kVar1)->Add(7);
+  EXPECT_EQ(7, other->GetUpDownCounter(kVar1)->Get());
+
+  // An explicit FlushPendingUpdates hands over pending deltas without
+  // waiting for the flush interval.
+  batched->Add(8);
+  EXPECT_EQ(0, observer->Get());
+  stats_->FlushPendingUpdates();
+  EXPECT_EQ(8, observer->Get());
+}
+
+void SharedMemStatisticsTestBase::TestHistogramWindows() {
+  const int64 kWindowMs = 1000;
+  stats_->set_histogram_window_ms(kWindowMs);
+  ParentInit();
+
+  // A second view of the same segment stands in for another process, and
+  // sees every Add straight away.
+  scoped_ptr<SharedMemStatistics> other(ChildInit());
+  ASSERT_TRUE(other.get() != NULL);
+  Histogram* hist = stats_->GetHistogram(kHist1);
+  Histogram* observer = other->GetHistogram(kHist1);
+  // 500 buckets, each 1 wide.
+  hist->SetMaxValue(500);
+  for (int i = 0; i < 100; ++i) {
+    hist->Add(i);
+  }
+  EXPECT_EQ(100, observer->Count());
+  EXPECT_EQ(0, observer->Minimum());
+  EXPECT_EQ(99, observer->Maximum());
+  EXPECT_EQ(50, observer->Median());
+
+  // There is no window to report on until the first one ends.
+  EXPECT_EQ(0, hist->WindowMs());
+  EXPECT_EQ(0, hist->WindowCount());
+
+  timer_->AdvanceMs(kWindowMs);
+  EXPECT_EQ(kWindowMs, hist->WindowMs());
+  EXPECT_EQ(100, hist->WindowCount());
+  EXPECT_EQ(50, hist->WindowPercentile(50));
+
+  // The next window only sees its own values, while the all-time view sees
+  // everything.
+  for (int i = 0; i < 10; ++i) {
+    hist->Add(400);
+  }
+  timer_->AdvanceMs(kWindowMs);
+  EXPECT_EQ(10, hist->WindowCount());
+  EXPECT_EQ(400, hist->WindowPercentile(50));
+  EXPECT_EQ(400, hist->WindowPercentile(99.9));
+  EXPECT_EQ(110, hist->Count());
+  EXPECT_EQ(55, hist->Median());
+
+  GoogleString html;
+  StringWriter writer(&html);
+  stats_->RenderHistograms(&writer, &handler_);
+  EXPECT_TRUE(Contains(html, "Last 1 s: Count 10, Median 400, 99% 400"));
+
+  // A window nobody rolled over in time reports its real length.
+  timer_->AdvanceMs(3 * kWindowMs);
+  EXPECT_EQ(3 * kWindowMs, hist->WindowMs());
+  EXPECT_EQ(0, hist->WindowCount());
+
+  hist->Clear();
+  EXPECT_EQ(0, observer->Count());
+  EXPECT_EQ(0, hist->WindowMs());
+}
+
 void SharedMemStatisticsTestBase::TestAddChild() {
   scoped_ptr<SharedMemStatistics> stats(ChildInit());
   stats->Init(false, &handler_);
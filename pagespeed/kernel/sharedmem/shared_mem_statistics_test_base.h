@@ -52,6 +52,8 @@ class SharedMemStatisticsTestBase : public testing::Test {
   void TestClear();
   void TestAdd();
   void TestSetReturningPrevious();
+  void TestBatchedVariable();
+  void TestHistogramWindows();
   void TestHistogram();
   void TestHistogramRender();
   void TestHistogramNoExtraClear();
@@ -122,6 +124,14 @@ TYPED_TEST_P(SharedMemStatisticsTestTemplate, TestSetReturningPrevious) {
   SharedMemStatisticsTestBase::TestSetReturningPrevious();
 }
 
+TYPED_TEST_P(SharedMemStatisticsTestTemplate, TestBatchedVariable) {
+  SharedMemStatisticsTestBase::TestBatchedVariable();
+}
+
+TYPED_TEST_P(SharedMemStatisticsTestTemplate, TestHistogramWindows) {
+  SharedMemStatisticsTestBase::TestHistogramWindows();
+}
+
 TYPED_TEST_P(SharedMemStatisticsTestTemplate, TestHistogram) {
   SharedMemStatisticsTestBase::TestHistogram();
 }
@@ -144,7 +154,8 @@ TYPED_TEST_P(SharedMemStatisticsTestTemplate, TestTimedVariableEmulation) {
 
 REGISTER_TYPED_TEST_CASE_P(SharedMemStatisticsTestTemplate, TestCreate,
                            TestSet, TestClear, TestAdd,
-                           TestSetReturningPrevious,
+                           TestSetReturningPrevious, TestBatchedVariable,
+                           TestHistogramWindows,
                            TestHistogram, TestHistogramRender,
                            TestHistogramNoExtraClear,
                            TestHistogramExtremeBuckets,
@@ -35,9 +35,12 @@ QueuedAlarm::QueuedAlarm(Scheduler* scheduler,
       scheduler_(scheduler),
       sequence_(sequence),
       callback_(callback),
+      sequence_portion_(&QueuedAlarm::SequencePortionOfRun,
+                        &QueuedAlarm::SequencePortionOfRunCancelled, this),
       canceled_(false),
       queued_sequence_portion_(false) {
   set_delete_after_callback(false);
+  sequence_portion_.set_delete_after_callback(false);
   alarm_ = scheduler_->AddAlarmAtUs(wakeup_time_us, this);
 }
 
@@ -83,9 +86,7 @@ void QueuedAlarm::Run() {
     delete this;
   } else {
     queued_sequence_portion_ = true;
-    sequence_->Add(MakeFunction(this,
-                                &QueuedAlarm::SequencePortionOfRun,
-                                &QueuedAlarm::SequencePortionOfRunCancelled));
+    sequence_->Add(&sequence_portion_);
   }
 }
 
@@ -76,6 +76,11 @@ class QueuedAlarm : public Function {
   Function* callback_;
   Scheduler::Alarm* alarm_;
 
+  // Queued on sequence_ when the alarm fires.  It's embedded rather than
+  // allocated per firing since a QueuedAlarm fires at most once; it does not
+  // delete itself, as SequencePortionOfRun[Cancelled] deletes us instead.
+  MemberFunction0<QueuedAlarm> sequence_portion_;
+
   bool canceled_;
   bool queued_sequence_portion_;
 };
@@ -409,6 +409,45 @@ void QueuedWorkerPool::Sequence::Add(Function* function) {
   UpdateWaveform(queue_size_, cancel ? 0 : 1);
 }
 
+void QueuedWorkerPool::Sequence::AddAll(std::vector<Function*>* functions) {
+  if (functions->empty()) {
+    return;
+  }
+  int num_added = functions->size();
+  std::vector<Function*> cancel_functions;
+  bool queue_sequence = false;
+  {
+    ScopedMutex lock(sequence_mutex_.get());
+    if (shutdown_) {
+#ifndef NDEBUG
+      LOG(WARNING) << "Adding " << num_added << " functions to sequence "
+                   << this << " after shutdown";
+#endif
+      cancel_functions.swap(*functions);
+    } else {
+      queue_sequence = (!active_ && work_queue_.empty());
+      for (int i = 0; i < num_added; ++i) {
+        // As in Add, overflowing a bounded queue cancels the oldest function.
+        if ((max_queue_size_ != kUnboundedQueue) &&
+            (work_queue_.size() >= max_queue_size_)) {
+          cancel_functions.push_back(work_queue_.front());
+          work_queue_.pop_front();
+        }
+        work_queue_.push_back((*functions)[i]);
+      }
+      functions->clear();
+    }
+  }
+  for (int i = 0, n = cancel_functions.size(); i < n; ++i) {
+    cancel_functions[i]->CallCancel();
+  }
+  if (queue_sequence) {
+    pool_->QueueSequence(this);
+  }
+  UpdateWaveform(queue_size_,
+                 num_added - static_cast<int>(cancel_functions.size()));
+}
+
 void QueuedWorkerPool::Sequence::CancelPendingFunctions() {
   std::deque<Function*> cancel_queue;
   {
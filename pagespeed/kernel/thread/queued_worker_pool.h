@@ -102,6 +102,12 @@ class QueuedWorkerPool {
     // this method will call function->Cancel().
     void Add(Function* function) LOCKS_EXCLUDED(sequence_mutex_);
 
+    // Adds all of 'functions' while taking sequence_mutex_ just once, and
+    // clears the vector.  Shutdown and queue-size limits are handled as if
+    // each function had been passed to Add in turn.
+    void AddAll(std::vector<Function*>* functions)
+        LOCKS_EXCLUDED(sequence_mutex_);
+
     void set_queue_size_stat(Waveform* x) { queue_size_ = x; }
 
     // Sets the maximum number of functions that can be enqueued to a sequence.
@@ -19,6 +19,8 @@
 
 #include "pagespeed/kernel/thread/queued_worker_pool.h"
 
+#include <vector>
+
 #include "base/logging.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/function.h"
@@ -312,6 +314,67 @@ TEST_F(QueuedWorkerPoolTest, MaxQueueSize) {
   EXPECT_EQ(-97, count);
 }
 
+// Tests that a batch added with AddAll runs in order, interleaved correctly
+// with individual Adds.
+TEST_F(QueuedWorkerPoolTest, AddAll) {
+  const int kBound = 42;
+  int count = 0;
+  SyncPoint sync(thread_runtime_.get());
+
+  QueuedWorkerPool::Sequence* sequence = worker_->NewSequence();
+  sequence->Add(new Increment(1, &count));
+  std::vector<Function*> functions;
+  for (int i = 1; i < kBound; ++i) {
+    functions.push_back(new Increment(i + 1, &count));
+  }
+  sequence->AddAll(&functions);
+  EXPECT_TRUE(functions.empty());
+  sequence->Add(new NotifyRunFunction(&sync));
+  sync.Wait();
+  EXPECT_EQ(kBound, count);
+  worker_->FreeSequence(sequence);
+}
+
+// AddAll on a bounded queue retires the oldest functions, just as the
+// equivalent series of Adds would.
+TEST_F(QueuedWorkerPoolTest, AddAllMaxQueueSize) {
+  SyncPoint started(thread_runtime_.get());
+  SyncPoint wait(thread_runtime_.get());
+  SyncPoint done(thread_runtime_.get());
+  QueuedWorkerPool::Sequence* sequence = worker_->NewSequence();
+  sequence->set_max_queue_size(4);
+  int count = 0;
+  sequence->Add(new NotifyAndWait(&started, &wait));
+  started.Wait();
+  sequence->Add(new Increment(-100, &count));  // will be canceled: -100.
+  std::vector<Function*> functions;
+  functions.push_back(new Increment(-99, &count));  // will be run: -99.
+  functions.push_back(new Increment(-98, &count));  // will be run: -98.
+  functions.push_back(new NotifyRunFunction(&done));
+  functions.push_back(new Increment(-97, &count));  // Cancels first increment.
+  sequence->AddAll(&functions);
+  wait.Notify();
+  done.Wait();
+  WaitUntilSequenceCompletes(sequence);
+  EXPECT_EQ(-97, count);
+}
+
+TEST_F(QueuedWorkerPoolTest, AddAllAfterShutDown) {
+  QueuedWorkerPool::Sequence* sequence = worker_->NewSequence();
+  worker_->ShutDown();
+  LogOpsFunction f1, f2;
+  std::vector<Function*> functions;
+  functions.push_back(&f1);
+  functions.push_back(&f2);
+  sequence->AddAll(&functions);
+  EXPECT_TRUE(functions.empty());
+  worker_.reset(NULL);
+  EXPECT_TRUE(f1.cancel_called());
+  EXPECT_FALSE(f1.run_called());
+  EXPECT_TRUE(f2.cancel_called());
+  EXPECT_FALSE(f2.run_called());
+}
+
 TEST_F(QueuedWorkerPoolTest, CancelPending) {
   SyncPoint wait(thread_runtime_.get());
   SyncPoint done(thread_runtime_.get());
@@ -18,6 +18,8 @@
 
 #include "pagespeed/kernel/thread/scheduler_sequence.h"
 
+#include <vector>
+
 #include "base/logging.h"
 #include "pagespeed/kernel/base/abstract_mutex.h"
 #include "pagespeed/kernel/base/function.h"
@@ -56,6 +58,28 @@ void Scheduler::Sequence::Add(Function* function) {
   }
 }
 
+void Scheduler::Sequence::AddAll(std::vector<Function*>* functions) {
+  if (functions->empty()) {
+    return;
+  }
+  net_instaweb::Sequence* forwarding_sequence = nullptr;
+  {
+    ScopedMutex lock(scheduler_->mutex());
+    if (forwarding_sequence_ != nullptr) {
+      forwarding_sequence = forwarding_sequence_;
+    } else {
+      for (Function* function : *functions) {
+        work_queue_.push_back(function);
+      }
+      functions->clear();
+      scheduler_->Signal();
+    }
+  }
+  if (forwarding_sequence != nullptr) {
+    forwarding_sequence->AddAll(functions);
+  }
+}
+
 bool Scheduler::Sequence::RunTasksUntil(int64 timeout_ms, bool* done) {
   scheduler_->mutex()->DCheckLocked();
   DCHECK(forwarding_sequence_ == nullptr);
@@ -86,12 +110,14 @@ void Scheduler::Sequence::ForwardToSequence(
   scheduler_->mutex()->DCheckLocked();
   DCHECK(forwarding_sequence != nullptr);
   forwarding_sequence_ = forwarding_sequence;
+  std::vector<Function*> functions;
+  functions.reserve(work_queue_.size());
   while (!work_queue_.empty()) {
-    Function* function = work_queue_.front();
+    functions.push_back(work_queue_.front());
     work_queue_.pop_front();
-    // Takes forwarding_sequence's mutex while holding scheduler_->mutex().
-    forwarding_sequence->Add(function);
   }
+  // Takes forwarding_sequence's mutex while holding scheduler_->mutex().
+  forwarding_sequence->AddAll(&functions);
 }
 
 }  // namespace net_instaweb
@@ -19,6 +19,8 @@
 #ifndef PAGESPEED_KERNEL_THREAD_SCHEDULER_SEQUENCE_H_
 #define PAGESPEED_KERNEL_THREAD_SCHEDULER_SEQUENCE_H_
 
+#include <vector>
+
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/function.h"
 #include "pagespeed/kernel/base/thread_annotations.h"
@@ -38,6 +40,8 @@ class Scheduler::Sequence : public net_instaweb::Sequence {
   virtual ~Sequence();
 
   void Add(Function* function) override LOCKS_EXCLUDED(scheduler_->mutex());
+  void AddAll(std::vector<Function*>* functions) override
+      LOCKS_EXCLUDED(scheduler_->mutex());
 
   // Runs functions for this sequence directly, until *done is true or
   // the timeout expires.  Returns 'false' if the timeout expired prior
@@ -18,6 +18,10 @@
 
 #include "pagespeed/kernel/thread/sequence.h"
 
+#include <vector>
+
+#include "pagespeed/kernel/base/function.h"
+
 namespace net_instaweb {
 
 Sequence::Sequence() {
@@ -26,4 +30,11 @@ Sequence::Sequence() {
 Sequence::~Sequence() {
 }
 
+void Sequence::AddAll(std::vector<Function*>* functions) {
+  for (int i = 0, n = functions->size(); i < n; ++i) {
+    Add((*functions)[i]);
+  }
+  functions->clear();
+}
+
 }  // namespace net_instaweb
@@ -21,6 +21,8 @@
 #ifndef PAGESPEED_KERNEL_THREAD_SEQUENCE_H_
 #define PAGESPEED_KERNEL_THREAD_SEQUENCE_H_
 
+#include <vector>
+
 #include "pagespeed/kernel/base/basictypes.h"
 
 namespace net_instaweb {
@@ -48,6 +50,12 @@ class Sequence {
   // been run, function->Cancel() will be called when the Sequence is destroyed.
   virtual void Add(Function* function) = 0;
 
+  // Adds all of 'functions' to the sequence, in order, and clears the vector.
+  // This is equivalent to calling Add on each, but implementations may
+  // override it to enqueue the whole batch with a single lock acquisition,
+  // which matters when a single event completes many callbacks at once.
+  virtual void AddAll(std::vector<Function*>* functions);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(Sequence);
 };
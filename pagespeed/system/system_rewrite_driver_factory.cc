@@ -40,6 +40,9 @@
 #include "pagespeed/controller/central_controller_rpc_server.h"
 #include "pagespeed/controller/popularity_contest_schedule_rewrite_controller.h"
 #include "pagespeed/controller/queued_expensive_operation_controller.h"
+#include "pagespeed/controller/shared_mem_central_controller.h"
+#include "pagespeed/controller/shared_mem_central_controller_server.h"
+#include "pagespeed/controller/shared_mem_controller_channel.h"
 #include "pagespeed/system/controller_manager.h"
 #include "pagespeed/system/controller_process.h"
 #include "pagespeed/system/in_place_resource_recorder.h"
@@ -51,6 +54,7 @@
 #include "net/instaweb/util/public/property_cache.h"
 #include "pagespeed/kernel/base/abstract_shared_mem.h"
 #include "pagespeed/kernel/base/file_system.h"
+#include "pagespeed/kernel/base/function.h"
 #include "pagespeed/kernel/base/google_message_handler.h"
 #include "pagespeed/kernel/base/md5_hasher.h"
 #include "pagespeed/kernel/base/message_handler.h"
@@ -67,6 +71,7 @@
 #include "pagespeed/kernel/sharedmem/shared_mem_statistics.h"
 #include "pagespeed/kernel/thread/pthread_shared_mem.h"
 #include "pagespeed/kernel/thread/queued_worker_pool.h"
+#include "pagespeed/kernel/thread/scheduler.h"
 #include "pagespeed/kernel/util/input_file_nonce_generator.h"
 #include "pagespeed/kernel/util/nonce_generator.h"
 
@@ -90,6 +95,15 @@ const char kTrackOriginalContentLength[] = "TrackOriginalContentLength";
 const char kCreateSharedMemoryMetadataCache[] =
     "CreateSharedMemoryMetadataCache";
 
+const char kSharedMemControllerSegment[] = "central_controller";
+
+// Every rewrite the popularity contest may queue or run can hold a slot, and
+// we allow as many again for expensive operations waiting their turn.
+int SharedMemControllerSlots(const SystemRewriteOptions& options) {
+  return 2 * (options.popularity_contest_max_queue_size() +
+              options.popularity_contest_max_inflight_requests());
+}
+
 }  // namespace
 
 SystemRewriteDriverFactory::SystemRewriteDriverFactory(
@@ -110,7 +124,10 @@ SystemRewriteDriverFactory::SystemRewriteDriverFactory(
       install_crash_handler_(false),
       thread_counts_finalized_(false),
       num_rewrite_threads_(-1),
-      num_expensive_rewrite_threads_(-1) {
+      num_expensive_rewrite_threads_(-1),
+      statistics_flush_interval_ms_(0),
+      statistics_flush_alarm_(NULL),
+      statistics_flush_stopped_(false) {
   if (shared_mem_runtime == NULL) {
 #ifdef PAGESPEED_SUPPORT_POSIX_SHARED_MEM
     shared_mem_runtime = new PthreadSharedMem();
@@ -183,6 +200,15 @@ SharedMemStatistics* SystemRewriteDriverFactory::
       // whether we are naming our shared-memory segments correctly.
       StrCat(filename_prefix(), name), shared_mem_runtime(),
       message_handler(), file_system(), timer());
+  int64 flush_interval_ms = options.statistics_flush_interval_ms();
+  stats->EnableBatchedUpdates(flush_interval_ms);
+  if (flush_interval_ms > 0) {
+    batched_statistics_.push_back(stats);
+    if ((statistics_flush_interval_ms_ == 0) ||
+        (flush_interval_ms < statistics_flush_interval_ms_)) {
+      statistics_flush_interval_ms_ = flush_interval_ms;
+    }
+  }
   NonStaticInitStats(stats);
   bool init_ok = stats->Init(true, message_handler());
   if (local && init_ok) {
@@ -206,6 +232,7 @@ void SystemRewriteDriverFactory::InitStats(Statistics* statistics) {
   InPlaceResourceRecorder::InitStats(statistics);
   RateController::InitStats(statistics);
   CentralControllerRpcClient::InitStats(statistics);
+  SharedMemCentralController::InitStats(statistics);
 
   statistics->AddVariable(kShutdownCount);
 }
@@ -277,7 +304,33 @@ void SystemRewriteDriverFactory::PrepareControllerProcess() {
 
 void SystemRewriteDriverFactory::StartController(
     const SystemRewriteOptions& options) {
-  if (!options.controller_port().empty()) {
+  if (options.controller_uses_shared_mem()) {
+    // The channel has to exist before we fork off the controller and the
+    // workers, so they all find the same segment.
+    GoogleString segment =
+        StrCat(filename_prefix(), kSharedMemControllerSegment);
+    int num_slots = SharedMemControllerSlots(options);
+    SharedMemControllerChannel channel(shared_mem_runtime(), segment,
+                                       num_slots, message_handler());
+    if (!channel.Initialize()) {
+      return;
+    }
+    shared_mem_controller_segment_ = segment;
+    std::unique_ptr<SharedMemCentralControllerServer> controller(
+        new SharedMemCentralControllerServer(
+            shared_mem_runtime(), segment, num_slots,
+            new QueuedExpensiveOperationController(
+                options.image_max_rewrites_at_once(), thread_system(),
+                statistics()),
+            new PopularityContestScheduleRewriteController(
+                thread_system(), statistics(), timer(),
+                options.popularity_contest_max_inflight_requests(),
+                options.popularity_contest_max_queue_size()),
+            timer(), message_handler()));
+    // In the forked process, this call runs the controller and never returns.
+    ControllerManager::ForkControllerProcess(
+        std::move(controller), this, system_thread_system_, message_handler());
+  } else if (!options.controller_port().empty()) {
     std::unique_ptr<CentralControllerRpcServer> controller(
         new CentralControllerRpcServer(
             options.controller_port(), new QueuedExpensiveOperationController(
@@ -361,6 +414,31 @@ void SystemRewriteDriverFactory::ChildInit() {
     server_context->ChildInit(this);
   }
   uninitialized_server_contexts_.clear();
+
+  if (!batched_statistics_.empty()) {
+    SetNeedSchedulerThread();
+    ScopedMutex lock(scheduler()->mutex());
+    ScheduleStatisticsFlush();
+    // Wake the scheduler so it notices the new alarm.
+    scheduler()->Signal();
+  }
+}
+
+void SystemRewriteDriverFactory::ScheduleStatisticsFlush() {
+  statistics_flush_alarm_ = scheduler()->AddAlarmAtUsMutexHeld(
+      timer()->NowUs() + statistics_flush_interval_ms_ * Timer::kMsUs,
+      MakeFunction(this, &SystemRewriteDriverFactory::FlushBatchedStatistics));
+}
+
+void SystemRewriteDriverFactory::FlushBatchedStatistics() {
+  for (int i = 0, n = batched_statistics_.size(); i < n; ++i) {
+    batched_statistics_[i]->FlushPendingUpdates();
+  }
+  ScopedMutex lock(scheduler()->mutex());
+  statistics_flush_alarm_ = NULL;
+  if (!statistics_flush_stopped_) {
+    ScheduleStatisticsFlush();
+  }
 }
 
 std::shared_ptr<CentralController>
@@ -372,7 +450,15 @@ SystemRewriteDriverFactory::GetCentralController(
     return RewriteDriverFactory::GetCentralController(lock_manager);
   }
 
-  if (central_controller_ == nullptr) {
+  if (central_controller_ == nullptr && conf->controller_uses_shared_mem()) {
+    // Attaches to the segment StartController created on first use, which
+    // will be after the worker process has been forked.
+    central_controller_ = std::make_shared<SharedMemCentralController>(
+        shared_mem_runtime(),
+        StrCat(filename_prefix(), kSharedMemControllerSegment),
+        SharedMemControllerSlots(*conf), thread_system(), statistics(),
+        message_handler());
+  } else if (central_controller_ == nullptr) {
     central_controller_ = std::make_shared<CentralControllerRpcClient>(
         conf->controller_port(),
         conf->popularity_contest_max_queue_size() +
@@ -565,6 +651,15 @@ void SystemRewriteDriverFactory::ShutDown() {
 
   StopCacheActivity();
 
+  if (!is_root_process_ && !batched_statistics_.empty()) {
+    ScopedMutex lock(scheduler()->mutex());
+    statistics_flush_stopped_ = true;
+    if (statistics_flush_alarm_ != NULL) {
+      scheduler()->CancelAlarm(statistics_flush_alarm_);
+      statistics_flush_alarm_ = NULL;
+    }
+  }
+
   // Next, we shutdown the fetchers before killing the workers in
   // RewriteDriverFactory::ShutDown; this is so any rewrite jobs in progress
   // can quickly wrap up.
@@ -602,6 +697,12 @@ void SystemRewriteDriverFactory::ShutDown() {
                                          message_handler());
     }
 
+    if (!shared_mem_controller_segment_.empty()) {
+      SharedMemControllerChannel::GlobalCleanup(shared_mem_runtime_.get(),
+                                                shared_mem_controller_segment_,
+                                                message_handler());
+    }
+
     // Cleanup SharedCircularBuffer.
     // Use GoogleMessageHandler instead of SystemMessageHandler.
     // As we are cleaning SharedCircularBuffer, we do not want to write to its
@@ -33,6 +33,7 @@
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/thread/queued_worker_pool.h"
+#include "pagespeed/kernel/thread/scheduler.h"
 
 namespace net_instaweb {
 
@@ -261,6 +262,11 @@ class SystemRewriteDriverFactory : public RewriteDriverFactory {
     return 1;
   }
 
+  // Called in child processes when something needs scheduler() alarms to
+  // run even while no requests are being served.  Servers that don't already
+  // dispatch the scheduler from a thread of their own should start one here.
+  virtual void SetNeedSchedulerThread() {}
+
   // By default this uses the ControllerManager to fork off some processes to
   // handle the Controller.  If you're on a system where fork doesn't make
   // sense or running the Controller in its own process doesn't make sense, this
@@ -351,10 +357,27 @@ class SystemRewriteDriverFactory : public RewriteDriverFactory {
 
   virtual UrlAsyncFetcher* DefaultAsyncUrlFetcher();
 
+  // Writes the statistics updates batched in this process through to shared
+  // memory, then schedules itself to run again unless we are shutting down.
+  void FlushBatchedStatistics();
+
+  // Schedules FlushBatchedStatistics after statistics_flush_interval_ms_.
+  // Requires scheduler()->mutex() to be held.
+  void ScheduleStatisticsFlush();
+
   scoped_ptr<SharedMemStatistics> shared_mem_statistics_;
   // While split statistics in the ServerContext cleans up the actual objects,
   // we do the segment cleanup for local stats here.
   StringVector local_shm_stats_segment_names_;
+
+  // Global and per-vhost statistics that batch their updates, which each
+  // child process writes through every statistics_flush_interval_ms_ so that
+  // an idle process doesn't sit on them.  The objects are owned by us or by
+  // our server contexts, which outlive ShutDown().
+  std::vector<SharedMemStatistics*> batched_statistics_;
+  int64 statistics_flush_interval_ms_;  // The smallest of their intervals.
+  Scheduler::Alarm* statistics_flush_alarm_;  // Guarded by scheduler mutex.
+  bool statistics_flush_stopped_;  // Guarded by scheduler mutex.
   scoped_ptr<AbstractSharedMem> shared_mem_runtime_;
   scoped_ptr<SharedCircularBuffer> shared_circular_buffer_;
 
@@ -413,7 +436,12 @@ class SystemRewriteDriverFactory : public RewriteDriverFactory {
   int num_rewrite_threads_;
   int num_expensive_rewrite_threads_;
 
-  std::shared_ptr<CentralControllerRpcClient> central_controller_;
+  std::shared_ptr<CentralController> central_controller_;
+
+  // Name of the segment used to talk to the controller if
+  // SystemRewriteOptions::controller_uses_shared_mem(), so the root process
+  // can clean it up.
+  GoogleString shared_mem_controller_segment_;
 
   DISALLOW_COPY_AND_ASSIGN(SystemRewriteDriverFactory);
 };
@@ -39,11 +39,14 @@ const char kFetchHttps[] = "FetchHttps";
 
 const char SystemRewriteOptions::kCentralControllerPort[] =
     "ExperimentalCentralControllerPort";
+const char SystemRewriteOptions::kCentralControllerSharedMem[] = "shm";
 const char SystemRewriteOptions::kPopularityContestMaxInFlight[] =
     "ExperimentalPopularityContestMaxInFlight";
 const char SystemRewriteOptions::kPopularityContestMaxQueueSize[] =
     "ExperimentalPopularityContestMaxQueueSize";
 const char SystemRewriteOptions::kStaticAssetCDN[] = "StaticAssetCDN";
+const char SystemRewriteOptions::kStatisticsFlushIntervalMs[] =
+    "StatisticsFlushIntervalMs";
 const char SystemRewriteOptions::kRedisServer[] = "RedisServer";
 const char SystemRewriteOptions::kRedisReconnectionDelayMs[] =
     "RedisReconnectionDelayMs";
@@ -147,6 +150,12 @@ void SystemRewriteOptions::AddProperties() {
                     &SystemRewriteOptions::statistics_logging_interval_ms_,
                     "asli", RewriteOptions::kStatisticsLoggingIntervalMs,
                     "How often to log statistics, in milliseconds.", true);
+  AddSystemProperty(0, &SystemRewriteOptions::statistics_flush_interval_ms_,
+                    "asfi", SystemRewriteOptions::kStatisticsFlushIntervalMs,
+                    kProcessScopeStrict,
+                    "If positive, each process batches statistics counter "
+                    "updates and writes them to shared memory about this "
+                    "often, in milliseconds", false);
   // 2 Weeks of data w/ 10 minute intervals.
   // Takes about 0.1s to parse 1MB file for modpagespeed.com/pagespeed_console
   // TODO(sligocki): Increase once we have a better method for reading
@@ -237,7 +246,9 @@ void SystemRewriteOptions::AddProperties() {
   AddSystemProperty("", &SystemRewriteOptions::controller_port_, "ccp",
                     SystemRewriteOptions::kCentralControllerPort,
                     kProcessScopeStrict,
-                    "TCP port for central controller processes", false);
+                    "TCP port or 'unix:' path for central controller "
+                    "processes, or 'shm' to talk to the controller through "
+                    "shared memory", false);
   AddSystemProperty(
       10, &SystemRewriteOptions::popularity_contest_max_inflight_requests_,
       "pci", SystemRewriteOptions::kPopularityContestMaxInFlight,
@@ -338,7 +349,11 @@ SystemRewriteOptions* SystemRewriteOptions::DynamicCast(
 
 bool SystemRewriteOptions::ControllerPortOption::SetFromString(
     StringPiece value_string, GoogleString* error_detail) {
-  // Valid values are: unix:<path> or a tcp port number.
+  // Valid values are: unix:<path>, shm or a tcp port number.
+  if (value_string == kCentralControllerSharedMem) {
+    set(value_string.as_string());
+    return true;
+  }
   if (strings::StartsWith(value_string, "unix:") &&
       value_string.size() > 5 /*strlen("unix:")*/) {
     set(value_string.as_string());
@@ -348,7 +363,7 @@ bool SystemRewriteOptions::ControllerPortOption::SetFromString(
   if (!StringToInt(value_string, &port)) {
     *error_detail =
         StrCat(kCentralControllerPort,
-               " is not a valid number or 'unix:' path: '",
+               " is not a valid number, 'unix:' path or 'shm': '",
                value_string, "'");
     return false;
   }
@@ -42,9 +42,13 @@ class SystemRewriteOptions : public RewriteOptions {
   typedef std::set<StaticAssetEnum::StaticAsset> StaticAssetSet;
 
   static const char kCentralControllerPort[];
+  // Value of kCentralControllerPort selecting the shared-memory transport
+  // instead of gRPC.
+  static const char kCentralControllerSharedMem[];
   static const char kPopularityContestMaxInFlight[];
   static const char kPopularityContestMaxQueueSize[];
   static const char kStaticAssetCDN[];
+  static const char kStatisticsFlushIntervalMs[];
   static const char kRedisServer[];
   static const char kRedisReconnectionDelayMs[];
   static const char kRedisTimeoutUs[];
@@ -146,6 +150,12 @@ class SystemRewriteOptions : public RewriteOptions {
   void set_statistics_logging_interval_ms(int64 x) {
     set_option(x, &statistics_logging_interval_ms_);
   }
+  int64 statistics_flush_interval_ms() const {
+    return statistics_flush_interval_ms_.value();
+  }
+  void set_statistics_flush_interval_ms(int64 x) {
+    set_option(x, &statistics_flush_interval_ms_);
+  }
   const GoogleString& file_cache_path() const {
     return file_cache_path_.value();
   }
@@ -206,6 +216,9 @@ class SystemRewriteOptions : public RewriteOptions {
   const GoogleString& controller_port() const {
     return controller_port_.value();
   }
+  bool controller_uses_shared_mem() const {
+    return controller_port() == kCentralControllerSharedMem;
+  }
   int popularity_contest_max_inflight_requests() const {
     return popularity_contest_max_inflight_requests_.value();
   }
@@ -507,6 +520,7 @@ class SystemRewriteOptions : public RewriteOptions {
   Option<int64> lru_cache_byte_limit_;
   Option<int64> lru_cache_kb_per_process_;
   Option<int64> statistics_logging_interval_ms_;
+  Option<int64> statistics_flush_interval_ms_;
   // If cache_flush_poll_interval_sec_<=0 then we turn off polling for
   // cache-flushes.
   Option<int64> cache_flush_poll_interval_sec_;
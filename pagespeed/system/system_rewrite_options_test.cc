@@ -254,6 +254,17 @@ TEST_F(SystemRewriteOptionsTest, CentralControllerUnixPort) {
   EXPECT_EQ("", msg);
 }
 
+TEST_F(SystemRewriteOptionsTest, CentralControllerSharedMem) {
+  GoogleString msg;
+  EXPECT_FALSE(options_.controller_uses_shared_mem());
+  EXPECT_EQ(options_.ParseAndSetOptionFromName1(
+            SystemRewriteOptions::kCentralControllerPort, "shm", &msg,
+            &handler_), RewriteOptions::kOptionOk);
+  EXPECT_EQ(options_.controller_port(), "shm");
+  EXPECT_TRUE(options_.controller_uses_shared_mem());
+  EXPECT_EQ("", msg);
+}
+
 TEST_F(SystemRewriteOptionsTest, CentralControllerTooShortUnixPort) {
   GoogleString msg;
   EXPECT_EQ(options_.ParseAndSetOptionFromName1(
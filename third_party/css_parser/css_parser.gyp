@@ -105,6 +105,7 @@
       'cflags': ['-funsigned-char', '-Wno-sign-compare', '-Wno-return-type'],
       'sources': [
         '<(css_parser_root)/string_using.h',
+        '<(css_parser_root)/webutil/css/arena.cc',
         '<(css_parser_root)/webutil/css/media.cc',
         '<(css_parser_root)/webutil/css/parser.cc',
         '<(css_parser_root)/webutil/css/selector.cc',
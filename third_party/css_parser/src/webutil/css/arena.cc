@@ -0,0 +1,106 @@
+/**
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "webutil/css/arena.h"
+
+#include <stdlib.h>
+
+#include "base/logging.h"
+
+namespace Css {
+
+namespace {
+
+// Prefixed to every ArenaAllocated object.  The union keeps the object that
+// follows it aligned for doubles and pointers.
+union AllocationHeader {
+  bool in_arena;
+  double align_double;
+  void* align_pointer;
+};
+
+const size_t kAlignment = sizeof(AllocationHeader);
+
+void* AllocateWithHeader(size_t size, Arena* arena) {
+  size_t total = size + sizeof(AllocationHeader);
+  AllocationHeader* header;
+  if (arena != NULL) {
+    header = static_cast<AllocationHeader*>(arena->Allocate(total));
+  } else {
+    header = static_cast<AllocationHeader*>(malloc(total));
+    CHECK(header != NULL);
+  }
+  header->in_arena = (arena != NULL);
+  return header + 1;
+}
+
+}  // namespace
+
+const size_t Arena::kBlockSize = 32 * 1024;
+
+Arena::Arena() : next_(NULL), remaining_(0) {
+}
+
+Arena::~Arena() {
+  for (int i = 0, n = blocks_.size(); i < n; ++i) {
+    free(blocks_[i]);
+  }
+}
+
+void* Arena::Allocate(size_t size) {
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  if (size > remaining_) {
+    if (size > kBlockSize / 4) {
+      // Give big requests a block of their own so that we do not waste the
+      // rest of the current block.
+      char* block = static_cast<char*>(malloc(size));
+      CHECK(block != NULL);
+      blocks_.push_back(block);
+      return block;
+    }
+    next_ = static_cast<char*>(malloc(kBlockSize));
+    CHECK(next_ != NULL);
+    blocks_.push_back(next_);
+    remaining_ = kBlockSize;
+  }
+  void* result = next_;
+  next_ += size;
+  remaining_ -= size;
+  return result;
+}
+
+void* ArenaAllocated::operator new(size_t size) {
+  return AllocateWithHeader(size, NULL);
+}
+
+void* ArenaAllocated::operator new(size_t size, Arena* arena) {
+  return AllocateWithHeader(size, arena);
+}
+
+void ArenaAllocated::operator delete(void* ptr) {
+  if (ptr != NULL) {
+    AllocationHeader* header = static_cast<AllocationHeader*>(ptr) - 1;
+    if (!header->in_arena) {
+      free(header);
+    }
+  }
+}
+
+void ArenaAllocated::operator delete(void* ptr, Arena* arena) {
+  operator delete(ptr);
+}
+
+}  // namespace Css
@@ -0,0 +1,80 @@
+/**
+ * Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Bump allocation for the CSS AST.  A Stylesheet parsed with
+// Parser::set_use_arena(true) allocates its nodes out of one Arena that it
+// owns, instead of making a separate heap allocation for every Value,
+// Declaration and Ruleset.
+
+#ifndef WEBUTIL_CSS_ARENA_H__
+#define WEBUTIL_CSS_ARENA_H__
+
+#include <stddef.h>
+#include <vector>
+
+#include "base/macros.h"
+
+namespace Css {
+
+// Hands out memory by bumping a pointer through large blocks.  Nothing is
+// returned to the heap until the Arena itself is destroyed, at which point
+// all the blocks are freed in one go.  Destructors of the objects placed in
+// the arena are not run by the Arena.
+class Arena {
+ public:
+  Arena();
+  ~Arena();
+
+  // Returns size bytes, aligned for any of the types stored in the AST.
+  void* Allocate(size_t size);
+
+ private:
+  static const size_t kBlockSize;
+
+  std::vector<char*> blocks_;
+  char* next_;       // Next free byte in the current block.
+  size_t remaining_;  // Bytes left in the current block.
+
+  DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+// Base class for the AST node types.  Objects allocated with
+// 'new (arena) T(...)' live in the arena, and objects allocated with plain
+// 'new T(...)' (or with a NULL arena) live on the heap as before.  Both can
+// be released with 'delete', so code that edits a parsed tree -- replacing a
+// Value, erasing a Declaration -- need not know where the nodes came from:
+// deleting an arena node runs its destructor but leaves the memory to the
+// Arena.
+//
+// Each allocation is prefixed by a small header recording where it came
+// from.  There is no virtual destructor, so as with the rest of the AST,
+// objects must be deleted through their own type.
+class ArenaAllocated {
+ public:
+  static void* operator new(size_t size);
+  static void* operator new(size_t size, Arena* arena);
+  static void operator delete(void* ptr);
+  // Matches the placement form above; only used if a constructor throws.
+  static void operator delete(void* ptr, Arena* arena);
+
+ protected:
+  ArenaAllocated() {}
+  ~ArenaAllocated() {}
+};
+
+}  // namespace Css
+
+#endif  // WEBUTIL_CSS_ARENA_H__
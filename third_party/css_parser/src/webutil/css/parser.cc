@@ -81,6 +81,8 @@ Parser::Parser(const char* utf8text, const char* textend)
       quirks_mode_(true),
       preservation_mode_(false),
       max_function_depth_(kDefaultMaxFunctionDepth),
+      use_arena_(false),
+      arena_(NULL),
       errors_seen_mask_(kNoError),
       unparseable_sections_seen_mask_(kNoError) {
 }
@@ -92,6 +94,8 @@ Parser::Parser(const char* utf8text)
       quirks_mode_(true),
       preservation_mode_(false),
       max_function_depth_(kDefaultMaxFunctionDepth),
+      use_arena_(false),
+      arena_(NULL),
       errors_seen_mask_(kNoError),
       unparseable_sections_seen_mask_(kNoError) {
 }
@@ -103,6 +107,8 @@ Parser::Parser(StringPiece s)
       quirks_mode_(true),
       preservation_mode_(false),
       max_function_depth_(kDefaultMaxFunctionDepth),
+      use_arena_(false),
+      arena_(NULL),
       errors_seen_mask_(kNoError),
       unparseable_sections_seen_mask_(kNoError) {
 }
@@ -622,6 +628,14 @@ UnicodeText Parser::ParseStringOrIdent() {
   }
 }
 
+void Parser::SetBytesInOriginalBuffer(const StringPiece& bytes, Value* value) {
+  if (arena_ != NULL) {
+    value->alias_bytes_in_original_buffer(bytes);
+  } else {
+    value->set_bytes_in_original_buffer(bytes);
+  }
+}
+
 template <char delim>
 Value* Parser::ParseStringValue() {
   Tracer trace(__func__, this);
@@ -629,9 +643,9 @@ Value* Parser::ParseStringValue() {
   const char* oldin = in_;
   UnicodeText string_contents = ParseString<delim>();
   StringPiece verbatim_bytes(oldin, in_ - oldin);
-  Value* value = new Value(Value::STRING, string_contents);
+  Value* value = new (arena_) Value(Value::STRING, string_contents);
   if (preservation_mode_) {
-    value->set_bytes_in_original_buffer(verbatim_bytes);
+    SetBytesInOriginalBuffer(verbatim_bytes, value);
   }
 
   return value;
@@ -674,20 +688,20 @@ Value* Parser::ParseNumber() {
   StringPiece verbatim_bytes(begin, in_ - begin);
   Value* value;
   if (Done()) {
-    value = new Value(num, Value::NO_UNIT);
+    value = new (arena_) Value(num, Value::NO_UNIT);
   } else if (*in_ == '%') {
     in_++;
-    value = new Value(num, Value::PERCENT);
+    value = new (arena_) Value(num, Value::PERCENT);
   } else if (StartsIdent(*in_)) {
-    value = new Value(num, ParseIdent());
+    value = new (arena_) Value(num, ParseIdent());
   } else {
-    value = new Value(num, Value::NO_UNIT);
+    value = new (arena_) Value(num, Value::NO_UNIT);
   }
 
   if (preservation_mode_) {
     // Store verbatim bytes so that we can reconstruct this with exactly the
     // same precision.
-    value->set_bytes_in_original_buffer(verbatim_bytes);
+    SetBytesInOriginalBuffer(verbatim_bytes, value);
   }
 
   return value;
@@ -793,7 +807,7 @@ HtmlColor Parser::ParseColor() {
 // Both commas and spaces are allowed as separators and are remembered.
 FunctionParameters* Parser::ParseFunction(int max_function_depth) {
   Tracer trace(__func__, this);
-  scoped_ptr<FunctionParameters> params(new FunctionParameters);
+  scoped_ptr<FunctionParameters> params(new (arena_) FunctionParameters);
 
   SkipSpace();
   // Separator before next value. Initial value doesn't matter.
@@ -889,7 +903,7 @@ Value* Parser::ParseRgbColor() {
       break;
 
     if (*in_ == ')')
-      return new Value(HtmlColor(rgb[0], rgb[1], rgb[2]));
+      return new (arena_) Value(HtmlColor(rgb[0], rgb[1], rgb[2]));
 
     DCHECK_EQ(',', *in_);
     in_++;
@@ -936,7 +950,7 @@ Value* Parser::ParseUrl() {
   }
   SkipSpace();
   if (!Done() && *in_ == ')')
-    return new Value(Value::URI, s);
+    return new (arena_) Value(Value::URI, s);
 
   return NULL;
 }
@@ -952,7 +966,7 @@ Value* Parser::ParseAnyExpectingColor() {
   const char* oldin = in_;
   HtmlColor c = ParseColor();
   if (c.IsDefined()) {
-    toret = new Value(c);
+    toret = new (arena_) Value(c);
   } else {
     in_ = oldin;  // no valid color.  rollback.
     toret = ParseAny();
@@ -1007,14 +1021,14 @@ Value* Parser::ParseAnyWithFunctionDepth(int max_function_depth) {
     case '#': {
       HtmlColor color = ParseColor();
       if (color.IsDefined())
-        toret = new Value(color);
+        toret = new (arena_) Value(color);
       else
         toret = NULL;
       break;
     }
     case ',':
       // TODO(sligocki): Add other possible value tokens like DELIM.
-      toret = new Value(Value::COMMA);
+      toret = new (arena_) Value(Value::COMMA);
       in_++;
       break;
     case '+':
@@ -1043,7 +1057,7 @@ Value* Parser::ParseAnyWithFunctionDepth(int max_function_depth) {
             scoped_ptr<FunctionParameters> params(
                 ParseFunction(max_function_depth - 1));
             if (params.get() != NULL && params->size() == 4) {
-              toret = new Value(Value::RECT, params.release());
+              toret = new (arena_) Value(Value::RECT, params.release());
             } else {
               ReportParsingError(kFunctionError, "Could not parse parameters "
                                  "for function rect");
@@ -1052,7 +1066,7 @@ Value* Parser::ParseAnyWithFunctionDepth(int max_function_depth) {
             scoped_ptr<FunctionParameters> params(
                 ParseFunction(max_function_depth - 1));
             if (params.get() != NULL) {
-              toret = new Value(id, params.release());
+              toret = new (arena_) Value(id, params.release());
             } else {
               ReportParsingError(kFunctionError, StringPrintf(
                   "Could not parse function parameters for function %s",
@@ -1069,7 +1083,7 @@ Value* Parser::ParseAnyWithFunctionDepth(int max_function_depth) {
         }
         SkipPastDelimiter(')');
       } else {
-        toret = new Value(Identifier(id));
+        toret = new (arena_) Value(Identifier(id));
       }
       break;
     }
@@ -1112,13 +1126,13 @@ Values* Parser::ParseValues(Property::Prop prop) {
   Tracer trace(__func__, this);
 
   SkipSpace();
-  if (Done()) return new Values();
+  if (Done()) return new (arena_) Values();
   DCHECK_LT(in_, end_);
 
   // If expecting_color is true, color values are expected.
   bool expecting_color = IsPropExpectingColor(prop);
 
-  scoped_ptr<Values> values(new Values);
+  scoped_ptr<Values> values(new (arena_) Values);
   // Note: We skip over all blocks and at-keywords and only parse "any"s.
   //   value : [ any | block | ATKEYWORD S* ]+;
   // TODO(sligocki): According to the spec, if we cannot parse one of the
@@ -1366,7 +1380,7 @@ bool Parser::ParseFontFamily(Values* values) {
           family.push_back(static_cast<char32>(' '));
           family.append(v->GetIdentifierText());
         }
-        values->push_back(new Value(Identifier(family)));
+        values->push_back(new (arena_) Value(Identifier(family)));
         break;
       }
       default:
@@ -1400,7 +1414,7 @@ Values* Parser::ParseFont() {
   if (Done()) return NULL;
   DCHECK_LT(in_, end_);
 
-  scoped_ptr<Values> values(new Values);
+  scoped_ptr<Values> values(new (arena_) Values);
 
   if (!SkipToNextAny())
     return NULL;
@@ -1433,11 +1447,11 @@ Values* Parser::ParseFont() {
     }
   }
 
-  scoped_ptr<Value> font_style(new Value(Identifier::NORMAL));
-  scoped_ptr<Value> font_variant(new Value(Identifier::NORMAL));
-  scoped_ptr<Value> font_weight(new Value(Identifier::NORMAL));
-  scoped_ptr<Value> font_size(new Value(Identifier::MEDIUM));
-  scoped_ptr<Value> line_height(new Value(Identifier::NORMAL));
+  scoped_ptr<Value> font_style(new (arena_) Value(Identifier::NORMAL));
+  scoped_ptr<Value> font_variant(new (arena_) Value(Identifier::NORMAL));
+  scoped_ptr<Value> font_weight(new (arena_) Value(Identifier::NORMAL));
+  scoped_ptr<Value> font_size(new (arena_) Value(Identifier::MEDIUM));
+  scoped_ptr<Value> line_height(new (arena_) Value(Identifier::NORMAL));
   scoped_ptr<Value> font_family;
 
   // parse style, variant and weight
@@ -1604,22 +1618,22 @@ static void ExpandShorthandProperties(Declarations* declarations,
         LOG(ERROR) << "font: values are not in the correct format.\n" << vals;
         break;
       }
-      declarations->push_back(
-          new Declaration(Property::FONT_STYLE, *vals->get(0), important));
-      declarations->push_back(
-          new Declaration(Property::FONT_VARIANT, *vals->get(1), important));
-      declarations->push_back(
-          new Declaration(Property::FONT_WEIGHT, *vals->get(2), important));
-      declarations->push_back(
-          new Declaration(Property::FONT_SIZE, *vals->get(3), important));
-      declarations->push_back(
-          new Declaration(Property::LINE_HEIGHT, *vals->get(4), important));
+      declarations->push_back(new (arena_) Declaration(
+          Property::FONT_STYLE, *vals->get(0), important));
+      declarations->push_back(new (arena_) Declaration(
+          Property::FONT_VARIANT, *vals->get(1), important));
+      declarations->push_back(new (arena_) Declaration(
+          Property::FONT_WEIGHT, *vals->get(2), important));
+      declarations->push_back(new (arena_) Declaration(
+          Property::FONT_SIZE, *vals->get(3), important));
+      declarations->push_back(new (arena_) Declaration(
+          Property::LINE_HEIGHT, *vals->get(4), important));
       if (vals->size() > 5) {
-        Values* family_vals = new Values;
+        Values* family_vals = new (arena_) Values;
         for (int i = 5, n = vals->size(); i < n; ++i)
-          family_vals->push_back(new Value(*vals->get(i)));
-        declarations->push_back(
-            new Declaration(Property::FONT_FAMILY, family_vals, important));
+          family_vals->push_back(new (arena_) Value(*vals->get(i)));
+        declarations->push_back(new (arena_) Declaration(
+            Property::FONT_FAMILY, family_vals, important));
       }
     }
       break;
@@ -1640,10 +1654,10 @@ Declarations* Parser::ParseRawDeclarations() {
   Tracer trace(__func__, this);
 
   SkipSpace();
-  if (Done()) return new Declarations();
+  if (Done()) return new (arena_) Declarations();
   DCHECK_LT(in_, end_);
 
-  Declarations* declarations = new Declarations();
+  Declarations* declarations = new (arena_) Declarations();
   while (in_ < end_) {
     // decl_start is saved so that we may pass through verbatim text
     // in case declaration could not be parsed correctly.
@@ -1683,7 +1697,7 @@ Declarations* Parser::ParseRawDeclarations() {
             vals.reset(ParseFont());
             break;
           case Property::FONT_FAMILY:
-            vals.reset(new Values());
+            vals.reset(new (arena_) Values());
             if (!ParseFontFamily(vals.get()) || vals->empty()) {
               vals.reset(NULL);
             }
@@ -1740,7 +1754,7 @@ Declarations* Parser::ParseRawDeclarations() {
         // For example: "foo: bar !important really;" is not valid.
         if (Done() || *in_ == ';' || *in_ == '}') {
           declarations->push_back(
-              new Declaration(prop, vals.release(), important));
+              new (arena_) Declaration(prop, vals.release(), important));
         } else {
           ReportParsingError(kDeclarationError, StringPrintf(
               "Unexpected char %c at end of declaration", *in_));
@@ -1778,7 +1792,8 @@ Declarations* Parser::ParseRawDeclarations() {
         // serialized back out in case it was actually meaningful even though
         // we could not understand it.
         StringPiece bytes_in_original_buffer(decl_start, in_ - decl_start);
-        declarations->push_back(new Declaration(bytes_in_original_buffer));
+        declarations->push_back(
+            new (arena_) Declaration(bytes_in_original_buffer));
         // All errors that occurred sinse we started this declaration are
         // demoted to unparseable sections now that we've saved the dummy
         // element.
@@ -1791,7 +1806,7 @@ Declarations* Parser::ParseRawDeclarations() {
 }
 
 Declarations* Parser::ExpandDeclarations(Declarations* orig_declarations) {
-  scoped_ptr<Declarations> new_declarations(new Declarations);
+  scoped_ptr<Declarations> new_declarations(new (arena_) Declarations);
   for (int j = 0; j < orig_declarations->size(); ++j) {
     // new_declarations takes ownership of declaration.
     Declaration* declaration = orig_declarations->at(j);
@@ -1978,7 +1993,8 @@ SimpleSelectors* Parser::ParseSimpleSelectors(bool expecting_combinator) {
         break;
     }
 
-  scoped_ptr<SimpleSelectors> selectors(new SimpleSelectors(combinator));
+  scoped_ptr<SimpleSelectors> selectors(
+      new (arena_) SimpleSelectors(combinator));
 
   SkipSpace();
   if (Done()) return NULL;
@@ -2009,8 +2025,8 @@ Selectors* Parser::ParseSelectors() {
   // selectors.
   bool success = true;
 
-  scoped_ptr<Selectors> selectors(new Selectors());
-  Selector* selector = new Selector();
+  scoped_ptr<Selectors> selectors(new (arena_) Selectors());
+  Selector* selector = new (arena_) Selector();
   selectors->push_back(selector);
 
   // The first simple selector sequence in a chain of simple selector
@@ -2026,7 +2042,7 @@ Selectors* Parser::ParseSelectors() {
           ReportParsingError(kSelectorError,
                              "Could not parse ruleset: unexpected ,");
         } else {
-          selector = new Selector();
+          selector = new (arena_) Selector();
           selectors->push_back(selector);
         }
         in_++;
@@ -2165,7 +2181,7 @@ Ruleset* Parser::ParseRuleset() {
   const char* start_pos = in_;
   const uint64 start_errors_seen_mask = errors_seen_mask_;
 
-  scoped_ptr<Ruleset> ruleset(new Ruleset());
+  scoped_ptr<Ruleset> ruleset(new (arena_) Ruleset());
   scoped_ptr<Selectors> selectors(ParseSelectors());
 
   if (Done()) {
@@ -2183,7 +2199,8 @@ Ruleset* Parser::ParseRuleset() {
   if (selectors.get() == NULL) {
     ReportParsingError(kSelectorError, "Failed to parse selector");
     if (preservation_mode_) {
-      selectors.reset(new Selectors(StringPiece(start_pos, in_ - start_pos)));
+      selectors.reset(
+          new (arena_) Selectors(StringPiece(start_pos, in_ - start_pos)));
       ruleset->set_selectors(selectors.release());
       // All errors that occurred sinse we started this declaration are
       // demoted to unparseable sections now that we've saved the dummy
@@ -2692,11 +2709,13 @@ void Parser::ParseStatement(const MediaQueries* media_queries,
 Stylesheet* Parser::ParseRawStylesheet() {
   Tracer trace(__func__, this);
 
+  Stylesheet* stylesheet =
+      use_arena_ ? new Stylesheet(new Arena) : new Stylesheet();
   SkipSpace();
-  if (Done()) return new Stylesheet();
+  if (Done()) return stylesheet;
   DCHECK_LT(in_, end_);
 
-  Stylesheet* stylesheet = new Stylesheet();
+  arena_ = stylesheet->arena();
   while (in_ < end_) {
     switch (*in_) {
       // HTML-style comments are not allowed in CSS.
@@ -2727,6 +2746,7 @@ Stylesheet* Parser::ParseRawStylesheet() {
 
   DCHECK(Done()) << "Finished parsing before end of document.";
 
+  arena_ = NULL;
   return stylesheet;
 }
 
@@ -2735,6 +2755,7 @@ Stylesheet* Parser::ParseStylesheet() {
 
   Stylesheet* stylesheet = ParseRawStylesheet();
 
+  arena_ = stylesheet->arena();
   Rulesets& rulesets = stylesheet->mutable_rulesets();
   for (int i = 0; i < rulesets.size(); ++i) {
     if (rulesets[i]->type() == Css::Ruleset::RULESET) {
@@ -2742,6 +2763,7 @@ Stylesheet* Parser::ParseStylesheet() {
       rulesets[i]->set_declarations(ExpandDeclarations(&orig_declarations));
     }
   }
+  arena_ = NULL;
 
   return stylesheet;
 }
@@ -27,6 +27,7 @@
 #include "strings/stringpiece.h"
 #include "testing/production_stub/public/gunit_prod.h"
 #include "util/utf8/public/unicodetext.h"
+#include "webutil/css/arena.h"
 #include "webutil/css/media.h"
 #include "webutil/css/property.h"  // while these CSS includes can be
 #include "webutil/css/selector.h"  // forward-declared, who is really
@@ -193,6 +194,21 @@ class Parser {
   void set_max_function_depth(int x) { max_function_depth_ = x; }
   static const int kDefaultMaxFunctionDepth = 10;
 
+  // With use_arena (default off), ParseStylesheet and ParseRawStylesheet
+  // allocate the Values, Declarations, Selectors and Rulesets of the returned
+  // Stylesheet from an Arena owned by the Stylesheet, which frees them all at
+  // once when it is deleted.  In preservation mode the verbatim bytes of
+  // those Values point into the parser's input instead of being copied.
+  //
+  // So, in this mode:
+  //  * the input text must outlive the returned Stylesheet, and
+  //  * nodes must not be moved out of the Stylesheet into anything that
+  //    outlives it (deep copies, as made by Value's copy constructor, are
+  //    fine).
+  // Nodes may still be deleted and replaced with heap-allocated ones.
+  bool use_arena() const { return use_arena_; }
+  void set_use_arena(bool x) { use_arena_ = x; }
+
   // This is a bitmask of errors seen during the parse.  This is decidedly
   // incomplete --- there are definitely many errors that are not reported here.
   static const uint64 kNoError           = 0;
@@ -386,6 +402,10 @@ class Parser {
   // which has bytes_in_original_buffer set.
   template<char delim> Value* ParseStringValue();
 
+  // Stores bytes as value's bytes_in_original_buffer, aliasing them rather
+  // than copying when parsing into an arena.
+  void SetBytesInOriginalBuffer(const StringPiece& bytes, Value* value);
+
   // ParseNumber parses a number and an optional unit, consuming to
   // the end of the number or unit and returning a Value*.
   // Real numbers and integers are specified in decimal notation
@@ -607,6 +627,10 @@ class Parser {
   bool preservation_mode_;
   int max_function_depth_;
 
+  bool use_arena_;
+  // The arena of the Stylesheet being parsed, if use_arena_, else NULL.
+  Arena* arena_;
+
   // errors_seen_mask_ is non-zero iff we failed to parse part of the CSS
   // and could not recover and so we have lost information.
   uint64 errors_seen_mask_;
@@ -657,7 +681,7 @@ class Parser {
 // A declaration consists of a property name (Property) and a list
 // of values (Values*).
 // It could also be important (font: 12pt Arial !important).
-class Declaration {
+class Declaration : public ArenaAllocated {
  public:
   // constructor.  We take ownership of v.
   Declaration(Property p, Values* v, bool important)
@@ -719,7 +743,8 @@ class Declaration {
 // Declarations, you are responsible for deleting them.
 // Also, be careful --- there's no virtual destructor, so this must be
 // deleted as a Declarations.
-class Declarations : public std::vector<Declaration*> {
+class Declarations : public std::vector<Declaration*>,
+                     public ArenaAllocated {
  public:
   Declarations() : std::vector<Declaration*>() { }
   ~Declarations();
@@ -765,7 +790,7 @@ class UnparsedRegion {
 // Unparsed regions between Rulesets can also be stored here in preservation
 // mode. For example, at-rules can be interspersed with Rulesets, for those
 // that we don't parse, they are stored in dummy Rulesets.
-class Ruleset {
+class Ruleset : public ArenaAllocated {
  public:
   // TODO(sligocki): Allow other parsed at-rules, like @page.
   enum Type { RULESET, UNPARSED_REGION, };
@@ -944,6 +969,13 @@ class FontFaces : public std::vector<Css::FontFace*> {
 class Stylesheet {
  public:
   Stylesheet() : type_(AUTHOR) {}
+  // Takes ownership of arena, from which the parser allocates this
+  // Stylesheet's nodes.  See Parser::set_use_arena.
+  explicit Stylesheet(Arena* arena) : arena_(arena), type_(AUTHOR) {}
+
+  // The arena holding this Stylesheet's nodes, or NULL if they are all
+  // heap-allocated.
+  Arena* arena() const { return arena_.get(); }
 
   // USER is currently unused.
   enum StylesheetType { AUTHOR, USER, SYSTEM };
@@ -968,6 +1000,8 @@ class Stylesheet {
 
   string ToString() const;
  private:
+  // Declared first so that it is destroyed after the nodes it holds.
+  scoped_ptr<Arena> arena_;
   StylesheetType type_;
   Charsets charsets_;
   Imports imports_;
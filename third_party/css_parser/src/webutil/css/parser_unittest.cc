@@ -2732,4 +2732,52 @@ TEST_F(ParserTest, BadPartialImportEncoding) {
   EXPECT_NE(Parser::kNoError, parser.errors_seen_mask());
 }
 
+TEST_F(ParserTest, Arena) {
+  const char kText[] =
+      "@import url(foo.css);\n"
+      ".a, div > p:hover { color: red; width: 1.50em; font: 12px Arial }\n"
+      "@media print { .b { background: url(x.png) no-repeat } }\n"
+      "@unknown { foo: bar }\n"
+      ".c { content: 'x\\'y'; margin: 0 auto; z-i ndex: 42 }\n";
+  Parser heap_parser(kText);
+  heap_parser.set_preservation_mode(true);
+  scoped_ptr<Stylesheet> heap_stylesheet(heap_parser.ParseStylesheet());
+  EXPECT_TRUE(heap_stylesheet->arena() == NULL);
+
+  Parser arena_parser(kText);
+  arena_parser.set_preservation_mode(true);
+  arena_parser.set_use_arena(true);
+  scoped_ptr<Stylesheet> arena_stylesheet(arena_parser.ParseStylesheet());
+  EXPECT_TRUE(arena_stylesheet->arena() != NULL);
+  EXPECT_EQ(heap_stylesheet->ToString(), arena_stylesheet->ToString());
+  EXPECT_EQ(heap_parser.errors_seen_mask(), arena_parser.errors_seen_mask());
+  EXPECT_EQ(heap_parser.unparseable_sections_seen_mask(),
+            arena_parser.unparseable_sections_seen_mask());
+
+  // Verbatim bytes refer to the input, and copies own theirs.
+  const Value* width =
+      arena_stylesheet->ruleset(0).declaration(1).values()->get(0);
+  EXPECT_EQ("1.50", width->bytes_in_original_buffer());
+  EXPECT_TRUE(width->bytes_in_original_buffer().data() >= kText &&
+              width->bytes_in_original_buffer().data() < kText + sizeof(kText));
+  Value copy(*width);
+  EXPECT_EQ("1.50", copy.bytes_in_original_buffer());
+  EXPECT_NE(width->bytes_in_original_buffer().data(),
+            copy.bytes_in_original_buffer().data());
+
+  // Arena nodes can be replaced by heap nodes.
+  Values* values = arena_stylesheet->mutable_rulesets()[0]
+      ->mutable_declarations()[1]->mutable_values();
+  delete values->at(0);
+  values->at(0) = new Value(2, Value::PX);
+  arena_stylesheet->mutable_rulesets()[0]->set_declarations(new Declarations);
+
+  // The arena is only used while parsing a stylesheet.
+  Parser declarations_parser("color: red");
+  declarations_parser.set_use_arena(true);
+  scoped_ptr<Declarations> declarations(
+      declarations_parser.ParseDeclarations());
+  EXPECT_EQ(1, declarations->size());
+}
+
 }  // namespace Css
@@ -26,6 +26,7 @@
 #include "base/logging.h"
 #include "strings/stringpiece.h"
 #include "util/utf8/public/unicodetext.h"
+#include "webutil/css/arena.h"
 #include "webutil/css/string.h"
 #include "webutil/html/htmltagenum.h"
 #include "webutil/html/htmltagindex.h"
@@ -248,7 +249,8 @@ class SimpleSelector {
 // combinator() is NONE, F's combinator is CHILD, and G's combinator
 // is SIBLING.
 // ------------
-class SimpleSelectors : public std::vector<SimpleSelector*> {
+class SimpleSelectors : public std::vector<SimpleSelector*>,
+                        public ArenaAllocated {
  public:
   enum Combinator {
     NONE,         // first one in the chain
@@ -279,7 +281,8 @@ class SimpleSelectors : public std::vector<SimpleSelector*> {
 // combinators.  Each SimpleSelectors stores the combinator between
 // it and the previous one in the chain.
 // ------------
-class Selector: public std::vector<SimpleSelectors*> {
+class Selector : public std::vector<SimpleSelectors*>,
+                 public ArenaAllocated {
  public:
   Selector() { }
   ~Selector();
@@ -298,7 +301,7 @@ class Selector: public std::vector<SimpleSelectors*> {
 // When several selectors share the same declarations, they may be
 // grouped into a comma-separated list:
 // ------------
-class Selectors: public std::vector<Selector*> {
+class Selectors : public std::vector<Selector*>, public ArenaAllocated {
  public:
   Selectors() : is_dummy_(false) {}
   // Dummy Selectors
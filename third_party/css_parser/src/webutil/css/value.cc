@@ -112,7 +112,9 @@ Value::Value(const Value& other)
     str_(other.str_),
     params_(new FunctionParameters),
     color_(other.color_),
-    bytes_in_original_buffer_(other.bytes_in_original_buffer_) {
+    owned_bytes_in_original_buffer_(other.bytes_in_original_buffer_.data(),
+                                    other.bytes_in_original_buffer_.size()) {
+  bytes_in_original_buffer_ = owned_bytes_in_original_buffer_;
   if (other.params_.get() != NULL) {
     params_->Copy(*other.params_);
   }
@@ -126,7 +128,7 @@ Value& Value::operator=(const Value& other) {
   identifier_ = other.identifier_;
   str_ = other.str_;
   color_ = other.color_;
-  bytes_in_original_buffer_ = other.bytes_in_original_buffer_;
+  set_bytes_in_original_buffer(other.bytes_in_original_buffer_);
   if (other.params_.get() != NULL) {
     params_->Copy(*other.params_);
   } else {
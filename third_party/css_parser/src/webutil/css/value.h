@@ -29,6 +29,7 @@
 #include "base/macros.h"
 #include "strings/stringpiece.h"
 #include "util/utf8/public/unicodetext.h"
+#include "webutil/css/arena.h"
 #include "webutil/css/identifier.h"
 #include "webutil/css/string.h"
 #include "webutil/html/htmlcolor.h"
@@ -51,7 +52,7 @@ class Values;
 // is set by the constructor and accessed with GetLexicalUnitType().
 // The values are also set by the constructor and accessed with the
 // various accessors.
-class Value {
+class Value : public ArenaAllocated {
  public:
   enum ValueType { NUMBER, URI, FUNCTION, RECT, COLOR, STRING, IDENT, COMMA,
                    UNKNOWN, DEFAULT };
@@ -145,7 +146,15 @@ class Value {
     return bytes_in_original_buffer_;
   }
   void set_bytes_in_original_buffer(const StringPiece& bytes) {
-    bytes.CopyToString(&bytes_in_original_buffer_);
+    bytes.CopyToString(&owned_bytes_in_original_buffer_);
+    bytes_in_original_buffer_ = owned_bytes_in_original_buffer_;
+  }
+  // Like set_bytes_in_original_buffer, but refers to bytes instead of
+  // copying them, so bytes must outlive this Value.  Used when parsing into
+  // an Arena.  Copies of this Value own their bytes.
+  void alias_bytes_in_original_buffer(const StringPiece& bytes) {
+    owned_bytes_in_original_buffer_.clear();
+    bytes_in_original_buffer_ = bytes;
   }
 
  private:
@@ -157,7 +166,10 @@ class Value {
   scoped_ptr<FunctionParameters> params_;  // FUNCTION and RECT params
   HtmlColor color_;           // COLOR
 
-  string bytes_in_original_buffer_;
+  // Points into owned_bytes_in_original_buffer_ or, for aliased bytes, into
+  // the parser's input.
+  StringPiece bytes_in_original_buffer_;
+  string owned_bytes_in_original_buffer_;
 
   // kDimensionUnitText stores the name of each unit (see TextFromUnit)
   static const char* const kDimensionUnitText[];
@@ -168,7 +180,7 @@ class Value {
 // responsible for deleting them.
 // Also, be careful --- there's no virtual destructor, so this must be
 // deleted as a Values.
-class Values : public std::vector<Value*> {
+class Values : public std::vector<Value*>, public ArenaAllocated {
  public:
   Values() : std::vector<Value*>() { }
   ~Values();
@@ -194,7 +206,7 @@ class Values : public std::vector<Value*> {
 // are interpretted correctly. Only the original mix of spaces and commas.
 //
 // FunctionParameters will delete all of its stored Value*'s on destruction.
-class FunctionParameters {
+class FunctionParameters : public ArenaAllocated {
  public:
   enum Separator {
     COMMA_SEPARATED,